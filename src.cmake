@@ -44,6 +44,7 @@ set(COMMONLIST
     ${COMMON_DIR}/Type.h
     ${COMMON_DIR}/Util.cpp
     ${COMMON_DIR}/Util.h
+    ${COMMON_DIR}/VisBits.h
     ${COMMON_DIR}/cm/cm_load.cpp
     ${COMMON_DIR}/cm/cm_local.h
     ${COMMON_DIR}/cm/cm_patch.cpp
@@ -156,9 +157,11 @@ set(SERVERLIST
     ${ENGINE_DIR}/server/sv_bot.cpp
     ${ENGINE_DIR}/server/sv_ccmds.cpp
     ${ENGINE_DIR}/server/sv_client.cpp
+    ${ENGINE_DIR}/server/sv_download.cpp
     ${ENGINE_DIR}/server/sv_init.cpp
     ${ENGINE_DIR}/server/sv_main.cpp
     ${ENGINE_DIR}/server/sv_net_chan.cpp
+    ${ENGINE_DIR}/server/sv_profile.cpp
     ${ENGINE_DIR}/server/sv_sgame.cpp
     ${ENGINE_DIR}/server/sv_snapshot.cpp
     ${ENGINE_DIR}/server/CryptoChallenge.cpp
@@ -226,6 +229,7 @@ endif()
 # Tests runnable for any engine variant
 set(ENGINETESTLIST ${COMMONTESTLIST}
     ${ENGINE_DIR}/framework/CommandSystemTest.cpp
+    ${ENGINE_DIR}/qcommon/msg_test.cpp
 )
 
 set(QCOMMONLIST
@@ -260,6 +264,7 @@ set(CLIENTBASELIST
     ${ENGINE_DIR}/client/cg_msgdef.h
     ${ENGINE_DIR}/client/client.h
     ${ENGINE_DIR}/client/cl_avi.cpp
+    ${ENGINE_DIR}/client/cl_benchmark.cpp
     ${ENGINE_DIR}/client/cl_cgame.cpp
     ${ENGINE_DIR}/client/cl_console.cpp
     ${ENGINE_DIR}/client/cl_download.cpp
@@ -269,6 +274,8 @@ set(CLIENTBASELIST
     ${ENGINE_DIR}/client/cl_scrn.cpp
     ${ENGINE_DIR}/client/cl_serverlist.cpp
     ${ENGINE_DIR}/client/cl_serverstatus.cpp
+    ${ENGINE_DIR}/client/PingScheduler.cpp
+    ${ENGINE_DIR}/client/PingScheduler.h
     ${ENGINE_DIR}/client/dl_main.cpp
     ${ENGINE_DIR}/client/hunk_allocator.cpp
     ${ENGINE_DIR}/client/key_identification.h
@@ -308,6 +315,7 @@ if (APPLE)
 endif()
 
 set(CLIENTTESTLIST ${ENGINETESTLIST}
+    ${ENGINE_DIR}/client/PingSchedulerTest.cpp
 )
 
 set(TTYCLIENTLIST
@@ -328,6 +336,7 @@ set(DEDSERVERLIST
 set(DUMMYAPPLIST
     ${OMPLIST}
     ${COMMON_DIR}/Util.h
+    ${COMMON_DIR}/VisBits.h
 )
 
 set(WIN_RC ${ENGINE_DIR}/sys/windows-resource/icon.rc)
@@ -215,7 +215,8 @@ namespace VM {
         REGISTER_CVAR,
         GET_CVAR,
         SET_CVAR,
-        ADD_CVAR_FLAGS
+        ADD_CVAR_FLAGS,
+        SET_CVAR_HANDLE
     };
 
     using RegisterCvarMsg = IPC::SyncMessage<
@@ -232,15 +233,27 @@ namespace VM {
         IPC::Message<IPC::Id<CVAR, ADD_CVAR_FLAGS>, std::string, int>,
         IPC::Reply<bool>
     >;
+    // SetCvarMsg for a cvar registered by the VM, identified by its registration order
+    using SetCvarHandleMsg = IPC::SyncMessage<
+        IPC::Message<IPC::Id<CVAR, SET_CVAR_HANDLE>, int, std::string>
+    >;
 
     enum VMCvarMessages {
-        ON_VALUE_CHANGED
+        ON_VALUE_CHANGED,
+        ON_VALUE_CHANGED_BATCH
     };
 
     using OnValueChangedMsg = IPC::SyncMessage<
         IPC::Message<IPC::Id<CVAR, ON_VALUE_CHANGED>, std::string, std::string>,
         IPC::Reply<bool, std::string>
     >;
+    // The new values of the cvars changed since the last message to the VM. The cvars are
+    // identified by the order in which the VM registered them, and get a success and
+    // description each in return.
+    using OnValueChangedBatchMsg = IPC::SyncMessage<
+        IPC::Message<IPC::Id<CVAR, ON_VALUE_CHANGED_BATCH>, std::vector<std::pair<int, std::string>>>,
+        IPC::Reply<std::vector<std::pair<bool, std::string>>>
+    >;
 
     // Log-Related Syscall Definitions
 
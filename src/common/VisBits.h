@@ -0,0 +1,187 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#ifndef COMMON_VISBITS_H_
+#define COMMON_VISBITS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/Platform.h"
+
+// Bit vectors of clusters (PVS) and areas, as used by the collision map,
+// the snapshot code and the renderer
+namespace VisBits {
+
+    // Rows are padded to whole 16 byte blocks, so the collision map and the
+    // renderer agree on the layout of the PVS they share
+    constexpr int ROW_ALIGNMENT = 16;
+
+    inline int RowBytes(int numBits)
+    {
+        return ((numBits + 127) >> 7) << 4;
+    }
+
+    inline bool Test(const uint8_t* bits, int bit)
+    {
+        return bits[bit >> 3] & (1 << (bit & 7));
+    }
+
+    inline void Set(uint8_t* bits, int bit)
+    {
+        bits[bit >> 3] |= 1 << (bit & 7);
+    }
+
+    // dst |= src
+    inline void Or(uint8_t* dst, const uint8_t* src, size_t bytes)
+    {
+        size_t i = 0;
+#if defined(DAEMON_USE_ARCH_INTRINSICS_i686_sse2)
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(d, s));
+        }
+#endif
+        for (; i < bytes; i++) {
+            dst[i] |= src[i];
+        }
+    }
+
+    // dst = a & b
+    inline void And(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t bytes)
+    {
+        size_t i = 0;
+#if defined(DAEMON_USE_ARCH_INTRINSICS_i686_sse2)
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_and_si128(x, y));
+        }
+#endif
+        for (; i < bytes; i++) {
+            dst[i] = a[i] & b[i];
+        }
+    }
+
+    // Whether a & b has any bit set
+    inline bool Intersects(const uint8_t* a, const uint8_t* b, size_t bytes)
+    {
+        size_t i = 0;
+#if defined(DAEMON_USE_ARCH_INTRINSICS_i686_sse2)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(x, y), zero)) != 0xffff) {
+                return true;
+            }
+        }
+#endif
+        for (; i < bytes; i++) {
+            if (a[i] & b[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether any bit is set
+    inline bool Any(const uint8_t* bits, size_t bytes)
+    {
+        size_t i = 0;
+#if defined(DAEMON_USE_ARCH_INTRINSICS_i686_sse2)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xffff) {
+                return true;
+            }
+        }
+#endif
+        for (; i < bytes; i++) {
+            if (bits[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether any bit from first to last, both included, is set
+    inline bool AnyInRange(const uint8_t* bits, int first, int last)
+    {
+        if (first > last) {
+            return false;
+        }
+
+        int firstByte = first >> 3;
+        int lastByte = last >> 3;
+        uint8_t firstMask = 0xff << (first & 7);
+        uint8_t lastMask = 0xff >> (7 - (last & 7));
+
+        if (firstByte == lastByte) {
+            return bits[firstByte] & firstMask & lastMask;
+        }
+
+        return (bits[firstByte] & firstMask) || (bits[lastByte] & lastMask)
+            || Any(bits + firstByte + 1, lastByte - firstByte - 1);
+    }
+
+    // Number of bits set
+    inline int PopCount(const uint8_t* bits, size_t bytes)
+    {
+        size_t i = 0;
+        int count = 0;
+#if defined(DAEMON_USE_ARCH_INTRINSICS_i686_sse2)
+        const __m128i m1 = _mm_set1_epi8(0x55);
+        const __m128i m2 = _mm_set1_epi8(0x33);
+        const __m128i m4 = _mm_set1_epi8(0x0f);
+        __m128i sums = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + i));
+            x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi64(x, 1), m1));
+            x = _mm_add_epi8(_mm_and_si128(x, m2), _mm_and_si128(_mm_srli_epi64(x, 2), m2));
+            x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi64(x, 4)), m4);
+            // sums of the byte counts of each half
+            sums = _mm_add_epi64(sums, _mm_sad_epu8(x, _mm_setzero_si128()));
+        }
+        count = _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+#endif
+        for (; i < bytes; i++) {
+            uint8_t x = bits[i];
+            x = x - ((x >> 1) & 0x55);
+            x = (x & 0x33) + ((x >> 2) & 0x33);
+            count += (x + (x >> 4)) & 0x0f;
+        }
+        return count;
+    }
+}
+
+#endif //COMMON_VISBITS_H_
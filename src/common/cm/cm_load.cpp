@@ -34,6 +34,10 @@ Maryland 20850 USA.
 
 #include "cm_local.h"
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 #include <common/FileSystem.h>
 
 // to allow boxes to be treated as brush models, we allocate
@@ -55,17 +59,21 @@ static cplane_t  *box_planes;
 static cbrush_t  *box_brush;
 
 void      CM_InitBoxHull();
-void      CM_FloodAreaConnections();
 
 Cvar::Cvar<bool> cm_forceTriangles(VM_STRING_PREFIX "cm_forceTriangles", "Convert all patches into triangles?", Cvar::CHEAT | Cvar::ROM, false);
+#ifndef BUILD_VM
+static Cvar::Cvar<int> cm_loadThreads(VM_STRING_PREFIX "cm_loadThreads", "threads generating patch and triangle soup collision on map load, 0 for one per core", Cvar::NONE, 0);
+#endif
 Log::Logger cmLog(VM_STRING_PREFIX "common.cm");
 
 static std::vector<void*> allocations;
+static std::mutex allocationsLock;
 
 void* CM_Alloc( size_t size )
 {
     void* alloc = calloc(size, 1);
     if (!alloc && size) Sys::Error("CM_Alloc: Out of memory");
+    std::lock_guard<std::mutex> lock(allocationsLock);
     allocations.push_back(alloc);
     return alloc;
 }
@@ -79,6 +87,33 @@ void CM_FreeAll()
     allocations.clear();
 }
 
+// Rows of bits are kept aligned and padded for VisBits
+static byte *CM_AllocVisRows( size_t size )
+{
+	uintptr_t alloc = reinterpret_cast<uintptr_t>( CM_Alloc( size + VisBits::ROW_ALIGNMENT - 1 ) );
+	return reinterpret_cast<byte *>( ( alloc + VisBits::ROW_ALIGNMENT - 1 ) & ~uintptr_t( VisBits::ROW_ALIGNMENT - 1 ) );
+}
+
+/*
+=================
+CM_AllocAreas
+
+Allocates cm.numAreas areas with all their portals closed
+=================
+*/
+void CM_AllocAreas()
+{
+	cm.areas = ( cArea_t * ) CM_Alloc( cm.numAreas * sizeof( *cm.areas ) );
+	cm.areaBytes = VisBits::RowBytes( cm.numAreas );
+	cm.floodAreaBits = CM_AllocVisRows( ( cm.numAreas + 1 ) * cm.areaBytes );
+	cm.floodSizes = ( int * ) CM_Alloc( ( cm.numAreas + 1 ) * sizeof( *cm.floodSizes ) );
+
+	for ( int i = 0; i < cm.numAreas; i++ )
+	{
+		cm.areas[ i ].firstPortal = -1;
+	}
+}
+
 /*
 ===============================================================================
 
@@ -353,8 +388,7 @@ static void CMod_LoadLeafs(const byte *const cmod_base, const lump_t *l)
 		}
 	}
 
-	cm.areas = ( cArea_t * ) CM_Alloc( cm.numAreas * sizeof( *cm.areas ) );
-	cm.areaPortals = ( int * ) CM_Alloc( cm.numAreas * cm.numAreas * sizeof( *cm.areaPortals ) );
+	CM_AllocAreas();
 }
 
 /*
@@ -593,14 +627,23 @@ CMod_LoadVisibility
 =================
 */
 static const int VIS_HEADER = 8;
+
+/*
+=================
+CMod_LoadVisibility
+
+The rows are copied to a padded stride, so that whole 16 byte blocks
+can be processed at once.
+=================
+*/
 static void CMod_LoadVisibility(const byte *const cmod_base, const lump_t *l)
 {
 	int len = l->filelen;
 
 	if ( !len )
 	{
-		cm.clusterBytes = ( cm.numClusters + 31 ) & ~31;
-		cm.visibility = ( byte * ) CM_Alloc( cm.clusterBytes );
+		cm.clusterBytes = VisBits::RowBytes( cm.numClusters );
+		cm.visibility = CM_AllocVisRows( cm.clusterBytes );
 		memset( cm.visibility, 255, cm.clusterBytes );
 		return;
 	}
@@ -608,14 +651,152 @@ static void CMod_LoadVisibility(const byte *const cmod_base, const lump_t *l)
 	const byte *buf = cmod_base + l->fileofs;
 
 	cm.vised = true;
-	cm.visibility = ( byte * ) CM_Alloc( len - VIS_HEADER );
 	cm.numClusters = LittleLong( ( ( int * ) buf ) [ 0 ] );
-	cm.clusterBytes = LittleLong( ( ( int * ) buf ) [ 1 ] );
-	memcpy( cm.visibility, buf + VIS_HEADER, len - VIS_HEADER );
+	int fileClusterBytes = LittleLong( ( ( int * ) buf ) [ 1 ] );
+
+	if ( cm.numClusters < 0 || fileClusterBytes < ( cm.numClusters + 7 ) >> 3
+	     || ( len - VIS_HEADER ) / std::max( fileClusterBytes, 1 ) < cm.numClusters )
+	{
+		Sys::Drop( "CMod_LoadVisibility: funny lump size" );
+	}
+
+	cm.clusterBytes = std::max( VisBits::RowBytes( cm.numClusters ), ( fileClusterBytes + 15 ) & ~15 );
+	cm.visibility = CM_AllocVisRows( cm.numClusters * cm.clusterBytes );
+
+	for ( int i = 0; i < cm.numClusters; i++ )
+	{
+		memcpy( cm.visibility + i * cm.clusterBytes, buf + VIS_HEADER + i * fileClusterBytes, fileClusterBytes );
+	}
 }
 
 //==================================================================
 
+/*
+=================
+CMod_GenerateSurfaceCollides
+
+Patches and triangle soups are independent of each other, so their
+collides are generated on worker threads. Each thread has its own plane
+cache, which is reset for every surface, so the result is the same as
+when they are generated one after the other.
+=================
+*/
+struct surfaceCollideJob_t
+{
+	int              surfaceNum;
+	const dsurface_t *in;
+};
+
+static void CMod_GenerateSurfaceCollide( const surfaceCollideJob_t &job, const drawVert_t *dv, const int *index,
+	vec3_t *vertexes, int *indexes )
+{
+	const dsurface_t *in = job.in;
+	cSurface_t *surface = cm.surfaces[ job.surfaceNum ];
+	const drawVert_t *dv_p = dv + LittleLong( in->firstVert );
+
+	if ( surface->type == mapSurfaceType_t::MST_PATCH )
+	{
+		int width = LittleLong( in->patchWidth );
+		int height = LittleLong( in->patchHeight );
+
+		for ( int j = 0; j < width * height; j++, dv_p++ )
+		{
+			vertexes[ j ][ 0 ] = LittleFloat( dv_p->xyz[ 0 ] );
+			vertexes[ j ][ 1 ] = LittleFloat( dv_p->xyz[ 1 ] );
+			vertexes[ j ][ 2 ] = LittleFloat( dv_p->xyz[ 2 ] );
+		}
+
+		// create the internal facet structure
+		surface->sc = CM_GeneratePatchCollide( width, height, vertexes );
+		return;
+	}
+
+	int numVertexes = LittleLong( in->numVerts );
+	int numIndexes = LittleLong( in->numIndexes );
+	const int *index_p = index + LittleLong( in->firstIndex );
+
+	for ( int j = 0; j < numVertexes; j++, dv_p++ )
+	{
+		vertexes[ j ][ 0 ] = LittleFloat( dv_p->xyz[ 0 ] );
+		vertexes[ j ][ 1 ] = LittleFloat( dv_p->xyz[ 1 ] );
+		vertexes[ j ][ 2 ] = LittleFloat( dv_p->xyz[ 2 ] );
+	}
+
+	for ( int j = 0; j < numIndexes; j++, index_p++ )
+	{
+		indexes[ j ] = LittleLong( *index_p );
+	}
+
+	// create the internal facet structure
+	surface->sc = CM_GenerateTriangleSoupCollide( numVertexes, vertexes, numIndexes, indexes );
+}
+
+static void CMod_GenerateSurfaceCollides( const std::vector<surfaceCollideJob_t> &jobs, const drawVert_t *dv, const int *index )
+{
+	if ( jobs.empty() )
+	{
+		return;
+	}
+
+	std::atomic<size_t> nextJob( 0 );
+	// jobs after the lowest failed one are skipped, but the ones before it still run as they may fail too
+	std::atomic<size_t> lowestFailed( jobs.size() );
+	std::mutex          errorLock; // guards lowestFailed updates and errorMessage
+	std::string         errorMessage;
+
+	auto worker = [ & ]()
+	{
+		std::unique_ptr<vec3_t[]> vertexes( new vec3_t[ SHADER_MAX_VERTEXES ] );
+		std::unique_ptr<int[]>    indexes( new int[ SHADER_MAX_INDEXES ] );
+
+		for ( size_t i = nextJob++; i < lowestFailed; i = nextJob++ )
+		{
+			try
+			{
+				CMod_GenerateSurfaceCollide( jobs[ i ], dv, index, vertexes.get(), indexes.get() );
+			}
+			catch ( Sys::DropErr &err )
+			{
+				// report the error of the first surface that failed, as a serial load would
+				std::lock_guard<std::mutex> lock( errorLock );
+
+				if ( i < lowestFailed )
+				{
+					lowestFailed = i;
+					errorMessage = err.what();
+				}
+			}
+		}
+	};
+
+	int numThreads = 1;
+#ifndef BUILD_VM
+	numThreads = cm_loadThreads.Get() > 0 ? cm_loadThreads.Get() : std::thread::hardware_concurrency();
+#endif
+	numThreads = Math::Clamp( numThreads, 1, static_cast<int>( jobs.size() ) );
+
+	std::vector<std::thread> threads;
+
+	for ( int i = 1; i < numThreads; i++ )
+	{
+		threads.emplace_back( worker );
+	}
+
+	worker();
+
+	for ( std::thread &thread : threads )
+	{
+		thread.join();
+	}
+
+	if ( lowestFailed < jobs.size() )
+	{
+		Sys::Drop( errorMessage );
+	}
+
+	cmLog.Debug( "CMod_GenerateSurfaceCollides: %i surfaces on %i threads", jobs.size(), numThreads );
+}
+
 /*
 =================
 CMod_LoadSurfaces
@@ -625,17 +806,14 @@ static const int MAX_PATCH_SIZE  = 64;
 static const int MAX_PATCH_VERTS = ( MAX_PATCH_SIZE * MAX_PATCH_SIZE );
 static void CMod_LoadSurfaces(const byte *const cmod_base, const lump_t *surfs, const lump_t *verts, const lump_t *indexesLump)
 {
-	drawVert_t    *dv, *dv_p;
+	drawVert_t    *dv;
 	dsurface_t    *in;
 	int           count;
 	int           i;
 	cSurface_t    *surface;
 	int           numVertexes;
-	static vec3_t vertexes[ SHADER_MAX_VERTEXES ];
-	int           width, height;
 	int           shaderNum;
 	int           numIndexes;
-	static int    indexes[ SHADER_MAX_INDEXES ];
 	int           *index;
 	int           *index_p;
 
@@ -663,7 +841,10 @@ static void CMod_LoadSurfaces(const byte *const cmod_base, const lump_t *surfs,
 		Sys::Drop( "CMod_LoadSurfaces: funny lump size" );
 	}
 
-	// scan through all the surfaces
+	std::vector<surfaceCollideJob_t> jobs;
+
+	// scan through all the surfaces, validating them here so the
+	// collides can be generated on other threads afterwards
 	for ( i = 0; i < count; i++, in++ )
 	{
 		if ( LittleLong( in->surfaceType ) == mapSurfaceType_t::MST_PATCH )
@@ -672,31 +853,18 @@ static void CMod_LoadSurfaces(const byte *const cmod_base, const lump_t *surfs,
 			cm.surfaces[ i ] = surface = ( cSurface_t * ) CM_Alloc( sizeof( *surface ) );
 			surface->type = mapSurfaceType_t::MST_PATCH;
 
-			// load the full drawverts onto the stack
-			width = LittleLong( in->patchWidth );
-			height = LittleLong( in->patchHeight );
-			numVertexes = width * height;
+			numVertexes = LittleLong( in->patchWidth ) * LittleLong( in->patchHeight );
 
 			if ( numVertexes > MAX_PATCH_VERTS )
 			{
 				Sys::Drop( "CMod_LoadSurfaces: MAX_PATCH_VERTS" );
 			}
 
-			dv_p = dv + LittleLong( in->firstVert );
-
-			for ( int j = 0; j < numVertexes; j++, dv_p++ )
-			{
-				vertexes[ j ][ 0 ] = LittleFloat( dv_p->xyz[ 0 ] );
-				vertexes[ j ][ 1 ] = LittleFloat( dv_p->xyz[ 1 ] );
-				vertexes[ j ][ 2 ] = LittleFloat( dv_p->xyz[ 2 ] );
-			}
-
 			shaderNum = LittleLong( in->shaderNum );
 			surface->contents = cm.shaders[ shaderNum ].contentFlags;
 			surface->surfaceFlags = cm.shaders[ shaderNum ].surfaceFlags;
 
-			// create the internal facet structure
-			surface->sc = CM_GeneratePatchCollide( width, height, vertexes );
+			jobs.push_back( { i, in } );
 		}
 		else if ( LittleLong( in->surfaceType ) == mapSurfaceType_t::MST_TRIANGLE_SOUP && ( cm.perPolyCollision || cm_forceTriangles.Get() ) )
 		{
@@ -705,7 +873,6 @@ static void CMod_LoadSurfaces(const byte *const cmod_base, const lump_t *surfs,
 			cm.surfaces[ i ] = surface = ( cSurface_t * ) CM_Alloc( sizeof( *surface ) );
 			surface->type = mapSurfaceType_t::MST_TRIANGLE_SOUP;
 
-			// load the full drawverts onto the stack
 			numVertexes = LittleLong( in->numVerts );
 
 			if ( numVertexes > SHADER_MAX_VERTEXES )
@@ -713,15 +880,6 @@ static void CMod_LoadSurfaces(const byte *const cmod_base, const lump_t *surfs,
 				Sys::Drop( "CMod_LoadSurfaces: SHADER_MAX_VERTEXES" );
 			}
 
-			dv_p = dv + LittleLong( in->firstVert );
-
-			for ( int j = 0; j < numVertexes; j++, dv_p++ )
-			{
-				vertexes[ j ][ 0 ] = LittleFloat( dv_p->xyz[ 0 ] );
-				vertexes[ j ][ 1 ] = LittleFloat( dv_p->xyz[ 1 ] );
-				vertexes[ j ][ 2 ] = LittleFloat( dv_p->xyz[ 2 ] );
-			}
-
 			numIndexes = LittleLong( in->numIndexes );
 
 			if ( numIndexes > SHADER_MAX_INDEXES )
@@ -733,9 +891,9 @@ static void CMod_LoadSurfaces(const byte *const cmod_base, const lump_t *surfs,
 
 			for ( int j = 0; j < numIndexes; j++, index_p++ )
 			{
-				indexes[ j ] = LittleLong( *index_p );
+				int vertexNum = LittleLong( *index_p );
 
-				if ( indexes[ j ] < 0 || indexes[ j ] >= numVertexes )
+				if ( vertexNum < 0 || vertexNum >= numVertexes )
 				{
 					Sys::Drop( "CMod_LoadSurfaces: Bad index in trisoup surface" );
 				}
@@ -745,10 +903,11 @@ static void CMod_LoadSurfaces(const byte *const cmod_base, const lump_t *surfs,
 			surface->contents = cm.shaders[ shaderNum ].contentFlags;
 			surface->surfaceFlags = cm.shaders[ shaderNum ].surfaceFlags;
 
-			// create the internal facet structure
-			surface->sc = CM_GenerateTriangleSoupCollide( numVertexes, vertexes, numIndexes, indexes );
+			jobs.push_back( { i, in } );
 		}
 	}
+
+	CMod_GenerateSurfaceCollides( jobs, dv, index );
 }
 
 //==================================================================
@@ -32,11 +32,16 @@ Maryland 20850 USA.
 ===========================================================================
 */
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include "cm_public.h"
 #include "cm_polylib.h"
 
 #include "common/Cvar.h"
 #include "common/Log.h"
+#include "common/VisBits.h"
 #include "engine/qcommon/qcommon.h"
 #include "engine/qcommon/qfiles.h"
 
@@ -150,6 +155,15 @@ struct cArea_t
 {
 	int floodnum;
 	int floodvalid;
+	int firstPortal; // index in clipMap_t::areaPortals, -1 if no portal was ever opened
+};
+
+// A portal from an area to another, each pair of areas has one in both directions
+struct cAreaPortal_t
+{
+	int otherArea;
+	int count; // reference count, the portal is open if > 0
+	int next; // next portal of the same area, -1 at the end
 };
 
 struct clipMap_t
@@ -182,7 +196,7 @@ struct clipMap_t
 	cbrush_t     *brushes;
 
 	int          numClusters;
-	int          clusterBytes;
+	int          clusterBytes; // padded to VisBits::RowBytes, rows are 16 byte aligned
 	byte         *visibility;
 	bool     vised; // if false, visibility is just a single cluster of ffs
 
@@ -191,7 +205,11 @@ struct clipMap_t
 
 	int          numAreas;
 	cArea_t      *areas;
-	int          *areaPortals; // [ numAreas*numAreas ] reference counts
+	std::vector<cAreaPortal_t> areaPortals;
+	int          areaBytes;
+	byte         *floodAreaBits; // [ ( numAreas + 1 ) * areaBytes ] the areas in each flood
+	int          *floodSizes; // [ numAreas + 1 ] the number of areas in each flood
+	std::vector<int> freeFloods; // flood numbers not used by any area
 
 	int          numSurfaces;
 	cSurface_t   **surfaces; // non-patches will be nullptr
@@ -279,11 +297,28 @@ cSurfaceCollide_t              *CM_GenerateTriangleSoupCollide( int numVertexes,
 
 void* CM_Alloc( size_t size );
 
+void CM_AllocAreas();
+void CM_FloodAreaConnections();
+
+// Surface collides are generated on worker threads, where Sys::Drop would be a fatal error,
+// so their errors are thrown and dropped again on the main thread by CM_LoadMap
+template<typename ... Args>
+NORETURN void CM_Drop( Str::StringRef format, Args&& ... args )
+{
+	if ( !Sys::OnMainThread() )
+	{
+		throw Sys::DropErr( true, Str::Format( format, std::forward<Args>( args ) ... ) );
+	}
+
+	Sys::Drop( format, std::forward<Args>( args ) ... );
+}
+
 // cm_plane.c
 
 // Temporary plane cache, used during construction of a surface collide
-extern int numTempPlanes;
-extern cPlane_t tempPlanes[];
+// Each thread building surface collides has its own
+extern thread_local int numTempPlanes;
+extern thread_local cPlane_t *tempPlanes;
 
 // Functions acting on the temporary plane cache
 void     CM_ResetPlaneCounts();
@@ -292,8 +327,10 @@ int      CM_FindPlane( const float *p1, const float *p2, const float *p3 );
 planeSide_t CM_PointOnPlaneSide( float *p, int planeNum );
 
 // Temporary facets buffer, used during construction of a surface collide
-extern int numFacets;
-extern cFacet_t facets[];
+extern thread_local int numFacets;
+extern thread_local cFacet_t *facets;
+
+void     CM_CopyTempPlanesAndFacets( cSurfaceCollide_t *sc );
 
 bool CM_ValidateFacet( cFacet_t *facet );
 void     CM_AddFacetBevels( cFacet_t *facet );
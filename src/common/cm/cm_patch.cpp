@@ -36,7 +36,7 @@ Maryland 20850 USA.
 
 #include "cm_patch.h"
 
-static int                     c_totalPatchBlocks;
+static std::atomic<int>        c_totalPatchBlocks;
 
 /*
 ================================================================================
@@ -457,7 +457,7 @@ static int CM_EdgePlaneNum( cGrid_t *grid, int gridPlanes[ MAX_GRID_SIZE ][ MAX_
 			return CM_FindPlane( p1, p2, up );
 	}
 
-	Sys::Drop( "CM_EdgePlaneNum: bad k" );
+	CM_Drop( "CM_EdgePlaneNum: bad k" );
 }
 
 /*
@@ -664,7 +664,7 @@ static void CM_SurfaceCollideFromGrid( cGrid_t *grid, cSurfaceCollide_t *sc )
 
 			if ( numFacets == SHADER_MAX_TRIANGLES )
 			{
-				Sys::Drop( "MAX_FACETS" );
+				CM_Drop( "MAX_FACETS" );
 			}
 
 			facet = &facets[ numFacets ];
@@ -720,7 +720,7 @@ static void CM_SurfaceCollideFromGrid( cGrid_t *grid, cSurfaceCollide_t *sc )
 
 				if ( numFacets == SHADER_MAX_TRIANGLES )
 				{
-					Sys::Drop( "MAX_FACETS" );
+					CM_Drop( "MAX_FACETS" );
 				}
 
 				facet = &facets[ numFacets ];
@@ -754,12 +754,7 @@ static void CM_SurfaceCollideFromGrid( cGrid_t *grid, cSurfaceCollide_t *sc )
 	}
 
 	// copy the results out
-	sc->numPlanes = numTempPlanes;
-	sc->numFacets = numFacets;
-	sc->facets = ( cFacet_t * ) CM_Alloc( numFacets * sizeof( *sc->facets ) );
-	std::copy_n( facets, numFacets, sc->facets );
-	sc->planes = ( cPlane_t * ) CM_Alloc( numTempPlanes * sizeof( *sc->planes ) );
-	std::copy_n( tempPlanes, numTempPlanes, sc->planes );
+	CM_CopyTempPlanesAndFacets( sc );
 }
 
 /*
@@ -780,17 +775,17 @@ cSurfaceCollide_t *CM_GeneratePatchCollide( int width, int height, const vec3_t
 
 	if ( width <= 2 || height <= 2 || !points )
 	{
-		Sys::Drop( "CM_GeneratePatchFacets: bad parameters: (%i, %i, %p)", width, height, ( void * ) points );
+		CM_Drop( "CM_GeneratePatchFacets: bad parameters: (%i, %i, %p)", width, height, ( void * ) points );
 	}
 
 	if ( !( width & 1 ) || !( height & 1 ) )
 	{
-		Sys::Drop( "CM_GeneratePatchFacets: even sizes are invalid for quadratic meshes" );
+		CM_Drop( "CM_GeneratePatchFacets: even sizes are invalid for quadratic meshes" );
 	}
 
 	if ( width > MAX_GRID_SIZE || height > MAX_GRID_SIZE )
 	{
-		Sys::Drop( "CM_GeneratePatchFacets: source is > MAX_GRID_SIZE" );
+		CM_Drop( "CM_GeneratePatchFacets: source is > MAX_GRID_SIZE" );
 	}
 
 	// build a grid
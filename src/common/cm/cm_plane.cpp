@@ -37,13 +37,24 @@ Maryland 20850 USA.
 constexpr float PLANE_TRI_EPSILON = 0.1f;
 
 static const int PLANE_HASHES = 8192;
-static cPlane_t *planeHashTable[ PLANE_HASHES ];
 
-int      numTempPlanes;
-cPlane_t tempPlanes[ SHADER_MAX_TRIANGLES ];
+// allocated the first time a thread builds a surface collide, rather than
+// as thread_local arrays which every thread of the process would pay for
+struct planeCache_t
+{
+	cPlane_t *hashTable[ PLANE_HASHES ];
+	cPlane_t planes[ SHADER_MAX_TRIANGLES ];
+	cFacet_t facets[ SHADER_MAX_TRIANGLES ];
+};
+
+static thread_local std::unique_ptr<planeCache_t> planeCache;
+static thread_local cPlane_t **planeHashTable;
+
+thread_local int      numTempPlanes;
+thread_local cPlane_t *tempPlanes;
 
-int      numFacets;
-cFacet_t facets[ SHADER_MAX_TRIANGLES ];
+thread_local int      numFacets;
+thread_local cFacet_t *facets;
 
 /*
 =================
@@ -53,10 +64,42 @@ CM_ResetPlaneCounts
 
 void CM_ResetPlaneCounts()
 {
-	memset( planeHashTable, 0, sizeof( planeHashTable ) );
+	if ( !planeCache )
+	{
+		planeCache.reset( new planeCache_t );
+		planeHashTable = planeCache->hashTable;
+		tempPlanes = planeCache->planes;
+		facets = planeCache->facets;
+	}
+
+	memset( planeHashTable, 0, sizeof( planeCache->hashTable ) );
 	numTempPlanes = 0;
 	numFacets = 0;
 }
+
+/*
+=================
+CM_CopyTempPlanesAndFacets
+
+The hash chains point into this thread's plane cache, they are cleared
+so the result doesn't depend on which thread built it
+=================
+*/
+void CM_CopyTempPlanesAndFacets( cSurfaceCollide_t *sc )
+{
+	sc->numPlanes = numTempPlanes;
+	sc->planes = ( cPlane_t * ) CM_Alloc( numTempPlanes * sizeof( *sc->planes ) );
+	std::copy_n( tempPlanes, numTempPlanes, sc->planes );
+
+	for ( int i = 0; i < numTempPlanes; i++ )
+	{
+		sc->planes[ i ].hashChain = nullptr;
+	}
+
+	sc->numFacets = numFacets;
+	sc->facets = ( cFacet_t * ) CM_Alloc( numFacets * sizeof( *sc->facets ) );
+	std::copy_n( facets, numFacets, sc->facets );
+}
 /*
 =================
 CM_SignbitsForNormal
@@ -208,7 +251,7 @@ static int CM_CreateNewFloatPlane( const plane_t &plane )
 	// create a new plane
 	if ( numTempPlanes == SHADER_MAX_TRIANGLES )
 	{
-		Sys::Drop( "CM_FindPlane: SHADER_MAX_TRIANGLES" );
+		CM_Drop( "CM_FindPlane: SHADER_MAX_TRIANGLES" );
 	}
 
 	p = &tempPlanes[ numTempPlanes ];
@@ -638,7 +681,7 @@ void CM_AddFacetBevels( cFacet_t *facet )
 
 	// add opposite plane
 	if ( facet->numBorders >= MAX_FACET_BEVELS ) {
-		Sys::Drop( "too many bevels" );
+		CM_Drop( "too many bevels" );
 		return;
 	}
 	facet->borderPlanes[ facet->numBorders ] = facet->surfacePlane;
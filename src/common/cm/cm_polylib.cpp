@@ -36,12 +36,11 @@ Maryland 20850 USA.
 
 #include "cm_local.h"
 
-// counters are only bumped when running single threaded,
-// because they are an awefull coherence problem
-static int c_active_windings;
-static int c_peak_windings;
-static int c_winding_allocs;
-static int c_winding_points;
+// windings are also made while building surface collides on worker threads
+static std::atomic<int> c_active_windings;
+static std::atomic<int> c_peak_windings;
+static std::atomic<int> c_winding_allocs;
+static std::atomic<int> c_winding_points;
 
 /*
 =============
@@ -55,11 +54,11 @@ winding_t      *AllocWinding( int points )
 
 	c_winding_allocs++;
 	c_winding_points += points;
-	c_active_windings++;
+	int active = ++c_active_windings;
 
-	if ( c_active_windings > c_peak_windings )
+	if ( active > c_peak_windings )
 	{
-		c_peak_windings = c_active_windings;
+		c_peak_windings = active;
 	}
 
 	s = sizeof( vec_t ) * 3 * points + sizeof( int );
@@ -143,7 +142,7 @@ winding_t *BaseWindingForPlane( const vec3_t normal, const vec_t dist )
 
 	if ( x == -1 )
 	{
-		Sys::Drop( "BaseWindingForPlane: no axis found" );
+		CM_Drop( "BaseWindingForPlane: no axis found" );
 	}
 
 	VectorCopy( vec3_origin, vup );
@@ -229,7 +228,7 @@ void ChopWindingInPlace( winding_t **inout, const vec3_t normal, const vec_t dis
 	vec_t        dists[ WORKAROUND_MAX_POINTS_ON_WINDING + 4 ];
 	planeSide_t  sides[ WORKAROUND_MAX_POINTS_ON_WINDING + 4 ];
 	int          counts[ 3 ];
-	static vec_t dot; // VC 4.2 optimizer bug if not static
+	vec_t        dot;
 	int          i, j;
 	vec_t        *p1, *p2;
 	vec3_t       mid;
@@ -332,7 +331,7 @@ void ChopWindingInPlace( winding_t **inout, const vec3_t normal, const vec_t dis
 
 	if ( f->numpoints > maxpts )
 	{
-		Sys::Drop( "ClipWinding: points exceeded estimate" );
+		CM_Drop( "ClipWinding: points exceeded estimate" );
 	}
 
 	if ( f->numpoints > MAX_POINTS_ON_WINDING )
@@ -342,7 +341,7 @@ void ChopWindingInPlace( winding_t **inout, const vec3_t normal, const vec_t dis
 
 	if ( f->numpoints > WORKAROUND_MAX_POINTS_ON_WINDING )
 	{
-		Sys::Drop( "ClipWinding: MAX_POINTS_ON_WINDING, can't workaround more, %d > %d, maybe that's an issue on map side?", f->numpoints, WORKAROUND_MAX_POINTS_ON_WINDING );
+		CM_Drop( "ClipWinding: MAX_POINTS_ON_WINDING, can't workaround more, %d > %d, maybe that's an issue on map side?", f->numpoints, WORKAROUND_MAX_POINTS_ON_WINDING );
 	}
 
 	FreeWinding( in );
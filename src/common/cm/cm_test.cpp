@@ -325,33 +325,149 @@ AREAPORTALS
 ===============================================================================
 */
 
-void CM_FloodArea_r( int areaNum, int floodnum )
+/*
+The open portals are kept in a list per area, and the floods are only changed around
+the portal that opened or closed: opening one merges two floods and closing one splits
+a flood if it was the last path between its two areas.
+*/
+
+static cAreaPortal_t *CM_FindAreaPortal( int area1, int area2 )
+{
+	for ( int i = cm.areas[ area1 ].firstPortal; i >= 0; i = cm.areaPortals[ i ].next )
+	{
+		if ( cm.areaPortals[ i ].otherArea == area2 )
+		{
+			return &cm.areaPortals[ i ];
+		}
+	}
+
+	return nullptr;
+}
+
+static void CM_AddAreaPortal( int area1, int area2 )
 {
-	int     i;
-	cArea_t *area;
-	int     *con;
+	cm.areaPortals.push_back( { area2, 0, cm.areas[ area1 ].firstPortal } );
+	cm.areas[ area1 ].firstPortal = cm.areaPortals.size() - 1;
+}
 
-	area = &cm.areas[ areaNum ];
+// Moves areas from a flood to another, the bits of the areas are in the areaBits row
+static void CM_MoveFloodAreas( const byte *areaBits, int fromFlood, int toFlood )
+{
+	byte *from = cm.floodAreaBits + fromFlood * cm.areaBytes;
+	byte *to = cm.floodAreaBits + toFlood * cm.areaBytes;
 
-	if ( area->floodvalid == cm.floodvalid )
+	for ( int i = 0; i < cm.areaBytes; i++ )
 	{
-		if ( area->floodnum == floodnum )
+		if ( !areaBits[ i ] )
 		{
-			return;
+			continue;
+		}
+
+		for ( int bit = 0; bit < 8; bit++ )
+		{
+			if ( areaBits[ i ] & ( 1 << bit ) )
+			{
+				cm.areas[ i * 8 + bit ].floodnum = toFlood;
+				cm.floodSizes[ fromFlood ]--;
+				cm.floodSizes[ toFlood ]++;
+			}
 		}
 
-		Sys::Drop( "FloodArea_r: reflooded" );
+		to[ i ] |= areaBits[ i ];
+		from[ i ] &= ~areaBits[ i ];
+	}
+
+	if ( !cm.floodSizes[ fromFlood ] )
+	{
+		cm.freeFloods.push_back( fromFlood );
+	}
+}
+
+static void CM_MergeFloods( int area1, int area2 )
+{
+	int flood1 = cm.areas[ area1 ].floodnum;
+	int flood2 = cm.areas[ area2 ].floodnum;
+
+	if ( flood1 == flood2 )
+	{
+		return;
+	}
+
+	// relabel the smaller flood
+	if ( cm.floodSizes[ flood1 ] < cm.floodSizes[ flood2 ] )
+	{
+		std::swap( flood1, flood2 );
 	}
 
-	area->floodnum = floodnum;
-	area->floodvalid = cm.floodvalid;
-	con = cm.areaPortals + areaNum * cm.numAreas;
+	CM_MoveFloodAreas( cm.floodAreaBits + flood2 * cm.areaBytes, flood2, flood1 );
+}
+
+/*
+====================
+CM_SplitFloods
+
+Called when the portal between the two areas of a flood closed. The areas reachable
+from each of them are searched in turn, so that the work is bounded by the smaller
+side: either the searches meet and the flood stays whole, or one of them runs out of
+areas and those become a new flood.
+====================
+*/
+static void CM_SplitFloods( int area1, int area2 )
+{
+	const int start[ 2 ] = { area1, area2 };
+	const int stamp[ 2 ] = { cm.floodvalid + 1, cm.floodvalid + 2 };
+	std::vector<int> stack[ 2 ];
+	std::vector<int> reached[ 2 ];
+
+	cm.floodvalid += 2;
 
-	for ( i = 0; i < cm.numAreas; i++ )
+	for ( int side = 0; side < 2; side++ )
 	{
-		if ( con[ i ] > 0 )
+		cm.areas[ start[ side ] ].floodvalid = stamp[ side ];
+		stack[ side ].push_back( start[ side ] );
+		reached[ side ].push_back( start[ side ] );
+	}
+
+	for ( int side = 0; ; side ^= 1 )
+	{
+		if ( stack[ side ].empty() )
+		{
+			// this side is cut off from the other one
+			std::vector<byte> areaBits( cm.areaBytes );
+
+			for ( int area : reached[ side ] )
+			{
+				VisBits::Set( areaBits.data(), area );
+			}
+
+			int newFlood = cm.freeFloods.back();
+			cm.freeFloods.pop_back();
+
+			CM_MoveFloodAreas( areaBits.data(), cm.areas[ area1 ].floodnum, newFlood );
+			return;
+		}
+
+		int area = stack[ side ].back();
+		stack[ side ].pop_back();
+
+		for ( int i = cm.areas[ area ].firstPortal; i >= 0; i = cm.areaPortals[ i ].next )
 		{
-			CM_FloodArea_r( i, floodnum );
+			const cAreaPortal_t &portal = cm.areaPortals[ i ];
+			cArea_t &other = cm.areas[ portal.otherArea ];
+
+			if ( portal.count <= 0 || other.floodvalid == stamp[ side ] )
+			{
+				continue;
+			}
+
+			if ( other.floodvalid == stamp[ side ^ 1 ] )
+			{
+				return; // still connected
+			}
+
+			other.floodvalid = stamp[ side ];
+			stack[ side ].push_back( portal.otherArea );
+			reached[ side ].push_back( portal.otherArea );
 		}
 	}
 }
@@ -360,29 +476,59 @@ void CM_FloodArea_r( int areaNum, int floodnum )
 ====================
 CM_FloodAreaConnections
 
+Floods all the areas from scratch
 ====================
 */
 void CM_FloodAreaConnections()
 {
-	int     i;
-	cArea_t *area;
+	std::vector<int> stack;
 	int     floodnum;
 
 	// all current floods are now invalid
 	cm.floodvalid++;
 	floodnum = 0;
 
-	area = cm.areas; // Ridah, optimization
+	memset( cm.floodAreaBits, 0, ( cm.numAreas + 1 ) * cm.areaBytes );
+	memset( cm.floodSizes, 0, ( cm.numAreas + 1 ) * sizeof( *cm.floodSizes ) );
 
-	for ( i = 0; i < cm.numAreas; i++, area++ )
+	for ( int i = 0; i < cm.numAreas; i++ )
 	{
-		if ( area->floodvalid == cm.floodvalid )
+		if ( cm.areas[ i ].floodvalid == cm.floodvalid )
 		{
 			continue; // already flooded into
 		}
 
 		floodnum++;
-		CM_FloodArea_r( i, floodnum );
+		cm.areas[ i ].floodvalid = cm.floodvalid;
+		stack.push_back( i );
+
+		while ( !stack.empty() )
+		{
+			int area = stack.back();
+			stack.pop_back();
+
+			cm.areas[ area ].floodnum = floodnum;
+			cm.floodSizes[ floodnum ]++;
+			VisBits::Set( cm.floodAreaBits + floodnum * cm.areaBytes, area );
+
+			for ( int p = cm.areas[ area ].firstPortal; p >= 0; p = cm.areaPortals[ p ].next )
+			{
+				const cAreaPortal_t &portal = cm.areaPortals[ p ];
+
+				if ( portal.count > 0 && cm.areas[ portal.otherArea ].floodvalid != cm.floodvalid )
+				{
+					cm.areas[ portal.otherArea ].floodvalid = cm.floodvalid;
+					stack.push_back( portal.otherArea );
+				}
+			}
+		}
+	}
+
+	cm.freeFloods.clear();
+
+	for ( int i = cm.numAreas; i > floodnum; i-- )
+	{
+		cm.freeFloods.push_back( i );
 	}
 }
 
@@ -404,24 +550,49 @@ void CM_AdjustAreaPortalState( int area1, int area2, bool open )
 		Sys::Drop( "CM_AdjustAreaPortalState: bad area number" );
 	}
 
+	// a portal to the same area doesn't change the floods
+	if ( area1 == area2 )
+	{
+		return;
+	}
+
+	cAreaPortal_t *portal1 = CM_FindAreaPortal( area1, area2 );
+
+	if ( !portal1 )
+	{
+		if ( !open )
+		{
+			return;
+		}
+
+		CM_AddAreaPortal( area1, area2 );
+		CM_AddAreaPortal( area2, area1 );
+		portal1 = CM_FindAreaPortal( area1, area2 );
+	}
+
+	cAreaPortal_t *portal2 = CM_FindAreaPortal( area2, area1 );
+
 	if ( open )
 	{
-		cm.areaPortals[ area1 * cm.numAreas + area2 ]++;
-		cm.areaPortals[ area2 * cm.numAreas + area1 ]++;
+		portal1->count++;
+		portal2->count++;
+
+		if ( portal1->count == 1 )
+		{
+			CM_MergeFloods( area1, area2 );
+		}
 	}
-	else if ( cm.areaPortals[ area2 * cm.numAreas + area1 ] )
+	else if ( portal1->count )
 	{
 		// Ridah, fixes loadgame issue
-		cm.areaPortals[ area1 * cm.numAreas + area2 ]--;
-		cm.areaPortals[ area2 * cm.numAreas + area1 ]--;
+		portal1->count--;
+		portal2->count--;
 
-		if ( cm.areaPortals[ area2 * cm.numAreas + area1 ] < 0 )
+		if ( !portal1->count )
 		{
-			Sys::Drop( "CM_AdjustAreaPortalState: negative reference count" );
+			CM_SplitFloods( area1, area2 );
 		}
 	}
-
-	CM_FloodAreaConnections();
 }
 
 /*
@@ -471,8 +642,6 @@ This is used to cull non-visible entities from snapshots
 */
 int CM_WriteAreaBits( byte *buffer, int area )
 {
-	int i;
-	int floodnum;
 	int bytes;
 
 	bytes = ( cm.numAreas + 7 ) >> 3;
@@ -484,15 +653,7 @@ int CM_WriteAreaBits( byte *buffer, int area )
 	}
 	else
 	{
-		floodnum = cm.areas[ area ].floodnum;
-
-		for ( i = 0; i < cm.numAreas; i++ )
-		{
-			if ( cm.areas[ i ].floodnum == floodnum )
-			{
-				buffer[ i >> 3 ] |= 1 << ( i & 7 );
-			}
-		}
+		VisBits::Or( buffer, cm.floodAreaBits + cm.areas[ area ].floodnum * cm.areaBytes, bytes );
 	}
 
 	return bytes;
@@ -98,7 +98,7 @@ static int CM_EdgePlaneNum(cTriangleSoup_t * triSoup, int tri, int edgeType)
                         return CM_FindPlane(p2, p1, up);
 
                 default:
-                        Sys::Drop("CM_EdgePlaneNum: bad edgeType=%i", edgeType);
+                        CM_Drop("CM_EdgePlaneNum: bad edgeType=%i", edgeType);
 
         }
 
@@ -265,13 +265,7 @@ static void CM_SurfaceCollideFromTriangleSoup( cTriangleSoup_t *triSoup, cSurfac
 	}
 
 	// copy the results out
-	sc->numPlanes = numTempPlanes;
-	sc->planes = ( cPlane_t * ) CM_Alloc( numTempPlanes * sizeof( *sc->planes ) );
-	std::copy_n( tempPlanes, numTempPlanes, sc->planes );
-
-	sc->numFacets = numFacets;
-	sc->facets = ( cFacet_t * ) CM_Alloc( numFacets * sizeof( *sc->facets ) );
-	std::copy_n( facets, numFacets, sc->facets );
+	CM_CopyTempPlanesAndFacets( sc );
 }
 
 /*
@@ -287,21 +281,23 @@ Points is packed as concatenated rows.
 cSurfaceCollide_t *CM_GenerateTriangleSoupCollide( int numVertexes, vec3_t *vertexes, int numIndexes, int *indexes )
 {
 	cSurfaceCollide_t *sc;
-	static cTriangleSoup_t triSoup;
 	int             i, j;
 
 	if ( numVertexes <= 2 || !vertexes || numIndexes <= 2 || !indexes )
 	{
-		Sys::Drop( "CM_GenerateTriangleSoupCollide: bad parameters: (%i, %p, %i, %p)", numVertexes, vertexes, numIndexes,
+		CM_Drop( "CM_GenerateTriangleSoupCollide: bad parameters: (%i, %p, %i, %p)", numVertexes, vertexes, numIndexes,
 		           indexes );
 	}
 
 	if ( numIndexes > SHADER_MAX_INDEXES )
 	{
-		Sys::Drop( "CM_GenerateTriangleSoupCollide: source is > SHADER_MAX_TRIANGLES" );
+		CM_Drop( "CM_GenerateTriangleSoupCollide: source is > SHADER_MAX_TRIANGLES" );
 	}
 
-	// build a triangle soup
+	// build a triangle soup, too large for the stack of a worker thread
+	std::unique_ptr<cTriangleSoup_t> triSoupPtr( new cTriangleSoup_t );
+	cTriangleSoup_t &triSoup = *triSoupPtr;
+
 	triSoup.numTriangles = numIndexes / 3;
 
 	for ( i = 0; i < triSoup.numTriangles; i++ )
@@ -31,11 +31,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <random>
+#include <vector>
+
+#include "cm_local.h"
 #include "cm_public.h"
 #include "common/FileSystem.h"
+#include "common/VisBits.h"
 
 namespace {
 
+using ::testing::ElementsAreArray;
 using ::testing::FloatNear;
 using ::testing::Pointwise;
 
@@ -184,4 +190,228 @@ TEST_F(TraceTest, BoxHitPatch)
     EXPECT_NEAR(tr.plane.dist, 362.105, PATCH_PLANE_DIST_ATOL);
 }
 
+TEST_F(TraceTest, AlignedClusterPVS)
+{
+    const byte* first = CM_ClusterPVS(0);
+    const byte* second = CM_ClusterPVS(1);
+    ASSERT_NE(first, second);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % VisBits::ROW_ALIGNMENT, 0u);
+    EXPECT_EQ((second - first) % VisBits::ROW_ALIGNMENT, 0);
+    EXPECT_TRUE(VisBits::Test(first, 0));
+    EXPECT_TRUE(VisBits::Test(second, 1));
+}
+
+TEST_F(TraceTest, WriteAreaBits)
+{
+    byte areaBits[MAX_MAP_AREA_BYTES]{};
+    int bytes = CM_WriteAreaBits(areaBits, 0);
+    ASSERT_GT(bytes, 0);
+    EXPECT_TRUE(VisBits::Test(areaBits, 0));
+
+    for (int area = 1; area < bytes * 8; area++) {
+        if (VisBits::Test(areaBits, area)) {
+            EXPECT_TRUE(CM_AreasConnected(0, area)) << area;
+        }
+    }
+
+    // the bits are OR'd in
+    byte allBits[MAX_MAP_AREA_BYTES];
+    memset(allBits, 255, sizeof(allBits));
+    CM_WriteAreaBits(allBits, 0);
+    EXPECT_EQ(VisBits::PopCount(allBits, bytes), bytes * 8);
+}
+
+std::vector<uint8_t> RandomBits(std::mt19937& rng, size_t bytes, int density)
+{
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> bits(bytes);
+    for (uint8_t& byte : bits) {
+        for (int i = 0; i < 8; i++) {
+            if (dist(rng) < density) {
+                byte |= 1 << i;
+            }
+        }
+    }
+    return bits;
+}
+
+int RefPopCount(const std::vector<uint8_t>& bits)
+{
+    int count = 0;
+    for (int i = 0; i < int(bits.size()) * 8; i++) {
+        if (bits[i >> 3] & (1 << (i & 7))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+TEST(VisBitsTest, RowBytes)
+{
+    EXPECT_EQ(VisBits::RowBytes(0), 0);
+    EXPECT_EQ(VisBits::RowBytes(1), 16);
+    EXPECT_EQ(VisBits::RowBytes(128), 16);
+    EXPECT_EQ(VisBits::RowBytes(129), 32);
+}
+
+// Sizes around the 16 byte blocks, with unaligned pointers
+TEST(VisBitsTest, MatchesByteLoops)
+{
+    std::mt19937 rng(44);
+    for (size_t bytes : {0, 1, 7, 15, 16, 17, 31, 32, 33, 100}) {
+        for (int density : {0, 1, 128, 256}) {
+            std::vector<uint8_t> a = RandomBits(rng, bytes + 1, density);
+            std::vector<uint8_t> b = RandomBits(rng, bytes + 1, density);
+            const uint8_t* pa = a.data() + 1;
+            const uint8_t* pb = b.data() + 1;
+
+            std::vector<uint8_t> orRef(pa, pa + bytes), andRef(bytes);
+            bool intersects = false, any = false;
+            for (size_t i = 0; i < bytes; i++) {
+                orRef[i] |= pb[i];
+                andRef[i] = pa[i] & pb[i];
+                intersects |= andRef[i] != 0;
+                any |= pa[i] != 0;
+            }
+
+            std::vector<uint8_t> orBits(pa, pa + bytes), andBits(bytes);
+            VisBits::Or(orBits.data(), pb, bytes);
+            VisBits::And(andBits.data(), pa, pb, bytes);
+            EXPECT_THAT(orBits, ElementsAreArray(orRef));
+            EXPECT_THAT(andBits, ElementsAreArray(andRef));
+            EXPECT_EQ(VisBits::Intersects(pa, pb, bytes), intersects);
+            EXPECT_EQ(VisBits::Any(pa, bytes), any);
+            EXPECT_EQ(VisBits::PopCount(pa, bytes), RefPopCount(std::vector<uint8_t>(pa, pa + bytes)));
+        }
+    }
+}
+
+TEST(VisBitsTest, AnyInRange)
+{
+    std::vector<uint8_t> bits(64);
+    EXPECT_FALSE(VisBits::AnyInRange(bits.data(), 0, 511));
+
+    for (int bit : {0, 7, 8, 200, 511}) {
+        std::fill(bits.begin(), bits.end(), 0);
+        VisBits::Set(bits.data(), bit);
+        for (int first : {0, 1, 7, 8, 9, 199, 200, 201, 300, 511}) {
+            for (int last : {first, first + 1, first + 100, 511}) {
+                if (last > 511) {
+                    continue;
+                }
+                EXPECT_EQ(VisBits::AnyInRange(bits.data(), first, last), first <= bit && bit <= last)
+                    << bit << " in " << first << ".." << last;
+            }
+        }
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests --gtest_filter=*VisBitsBenchmark*
+TEST(VisBitsTest, DISABLED_VisBitsBenchmark)
+{
+    constexpr int numClusters = 4096;
+    const int rowBytes = VisBits::RowBytes(numClusters);
+    std::mt19937 rng(44);
+    std::vector<uint8_t> vis = RandomBits(rng, numClusters * rowBytes, 32);
+    std::vector<uint8_t> dest(rowBytes);
+
+    auto time = [&](const char* name, void (*orRow)(uint8_t*, const uint8_t*, int)) {
+        auto start = Sys::SteadyClock::now();
+        for (int cluster = 0; cluster < numClusters; cluster++) {
+            orRow(dest.data(), vis.data() + cluster * rowBytes, rowBytes);
+        }
+        auto usec = std::chrono::duration_cast<std::chrono::microseconds>(Sys::SteadyClock::now() - start).count();
+        std::cout << name << ": " << usec << " us for " << numClusters << " rows of " << rowBytes << " bytes" << std::endl;
+    };
+
+    time("byte loop OR", [](uint8_t* dst, const uint8_t* src, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            dst[i] |= src[i];
+        }
+    });
+    time("VisBits::Or", [](uint8_t* dst, const uint8_t* src, int bytes) {
+        VisBits::Or(dst, src, bytes);
+    });
+    time("bit loop popcount", [](uint8_t* dst, const uint8_t* src, int bytes) {
+        int count = 0;
+        for (int i = 0; i < bytes * 8; i++) {
+            if (src[i >> 3] & (1 << (i & 7))) {
+                count++;
+            }
+        }
+        dst[0] = count;
+    });
+    time("VisBits::PopCount", [](uint8_t* dst, const uint8_t* src, int bytes) {
+        dst[0] = VisBits::PopCount(src, bytes);
+    });
+}
+
+int FindRoot(std::vector<int>& parents, int area)
+{
+    while (parents[area] != area) {
+        area = parents[area] = parents[parents[area]];
+    }
+    return area;
+}
+
+// Opens and closes random portals, checking the incrementally updated floods
+// against a union-find of the open portals
+TEST(AreaPortalTest, MatchesReferenceFloods)
+{
+    constexpr int numAreas = 37;
+    CM_ClearMap();
+    cm.numAreas = numAreas;
+    CM_AllocAreas();
+    CM_FloodAreaConnections();
+
+    std::mt19937 rng(49);
+    std::uniform_int_distribution<int> areaDist(0, numAreas - 1);
+    std::vector<int> counts(numAreas * numAreas);
+
+    for (int step = 0; step < 2000; step++) {
+        int area1 = areaDist(rng);
+        int area2 = areaDist(rng);
+        // open more than close at first, so that large floods form and break up
+        bool open = std::uniform_int_distribution<int>(0, 99)(rng) < (step < 1000 ? 60 : 40);
+
+        CM_AdjustAreaPortalState(area1, area2, open);
+        if (open) {
+            counts[area1 * numAreas + area2]++;
+            if (area1 != area2) {
+                counts[area2 * numAreas + area1]++;
+            }
+        } else if (counts[area1 * numAreas + area2] > 0) {
+            counts[area1 * numAreas + area2]--;
+            if (area1 != area2) {
+                counts[area2 * numAreas + area1]--;
+            }
+        }
+
+        std::vector<int> parents(numAreas);
+        for (int i = 0; i < numAreas; i++) {
+            parents[i] = i;
+        }
+        for (int i = 0; i < numAreas; i++) {
+            for (int j = 0; j < numAreas; j++) {
+                if (counts[i * numAreas + j] > 0) {
+                    parents[FindRoot(parents, i)] = FindRoot(parents, j);
+                }
+            }
+        }
+
+        for (int i = 0; i < numAreas; i++) {
+            byte areaBits[MAX_MAP_AREA_BYTES]{};
+            CM_WriteAreaBits(areaBits, i);
+
+            for (int j = 0; j < numAreas; j++) {
+                bool connected = FindRoot(parents, i) == FindRoot(parents, j);
+                ASSERT_EQ(CM_AreasConnected(i, j), connected) << "step " << step << ": " << i << " " << j;
+                ASSERT_EQ(VisBits::Test(areaBits, j), connected) << "step " << step << ": " << i << " " << j;
+            }
+        }
+    }
+
+    CM_ClearMap();
+}
+
 } // namespace
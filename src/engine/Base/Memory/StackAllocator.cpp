@@ -35,7 +35,7 @@ StackAllocator::StackAllocator( Allocator* newAllocator ) :
 }
 
 void StackAllocator::Init( const uint64_t newSize ) {
-	size = ( newSize + 63 ) & ~64;
+	size = ( newSize + 63 ) & ~63ull;
 	memory = allocator->Alloc( size, 64 );
 
 	persistentIndex = 0;
@@ -43,31 +43,43 @@ void StackAllocator::Init( const uint64_t newSize ) {
 }
 
 void StackAllocator::Resize( const uint64_t newSize ) {
-	if ( newSize > persistentIndex + tempIndex ) {
-		Sys::Drop( "StackAllocator: failed to resize: %u bytes > %u persistent bytes + %u temp bytes",
+	if ( newSize < persistentIndex + tempIndex ) {
+		Sys::Drop( "StackAllocator: failed to resize: %u bytes < %u persistent bytes + %u temp bytes",
 			newSize, persistentIndex, tempIndex );
 	}
 
-	const uint64_t tempSize = ( newSize + 63 ) & ~64;
+	const uint64_t tempSize = ( newSize + 63 ) & ~63ull;
 	byte* tempMemory = allocator->Alloc( tempSize, 64 );
 
 	memcpy( tempMemory, memory, persistentIndex );
-	memcpy( tempMemory + ( tempSize - tempIndex ), memory + ( size - tempIndex ), persistentIndex );
+	memcpy( tempMemory + ( tempSize - tempIndex ), memory + ( size - tempIndex ), tempIndex );
 
-	Free();
+	allocator->Free( memory );
 
 	memory = tempMemory;
 	size = tempSize;
 }
 
+void StackAllocator::Reset() {
+	persistentIndex = 0;
+	tempIndex = 0;
+}
+
 void StackAllocator::Free() {
-	allocator->Free( memory );
+	if ( memory ) {
+		allocator->Free( memory );
+	}
+
+	memory = nullptr;
+	size = 0;
+	persistentIndex = 0;
+	tempIndex = 0;
 }
 
 byte* StackAllocator::Alloc( const uint64_t allocationSize, const uint64_t alignment ) {
-	const uint64_t paddedSize = ( allocationSize + alignment - 1 ) & ~alignment;
+	const uint64_t offset = ( persistentIndex + alignment - 1 ) & ~( alignment - 1 );
 
-	if ( paddedSize > size - persistentIndex - tempIndex ) {
+	if ( offset + allocationSize > size - tempIndex ) {
 		return nullptr;
 	}
 
@@ -76,8 +88,8 @@ byte* StackAllocator::Alloc( const uint64_t allocationSize, const uint64_t align
 		return ( void* ) ( memory - tempIndex );
 	} */
 
-	byte* ptr = memory + persistentIndex;
-	persistentIndex += paddedSize;
+	byte* ptr = memory + offset;
+	persistentIndex = offset + allocationSize;
 
 	return ptr;
 }
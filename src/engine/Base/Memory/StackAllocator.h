@@ -43,18 +43,27 @@ class StackAllocator : public Allocator {
 
 	void Init( const uint64_t newSize );
 	void Resize( const uint64_t newSize );
+	void Reset();
 	void Free();
 
+	uint64_t Size() const {
+		return size;
+	}
+
+	uint64_t Used() const {
+		return persistentIndex + tempIndex;
+	}
+
 	byte* Alloc( const uint64_t allocationSize, const uint64_t alignment ) override;
 	void Free( byte* memory ) override;
 
 	private:
-	uint64_t size;
-	byte* memory;
+	uint64_t size = 0;
+	byte* memory = nullptr;
 	Allocator* allocator;
 
-	uint64_t persistentIndex;
-	uint64_t tempIndex;
+	uint64_t persistentIndex = 0;
+	uint64_t tempIndex = 0;
 };
 
 #endif // STACK_ALLOCATOR_H
\ No newline at end of file
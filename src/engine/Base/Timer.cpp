@@ -42,22 +42,24 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #else
 	#include <time.h>
 
+	#include "Int.h"
+
 	uint64 TimeNs() {
 		timespec ts;
 		clock_gettime( CLOCK_MONOTONIC_RAW, &ts );
 
-		return ts.tv_nsec;
+		return uint64( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
 	}
 #endif
 
 #include "Timer.h"
 
 uint64 NsToMs( const uint64 time ) {
-	return time / 1000;
+	return time / 1000000;
 }
 
 uint64 NsToUs( const uint64 time ) {
-	return time / 1000000;
+	return time / 1000;
 }
 
 uint64 NsToS( const uint64 time ) {
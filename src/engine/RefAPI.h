@@ -66,6 +66,8 @@ struct glyphInfo_t
 struct fontInfo_t
 {
 	void         *face, *faceData;
+	int           faceSize;
+	uint32_t      checkSum; // of the font file, keys the glyph cache
 	glyphInfo_t  *glyphBlock[0x110000 / 256]; // glyphBlock_t
 	int           pointSize;
 	char          name[ MAX_QPATH ];
@@ -140,6 +142,7 @@ struct refexport_t {
 
 	int ( *MarkFragments )( int numPoints, const vec3_t* points, const vec3_t projection,
 		int maxPoints, vec3_t pointBuffer, int maxFragments, markFragment_t* fragmentBuffer );
+	void ( *MarkFragmentsBatch )( const markRequest_t* requests, int numRequests, int maxPoints, int maxFragments, int* results );
 
 	void ( *ModelBounds )( qhandle_t model, vec3_t mins, vec3_t maxs );
 
@@ -157,6 +160,7 @@ struct refexport_t {
 	int ( *BuildSkeleton )( refSkeleton_t* skel, qhandle_t anim, int startFrame, int endFrame, float frac,
 		bool clearOrigin );
 	int ( *BlendSkeleton )( refSkeleton_t* skel, const refSkeleton_t* blend, float frac );
+	void ( *BuildSkeletons )( const skeletonRequest_t* requests, int numRequests, refSkeleton_t* skels, int* results );
 	int ( *BoneIndex )( qhandle_t hModel, const char* boneName );
 	int ( *AnimNumFrames )( qhandle_t hAnim );
 	int ( *AnimFrameRate )( qhandle_t hAnim );
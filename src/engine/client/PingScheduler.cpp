@@ -0,0 +1,161 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include "PingScheduler.h"
+
+#include <algorithm>
+
+// When frames are further apart than the spacing, the requests that
+// should have been sent in between are sent at once, up to that long
+static const int MAX_SEND_BURST = 50;
+
+// The backoff doubles at most that many times
+static const int MAX_BACKOFF_SHIFT = 8;
+
+void PingScheduler::Reset( int numServers )
+{
+	servers.assign( std::max( numServers, 0 ), server_t() );
+	deadlines = {};
+	numOutstanding = 0;
+	cursor = 0;
+}
+
+void PingScheduler::Grow( int numServers )
+{
+	if ( numServers > NumServers() )
+	{
+		servers.resize( numServers );
+	}
+}
+
+void PingScheduler::ResetAttempts()
+{
+	for ( server_t &server : servers )
+	{
+		server.attempts = 0;
+		server.notBefore = 0;
+	}
+}
+
+// The first attempt, from the given one on, that is not disabled
+static int NextAttempt( const PingScheduler::Config &config, int attempt )
+{
+	while ( attempt < PingScheduler::MAX_ATTEMPTS && config.spacing[ attempt ] < 0 )
+	{
+		attempt++;
+	}
+
+	return attempt;
+}
+
+bool PingScheduler::Update( int now, const Config &config, const WantedFunc &wanted,
+                            const SendFunc &send, const TimeoutFunc &timedOut )
+{
+	// time out the expired requests, the earliest first
+	while ( !deadlines.empty() && deadlines.top().time <= now )
+	{
+		deadline_t deadline = deadlines.top();
+		deadlines.pop();
+
+		server_t &server = servers[ deadline.server ];
+
+		// answered in time
+		if ( !server.outstanding || server.request != deadline.request )
+		{
+			continue;
+		}
+
+		server.outstanding = false;
+		numOutstanding--;
+		server.notBefore = now + ( config.backoff << std::min( server.attempts - 1, MAX_BACKOFF_SHIFT ) );
+
+		timedOut( deadline.server, NextAttempt( config, server.attempts ) >= MAX_ATTEMPTS );
+	}
+
+	sendClock = std::max( sendClock, now - MAX_SEND_BURST );
+
+	// look for due servers from where the last update stopped, so that
+	// all of them get their turn even when the window is always full
+	bool pending = false;
+	int numServers = NumServers();
+
+	for ( int scanned = 0; scanned < numServers && numOutstanding < config.window; scanned++ )
+	{
+		server_t &server = servers[ cursor ];
+		int attempt = NextAttempt( config, server.attempts );
+
+		if ( server.outstanding || attempt >= MAX_ATTEMPTS || !wanted( cursor ) )
+		{
+			cursor = ( cursor + 1 ) % numServers;
+			continue;
+		}
+
+		pending = true;
+
+		if ( server.notBefore > now )
+		{
+			cursor = ( cursor + 1 ) % numServers;
+			continue;
+		}
+
+		// rate limited, this server is the next one
+		if ( sendClock > now )
+		{
+			break;
+		}
+
+		send( cursor, attempt );
+
+		server.attempts = attempt + 1;
+		server.outstanding = true;
+		server.sent = now;
+		server.request = nextRequest++;
+		deadlines.push( { now + config.timeout, cursor, server.request } );
+		numOutstanding++;
+		sendClock += config.spacing[ attempt ];
+
+		cursor = ( cursor + 1 ) % numServers;
+	}
+
+	return pending || numOutstanding > 0;
+}
+
+int PingScheduler::Complete( int server, int now )
+{
+	if ( server < 0 || server >= NumServers() || !servers[ server ].outstanding )
+	{
+		return -1;
+	}
+
+	servers[ server ].outstanding = false;
+	numOutstanding--;
+
+	return now - servers[ server ].sent;
+}
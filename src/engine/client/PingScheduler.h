@@ -0,0 +1,129 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#ifndef CLIENT_PINGSCHEDULER_H_
+#define CLIENT_PINGSCHEDULER_H_
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+/*
+Decides when the server list pings are sent. Up to a window of requests
+are outstanding at once, they time out in deadline order, and servers
+that did not answer are retried with an exponential backoff.
+
+Servers are identified by their index in the list being pinged; sending
+the requests and matching the responses is left to the caller.
+*/
+class PingScheduler
+{
+public:
+	static constexpr int MAX_ATTEMPTS = 3;
+
+	struct Config
+	{
+		int window; // requests outstanding at once
+		int timeout; // msec before a request is given up
+		int spacing[ MAX_ATTEMPTS ]; // msec between requests of each attempt, -1 to skip the attempt
+		int backoff; // msec before the first retry, doubled for each further one
+	};
+
+	// Whether server i still needs a ping
+	using WantedFunc = std::function<bool( int server )>;
+	// Sends the request of the given attempt, the first one being 0
+	using SendFunc = std::function<void( int server, int attempt )>;
+	// A request timed out, final if no other attempt will be made
+	using TimeoutFunc = std::function<void( int server, bool final )>;
+
+	// Forgets all the servers and outstanding requests
+	void Reset( int numServers );
+
+	// More servers were added to the list
+	void Grow( int numServers );
+
+	// Allows all the servers to be pinged again
+	void ResetAttempts();
+
+	// Times out the expired requests and sends the due ones. Returns
+	// whether any request is outstanding or waiting to be sent.
+	bool Update( int now, const Config &config, const WantedFunc &wanted,
+	             const SendFunc &send, const TimeoutFunc &timedOut );
+
+	// A response arrived from server i. Returns the round trip time, or
+	// -1 if no request to that server is outstanding.
+	int Complete( int server, int now );
+
+	int NumServers() const
+	{
+		return servers.size();
+	}
+
+	int NumOutstanding() const
+	{
+		return numOutstanding;
+	}
+
+	int Attempts( int server ) const
+	{
+		return servers[ server ].attempts;
+	}
+
+private:
+	struct server_t
+	{
+		int attempts = 0;
+		int notBefore = 0; // no retry before that time
+		int sent = 0; // when the outstanding request was sent
+		int request = 0; // matches the deadline of the outstanding request
+		bool outstanding = false;
+	};
+
+	struct deadline_t
+	{
+		int time;
+		int server;
+		int request;
+
+		bool operator>( const deadline_t &other ) const
+		{
+			return time > other.time;
+		}
+	};
+
+	std::vector<server_t> servers;
+	std::priority_queue<deadline_t, std::vector<deadline_t>, std::greater<deadline_t>> deadlines;
+	int numOutstanding = 0;
+	int nextRequest = 0;
+	int cursor = 0; // where the search for due servers resumes
+	int sendClock = 0; // send time of the last request, plus its spacing
+};
+
+#endif // CLIENT_PINGSCHEDULER_H_
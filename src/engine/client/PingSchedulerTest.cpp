@@ -0,0 +1,251 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <map>
+#include <random>
+
+#include "PingScheduler.h"
+
+namespace {
+
+const PingScheduler::Config config = { 64, 800, { 2, 5, 10 }, 250 };
+
+// Simulates the servers answering the getinfo requests: some are slow,
+// some lose the first request, and some never answer
+class SimulatedServers
+{
+public:
+	enum class behavior_t { ANSWER, LOSE_FIRST, SILENT };
+
+	SimulatedServers( int count, int seed )
+	{
+		std::mt19937 rng( seed );
+		std::uniform_int_distribution<int> latencyDist( 10, 600 );
+		std::uniform_int_distribution<int> behaviorDist( 0, 99 );
+
+		for ( int i = 0; i < count; i++ )
+		{
+			int roll = behaviorDist( rng );
+			behaviors.push_back( roll < 10 ? behavior_t::SILENT : roll < 15 ? behavior_t::LOSE_FIRST : behavior_t::ANSWER );
+			latencies.push_back( latencyDist( rng ) );
+		}
+
+		sends.resize( count );
+		finalTimeouts.resize( count );
+		completed.assign( count, false );
+		pings.assign( count, -1 );
+	}
+
+	// Runs the scheduler with a frame every frameTime msec, until it has
+	// nothing left to do. Returns the time it took.
+	int Run( PingScheduler &scheduler, int frameTime, const PingScheduler::Config &runConfig = config )
+	{
+		int now = 1000;
+		scheduler.Reset( behaviors.size() );
+
+		auto wanted = [ this ]( int server ) { return !completed[ server ]; };
+		auto send = [ &, this ]( int server, int attempt ) {
+			EXPECT_EQ( attempt, int( sends[ server ].size() ) );
+			sends[ server ].push_back( now );
+
+			bool lost = behaviors[ server ] == behavior_t::SILENT
+			            || ( behaviors[ server ] == behavior_t::LOSE_FIRST && attempt == 0 );
+
+			if ( !lost )
+			{
+				responses.emplace( now + latencies[ server ], server );
+			}
+		};
+		auto timedOut = [ this ]( int server, bool final ) {
+			if ( final )
+			{
+				finalTimeouts[ server ]++;
+			}
+		};
+
+		while ( scheduler.Update( now, runConfig, wanted, send, timedOut ) )
+		{
+			EXPECT_LE( scheduler.NumOutstanding(), runConfig.window );
+			maxOutstanding = std::max( maxOutstanding, scheduler.NumOutstanding() );
+
+			now += frameTime;
+
+			// the responses that arrived during the frame
+			while ( !responses.empty() && responses.begin()->first <= now )
+			{
+				int server = responses.begin()->second;
+				responses.erase( responses.begin() );
+
+				int ping = scheduler.Complete( server, now );
+
+				if ( ping >= 0 )
+				{
+					completed[ server ] = true;
+					pings[ server ] = ping;
+				}
+			}
+
+			if ( now > 1000 * 1000 )
+			{
+				ADD_FAILURE() << "the pings never end";
+				break;
+			}
+		}
+
+		return now - 1000;
+	}
+
+	std::vector<behavior_t> behaviors;
+	std::vector<int> latencies;
+	std::vector<std::vector<int>> sends;
+	std::vector<int> finalTimeouts;
+	std::vector<bool> completed;
+	std::vector<int> pings;
+	std::multimap<int, int> responses;
+	int maxOutstanding = 0;
+};
+
+TEST(PingSchedulerTest, ThousandsOfServers)
+{
+	const int count = 4096;
+	SimulatedServers servers( count, 45 );
+	PingScheduler scheduler;
+	int time = servers.Run( scheduler, 16 );
+
+	EXPECT_EQ( servers.maxOutstanding, config.window );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		switch ( servers.behaviors[ i ] )
+		{
+		case SimulatedServers::behavior_t::ANSWER:
+			EXPECT_TRUE( servers.completed[ i ] ) << i;
+			EXPECT_EQ( servers.sends[ i ].size(), 1u ) << i;
+			// the response is seen on the next frame
+			EXPECT_GE( servers.pings[ i ], servers.latencies[ i ] ) << i;
+			EXPECT_LT( servers.pings[ i ], servers.latencies[ i ] + 16 ) << i;
+			break;
+
+		case SimulatedServers::behavior_t::LOSE_FIRST:
+			EXPECT_TRUE( servers.completed[ i ] ) << i;
+			EXPECT_EQ( servers.sends[ i ].size(), 2u ) << i;
+			break;
+
+		case SimulatedServers::behavior_t::SILENT:
+			EXPECT_FALSE( servers.completed[ i ] ) << i;
+			EXPECT_EQ( servers.sends[ i ].size(), size_t( PingScheduler::MAX_ATTEMPTS ) ) << i;
+			EXPECT_EQ( servers.finalTimeouts[ i ], 1 ) << i;
+			break;
+		}
+	}
+
+	// the same servers with 16 requests at a time, as with the former
+	// fixed ping list
+	SimulatedServers sameServers( count, 45 );
+	PingScheduler::Config narrow = config;
+	narrow.window = 16;
+	PingScheduler narrowScheduler;
+	int narrowTime = sameServers.Run( narrowScheduler, 16, narrow );
+
+	EXPECT_LT( time * 2, narrowTime );
+}
+
+TEST(PingSchedulerTest, RetriesBackOff)
+{
+	SimulatedServers servers( 512, 46 );
+	PingScheduler scheduler;
+	servers.Run( scheduler, 16 );
+
+	int retried = 0;
+
+	for ( const std::vector<int> &sends : servers.sends )
+	{
+		// request n + 1 is sent once request n timed out and the backoff elapsed
+		for ( size_t n = 0; n + 1 < sends.size(); n++ )
+		{
+			EXPECT_GE( sends[ n + 1 ] - sends[ n ], config.timeout + ( config.backoff << n ) );
+			retried++;
+		}
+	}
+
+	EXPECT_GT( retried, 0 );
+}
+
+TEST(PingSchedulerTest, SpacingLimitsRate)
+{
+	PingScheduler scheduler;
+	scheduler.Reset( 1000 );
+
+	int sent = 0;
+	auto wanted = []( int ) { return true; };
+	auto send = [ &sent ]( int, int ) { sent++; };
+	auto timedOut = []( int, bool ) {};
+
+	PingScheduler::Config slow = config;
+	slow.window = 1000;
+
+	for ( int now = 0; now <= 1000; now += 10 )
+	{
+		scheduler.Update( now, slow, wanted, send, timedOut );
+	}
+
+	// one request every 2 msec, plus the initial burst
+	EXPECT_GE( sent, 1000 / 2 );
+	EXPECT_LE( sent, ( 1000 + 50 ) / 2 + 1 );
+}
+
+TEST(PingSchedulerTest, LateResponseIgnored)
+{
+	PingScheduler scheduler;
+	scheduler.Reset( 1 );
+
+	auto wanted = []( int ) { return true; };
+	auto send = []( int, int ) {};
+	bool final = false;
+	auto timedOut = [ &final ]( int, bool f ) { final = f; };
+
+	PingScheduler::Config once = config;
+	once.spacing[ 1 ] = once.spacing[ 2 ] = -1;
+
+	EXPECT_TRUE( scheduler.Update( 0, once, wanted, send, timedOut ) );
+	EXPECT_EQ( scheduler.NumOutstanding(), 1 );
+	EXPECT_FALSE( scheduler.Update( once.timeout, once, wanted, send, timedOut ) );
+	EXPECT_TRUE( final );
+	EXPECT_EQ( scheduler.Complete( 0, once.timeout + 10 ), -1 );
+
+	scheduler.ResetAttempts();
+	EXPECT_TRUE( scheduler.Update( once.timeout + 20, once, wanted, send, timedOut ) );
+	EXPECT_EQ( scheduler.Complete( 0, once.timeout + 30 ), 10 );
+}
+
+} // namespace
@@ -91,6 +91,24 @@ namespace Util {
 		}
 	};
 
+	// Only the used bones are sent, like for a single refSkeleton_t
+	template<> struct SerializeTraits<std::vector<refSkeleton_t>> {
+		static void Write( Writer& stream, const std::vector<refSkeleton_t>& skels ) {
+			stream.WriteSize( skels.size() );
+			for ( const refSkeleton_t& skel : skels ) {
+				stream.Write<refSkeleton_t>( skel );
+			}
+		}
+		static std::vector<refSkeleton_t> Read( Reader& stream ) {
+			std::vector<refSkeleton_t> skels;
+			skels.resize( stream.ReadSize<refSkeleton_t>() );
+			for ( refSkeleton_t& skel : skels ) {
+				skel = stream.Read<refSkeleton_t>();
+			}
+			return skels;
+		}
+	};
+
 	template<> struct SerializeTraits<std::vector<BoneMod>> {
 		static void Write( Writer& stream, const std::vector<BoneMod>& boneMods ) {
 			stream.WriteSize( boneMods.size() );
@@ -283,6 +301,9 @@ enum cgameImport_t
   CG_LAN_RESETPINGS,
   CG_LAN_SERVERSTATUS,
   CG_LAN_RESETSERVERSTATUS,
+
+  // Appended so that the IDs above stay compatible with existing VMs
+  CG_R_BUILDSKELETONS,
 };
 
 // All Miscs
@@ -403,6 +424,11 @@ namespace Render {
 		IPC::Message<IPC::Id<VM::QVM, CG_R_BUILDSKELETON>, int, int, int, float, bool>,
 		IPC::Reply<refSkeleton_t, int>
 	>;
+	// Builds many skeletons with a single round trip
+	using BuildSkeletonsMsg = IPC::SyncMessage<
+		IPC::Message<IPC::Id<VM::QVM, CG_R_BUILDSKELETONS>, std::vector<skeletonRequest_t>>,
+		IPC::Reply<std::vector<refSkeleton_t>, std::vector<int>>
+	>;
 	using BoneIndexMsg = IPC::SyncMessage<
 		IPC::Message<IPC::Id<VM::QVM, CG_R_BONEINDEX>, int, std::string>,
 		IPC::Reply<int>
@@ -0,0 +1,182 @@
+/*
+===========================================================================
+
+Daemon BSD Source Code
+Copyright (c) 2026 Daemon Developers
+All rights reserved.
+
+This file is part of the Daemon BSD Source Code (Daemon Source Code).
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+// cl_benchmark.cpp: per-frame timings of timedemos
+
+#include "client.h"
+#include <common/FileSystem.h>
+
+static Cvar::Cvar<std::string> cvar_demo_benchmarkOutput( "demo.benchmark.output",
+	"if set, timedemos write per-frame timings to <name>.csv and a summary to <name>.json in the homepath", Cvar::NONE, "" );
+static Cvar::Cvar<bool> cvar_demo_benchmarkQuit( "demo.benchmark.quit", "quit once a timedemo is completed", Cvar::NONE, false );
+
+timeDemoFrameStats_t cl_timeDemoFrame;
+
+static std::vector<timeDemoFrameStats_t> timeDemoFrames;
+
+bool CL_TimeDemoBenchmarking()
+{
+	return cvar_demo_timedemo.Get() && clc.demoplaying && !cvar_demo_benchmarkOutput.Get().empty();
+}
+
+void CL_TimeDemoFrameBegin()
+{
+	// A new demo, timed frames start being counted in CL_SetCGameTime
+	if ( !clc.timeDemoStart )
+	{
+		timeDemoFrames.clear();
+	}
+
+	cl_timeDemoFrame = {};
+}
+
+void CL_TimeDemoFrameEnd()
+{
+	if ( clc.timeDemoStart )
+	{
+		timeDemoFrames.push_back( cl_timeDemoFrame );
+	}
+}
+
+/*
+The cgame time includes the IPC round trips, but not the time the engine spends
+serving the syscalls it makes during its frame. The renderer time is the renderer and sound command buffer
+the cgame sends, plus the rest of the screen update (console, EndFrame).
+*/
+enum class benchmarkStage_t
+{
+	PARSE,
+	CGAME,
+	IPC,
+	RENDERER,
+	FRAME,
+	COUNT
+};
+
+static const char *benchmarkStageNames[] = { "parse", "cgame", "ipc", "renderer", "frame" };
+
+static uint64_t CL_BenchmarkStageTime( const timeDemoFrameStats_t& frame, benchmarkStage_t stage )
+{
+	switch ( stage )
+	{
+		case benchmarkStage_t::PARSE:
+			return frame.parse;
+		case benchmarkStage_t::CGAME:
+			return frame.cgame > frame.cgameServed ? frame.cgame - frame.cgameServed : 0;
+		case benchmarkStage_t::IPC:
+			return frame.syscalls;
+		case benchmarkStage_t::RENDERER:
+			return ( frame.screen > frame.cgame ? frame.screen - frame.cgame : 0 ) + frame.commandBuffer;
+		case benchmarkStage_t::FRAME:
+			return frame.frame;
+		default:
+			ASSERT_UNREACHABLE();
+	}
+}
+
+// Nearest-rank percentile of sorted values
+static uint64_t CL_Percentile( const std::vector<uint64_t>& sorted, int percent )
+{
+	size_t rank = ( sorted.size() * percent + 99 ) / 100;
+	return sorted[ std::max( rank, size_t( 1 ) ) - 1 ];
+}
+
+static void CL_WriteTimeDemoStats( int msec )
+{
+	const std::string& name = cvar_demo_benchmarkOutput.Get();
+	const int numStages = Util::ordinal( benchmarkStage_t::COUNT );
+
+	try
+	{
+		FS::File csv = FS::HomePath::OpenWrite( name + ".csv" );
+		csv.Printf( "frame,parse_us,cgame_us,ipc_us,renderer_us,frame_us\n" );
+
+		for ( size_t i = 0; i < timeDemoFrames.size(); i++ )
+		{
+			std::string line = std::to_string( i );
+
+			for ( int stage = 0; stage < numStages; stage++ )
+			{
+				line += Str::Format( ",%.1f", CL_BenchmarkStageTime( timeDemoFrames[ i ], benchmarkStage_t( stage ) ) / 1000.0 );
+			}
+
+			csv.Printf( "%s\n", line );
+		}
+
+		FS::File json = FS::HomePath::OpenWrite( name + ".json" );
+		json.Printf( "{\n\t\"demo\": \"%s\",\n\t\"frames\": %d,\n\t\"seconds\": %.3f,\n\t\"fps\": %.1f,\n\t\"stages_us\": {\n",
+			clc.demoName, timeDemoFrames.size(), msec / 1000.0, msec ? clc.timeDemoFrames * 1000.0 / msec : 0.0 );
+
+		std::vector<uint64_t> times( timeDemoFrames.size() );
+		for ( int stage = 0; stage < numStages; stage++ )
+		{
+			uint64_t total = 0;
+			for ( size_t i = 0; i < timeDemoFrames.size(); i++ )
+			{
+				times[ i ] = CL_BenchmarkStageTime( timeDemoFrames[ i ], benchmarkStage_t( stage ) );
+				total += times[ i ];
+			}
+
+			std::sort( times.begin(), times.end() );
+
+			json.Printf( "\t\t\"%s\": { \"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p95\": %.1f, \"p99\": %.1f, \"max\": %.1f }%s\n",
+				benchmarkStageNames[ stage ], total / 1000.0 / times.size(),
+				CL_Percentile( times, 50 ) / 1000.0, CL_Percentile( times, 90 ) / 1000.0,
+				CL_Percentile( times, 95 ) / 1000.0, CL_Percentile( times, 99 ) / 1000.0,
+				times.back() / 1000.0, stage + 1 < numStages ? "," : "" );
+		}
+
+		json.Printf( "\t}\n}\n" );
+
+		Log::Notice( "Wrote timedemo stats for %d frames to %s.csv and %s.json", timeDemoFrames.size(), name, name );
+	}
+	catch ( std::system_error& err )
+	{
+		Log::Warn( "Couldn't write timedemo stats to %s: %s", name, err.what() );
+	}
+}
+
+void CL_TimeDemoCompleted( int msec )
+{
+	if ( CL_TimeDemoBenchmarking() && !timeDemoFrames.empty() )
+	{
+		CL_WriteTimeDemoStats( msec );
+	}
+
+	timeDemoFrames.clear();
+
+	if ( cvar_demo_benchmarkQuit.Get() )
+	{
+		Cmd::BufferCommandText( "quit" );
+	}
+}
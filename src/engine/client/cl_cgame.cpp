@@ -373,6 +373,8 @@ static void LAN_ResetPings( int source )
 			servers[ i ].ping = -1;
 		}
 	}
+
+	CL_ResetPingAttempts( source );
 }
 
 /*
@@ -638,7 +640,14 @@ CL_CGameRendering
 */
 void CL_CGameRendering()
 {
-	cgvm.CGameDrawActiveFrame(cl.serverTime, clc.demoplaying);
+	const uint64_t served = cl_timeDemoFrame.syscalls + cl_timeDemoFrame.commandBuffer;
+
+	{
+		Timer timer( &cl_timeDemoFrame.cgame );
+		cgvm.CGameDrawActiveFrame(cl.serverTime, clc.demoplaying);
+	}
+
+	cl_timeDemoFrame.cgameServed += cl_timeDemoFrame.syscalls + cl_timeDemoFrame.commandBuffer - served;
 }
 
 /*
@@ -1069,14 +1078,23 @@ void CGameVM::CGameConsoleLine(const std::string& str)
 	this->SendMsg<CGameConsoleLineMsg>(str);
 }
 
+void CGameVM::FlushPendingMsgs()
+{
+	if (services) {
+		services->FlushCvarChanges();
+	}
+}
+
 void CGameVM::Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel)
 {
 	int major = id >> 16;
 	int minor = id & 0xffff;
 	if (major == VM::QVM) {
+		Timer timer(&cl_timeDemoFrame.syscalls);
 		this->QVMSyscall(minor, reader, channel);
 
 	} else if (major == VM::COMMAND_BUFFER) {
+		Timer timer(&cl_timeDemoFrame.commandBuffer);
 		this->cmdBuffer.Syscall(minor, reader, channel);
 
 	} else if (major < VM::LAST_COMMON_SYSCALL) {
@@ -1087,6 +1105,11 @@ void CGameVM::Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel)
 	}
 }
 
+// Limits of the mark buffers the cgame can ask for, far more than a mark needs
+static const unsigned MAX_MARK_POINTS = 1024;
+static const unsigned MAX_MARK_FRAGMENTS = 256;
+static const size_t MAX_BATCH_MARKS = 1024;
+
 void CGameVM::QVMSyscall(int syscallNum, Util::Reader& reader, IPC::Channel& channel)
 {
 	switch (syscallNum) {
@@ -1109,33 +1132,49 @@ void CGameVM::QVMSyscall(int syscallNum, Util::Reader& reader, IPC::Channel& cha
 				const std::vector<markMsgInput_t>& inputs,
 				std::vector<markMsgOutput_t>& outputs)
 			{
+				if (inputs.size() > MAX_BATCH_MARKS) {
+					Sys::Drop("CG_CM_BATCHMARKFRAGMENTS: %u marks, more than %d", inputs.size(), MAX_BATCH_MARKS);
+				}
+
+				// A mark stops at the buffer size, so larger requests only get as much as fits
+				maxPoints = std::min(maxPoints, MAX_MARK_POINTS);
+				maxFragments = std::min(maxFragments, MAX_MARK_FRAGMENTS);
+
+				// Each mark gets its own slice of the buffers so that they can be projected in parallel
+				std::vector<std::array<float, 3>> pointBuf(maxPoints * inputs.size());
+				std::vector<markFragment_t> fragmentBuf(maxFragments * inputs.size());
+				std::vector<markRequest_t> requests(inputs.size());
+				std::vector<int> results(inputs.size());
+
+				for (size_t i = 0; i < inputs.size(); i++)
+				{
+					requests[i].numPoints = inputs[i].first.size();
+					requests[i].points = reinterpret_cast<const vec3_t*>(inputs[i].first.data());
+					requests[i].projection = inputs[i].second.data();
+					requests[i].pointBuffer = reinterpret_cast<float*>(pointBuf.data() + i * maxPoints);
+					requests[i].fragmentBuffer = fragmentBuf.data() + i * maxFragments;
+				}
+
+				re.MarkFragmentsBatch(requests.data(), requests.size(), maxPoints, maxFragments, results.data());
+
 				outputs.reserve(inputs.size());
-				std::vector<std::array<float, 3>> pointBuf(maxPoints);
-				std::vector<markFragment_t> fragmentBuf(maxFragments);
 
-				for (const markMsgInput_t& input : inputs)
+				for (size_t i = 0; i < inputs.size(); i++)
 				{
-					auto& inputPoints = input.first;
-					auto& projection = input.second;
-					size_t numFragments = re.MarkFragments(
-						inputPoints.size(),
-						reinterpret_cast<const vec3_t*>(inputPoints.data()),
-						projection.data(),
-						maxPoints,
-						reinterpret_cast<float*>(pointBuf.data()),
-						maxFragments,
-						fragmentBuf.data());
+					const std::array<float, 3>* points = pointBuf.data() + i * maxPoints;
+					const markFragment_t* fragments = fragmentBuf.data() + i * maxFragments;
+					size_t numFragments = results[i];
 					size_t numPoints;
 					if (numFragments == 0) {
 						numPoints = 0;
 					} else {
 						// HACK: assume last fragment is last
-						const markFragment_t& lastFragment = fragmentBuf[numFragments - 1];
+						const markFragment_t& lastFragment = fragments[numFragments - 1];
 						numPoints = lastFragment.firstPoint + lastFragment.numPoints;
 					}
 					outputs.emplace_back(
-						std::vector<std::array<float, 3>>(pointBuf.data(), pointBuf.data() + numPoints),
-						std::vector<markFragment_t>(fragmentBuf.data(), fragmentBuf.data() + numFragments)
+						std::vector<std::array<float, 3>>(points, points + numPoints),
+						std::vector<markFragment_t>(fragments, fragments + numFragments)
 					);
 				}
 			});
@@ -1297,6 +1336,14 @@ void CGameVM::QVMSyscall(int syscallNum, Util::Reader& reader, IPC::Channel& cha
 			});
 			break;
 
+		case CG_R_BUILDSKELETONS:
+			IPC::HandleMsg<Render::BuildSkeletonsMsg>(channel, std::move(reader), [this] (const std::vector<skeletonRequest_t>& requests, std::vector<refSkeleton_t>& skels, std::vector<int>& results) {
+				skels.resize(requests.size());
+				results.resize(requests.size());
+				re.BuildSkeletons(requests.data(), requests.size(), skels.data(), results.data());
+			});
+			break;
+
 		case CG_R_BONEINDEX:
 			IPC::HandleMsg<Render::BoneIndexMsg>(channel, std::move(reader), [this] (int model, const std::string& boneName, int& index) {
 				index = re.BoneIndex(model, boneName.c_str());
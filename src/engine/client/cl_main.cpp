@@ -486,6 +486,8 @@ NORETURN static void CL_DemoCompleted()
 			Log::Notice( "%i frames, %3.1fs: %3.1f fps", clc.timeDemoFrames,
 			            time / 1000.0, clc.timeDemoFrames * 1000.0 / time );
 		}
+
+		CL_TimeDemoCompleted( time );
 	}
 
 	throw Sys::DropErr(false, "Demo completed");
@@ -504,6 +506,8 @@ void CL_ReadDemoMessage()
 	byte  bufData[ MAX_MSGLEN ];
 	int   s;
 
+	Timer timer( &cl_timeDemoFrame.parse );
+
 	if ( !clc.demofile )
 	{
 		CL_DemoCompleted();
@@ -1641,6 +1645,7 @@ void CL_CheckForResend()
 
 			Q_strncpyz( info, Cvar_InfoString( CVAR_USERINFO, false ), sizeof( info ) );
 			Info_SetValueForKey( info, "protocol", va( "%i", PROTOCOL_VERSION ), false );
+			Info_SetValueForKey( info, "psdelta", va( "%i", PS_DELTA_VERSION ), false );
 			Info_SetValueForKey( info, "qport", va( "%i", port ), false );
 			Info_SetValueForKey( info, "challenge", clc.challenge.c_str(), false );
 			Info_SetValueForKey( info, "pubkey", key, false );
@@ -2015,6 +2020,15 @@ void CL_Frame( int msec )
 		return;
 	}
 
+	const bool benchmarking = CL_TimeDemoBenchmarking();
+
+	if ( benchmarking )
+	{
+		CL_TimeDemoFrameBegin();
+	}
+
+	Timer frameTimer;
+
 	// if recording an avi, lock to a fixed fps
 	if ( CL_VideoRecording() && cl_aviFrameRate->integer && msec )
 	{
@@ -2078,6 +2092,12 @@ void CL_Frame( int msec )
 	Con_RunConsole();
 
 	cls.framecount++;
+
+	if ( benchmarking )
+	{
+		cl_timeDemoFrame.frame = frameTimer.Time();
+		CL_TimeDemoFrameEnd();
+	}
 }
 
 static bool CL_InitRef();
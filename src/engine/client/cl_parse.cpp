@@ -263,14 +263,7 @@ void CL_ParseSnapshot( msg_t *msg )
 	// read playerinfo
 	SHOWNET( msg, "playerstate" );
 
-	if ( old )
-	{
-		MSG_ReadDeltaPlayerstate( msg, &old->ps, &newSnap.ps );
-	}
-	else
-	{
-		MSG_ReadDeltaPlayerstate( msg, nullptr, &newSnap.ps );
-	}
+	MSG_ReadDeltaPlayerstate( msg, old ? &old->ps : nullptr, &newSnap.ps, &clc.psDelta );
 
 	// read packet entities
 	SHOWNET( msg, "packet entities" );
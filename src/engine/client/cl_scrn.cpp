@@ -250,6 +250,8 @@ void SCR_UpdateScreen()
 
 	recursive = 1;
 
+	Timer timer( &cl_timeDemoFrame.screen );
+
 #if defined(__APPLE__) && defined(BUILD_GRAPHICAL_CLIENT)
 	if ( cls.state == connstate_t::CA_LOADING )
 	{
@@ -43,8 +43,7 @@ Maryland 20850 USA.
 #include "client.h"
 #include "engine/framework/Crypto.h"
 #include "engine/framework/Network.h"
-
-#define MAX_PINGREQUESTS         16
+#include "PingScheduler.h"
 
 static Log::Logger serverInfoLog("client.serverinfo", "");
 
@@ -54,25 +53,215 @@ static Cvar::Cvar<std::string> cl_gamename(
 static Cvar::Range<Cvar::Cvar<int>> cl_maxPing(
 	"cl_maxPing", "ping timeout for server list", Cvar::NONE, 800, 100, 9999);
 
-constexpr int PING_MAX_ATTEMPTS = 3;
+constexpr int PING_MAX_ATTEMPTS = PingScheduler::MAX_ATTEMPTS;
 static Cvar::Range<Cvar::Cvar<int>> pingSpacing[ PING_MAX_ATTEMPTS ] {
 	{"cl_pingSpacing", "milliseconds between ping packets (1st attempt)", Cvar::NONE, 5, 0, 5000},
 	{"cl_pingSpacingRetry1", "milliseconds between ping packets for 1st retry or -1 to disable retry", Cvar::NONE, 50, -1, 5000},
 	{"cl_pingSpacingRetry2", "milliseconds between ping packets for 2nd retry or -1 to disable retry", Cvar::NONE, 125, -1, 5000},
 };
 
+static Cvar::Range<Cvar::Cvar<int>> cl_pingWindow(
+	"cl_pingWindow", "server list pings waiting for an answer at once", Cvar::NONE, 64, 1, 1024);
+static Cvar::Range<Cvar::Cvar<int>> cl_pingBackoff(
+	"cl_pingBackoff", "milliseconds before pinging again a server that did not answer, doubled for each further retry",
+	Cvar::NONE, 250, 0, 10000);
+
+static Cvar::Cvar<bool> cl_serverInfoCache(
+	"cl_serverInfoCache", "show the last known info of servers until they answer the ping", Cvar::NONE, true);
+
 struct ping_t
 {
 	netadr_t adr;
 	int      start;
-	int      time;
 	char     challenge[ 9 ]; // 8-character challenge string
-	serverResponseProtocol_t responseProto;
-	char     info[ MAX_INFO_STRING ];
+	int      server; // index in the list being pinged, -1 for the ping command
 };
 
-ping_t             cl_pinglist[ MAX_PINGREQUESTS ];
-static int lastPingSendTime = -99999;
+// outstanding pings, by address
+static std::unordered_map<std::string, ping_t> cl_pings;
+
+static PingScheduler pingScheduler;
+static int pingScheduleSource = -1;
+
+/*
+The info of the servers that answered, so that the list can show them
+before they answered again. It is saved to the homepath when all the
+pings are complete.
+*/
+struct cachedServerInfo_t
+{
+	std::string info;
+	int         ping;
+	int64_t     time; // seconds since the epoch
+};
+
+static const char SERVERINFO_CACHE_FILE[] = "serverinfo.cache";
+static const int64_t SERVERINFO_CACHE_MAX_AGE = 14 * 24 * 60 * 60;
+
+static std::unordered_map<std::string, cachedServerInfo_t> serverInfoCache;
+static bool serverInfoCacheLoaded = false;
+static bool serverInfoCacheModified = false;
+
+static std::string CL_PingKey( const netadr_t& adr )
+{
+	return Net::AddressToString( adr, true );
+}
+
+static serverResponseProtocol_t CL_ResponseProtocol( const netadr_t& adr )
+{
+	switch ( adr.type )
+	{
+		case netadrtype_t::NA_BROADCAST:
+		case netadrtype_t::NA_IP:
+			return serverResponseProtocol_t::IP4;
+
+		case netadrtype_t::NA_IP6:
+			return serverResponseProtocol_t::IP6;
+
+		default:
+			return serverResponseProtocol_t::UNKNOWN;
+	}
+}
+
+/*
+===================
+CL_LoadServerInfoCache
+
+The file has a line per server: address, ping, time and info string
+===================
+*/
+static void CL_LoadServerInfoCache()
+{
+	serverInfoCacheLoaded = true;
+
+	std::error_code err;
+	std::string data = FS::HomePath::OpenRead( SERVERINFO_CACHE_FILE, err ).ReadAll( err );
+
+	if ( err )
+	{
+		return;
+	}
+
+	int64_t now = time( nullptr );
+	size_t lineStart = 0;
+
+	while ( lineStart < data.size() )
+	{
+		size_t lineEnd = data.find( '\n', lineStart );
+
+		if ( lineEnd == std::string::npos )
+		{
+			lineEnd = data.size();
+		}
+
+		std::string line = data.substr( lineStart, lineEnd - lineStart );
+		lineStart = lineEnd + 1;
+
+		char address[ 64 ];
+		int ping, infoStart;
+		long long savedTime;
+
+		if ( sscanf( line.c_str(), "%63s %d %lld %n", address, &ping, &savedTime, &infoStart ) != 3
+		     || now - savedTime > SERVERINFO_CACHE_MAX_AGE )
+		{
+			continue;
+		}
+
+		serverInfoCache[ address ] = { line.substr( infoStart ), ping, savedTime };
+	}
+
+	serverInfoLog.Debug( "loaded the info of %d servers from %s", serverInfoCache.size(), SERVERINFO_CACHE_FILE );
+}
+
+static void CL_SaveServerInfoCache()
+{
+	serverInfoCacheModified = false;
+
+	int64_t now = time( nullptr );
+	std::string data;
+
+	for ( const auto& entry : serverInfoCache )
+	{
+		if ( now - entry.second.time <= SERVERINFO_CACHE_MAX_AGE )
+		{
+			data += Str::Format( "%s %d %d %s\n", entry.first, entry.second.ping, entry.second.time, entry.second.info );
+		}
+	}
+
+	try
+	{
+		FS::File file = FS::HomePath::OpenWrite( SERVERINFO_CACHE_FILE );
+		file.Write( data.data(), data.size() );
+	}
+	catch ( std::system_error& err )
+	{
+		serverInfoLog.Warn( "Couldn't write %s: %s", SERVERINFO_CACHE_FILE, err.what() );
+	}
+}
+
+static void CL_CacheServerInfo( const netadr_t& adr, const char *info, int ping )
+{
+	if ( !cl_serverInfoCache.Get() )
+	{
+		return;
+	}
+
+	serverInfoCache[ CL_PingKey( adr ) ] = { info, ping, time( nullptr ) };
+	serverInfoCacheModified = true;
+}
+
+// Shows the last known info of the server while it is pinged
+static void CL_ApplyCachedServerInfo( serverInfo_t *server )
+{
+	if ( !cl_serverInfoCache.Get() )
+	{
+		return;
+	}
+
+	if ( !serverInfoCacheLoaded )
+	{
+		CL_LoadServerInfoCache();
+	}
+
+	auto it = serverInfoCache.find( CL_PingKey( server->adr ) );
+
+	if ( it != serverInfoCache.end() )
+	{
+		server->infoString = it->second.info;
+		server->ping = it->second.ping;
+		server->responseProto = CL_ResponseProtocol( server->adr );
+	}
+}
+
+/*
+===================
+CL_ResetPingSchedule
+
+The list of the source is being replaced, the indices of its servers
+are no longer valid
+===================
+*/
+static void CL_ResetPingSchedule( int source )
+{
+	if ( source != pingScheduleSource )
+	{
+		return;
+	}
+
+	pingScheduler.Reset( 0 );
+
+	for ( auto it = cl_pings.begin(); it != cl_pings.end(); )
+	{
+		if ( it->second.server >= 0 )
+		{
+			it = cl_pings.erase( it );
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
 
 /*
 ===================
@@ -137,6 +326,7 @@ static int CL_GSRSequenceInformation( byte **data )
 		// between - only use the results that arrive later
 		Log::Debug( "Master changed its mind about packet count!" );
 		cls.numglobalservers = 0;
+		CL_ResetPingSchedule( AS_GLOBAL );
 	}
 
 	cls.numMasterPackets = num;
@@ -468,6 +658,7 @@ void CL_ServersResponsePacket( const netadr_t *from, msg_t *msg, bool extended )
 
 		CL_InitServerInfo( server, &addresses[ i ] );
 		Q_strncpyz( server->label, label, sizeof( server->label ) );
+		CL_ApplyCachedServerInfo( server );
 		// advance to next slot
 		count++;
 	}
@@ -516,6 +707,22 @@ static void CL_SetServerInfoByAddress(
 	}
 }
 
+// The server at that index of the list being pinged
+static serverInfo_t *CL_PingedServer( int n )
+{
+	switch ( pingScheduleSource )
+	{
+		case AS_LOCAL:
+			return n >= 0 && n < cls.numlocalservers ? &cls.localServers[ n ] : nullptr;
+
+		case AS_GLOBAL:
+			return n >= 0 && n < cls.numglobalservers ? &cls.globalServers[ n ] : nullptr;
+
+		default:
+			return nullptr;
+	}
+}
+
 /*
 ===================
 CL_ServerInfoPacket
@@ -550,47 +757,39 @@ void CL_ServerInfoPacket( const netadr_t& from, msg_t *msg )
 		return;
 	}
 
-	// iterate servers waiting for ping response
-	for ( i = 0; i < MAX_PINGREQUESTS; i++ )
+	// is a ping waiting for this response
+	auto it = cl_pings.find( CL_PingKey( from ) );
+
+	if ( it != cl_pings.end() )
 	{
-		if ( cl_pinglist[ i ].adr.port && cl_pinglist[ i ].time == -1 && NET_CompareAdr( from, cl_pinglist[i].adr ) )
-		{
-			if ( strcmp( cl_pinglist[ i ].challenge, Info_ValueForKey( infoString, "challenge" ) ) )
-			{
-				serverInfoLog.Verbose( "wrong challenge for ping response from %s", NET_AdrToString( from ) );
-				return;
-			}
+		const ping_t &ping = it->second;
 
-			// calc ping time
-			cl_pinglist[ i ].time = Sys::Milliseconds() - cl_pinglist[ i ].start;
+		if ( strcmp( ping.challenge, Info_ValueForKey( infoString, "challenge" ) ) )
+		{
+			serverInfoLog.Verbose( "wrong challenge for ping response from %s", NET_AdrToString( from ) );
+			return;
+		}
 
-			serverInfoLog.Debug( "ping time %dms from %s", cl_pinglist[ i ].time, NET_AdrToString( from ) );
+		int now = Sys::Milliseconds();
+		int time = now - ping.start;
 
-			// save of info
-			Q_strncpyz( cl_pinglist[ i ].info, infoString, sizeof( cl_pinglist[ i ].info ) );
+		serverInfoLog.Debug( "ping time %dms from %s", time, NET_AdrToString( from ) );
 
-			// tack on the net type
-			switch ( from.type )
-			{
-				case netadrtype_t::NA_BROADCAST:
-				case netadrtype_t::NA_IP:
-					cl_pinglist[ i ].responseProto = serverResponseProtocol_t::IP4;
-					break;
+		serverInfo_t *server = CL_PingedServer( ping.server );
 
-				case netadrtype_t::NA_IP6:
-					cl_pinglist[ i ].responseProto = serverResponseProtocol_t::IP6;
-					break;
-
-				default:
-					cl_pinglist[ i ].responseProto = serverResponseProtocol_t::UNKNOWN;
-					break;
-			}
+		if ( server && pingScheduler.Complete( ping.server, now ) >= 0 && NET_CompareAdr( from, server->adr ) )
+		{
+			CL_SetServerInfo( server, infoString, CL_ResponseProtocol( from ), pingStatus_t::COMPLETE, time );
+		}
+		else
+		{
+			CL_SetServerInfoByAddress( from, infoString, CL_ResponseProtocol( from ), pingStatus_t::COMPLETE, time );
+		}
 
-			CL_SetServerInfoByAddress( from, infoString, cl_pinglist[ i ].responseProto,
-			                           pingStatus_t::COMPLETE, cl_pinglist[ i ].time );
+		CL_CacheServerInfo( from, infoString, time );
+		cl_pings.erase( it );
 
-			return;
-		}
+		return;
 	}
 
 	// if not just sent a local broadcast or pinging local servers
@@ -659,6 +858,7 @@ void CL_LocalServers_f()
 	// reset the list, waiting for response
 	cls.numlocalservers = 0;
 	cls.pingUpdateSource = AS_LOCAL;
+	CL_ResetPingSchedule( AS_LOCAL );
 
 	for ( i = 0; i < MAX_OTHER_SERVERS; i++ )
 	{
@@ -772,6 +972,7 @@ void CL_GlobalServers_f()
 		cls.numglobalservers = -1;
 		cls.numserverLinks = 0;
 		cls.pingUpdateSource = AS_GLOBAL;
+		CL_ResetPingSchedule( AS_GLOBAL );
 
 		Com_sprintf( command, sizeof( command ), "getserversExt %s %d dual",
 		             cl_gamename.Get().c_str(), protocol);
@@ -791,132 +992,6 @@ void CL_GlobalServers_f()
 	}
 }
 
-/*
-==================
-CL_GetPing
-==================
-*/
-static pingStatus_t CL_GetPing( int n )
-{
-	ASSERT( n >= 0 && n < MAX_PINGREQUESTS );
-	ASSERT( cl_pinglist[ n ].adr.port );
-
-	pingStatus_t status;
-	// FIXME: don't use 0 for timed out or waiting in cgame ABI
-	int time;
-
-	if ( cl_pinglist[ n ].time >= 0 )
-	{
-		time = cl_pinglist[ n ].time;
-		status = pingStatus_t::COMPLETE;
-	}
-	else
-	{
-		// check for timeout
-		int elapsed = Sys::Milliseconds() - cl_pinglist[ n ].start;
-
-		if ( elapsed >= cl_maxPing.Get() )
-		{
-			time = 0;
-			status = pingStatus_t::TIMEOUT;
-		}
-		else
-		{
-			time = 0;
-			status = pingStatus_t::WAITING;
-		}
-	}
-
-	// FIXME: do we really need to call this again? CL_ServerInfoPacket already calls it
-	// at the moment the ping response arrives
-	CL_SetServerInfoByAddress( cl_pinglist[ n ].adr, cl_pinglist[ n ].info,
-	                           cl_pinglist[ n ].responseProto, status, time );
-
-	return status;
-}
-
-/*
-==================
-CL_ClearPing
-==================
-*/
-static void CL_ClearPing( int n )
-{
-	if ( n < 0 || n >= MAX_PINGREQUESTS )
-	{
-		return;
-	}
-
-	cl_pinglist[ n ].adr.port = 0;
-	cl_pinglist[ n ].info[ 0 ] = '\0';
-}
-
-/*
-==================
-CL_GetPingQueueCount
-==================
-*/
-static int CL_GetPingQueueCount()
-{
-	int    i;
-	int    count;
-	ping_t *pingptr;
-
-	count = 0;
-	pingptr = cl_pinglist;
-
-	for ( i = 0; i < MAX_PINGREQUESTS; i++, pingptr++ )
-	{
-		if ( pingptr->adr.port )
-		{
-			count++;
-		}
-	}
-
-	return ( count );
-}
-
-/*
-==================
-CL_GetFreePing
-==================
-*/
-static ping_t &CL_GetFreePing()
-{
-	// Look for a free slot
-	for ( ping_t &ping : cl_pinglist )
-	{
-		if ( !ping.adr.port )
-		{
-			return ping;
-		}
-	}
-
-	// Look for an existing ping to cancel
-	ping_t *best = nullptr;
-	int oldestStart = std::numeric_limits<int>::max();
-
-	for ( ping_t &ping : cl_pinglist )
-	{
-		if ( ping.start <= oldestStart )
-		{
-			best = &ping;
-			oldestStart = ping.start;
-		}
-	}
-
-	if ( best->time >= 0 )
-	{
-		serverInfoLog.Verbose( "CL_GetFreePing: evicting completed ping record" );
-	}
-	else
-	{
-		serverInfoLog.Verbose( "CL_GetFreePing: evicting outstanding ping request" );
-	}
-
-	return *best;
-}
-
 static void GeneratePingChallenge( ping_t &ping )
 {
 	Crypto::Data bytes( 6 );
@@ -932,7 +1007,6 @@ CL_Ping_f
 */
 void CL_Ping_f()
 {
-	ping_t        *pingptr;
 	const char   *server;
 	int          argc;
 	netadrtype_t family = netadrtype_t::NA_UNSPEC;
@@ -974,51 +1048,33 @@ void CL_Ping_f()
 		return;
 	}
 
-	pingptr = &CL_GetFreePing();
+	ping_t &ping = cl_pings[ CL_PingKey( to ) ];
 
-	pingptr->adr = to;
-	pingptr->start = Sys::Milliseconds();
-	pingptr->time = -1;
-	GeneratePingChallenge( *pingptr );
+	ping.adr = to;
+	ping.start = Sys::Milliseconds();
+	ping.server = -1;
+	GeneratePingChallenge( ping );
 
-	CL_SetServerInfoByAddress( pingptr->adr, nullptr, serverResponseProtocol_t::UNKNOWN,
+	CL_SetServerInfoByAddress( ping.adr, nullptr, serverResponseProtocol_t::UNKNOWN,
 	                           pingStatus_t::WAITING, 0 );
 
-	Net::OutOfBandPrint( netsrc_t::NS_CLIENT, to, "getinfo %s", pingptr->challenge );
+	Net::OutOfBandPrint( netsrc_t::NS_CLIENT, to, "getinfo %s", ping.challenge );
 }
 
-// complete all of the 1st tries before starting 2nd tries, etc.
-static int PingAttemptNum( const serverInfo_t *servers, int count )
+// Times out the pings sent by the ping command
+static void CL_ExpireCommandPings( int now )
 {
-	int result = PING_MAX_ATTEMPTS;
-	for ( int i = 0; i < count; i++ )
+	for ( auto it = cl_pings.begin(); it != cl_pings.end(); )
 	{
-		if ( servers[ i ].visible && servers[ i ].pingStatus != pingStatus_t::COMPLETE )
+		if ( it->second.server < 0 && now - it->second.start >= cl_maxPing.Get() )
 		{
-			result = std::min( result, servers[ i ].pingAttempts );
+			CL_SetServerInfoByAddress( it->second.adr, "", serverResponseProtocol_t::UNKNOWN,
+			                           pingStatus_t::TIMEOUT, 0 );
+			it = cl_pings.erase( it );
 		}
-	}
-
-	while ( result < PING_MAX_ATTEMPTS && pingSpacing[ result ].Get() < 0 )
-	{
-		++result;
-	}
-
-	return result;
-}
-
-static void HarvestCompletedPings()
-{
-	for ( int i = 0; i < MAX_PINGREQUESTS; i++ )
-	{
-		if ( !cl_pinglist[ i ].adr.port )
-		{
-			continue;
-		}
-
-		if ( CL_GetPing( i ) != pingStatus_t::WAITING )
+		else
 		{
-			CL_ClearPing( i );
+			++it;
 		}
 	}
 }
@@ -1027,7 +1083,7 @@ static void HarvestCompletedPings()
 ==================
 CL_UpdateVisiblePings_f
 
-Returns true if there are any newly completed pings or any outstanding pings
+Returns true if there are any outstanding pings or visible servers left to ping
 ==================
 */
 bool CL_UpdateVisiblePings_f( int source )
@@ -1038,107 +1094,97 @@ bool CL_UpdateVisiblePings_f( int source )
 	}
 
 	cls.pingUpdateSource = source;
-	int usedSlots = CL_GetPingQueueCount();
-	bool status = usedSlots > 0;
-	HarvestCompletedPings();
 
-	if ( usedSlots < MAX_PINGREQUESTS )
+	if ( source != pingScheduleSource )
 	{
-		serverInfo_t *server;
-		int max;
-
-		switch ( source )
-		{
-			case AS_LOCAL:
-				server = &cls.localServers[ 0 ];
-				max = cls.numlocalservers;
-				break;
+		CL_ResetPingSchedule( pingScheduleSource );
+		pingScheduleSource = source;
+	}
 
-			case AS_GLOBAL:
-				server = &cls.globalServers[ 0 ];
-				max = cls.numglobalservers;
-				break;
+	serverInfo_t *servers;
+	int count;
 
-			default:
-				ASSERT_UNREACHABLE();
-		}
+	switch ( source )
+	{
+		case AS_LOCAL:
+			servers = &cls.localServers[ 0 ];
+			count = cls.numlocalservers;
+			break;
 
-		int attempt = PingAttemptNum( server, max );
+		case AS_GLOBAL:
+			servers = &cls.globalServers[ 0 ];
+			count = cls.numglobalservers;
+			break;
 
-		if ( attempt >= PING_MAX_ATTEMPTS )
-		{
-			return status; // all pings are complete
-		}
+		default:
+			ASSERT_UNREACHABLE();
+	}
 
-		if ( Sys::Milliseconds() < lastPingSendTime + pingSpacing[ attempt ].Get() )
-		{
-			return true; // rate limited
-		}
+	pingScheduler.Grow( count );
 
-		for ( int i = 0; i < max; i++ )
-		{
-			if ( !server[ i ].visible )
-			{
-				continue;
-			}
+	int now = Sys::Milliseconds();
+	CL_ExpireCommandPings( now );
 
-			if ( server[ i ].pingStatus == pingStatus_t::COMPLETE )
-			{
-				continue;
-			}
+	PingScheduler::Config config;
+	config.window = cl_pingWindow.Get();
+	config.timeout = cl_maxPing.Get();
+	config.backoff = cl_pingBackoff.Get();
 
-			if ( server[ i ].pingAttempts > attempt )
-			{
-				continue;
-			}
+	for ( int i = 0; i < PING_MAX_ATTEMPTS; i++ )
+	{
+		config.spacing[ i ] = pingSpacing[ i ].Get();
+	}
 
-			int j;
+	auto wanted = [ servers ]( int i ) {
+		return servers[ i ].visible && servers[ i ].pingStatus != pingStatus_t::COMPLETE;
+	};
 
-			for ( j = 0; j < MAX_PINGREQUESTS; j++ )
-			{
-				if ( !cl_pinglist[ j ].adr.port )
-				{
-					continue;
-				}
+	auto send = [ servers, now ]( int i, int attempt ) {
+		ping_t &ping = cl_pings[ CL_PingKey( servers[ i ].adr ) ];
+		ping.adr = servers[ i ].adr;
+		ping.start = now;
+		ping.server = i;
+		GeneratePingChallenge( ping );
+		Net::OutOfBandPrint( netsrc_t::NS_CLIENT, ping.adr, "getinfo %s", ping.challenge );
+		servers[ i ].pingAttempts = attempt + 1;
+	};
 
-				if ( NET_CompareAdr( cl_pinglist[ j ].adr, server[ i ].adr ) )
-				{
-					// already on the list
-					break;
-				}
-			}
+	auto timedOut = [ servers ]( int i, bool final ) {
+		auto it = cl_pings.find( CL_PingKey( servers[ i ].adr ) );
 
-			// Not in the list, so find and use a free slot.
-			if ( j >= MAX_PINGREQUESTS )
-			{
-				status = true;
-
-				ping_t &ping = CL_GetFreePing();
-				ping.adr = server[ i ].adr;
-				ping.start = Sys::Milliseconds();
-				ping.time = -1;
-				GeneratePingChallenge( ping );
-				Net::OutOfBandPrint( netsrc_t::NS_CLIENT, ping.adr, "getinfo %s", ping.challenge );
-				lastPingSendTime = ping.start;
-				server[ i ].pingAttempts = attempt + 1;
-
-				if ( ++usedSlots >= MAX_PINGREQUESTS )
-				{
-					break;
-				}
+		if ( it != cl_pings.end() && it->second.server == i )
+		{
+			cl_pings.erase( it );
+		}
 
-				if ( pingSpacing[ attempt ].Get() > 0 )
-				{
-					break;
-				}
-			}
+		// keep showing the last known info until the last attempt failed
+		if ( final )
+		{
+			CL_SetServerInfo( &servers[ i ], "", serverResponseProtocol_t::UNKNOWN, pingStatus_t::TIMEOUT, 0 );
 		}
-	}
+	};
+
+	bool status = pingScheduler.Update( now, config, wanted, send, timedOut );
 
-	if ( usedSlots > 0 )
+	if ( !status && serverInfoCacheModified )
 	{
-		status = true;
+		CL_SaveServerInfoCache();
 	}
 
-	return status;
+	return status || !cl_pings.empty();
+}
+
+/*
+==================
+CL_ResetPingAttempts
+
+Lets the visible servers of the source be pinged again
+==================
+*/
+void CL_ResetPingAttempts( int source )
+{
+	if ( source == pingScheduleSource )
+	{
+		pingScheduler.ResetAttempts();
+	}
 }
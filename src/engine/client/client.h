@@ -50,6 +50,8 @@ Maryland 20850 USA.
 #include "framework/CommandBufferHost.h"
 #include "common/IPC/CommandBuffer.h"
 
+#include "Timer.h"
+
 #define RETRANSMIT_TIMEOUT 3000 // time between connection packet retransmits
 
 // snapshots are a view of the server at a given time
@@ -200,6 +202,9 @@ struct clientConnection_t
 	// delta compression layer
 	int serverMessageSequence;
 
+	// playerstate field orders sent by the server
+	psDeltaDecoder_t psDelta;
+
 	// reliable messages received from server
 	int  serverCommandSequence;
 	int  lastExecutedServerCommand; // last server command grabbed or executed with CL_GetServerCommand
@@ -344,6 +349,7 @@ public:
 
 private:
 	virtual void Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel) override final;
+	virtual void FlushPendingMsgs() override final;
 	void QVMSyscall(int syscallNum, Util::Reader& reader, IPC::Channel& channel);
 
 	std::unique_ptr<VM::CommonVMServices> services;
@@ -457,6 +463,29 @@ void        CL_ShutdownRef();
 
 void CL_Record(std::string demo_name);
 
+//
+// cl_benchmark.cpp
+//
+
+// Time spent in each part of a timedemo frame, in nanoseconds
+struct timeDemoFrameStats_t
+{
+	uint64_t parse; // reading demo messages
+	uint64_t cgame; // the whole cgame frame call
+	uint64_t cgameServed; // serving cgame syscalls and commands during the cgame frame call
+	uint64_t syscalls; // serving cgame syscalls, during the cgame frame or not
+	uint64_t commandBuffer; // running the renderer and sound commands of the cgame
+	uint64_t screen; // the whole screen update, including the cgame frame
+	uint64_t frame; // the whole client frame
+};
+
+extern timeDemoFrameStats_t cl_timeDemoFrame;
+
+bool        CL_TimeDemoBenchmarking();
+void        CL_TimeDemoFrameBegin();
+void        CL_TimeDemoFrameEnd();
+void        CL_TimeDemoCompleted( int msec );
+
 //
 // cl_serverstatus.cpp
 //
@@ -544,6 +573,7 @@ void     CL_LocalServers_f();
 void     CL_GlobalServers_f();
 void     CL_Ping_f();
 bool CL_UpdateVisiblePings_f( int source );
+void CL_ResetPingAttempts( int source );
 
 //
 // console
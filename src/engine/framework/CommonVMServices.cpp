@@ -158,29 +158,100 @@ namespace VM {
 
     // Cvar related
 
+    // The changes are not sent to the VM right away, but coalesced until the next message to
+    // the VM, so that executing a config costs a single round trip. They are accepted in the
+    // meantime, and reverted if the VM rejects them.
     class CommonVMServices::ProxyCvar : public Cvar::CvarProxy {
         public:
-            ProxyCvar(CommonVMServices* services, std::string name, std::string description, int flags, std::string defaultValue)
-            :CvarProxy(std::move(name), flags, std::move(defaultValue)), services(services) {
-                wasAdded = Register(std::move(description));
+            ProxyCvar(CommonVMServices* services, int handle, std::string name, std::string description, int flags, std::string defaultValue)
+            :CvarProxy(std::move(name), flags, defaultValue), services(services), handle(handle),
+            vmValue(defaultValue), vmDescription(description) {
+                record = Cvar::RegisterRecord(this, this->name, std::move(description), flags, defaultValue);
             }
             virtual ~ProxyCvar() override {
-                if (wasAdded) {
+                if (record) {
                     Cvar::Unregister(name);
                 }
             }
 
             virtual Cvar::OnValueChangedResult OnValueChanged(Str::StringRef newValue) override {
-                Cvar::OnValueChangedResult result;
-                services->GetVM().SendMsg<OnValueChangedMsg>(name, newValue, result.success, result.description);
-                return result;
+                if (!pending) {
+                    services->pendingCvars.push_back(handle);
+                    pending = true;
+                }
+                pendingValue = newValue;
+                return Cvar::OnValueChangedResult{true, vmDescription};
+            }
+
+            // Takes the change to send, if it is one for the VM
+            bool TakePendingValue(std::string& value) {
+                pending = false;
+                value = std::move(pendingValue);
+                return value != vmValue;
+            }
+
+            void OnValidated(const std::string& value, bool success, const std::string& description) {
+                if (success) {
+                    vmValue = value;
+                    vmDescription = description;
+                    Cvar::ValueAccepted(record, name, value, description);
+                } else {
+                    Cvar::ValueRejected(record, name, value, description, vmValue, vmDescription);
+                }
+            }
+
+            void SetValue(const std::string& value) {
+                if (record) {
+                    Cvar::SetValue(record, name, value);
+                } else {
+                    Cvar::SetValue(name, value);
+                }
             }
 
         private:
-            bool wasAdded;
+            // Null if the cvar was already registered by someone else
+            Cvar::cvarRecord_t* record;
             CommonVMServices* services;
+            int handle;
+
+            bool pending = false;
+            std::string pendingValue;
+
+            // What the VM has
+            std::string vmValue;
+            std::string vmDescription;
     };
 
+    void CommonVMServices::FlushCvarChanges() {
+        if (pendingCvars.empty()) {
+            return;
+        }
+
+        std::vector<std::pair<int, std::string>> changes;
+        for (int handle : pendingCvars) {
+            std::string value;
+            if (registeredCvars[handle]->TakePendingValue(value)) {
+                changes.emplace_back(handle, std::move(value));
+            }
+        }
+        pendingCvars.clear();
+
+        if (changes.empty()) {
+            return;
+        }
+
+        std::vector<std::pair<bool, std::string>> results;
+        GetVM().SendMsg<OnValueChangedBatchMsg>(changes, results);
+
+        if (results.size() != changes.size()) {
+            Sys::Drop("VM '%s' answered %d of %d cvar changes", vmName, results.size(), changes.size());
+        }
+
+        for (size_t i = 0; i < changes.size(); i++) {
+            registeredCvars[changes[i].first]->OnValidated(changes[i].second, results[i].first, results[i].second);
+        }
+    }
+
     void CommonVMServices::HandleCvarSyscall(int minor, Util::Reader& reader, IPC::Channel& channel) {
         switch(minor) {
             case REGISTER_CVAR:
@@ -199,6 +270,10 @@ namespace VM {
 				AddCvarFlags(reader, channel);
 				break;
 
+            case SET_CVAR_HANDLE:
+                SetCvarHandle(reader, channel);
+                break;
+
             default:
                 Sys::Drop("Bad cvar syscall number '%d' for VM '%s'", minor, vmName);
         }
@@ -208,7 +283,10 @@ namespace VM {
         IPC::HandleMsg<RegisterCvarMsg>(channel, std::move(reader), [this](std::string name, std::string description,
                 int flags, std::string defaultValue){
             // The registration of the cvar is made automatically when it is created
-            registeredCvars.emplace_back(Util::make_unique<ProxyCvar>(this, name, description, flags, defaultValue));
+            registeredCvars.emplace_back(Util::make_unique<ProxyCvar>(this, registeredCvars.size(), name, description, flags, defaultValue));
+
+            // Let the VM know about the value from the configuration
+            FlushCvarChanges();
         });
     }
 
@@ -224,6 +302,22 @@ namespace VM {
         IPC::HandleMsg<SetCvarMsg>(channel, std::move(reader), [this](const std::string& name, std::string value){
             //TODO check it is only touching allowed cvars?
             Cvar::SetValue(name, value);
+
+            // The VM expects to see the new value of its own cvars
+            FlushCvarChanges();
+        });
+    }
+
+    void CommonVMServices::SetCvarHandle(Util::Reader& reader, IPC::Channel& channel) {
+        IPC::HandleMsg<SetCvarHandleMsg>(channel, std::move(reader), [this](int handle, const std::string& value){
+            if (handle < 0 || handle >= (int) registeredCvars.size()) {
+                Sys::Drop("VM '%s' set unknown cvar handle %d", vmName, handle);
+            }
+
+            registeredCvars[handle]->SetValue(value);
+
+            // The VM expects to see the new value of its own cvars
+            FlushCvarChanges();
         });
     }
 
@@ -45,6 +45,9 @@ namespace VM {
 
             void Syscall(int major, int minor, Util::Reader reader, IPC::Channel& channel);
 
+            // Sends the cvar changes not sent yet, must be done before any other message to the VM
+            void FlushCvarChanges();
+
         private:
             std::string vmName;
             FS::Owner fileOwnership;
@@ -75,9 +78,13 @@ namespace VM {
             void GetCvar(Util::Reader& reader, IPC::Channel& channel);
             void SetCvar(Util::Reader& reader, IPC::Channel& channel);
             void AddCvarFlags(Util::Reader& reader, IPC::Channel& channel);
+            void SetCvarHandle(Util::Reader& reader, IPC::Channel& channel);
 
             class ProxyCvar;
+            // In the order of registration, which is the handle of the cvar for the VM
             std::vector<std::unique_ptr<ProxyCvar>> registeredCvars;
+            // Handles of the cvars with a change not sent yet
+            std::vector<int> pendingCvars;
 
             // Log Related
             void HandleLogSyscall(int minor, Util::Reader& reader, IPC::Channel& channel);
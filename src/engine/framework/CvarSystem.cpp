@@ -223,6 +223,61 @@ namespace Cvar {
         cvar->description = std::move(realDescription);
     }
 
+    static void InternalSetRecordValue(const std::string& cvarName, cvarRecord_t* cvar, std::string value, bool rom, bool warnRom) {
+        if (not (cvar->flags & CVAR_USER_CREATED)) {
+            if (cvar->flags & CVAR_ROM and not rom) {
+                Log::Notice("%s is read only.", cvarName.c_str());
+                return;
+            }
+
+            if (cvar->flags & INIT and not rom) {
+                Log::Notice("%s can only be set at program initalization.", cvarName);
+                return;
+            }
+
+            if (rom and warnRom and not (cvar->flags & (CVAR_ROM | INIT))) {
+                Log::Notice("SetValueForce called on non-ROM cvar '%s'", cvarName.c_str());
+            }
+
+            if (not cheatsAllowed && cvar->flags & CHEAT) {
+                Log::Notice("%s is cheat-protected.", cvarName.c_str());
+                return;
+            }
+        }
+
+        // mark for archival if flagged as archive-on-change
+        if (cvar->flags & ARCHIVE) {
+            cvar->flags |= USER_ARCHIVE;
+        }
+
+        if (cvar->proxy) {
+            //Tell the cvar proxy about the new value
+            OnValueChangedResult result = cvar->proxy->OnValueChanged(value);
+
+            if (result.success) {
+                if (cvar->flags & INTERNAL_LATCH && value != cvar->value) {
+                    ChangeCvarDescription(cvarName, cvar, Str::Format("%s - latched value \"%s^*\"", result.description, value));
+                    OnValueChangedResult undo = cvar->proxy->OnValueChanged(cvar->value);
+                    if (!undo.success) {
+                        Sys::Error("error testing new value for latched cvar %s", cvarName);
+                    }
+                    Log::Notice("The change to %s will take effect after restart.", cvarName);
+                    cvar->latchedValue = value;
+                    return;
+                }
+                cvar->latchedValue = Util::nullopt;
+                cvar->value = std::move(value);
+                ChangeCvarDescription(cvarName, cvar, result.description);
+            } else {
+                Log::Notice("Value '%s^*' is not valid for cvar %s: %s", value, cvarName, result.description);
+                return;
+            }
+        } else {
+            cvar->value = std::move(value);
+        }
+        SetCCvar(*cvar);
+    }
+
     void InternalSetValue(const std::string& cvarName, std::string value, bool rom, bool warnRom) {
         CvarMap& cvars = GetCvarMap();
 
@@ -240,62 +295,8 @@ namespace Cvar {
             GetCCvar(cvarName, *cvars[cvarName]);
 
         } else {
-            cvarRecord_t* cvar = it->second;
-
-            if (not (cvar->flags & CVAR_USER_CREATED)) {
-                if (cvar->flags & CVAR_ROM and not rom) {
-                    Log::Notice("%s is read only.", cvarName.c_str());
-                    return;
-                }
-
-                if (cvar->flags & INIT and not rom) {
-                    Log::Notice("%s can only be set at program initalization.", cvarName);
-                    return;
-                }
-
-                if (rom and warnRom and not (cvar->flags & (CVAR_ROM | INIT))) {
-                    Log::Notice("SetValueForce called on non-ROM cvar '%s'", cvarName.c_str());
-                }
-
-                if (not cheatsAllowed && cvar->flags & CHEAT) {
-                    Log::Notice("%s is cheat-protected.", cvarName.c_str());
-                    return;
-                }
-            }
-
-            // mark for archival if flagged as archive-on-change
-            if (cvar->flags & ARCHIVE) {
-                cvar->flags |= USER_ARCHIVE;
-            }
-
-            if (cvar->proxy) {
-                //Tell the cvar proxy about the new value
-                OnValueChangedResult result = cvar->proxy->OnValueChanged(value);
-
-                if (result.success) {
-                    if (cvar->flags & INTERNAL_LATCH && value != cvar->value) {
-                        ChangeCvarDescription(cvarName, cvar, Str::Format("%s - latched value \"%s^*\"", result.description, value));
-                        OnValueChangedResult undo = cvar->proxy->OnValueChanged(cvar->value);
-                        if (!undo.success) {
-                            Sys::Error("error testing new value for latched cvar %s", cvarName);
-                        }
-                        Log::Notice("The change to %s will take effect after restart.", cvarName);
-                        cvar->latchedValue = value;
-                        return;
-                    }
-                    cvar->latchedValue = Util::nullopt;
-                    cvar->value = std::move(value);
-                    ChangeCvarDescription(cvarName, cvar, result.description);
-                } else {
-                    Log::Notice("Value '%s^*' is not valid for cvar %s: %s", value, cvarName, result.description);
-                    return;
-                }
-            } else {
-                cvar->value = std::move(value);
-            }
-            SetCCvar(*cvar);
+            InternalSetRecordValue(cvarName, it->second, std::move(value), rom, warnRom);
         }
-
     }
 
     // Simple proxies for InternalSetValue
@@ -307,6 +308,10 @@ namespace Cvar {
         InternalSetValue(cvarName, value, true, true);
     }
 
+    void SetValue(cvarRecord_t* cvar, const std::string& cvarName, const std::string& value) {
+        InternalSetRecordValue(cvarName, cvar, value, false, true);
+    }
+
     std::string GetValue(const std::string& cvarName) {
         CvarMap& cvars = GetCvarMap();
         std::string result = "";
@@ -320,6 +325,10 @@ namespace Cvar {
     }
 
     bool Register(CvarProxy* proxy, const std::string& name, std::string description, int flags, const std::string& defaultValue) {
+        return RegisterRecord(proxy, name, std::move(description), flags, defaultValue) != nullptr;
+    }
+
+    cvarRecord_t* RegisterRecord(CvarProxy* proxy, const std::string& name, std::string description, int flags, const std::string& defaultValue) {
         CvarMap& cvars = GetCvarMap();
         cvarRecord_t* cvar;
 
@@ -327,7 +336,7 @@ namespace Cvar {
         if (it == cvars.end()) {
             if (!Cmd::IsValidCvarName(name)) {
                 Log::Notice("Invalid cvar name '%s'", name.c_str());
-                return false;
+                return nullptr;
             }
 
             //Create the cvar and parse its default value
@@ -342,7 +351,7 @@ namespace Cvar {
 
             if (proxy && cvar->proxy) {
                 Log::Warn("Cvar %s cannot be registered twice", name.c_str());
-                return false;
+                return nullptr;
             }
 
             // Register the cvar with the previous user_created value
@@ -372,7 +381,7 @@ namespace Cvar {
             }
         }
         GetCCvar(name, *cvar);
-        return true;
+        return cvar;
     }
 
     void Unregister(const std::string& cvarName) {
@@ -387,6 +396,24 @@ namespace Cvar {
         } //TODO else what?
     }
 
+    void ValueAccepted(cvarRecord_t* cvar, const std::string& cvarName, const std::string& value, Str::StringRef description) {
+        // Nothing to do if the cvar has been changed again since
+        if (cvar->value == value) {
+            ChangeCvarDescription(cvarName, cvar, description);
+        }
+    }
+
+    void ValueRejected(cvarRecord_t* cvar, const std::string& cvarName, const std::string& value, Str::StringRef reason,
+            const std::string& previousValue, Str::StringRef previousDescription) {
+        Log::Notice("Value '%s^*' is not valid for cvar %s: %s", value, cvarName, reason);
+
+        if (cvar->value == value) {
+            cvar->value = previousValue;
+            SetCCvar(*cvar);
+            ChangeCvarDescription(cvarName, cvar, previousDescription);
+        }
+    }
+
     Cmd::CompletionResult Complete(Str::StringRef prefix) {
         CvarMap& cvars = GetCvarMap();
 
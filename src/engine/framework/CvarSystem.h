@@ -79,6 +79,19 @@ namespace Cvar {
     bool Register(CvarProxy* proxy, const std::string& name, std::string description, int flags, const std::string& defaultValue);
     void Unregister(const std::string& cvarName);
 
+    // The entry of a cvar in the cvar table, valid until the cvar system is shut down. Lets
+    // proxies such as the ones of the VMs access their cvar without looking it up by name.
+    struct cvarRecord_t;
+    // Like Register, returns nullptr when the cvar could not be registered
+    cvarRecord_t* RegisterRecord(CvarProxy* proxy, const std::string& name, std::string description, int flags, const std::string& defaultValue);
+    void SetValue(cvarRecord_t* cvar, const std::string& cvarName, const std::string& value);
+
+    // For proxies that validate new values later, such as the ones of the VMs. A rejected
+    // value is replaced by the previous one, unless the cvar has been changed since.
+    void ValueAccepted(cvarRecord_t* cvar, const std::string& cvarName, const std::string& value, Str::StringRef description);
+    void ValueRejected(cvarRecord_t* cvar, const std::string& cvarName, const std::string& value, Str::StringRef reason,
+            const std::string& previousValue, Str::StringRef previousDescription);
+
     // Marks the cvar as latch and sets the new value if any
     // TODO: support it in gamelogic too
     void Latch(CvarProxy& cvar);
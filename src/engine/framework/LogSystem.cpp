@@ -33,39 +33,271 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "qcommon/qcommon.h"
 #include "LogSystem.h"
 
+#include <condition_variable>
+#include <thread>
+
 namespace Log {
     static Target* targets[MAX_TARGET_ID];
 
+    static std::vector<Log::Event> buffers[MAX_TARGET_ID];
+    static std::recursive_mutex bufferLocks[MAX_TARGET_ID];
 
-    //TODO make me reentrant // or check it is actually reentrant when using for (Event e : events) do stuff
-    //TODO think way more about thread safety
-    void Dispatch(Log::Event event, int targetControl) {
-        static std::vector<Log::Event> buffers[MAX_TARGET_ID];
-        static std::recursive_mutex bufferLocks[MAX_TARGET_ID];
+    // Must be called with bufferLocks[id] held
+    static void ProcessBuffer(int id) {
+        auto& buffer = buffers[id];
 
-        if (Sys::IsProcessTerminating()) {
-            return;
+        bool processed = false;
+        if (targets[id]) {
+            processed = targets[id]->Process(buffer);
         }
 
-        for (int i = 0; i < MAX_TARGET_ID; i++) {
-            if ((targetControl >> i) & 1) {
-                std::lock_guard<std::recursive_mutex> guard(bufferLocks[i]);
-                auto& buffer = buffers[i];
+        if (processed || buffer.size() > 512) {
+            buffer.clear();
+        }
+    }
+
+    static Cvar::Cvar<bool> useAsyncWriter("logs.asyncWriter", "write to the logfile from a separate thread", Cvar::INIT | Cvar::TEMPORARY, true);
+
+    // Writing to the log file is slow, so once started its events are pushed in a bounded
+    // lock-free queue, and a writer thread hands them to the target in batches. Pushing never
+    // blocks, events are dropped and counted when the queue is full.
+    // The TTY stays synchronous as the consoles share their state with the main thread.
+    class AsyncWriter {
+        public:
+            static const int TARGETS = 1 << LOGFILE;
+
+            AsyncWriter() {
+                for (size_t i = 0; i < QUEUE_SIZE; i++) {
+                    slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            bool IsRunning() const {
+                return running.load(std::memory_order_acquire);
+            }
+
+            // Can be called by any thread.
+            void Push(std::string text, int targetControl) {
+                size_t pos = enqueuePos.load(std::memory_order_relaxed);
+                Slot* slot;
+                while (true) {
+                    slot = &slots[pos & (QUEUE_SIZE - 1)];
+                    intptr_t diff = intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(pos);
+
+                    if (diff == 0) {
+                        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            break;
+                        }
+                    } else if (diff < 0) {
+                        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    } else {
+                        pos = enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+
+                slot->text = std::move(text);
+                slot->targetControl = targetControl;
+                slot->sequence.store(pos + 1, std::memory_order_release);
+
+                if (sleeping.load(std::memory_order_acquire)) {
+                    std::lock_guard<std::mutex> guard(wakeLock);
+                    wake.notify_one();
+                }
+            }
+
+            void Start() {
+                if (running.load() or not useAsyncWriter.Get()) {
+                    return;
+                }
 
-                buffer.push_back(event);
+                halt.store(false);
+                thread = std::thread(&AsyncWriter::Run, this);
+                threadId = thread.get_id();
+                running.store(true, std::memory_order_release);
+            }
+
+            // Writes out everything that is queued, and goes back to writing on the calling thread
+            void Stop() {
+                if (not running.exchange(false)) {
+                    Drain();
+                    return;
+                }
 
-                bool processed = false;
-                if (targets[i]) {
-                    processed = targets[i]->Process(buffer);
+                {
+                    std::lock_guard<std::mutex> guard(wakeLock);
+                    halt.store(true);
+                    wake.notify_one();
                 }
 
-                if (processed || buffer.size() > 512) {
-                    buffer.clear();
+                // On a crash in the writer thread we can't wait for it, nor trust the queue
+                if (std::this_thread::get_id() == threadId) {
+                    thread.detach();
+                    return;
                 }
+
+                thread.join();
+                Drain();
+            }
+
+            // Hands every queued event to its targets, returns false if there were none.
+            // Only one thread at a time can be the consumer.
+            bool Drain() {
+                std::lock_guard<std::mutex> guard(drainLock);
+
+                batch.clear();
+                while (batch.size() < MAX_BATCH) {
+                    Slot* slot = &slots[dequeuePos & (QUEUE_SIZE - 1)];
+                    if (intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(dequeuePos + 1) < 0) {
+                        break;
+                    }
+
+                    batch.emplace_back(std::move(slot->text), slot->targetControl);
+                    slot->sequence.store(dequeuePos + QUEUE_SIZE, std::memory_order_release);
+                    dequeuePos++;
+                }
+
+                size_t dropped = droppedEvents.load(std::memory_order_relaxed);
+                if (dropped != reportedDrops) {
+                    batch.emplace_back(Str::Format("^3Warn: the log queue was full, dropped %d events", dropped - reportedDrops), TARGETS);
+                    reportedDrops = dropped;
+                }
+
+                if (batch.empty()) {
+                    return false;
+                }
+
+                for (int i = 0; i < MAX_TARGET_ID; i++) {
+                    if (not ((TARGETS >> i) & 1)) {
+                        continue;
+                    }
+
+                    std::lock_guard<std::recursive_mutex> bufferGuard(bufferLocks[i]);
+                    bool added = false;
+                    for (const auto& event : batch) {
+                        if ((event.second >> i) & 1) {
+                            buffers[i].emplace_back(event.first);
+                            added = true;
+                        }
+                    }
+
+                    if (added) {
+                        ProcessBuffer(i);
+                    }
+                }
+
+                return true;
+            }
+
+            // Hands to the targets every event pushed before the call, the writer thread
+            // may be doing it already so it is waited for.
+            void Flush() {
+                // A crash in the writer thread can leave the queue locked
+                if (std::this_thread::get_id() == threadId) {
+                    return;
+                }
+
+                const size_t end = enqueuePos.load(std::memory_order_acquire);
+
+                while (true) {
+                    {
+                        std::lock_guard<std::mutex> guard(drainLock);
+                        if (intptr_t(dequeuePos - end) >= 0) {
+                            return;
+                        }
+                    }
+
+                    // An event can be claimed but not written yet by its producer
+                    if (not Drain()) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+
+        private:
+            static const size_t QUEUE_SIZE = 4096; // Must be a power of 2
+            static const size_t MAX_BATCH = 256;
+
+            struct Slot {
+                std::atomic<size_t> sequence;
+                int targetControl;
+                std::string text;
+            };
+
+            void Run() {
+                while (not halt.load()) {
+                    if (Drain()) {
+                        continue;
+                    }
+
+                    std::unique_lock<std::mutex> guard(wakeLock);
+                    sleeping.store(true, std::memory_order_release);
+
+                    // The timeout covers events pushed between Drain and sleeping being set
+                    if (not halt.load()) {
+                        wake.wait_for(guard, std::chrono::milliseconds(10));
+                    }
+
+                    sleeping.store(false, std::memory_order_release);
+                }
+            }
+
+            Slot slots[QUEUE_SIZE];
+            std::atomic<size_t> enqueuePos{0};
+            std::atomic<size_t> droppedEvents{0};
+
+            // Consumer side, guarded by drainLock
+            std::mutex drainLock;
+            size_t dequeuePos = 0;
+            size_t reportedDrops = 0;
+            std::vector<std::pair<std::string, int>> batch;
+
+            std::atomic<bool> running{false};
+            std::atomic<bool> halt{false};
+            std::atomic<bool> sleeping{false};
+            std::mutex wakeLock;
+            std::condition_variable wake;
+            std::thread thread;
+            std::thread::id threadId;
+    };
+
+    // Never destroyed, so that logging keeps working during static destruction
+    static AsyncWriter& asyncWriter = *new AsyncWriter;
+
+    void Dispatch(Log::Event event, int targetControl) {
+        if (Sys::IsProcessTerminating()) {
+            return;
+        }
+
+        if (asyncWriter.IsRunning() && (targetControl & AsyncWriter::TARGETS)) {
+            int asyncTargets = targetControl & AsyncWriter::TARGETS;
+            targetControl &= ~AsyncWriter::TARGETS;
+
+            if (targetControl) {
+                asyncWriter.Push(event.text, asyncTargets);
+            } else {
+                asyncWriter.Push(std::move(event.text), asyncTargets);
+                return;
+            }
+        }
+
+        for (int i = 0; i < MAX_TARGET_ID; i++) {
+            if ((targetControl >> i) & 1) {
+                std::lock_guard<std::recursive_mutex> guard(bufferLocks[i]);
+                buffers[i].push_back(event);
+                ProcessBuffer(i);
             }
         }
     }
 
+    void StartAsyncWriter() {
+        asyncWriter.Start();
+    }
+
+    void StopAsyncWriter() {
+        asyncWriter.Stop();
+    }
+
     void RegisterTarget(TargetId id, Target* target) {
         targets[id] = target;
     }
@@ -86,10 +318,12 @@ namespace Log {
             }
 
             virtual bool Process(const std::vector<Log::Event>& events) override {
+                std::string text;
                 for (auto& event : events)  {
-                    CON_Print(event.text.c_str());
-                    CON_Print("\n");
+                    text += event.text;
+                    text += '\n';
                 }
+                CON_Print(text.c_str());
                 return true;
             }
     };
@@ -114,9 +348,12 @@ namespace Log {
                 }
 
                 if (logFile) {
+                    std::string text;
                     for (auto& event : events) {
-                        logFile.Printf("%s\n", event.text);
+                        text += event.text;
+                        text += '\n';
                     }
+                    logFile.Write(text.data(), text.size());
                     return true;
                 } else {
                     return false;
@@ -150,6 +387,9 @@ namespace Log {
     }
 
     void FlushLogFile() {
+        asyncWriter.Flush();
+
+        std::lock_guard<std::recursive_mutex> guard(bufferLocks[LOGFILE]);
         std::error_code err;
         logfile.logFile.Flush(err);
         if (err) {
@@ -52,6 +52,13 @@ namespace Log {
 
     void FlushLogFile();
 
+    // Start writing to the log file from a separate thread.
+    // Called once threads can be created.
+    void StartAsyncWriter();
+
+    // Write out the queued events and go back to writing on the calling thread
+    void StopAsyncWriter();
+
     class Target {
         public:
             Target();
@@ -521,6 +521,9 @@ static void Shutdown(bool error, Str::StringRef message)
 		Cvar::Shutdown();
 	}
 
+	// Write out the queued logs while the console can still print them
+	Log::StopAsyncWriter();
+
 	// Always run CON_Shutdown, because it restores the terminal to a usable state.
 	CON_Shutdown();
 
@@ -956,6 +959,9 @@ static void Init(int argc, char** argv)
 		Sys::Error("Could not create singleton socket thread: %s", err.what());
 	}
 
+	EarlyCvar("logs.asyncWriter", cmdlineArgs);
+	Log::StartAsyncWriter();
+
 	// Load the base paks
 	// TODO: cvar names and FS_* stuff needs to be properly integrated
 	EarlyCvar("fs_basepak", cmdlineArgs);
@@ -131,6 +131,8 @@ public:
 	// Send a message to the VM
 	template<typename Msg, typename... Args> void SendMsg(Args&&... args)
 	{
+		FlushPendingMsgs();
+
 		// Marking lambda as mutable to work around a bug in gcc 4.6
 		LogMessage(false, true, Msg::id);
 		IPC::SendMsg<Msg>(rootChannel, [this](uint32_t id, Util::Reader reader) mutable {
@@ -156,6 +158,9 @@ protected:
 	// System call handler
 	virtual void Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel) = 0;
 
+	// Sends the messages held back to be batched, before any other message
+	virtual void FlushPendingMsgs() {}
+
 private:
 	void FreeInProcessVM();
 
@@ -100,6 +100,10 @@ int R_MarkFragments( int, const vec3_t*, const vec3_t, int, vec3_t, int, markFra
 {
 	return 0;
 }
+void RE_MarkFragmentsBatch( const markRequest_t*, int numRequests, int, int, int *results )
+{
+	std::fill_n( results, numRequests, 0 );
+}
 int R_LerpTag( orientation_t*, const refEntity_t*, const char*, int )
 {
 	return 0;
@@ -132,6 +136,14 @@ int RE_BlendSkeleton( refSkeleton_t*, const refSkeleton_t*, float )
 {
 	return 1;
 }
+void RE_BuildSkeletons( const skeletonRequest_t*, int numRequests, refSkeleton_t *skels, int *results )
+{
+	for ( int i = 0; i < numRequests; i++ )
+	{
+		skels[ i ].numBones = 0;
+		results[ i ] = 1;
+	}
+}
 int RE_BoneIndex( qhandle_t, const char* )
 {
 	return 0;
@@ -229,6 +241,7 @@ refexport_t    *GetRefAPI( int, refimport_t* )
     re.SendBotDebugDrawCommands = RE_SendBotDebugDrawCommands;
 
     re.MarkFragments = R_MarkFragments;
+    re.MarkFragmentsBatch = RE_MarkFragmentsBatch;
 
     re.ModelBounds = R_ModelBounds;
 
@@ -244,6 +257,7 @@ refexport_t    *GetRefAPI( int, refimport_t* )
     re.CheckSkeleton = RE_CheckSkeleton;
     re.BuildSkeleton = RE_BuildSkeleton;
     re.BlendSkeleton = RE_BlendSkeleton;
+    re.BuildSkeletons = RE_BuildSkeletons;
     re.BoneIndex = RE_BoneIndex;
     re.AnimNumFrames = RE_AnimNumFrames;
     re.AnimFrameRate = RE_AnimFrameRate;
@@ -52,6 +52,8 @@ Maryland 20850 USA.
 #include "sys/sys_events.h"
 #include <common/FileSystem.h>
 
+#include "Timer.h"
+
 cvar_t *com_speeds;
 cvar_t *com_timescale;
 cvar_t *com_dropsim; // 0.0 to 1.0, simulated packet drops
@@ -439,6 +441,12 @@ void Com_EventLoop()
 				}
 			}
 
+			// client packets are executed together once they are all in
+			if ( com_sv_running.Get() )
+			{
+				SV_FlushClientMessages();
+			}
+
 			return;
 		}
 
@@ -782,12 +790,83 @@ static Cvar::Cvar<std::string> watchdogCmd("common.watchdogCmd", "the command tr
 
 static Cvar::Cvar<bool> showTraceStats("common.showTraceStats", "are physics traces stats printed each frame", Cvar::CHEAT, false);
 
+static Cvar::Range<Cvar::Cvar<int>> spinMargin("common.framerate.spinMargin", "in microseconds, how long before the next frame to stop sleeping and spin instead", Cvar::NONE, 1500, 0, 20000);
+
+/*
+Histogram of how much longer than its frame budget each frame took, sleeping
+overshoots and frames that are too slow both end up here.
+The upper bounds of the buckets are in microseconds, the last bucket has none.
+*/
+static const int frameJitterBounds[] = { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000 };
+
+static struct
+{
+	uint64_t buckets[ ARRAY_LEN( frameJitterBounds ) + 1 ];
+	uint64_t frames;
+	uint64_t totalNs;
+	uint64_t maxNs;
+} frameJitter;
+
+static void Com_RecordFrameJitter( uint64 budgetNs, uint64 frameNs )
+{
+	const uint64 jitterNs = frameNs > budgetNs ? frameNs - budgetNs : 0;
+
+	size_t bucket = 0;
+	while ( bucket < ARRAY_LEN( frameJitterBounds ) && jitterNs >= frameJitterBounds[ bucket ] * 1_us )
+	{
+		bucket++;
+	}
+
+	frameJitter.buckets[ bucket ]++;
+	frameJitter.frames++;
+	frameJitter.totalNs += jitterNs;
+	frameJitter.maxNs = std::max( frameJitter.maxNs, jitterNs );
+}
+
+class FrameJitterCmd : public Cmd::StaticCmd
+{
+public:
+	FrameJitterCmd():
+		StaticCmd("frameJitter", Cmd::BASE, "Shows how late frames start compared to the framerate limit, 'reset' clears the stats")
+	{}
+
+	void Run(const Cmd::Args& args) const override
+	{
+		if ( args.Argc() > 1 && args.Argv( 1 ) == "reset" )
+		{
+			ResetStruct( frameJitter );
+			return;
+		}
+
+		if ( !frameJitter.frames )
+		{
+			Print( "No paced frames yet" );
+			return;
+		}
+
+		Print( "%u frames, average %s late, max %s late", frameJitter.frames,
+			FormatTime( frameJitter.totalNs / frameJitter.frames, TimeUnit::ms ), FormatTime( frameJitter.maxNs, TimeUnit::ms ) );
+
+		for ( size_t i = 0; i < ARRAY_LEN( frameJitter.buckets ); i++ )
+		{
+			std::string range = i < ARRAY_LEN( frameJitterBounds )
+				? Str::Format( "< %5dus", frameJitterBounds[ i ] )
+				: Str::Format( ">= %4dus", frameJitterBounds[ i - 1 ] );
+
+			Print( "%s: %8u %5.1f%%", range, frameJitter.buckets[ i ],
+				100.0 * frameJitter.buckets[ i ] / frameJitter.frames );
+		}
+	}
+};
+static FrameJitterCmd FrameJitterCmdRegistration;
+
 void Com_Frame()
 {
 	Omp::SetupThreads();
 
-	int             msec, minMsec;
-	static int      lastTime = 0;
+	int             msec;
+	uint64          budgetNs;
+	static uint64   lastFrameNs = 0;
 	//int             key;
 
 	int             timeBeforeFirstEvents;
@@ -830,7 +909,7 @@ void Com_Frame()
 	{
 		if ( Com_IsDedicatedServer() )
 		{
-			minMsec = SV_FrameMsec();
+			budgetNs = SV_FrameMsec() * 1_ms;
 		}
 		else
 		{
@@ -850,23 +929,25 @@ void Com_Frame()
 			}
 
 			// A positive maxfps caps the fps to the given number, with an implicit
-			// cap at 333fps to avoid bugs. Above 333fps minMsec is less than 3.
-			// At 1 or 2 minMsec, the game still runs but exhibits various issues
+			// cap at 333fps to avoid bugs. Above 333fps the budget is less than 3ms.
+			// At 1 or 2ms, the game still runs but exhibits various issues
 			// such as first-person weapon model flickering, or client having
 			// connection issues with server.
+			// The budget isn't rounded to milliseconds so that e.g. 144fps gets
+			// 6.94ms frames instead of 7ms ones.
 			if ( max > 0 )
 			{
-				minMsec = std::max( 1000 / max, 3 );
+				budgetNs = std::max( 1_s / max, 3_ms );
 			}
 			// A zero maxfps unlocks fps but still cap it to 333 to avoid bugs.
 			else if ( max == 0 )
 			{
-				minMsec = 3;
+				budgetNs = 3_ms;
 			}
 			// A negative maxfps really unlocks fps (and bugs).
 			else
 			{
-				minMsec = 1;
+				budgetNs = 1_ms;
 			}
 		}
 	}
@@ -874,8 +955,8 @@ void Com_Frame()
 	{
 		// It looks like demo played with cvar_demo_timedemo enabled
 		// are not affected by the rendering bugs related to having
-		// minMsec being lower than 3.
-		minMsec = 0;
+		// a frame budget lower than 3ms.
+		budgetNs = 0;
 	}
 
 	Com_EventLoop();
@@ -883,45 +964,54 @@ void Com_Frame()
 	// It must be called at least once.
 	IN_Frame();
 
-	com_frameTime = Sys::Milliseconds();
-
-	// lastTime can be greater than com_frameTime on first frame.
-	lastTime = std::min( lastTime, com_frameTime );
+	uint64 frameStartNs = TimeNs();
 
-	msec = com_frameTime - lastTime;
+	if ( !lastFrameNs )
+	{
+		lastFrameNs = frameStartNs;
+	}
 
-	// For framerates up to 250fps, sleep until 1ms is remaining
-	// use extra margin of 2ms when looking for an higher framerate.
-	int margin = minMsec > 3 ? 1 : 2;
+	// Sleeping is only precise to a millisecond or worse, so sleep until
+	// common.framerate.spinMargin is remaining, then keep pumping events
+	// until the budget is reached.
+	const uint64 margin = spinMargin.Get() * 1_us;
 
-	while ( msec < minMsec )
+	while ( frameStartNs - lastFrameNs < budgetNs )
 	{
-		// Never sleep more than 50ms.
-		// Never sleep when there is only “margin” left or less remaining.
-		int sleep = std::min( std::max( minMsec - msec - margin, 0 ), 50 );
+		const uint64 remainingNs = budgetNs - ( frameStartNs - lastFrameNs );
 
-		if ( sleep )
+		if ( remainingNs > margin )
 		{
+			// Never sleep more than 50ms.
 			// Give cycles back to the OS.
-			Sys::SleepFor( std::chrono::milliseconds( sleep ) );
+			Sys::SleepFor( std::chrono::nanoseconds( std::min( remainingNs - margin, 50_ms ) ) );
 		}
 
 		Com_EventLoop();
 
 		IN_Frame();
 
-		com_frameTime = Sys::Milliseconds();
+		frameStartNs = TimeNs();
+	}
 
-		msec = com_frameTime - lastTime;
+	com_frameTime = Sys::Milliseconds();
+
+	// Whole milliseconds elapsed on the same clock, so that fractional frame budgets
+	// add up to the right amount of game time over several frames
+	msec = static_cast<int>( frameStartNs / 1_ms - lastFrameNs / 1_ms );
+
+	if ( budgetNs )
+	{
+		Com_RecordFrameJitter( budgetNs, frameStartNs - lastFrameNs );
 	}
 
+	lastFrameNs = frameStartNs;
+
 	IN_FrameEnd();
 
 	Keyboard::BufferDeferredBinds();
 	Cmd::ExecuteCommandBuffer();
 
-	lastTime = com_frameTime;
-
 	// mess with msec if needed
 	com_frameMsec = msec;
 	msec = Com_ModifyMsec( msec );
@@ -39,7 +39,8 @@ Maryland 20850 USA.
 #include "qcommon/q_shared.h"
 #include "qcommon.h"
 
-static int bloc = 0;
+// client packets are decoded on several threads, see SV_FlushClientMessages
+static thread_local int bloc = 0;
 
 //bani - optimized version
 //clears data along the way so we don't have to memset() it ahead of time
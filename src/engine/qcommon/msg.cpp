@@ -33,6 +33,7 @@ Maryland 20850 USA.
 */
 
 #include <stddef.h>
+#include <numeric>
 #include "qcommon/q_shared.h"
 #include "qcommon.h"
 
@@ -220,6 +221,51 @@ void MSG_WriteBits( msg_t *msg, int value, int bits )
 	}
 }
 
+/*
+=============
+MSG_WriteBitstream
+
+The huffman code of a write doesn't depend on where it is in the message, so the
+bits can be copied to another position instead of encoding the values again.
+=============
+*/
+void MSG_WriteBitstream( msg_t *msg, const msg_t *src, int firstBit, int bits )
+{
+	if ( msg->oob || src->oob )
+	{
+		Sys::Drop( "MSG_WriteBitstream: can't copy out of band data" );
+	}
+
+	if ( bits <= 0 )
+	{
+		return;
+	}
+
+	if ( msg->maxsize - msg->cursize < ( bits >> 3 ) + 32 )
+	{
+		msg->overflowed = true;
+		return;
+	}
+
+	for ( int end = firstBit + bits; firstBit < end; )
+	{
+		// as many bits as are left in both the source and destination bytes
+		int n = std::min( { 8 - ( firstBit & 7 ), 8 - ( msg->bit & 7 ), end - firstBit } );
+		int value = ( src->data[ firstBit >> 3 ] >> ( firstBit & 7 ) ) & ( ( 1 << n ) - 1 );
+
+		if ( !( msg->bit & 7 ) )
+		{
+			msg->data[ msg->bit >> 3 ] = 0;
+		}
+
+		msg->data[ msg->bit >> 3 ] |= value << ( msg->bit & 7 );
+		msg->bit += n;
+		firstBit += n;
+	}
+
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
 int MSG_ReadBits( msg_t *msg, int bits )
 {
 	int      value;
@@ -1247,6 +1293,8 @@ static bool IsValid(const NetcodeTable& table, int size) {
 
 static NetcodeTable playerStateFields;
 static size_t playerStateSize;
+// field indices in the order of the netcode table, used by order slot 0
+static psDeltaOrder_t playerStateTableOrder;
 // This will be called twice (with what should be the same data both times) in a local
 // game where both the cgame and sgame are running.
 void MSG_InitNetcodeTables(NetcodeTable playerStateTable, int psSize) {
@@ -1255,6 +1303,9 @@ void MSG_InitNetcodeTables(NetcodeTable playerStateTable, int psSize) {
 
 	playerStateFields = std::move(playerStateTable);
 	playerStateSize = psSize;
+
+	playerStateTableOrder.numFields = std::min( playerStateFields.size(), size_t( PS_DELTA_MAX_FIELDS ) );
+	std::iota( playerStateTableOrder.fields, playerStateTableOrder.fields + playerStateTableOrder.numFields, 0 );
 }
 // TODO: add function to clear
 
@@ -1330,24 +1381,332 @@ static void WriteStatsGroup(msg_t* msg, const int* from, const int* to)
 	}
 }
 
+// Exp-Golomb code: as many zero bits as the value + 1 has bits after its leading one, then those bits
+static int ExpGolombBits( unsigned value )
+{
+	int len = 0;
+
+	for ( unsigned x = value + 1; x > 1; x >>= 1 )
+	{
+		len++;
+	}
+
+	return 2 * len + 1;
+}
+
+static void MSG_WriteExpGolomb( msg_t *msg, unsigned value )
+{
+	unsigned x = value + 1;
+	int      len = ExpGolombBits( value ) / 2;
+
+	if ( len )
+	{
+		MSG_WriteBits( msg, 0, len );
+	}
+
+	MSG_WriteBits( msg, 1, 1 );
+
+	if ( len )
+	{
+		MSG_WriteBits( msg, x & ( ( 1 << len ) - 1 ), len );
+	}
+}
+
+static unsigned MSG_ReadExpGolomb( msg_t *msg )
+{
+	int len = 0;
+
+	while ( !MSG_ReadBits( msg, 1 ) )
+	{
+		// nothing sent this way needs more than 16 bits
+		if ( ++len > 16 )
+		{
+			Sys::Drop( "invalid Exp-Golomb code" );
+		}
+	}
+
+	unsigned x = 1 << len;
+
+	if ( len )
+	{
+		x |= MSG_ReadBits( msg, len );
+	}
+
+	return x - 1;
+}
+
+// does not include presence bit, the stats that changed are sent as gaps when that is shorter than their mask
+static void WriteStatsGroupAdaptive( msg_t *msg, const int *from, const int *to )
+{
+	int statsbits = 0;
+	int count = 0;
+	int gapBits = 0;
+
+	for ( int i = 0, last = -1; i < STATS_GROUP_NUM_STATS; i++ )
+	{
+		if ( from[ i ] != to[ i ] )
+		{
+			statsbits |= 1 << i;
+			gapBits += ExpGolombBits( i - last - 1 );
+			last = i;
+			count++;
+		}
+	}
+
+	gapBits += ExpGolombBits( count - 1 );
+
+	if ( gapBits < 16 )
+	{
+		MSG_WriteBits( msg, 0, 1 );
+		MSG_WriteExpGolomb( msg, count - 1 );
+
+		for ( int i = 0, last = -1; i < STATS_GROUP_NUM_STATS; i++ )
+		{
+			if ( statsbits & ( 1 << i ) )
+			{
+				MSG_WriteExpGolomb( msg, i - last - 1 );
+				last = i;
+			}
+		}
+	}
+	else
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteShort( msg, statsbits );
+	}
+
+	for ( int i = 0; i < STATS_GROUP_NUM_STATS; i++ )
+	{
+		if ( statsbits & ( 1 << i ) )
+		{
+			MSG_WriteShort( msg, to[ i ] );
+		}
+	}
+}
+
+// does not include presence bit
+static void WriteFieldValue( msg_t *msg, const netField_t& field, const int *toF )
+{
+	if ( field.bits == 0 )
+	{
+		// float
+		float fullFloat = * ( float * ) toF;
+		int   trunc = ( int ) fullFloat;
+
+		if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 && trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) )
+		{
+			// send as small integer
+			MSG_WriteBits( msg, 0, 1 );
+			MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+		}
+		else
+		{
+			// send as full floating point value
+			MSG_WriteBits( msg, 1, 1 );
+			MSG_WriteBits( msg, *toF, 32 );
+		}
+	}
+	else
+	{
+		// integer
+		MSG_WriteBits( msg, *toF, field.bits );
+	}
+}
+
+// bits of an index into the playerstate fields
+static int PlayerStateIndexBits()
+{
+	int bits = 1;
+
+	while ( ( 1 << bits ) < int( playerStateFields.size() ) )
+	{
+		bits++;
+	}
+
+	return bits;
+}
+
+// bits of the changed field list of a delta in a given order
+static int PlayerStateMaskBits( const psDeltaOrder_t& order, const std::bitset<PS_DELTA_MAX_FIELDS>& changed )
+{
+	int bits = ExpGolombBits( changed.count() );
+	int last = -1;
+
+	for ( int i = 0; i < order.numFields; i++ )
+	{
+		if ( changed[ order.fields[ i ] ] )
+		{
+			bits += ExpGolombBits( i - last - 1 );
+			last = i;
+		}
+	}
+
+	return bits;
+}
+
+/*
+=============
+MSG_ChoosePlayerStateOrder
+
+Sorts the fields by how often they changed in the last deltas, the ones most
+likely to change coming first so that they are reached with short gaps. The
+new order is only worth it if what it would have saved on these deltas pays
+for sending it once, the resends until the client acknowledges it are paid by
+the deltas that follow.
+=============
+*/
+static void MSG_ChoosePlayerStateOrder( psDeltaEncoder_t *encoder, int messageNum )
+{
+	const psDeltaOrder_t& current = encoder->slot ? encoder->orders[ encoder->slot ] : playerStateTableOrder;
+	int counts[ PS_DELTA_MAX_FIELDS ] = {};
+
+	for ( int i = 0; i < encoder->numHistory; i++ )
+	{
+		for ( int field = 0; field < current.numFields; field++ )
+		{
+			counts[ field ] += encoder->history[ i ][ field ];
+		}
+	}
+
+	psDeltaOrder_t candidate = current;
+	std::stable_sort( candidate.fields, candidate.fields + candidate.numFields, [ &counts ]( byte a, byte b ) {
+		return counts[ a ] > counts[ b ];
+	} );
+
+	int saved = 0;
+
+	for ( int i = 0; i < encoder->numHistory; i++ )
+	{
+		saved += PlayerStateMaskBits( current, encoder->history[ i ] ) - PlayerStateMaskBits( candidate, encoder->history[ i ] );
+	}
+
+	if ( saved <= 1 + candidate.numFields * PlayerStateIndexBits() )
+	{
+		return;
+	}
+
+	encoder->pendingSlot = encoder->slot % ( PS_DELTA_ORDER_SLOTS - 1 ) + 1;
+	encoder->pendingMessage = messageNum;
+	encoder->orders[ encoder->pendingSlot ] = candidate;
+}
+
+/*
+=============
+MSG_WriteAdaptivePlayerstate
+
+Everything after the field count of a PS_DELTA_ADAPTIVE delta, see qcommon.h
+=============
+*/
+static void MSG_WriteAdaptivePlayerstate( msg_t *msg, bool delta, const OpaquePlayerState *from, const OpaquePlayerState *to,
+                                          const std::bitset<PS_DELTA_MAX_FIELDS>& changed, psDeltaEncoder_t *encoder,
+                                          int messageNum, int acknowledged, bool canSendOrder )
+{
+	if ( !delta )
+	{
+		// the client may be starting a demo, it can't know about earlier orders
+		encoder->slot = 0;
+		encoder->pendingSlot = 0;
+		encoder->numHistory = 0;
+	}
+	else
+	{
+		if ( encoder->pendingSlot && acknowledged >= encoder->pendingMessage )
+		{
+			encoder->slot = encoder->pendingSlot;
+			encoder->pendingSlot = 0;
+		}
+
+		encoder->history[ encoder->numHistory++ ] = changed;
+
+		if ( encoder->numHistory == PS_DELTA_HISTORY )
+		{
+			if ( !encoder->pendingSlot && canSendOrder )
+			{
+				MSG_ChoosePlayerStateOrder( encoder, messageNum );
+			}
+
+			encoder->numHistory = 0;
+		}
+	}
+
+	int slot = encoder->pendingSlot ? encoder->pendingSlot : encoder->slot;
+	const psDeltaOrder_t& order = slot ? encoder->orders[ slot ] : playerStateTableOrder;
+
+	MSG_WriteBits( msg, slot, PS_DELTA_SLOT_BITS );
+
+	if ( slot )
+	{
+		MSG_WriteBits( msg, slot == encoder->pendingSlot, 1 );
+
+		if ( slot == encoder->pendingSlot )
+		{
+			int indexBits = PlayerStateIndexBits();
+
+			for ( int i = 0; i < order.numFields; i++ )
+			{
+				MSG_WriteBits( msg, order.fields[ i ], indexBits );
+			}
+		}
+	}
+
+	MSG_WriteExpGolomb( msg, changed.count() );
+
+	for ( int i = 0, last = -1; i < order.numFields; i++ )
+	{
+		if ( changed[ order.fields[ i ] ] )
+		{
+			MSG_WriteExpGolomb( msg, i - last - 1 );
+			last = i;
+		}
+	}
+
+	for ( int i = 0; i < order.numFields; i++ )
+	{
+		byte index = order.fields[ i ];
+
+		if ( !changed[ index ] )
+		{
+			continue;
+		}
+
+		const netField_t& field = playerStateFields[ index ];
+		auto fromF = reinterpret_cast<const int *>( reinterpret_cast<const byte *>( from ) + field.offset );
+		auto toF = reinterpret_cast<const int *>( reinterpret_cast<const byte *>( to ) + field.offset );
+
+		if ( field.bits == STATS_GROUP_FIELD )
+		{
+			WriteStatsGroupAdaptive( msg, fromF, toF );
+		}
+		else
+		{
+			WriteFieldValue( msg, field, toF );
+		}
+	}
+}
+
 /*
 =============
 MSG_WriteDeltaPlayerstate
 
 =============
 */
+void MSG_WriteDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, const OpaquePlayerState *to )
+{
+	MSG_WriteDeltaPlayerstate( msg, from, to, nullptr, 0, 0, false );
+}
+
 void MSG_WriteDeltaPlayerstate(
-	msg_t *msg, const OpaquePlayerState *from, const OpaquePlayerState *to )
+	msg_t *msg, const OpaquePlayerState *from, const OpaquePlayerState *to,
+	psDeltaEncoder_t *encoder, int messageNum, int acknowledged, bool canSendOrder )
 {
 	int           lc;
-	float      fullFloat;
-	int        trunc;
 	int        startBit, endBit;
 	int        print;
 
 	if ( playerStateFields.empty() )
 		Sys::Drop( "no netcode table" );
 
+	bool delta = from != nullptr;
 	OpaquePlayerState dummy;
 	if ( !from )
 	{
@@ -1377,6 +1736,8 @@ void MSG_WriteDeltaPlayerstate(
 	}
 
 	int numFields = playerStateFields.size();
+	bool adaptive = encoder && encoder->version >= PS_DELTA_ADAPTIVE && numFields <= PS_DELTA_MAX_FIELDS;
+	std::bitset<PS_DELTA_MAX_FIELDS> changed;
 
 	lc = 0;
 
@@ -1392,11 +1753,25 @@ void MSG_WriteDeltaPlayerstate(
 		{
 			lc = i + 1;
 
+			if ( adaptive )
+			{
+				changed[ i ] = true;
+			}
+
 			field->used++;
 		}
 	}
 
-	MSG_WriteByte( msg, lc );  // # of changes
+	if ( adaptive )
+	{
+		MSG_WriteByte( msg, PS_DELTA_ESCAPE );
+		MSG_WriteAdaptivePlayerstate( msg, delta, from, to, changed, encoder, messageNum, acknowledged, canSendOrder );
+		lc = 0;
+	}
+	else
+	{
+		MSG_WriteByte( msg, lc );  // # of changes
+	}
 
 	for ( int i = 0; i < lc; i++ )
 	{
@@ -1416,40 +1791,7 @@ void MSG_WriteDeltaPlayerstate(
 		}
 
 		MSG_WriteBits( msg, 1, 1 );  // changed
-
-		if ( field->bits == 0 )
-		{
-			// float
-			fullFloat = * ( float * ) toF;
-			trunc = ( int ) fullFloat;
-
-			if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 && trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) )
-			{
-				// send as small integer
-				MSG_WriteBits( msg, 0, 1 );
-				MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
-//              if ( print ) {
-//                  Log::Notice( "%s:%i ", field->name, trunc );
-//              }
-			}
-			else
-			{
-				// send as full floating point value
-				MSG_WriteBits( msg, 1, 1 );
-				MSG_WriteBits( msg, *toF, 32 );
-//              if ( print ) {
-//                  Log::Notice( "%s:%f ", field->name, *(float *)toF );
-//              }
-			}
-		}
-		else
-		{
-			// integer
-			MSG_WriteBits( msg, *toF, field->bits );
-//          if ( print ) {
-//              Log::Notice( "%s:%i ", field->name, *toF );
-//          }
-		}
+		WriteFieldValue( msg, *field, toF );
 	}
 
 	if ( print )
@@ -1481,17 +1823,190 @@ static void ReadStatsGroup(msg_t* msg, int* to, const netField_t& field)
 		}
 	}
 }
+
+// does not include presence bit
+static void ReadStatsGroupAdaptive( msg_t *msg, int *to, const netField_t& field )
+{
+	LOG( field.name );
+	int bits = 0;
+
+	if ( !MSG_ReadBits( msg, 1 ) )
+	{
+		unsigned count = MSG_ReadExpGolomb( msg ) + 1;
+
+		if ( count > STATS_GROUP_NUM_STATS )
+		{
+			Sys::Drop( "invalid playerState stats count" );
+		}
+
+		for ( unsigned i = 0, stat = -1; i < count; i++ )
+		{
+			stat += MSG_ReadExpGolomb( msg ) + 1;
+
+			if ( stat >= STATS_GROUP_NUM_STATS )
+			{
+				Sys::Drop( "invalid playerState stats index" );
+			}
+
+			bits |= 1 << stat;
+		}
+	}
+	else
+	{
+		bits = MSG_ReadShort( msg );
+	}
+
+	for ( int i = 0; i < STATS_GROUP_NUM_STATS; i++ )
+	{
+		if ( bits & ( 1 << i ) )
+		{
+			to[ i ] = MSG_ReadShort( msg );
+		}
+	}
+}
+
+// does not include presence bit
+static void ReadFieldValue( msg_t *msg, int *toF, const netField_t& field, bool print )
+{
+	if ( field.bits == 0 )
+	{
+		// float
+		if ( MSG_ReadBits( msg, 1 ) == 0 )
+		{
+			// integral float
+			int trunc = MSG_ReadBits( msg, FLOAT_INT_BITS );
+			// bias to allow equal parts positive and negative
+			trunc -= FLOAT_INT_BIAS;
+			* ( float * ) toF = trunc;
+
+			if ( print )
+			{
+				Log::Notice( "%s:%i ", field.name, trunc );
+			}
+		}
+		else
+		{
+			// full floating point value
+			*toF = MSG_ReadBits( msg, 32 );
+
+			if ( print )
+			{
+				Log::Notice( "%s:%f ", field.name, * ( float * ) toF );
+			}
+		}
+	}
+	else
+	{
+		// integer
+		*toF = MSG_ReadBits( msg, field.bits );
+
+		if ( print )
+		{
+			Log::Notice( "%s:%i ", field.name, *toF );
+		}
+	}
+}
+
+/*
+===================
+MSG_ReadAdaptivePlayerstate
+
+Everything after the field count of a PS_DELTA_ADAPTIVE delta, to already holds from
+===================
+*/
+static void MSG_ReadAdaptivePlayerstate( msg_t *msg, OpaquePlayerState *to, psDeltaDecoder_t *decoder, bool print )
+{
+	int numFields = playerStateFields.size();
+
+	if ( !decoder || numFields > PS_DELTA_MAX_FIELDS )
+	{
+		Sys::Drop( "unexpected adaptive playerState delta" );
+	}
+
+	int slot = MSG_ReadBits( msg, PS_DELTA_SLOT_BITS );
+
+	if ( slot && MSG_ReadBits( msg, 1 ) )
+	{
+		psDeltaOrder_t& order = decoder->orders[ slot ];
+		std::bitset<PS_DELTA_MAX_FIELDS> seen;
+		int indexBits = PlayerStateIndexBits();
+
+		order.numFields = numFields;
+
+		for ( int i = 0; i < numFields; i++ )
+		{
+			int field = MSG_ReadBits( msg, indexBits );
+
+			if ( field >= numFields || seen[ field ] )
+			{
+				order.numFields = 0;
+				Sys::Drop( "invalid playerState field order" );
+			}
+
+			order.fields[ i ] = field;
+			seen[ field ] = true;
+		}
+	}
+
+	const psDeltaOrder_t& order = slot ? decoder->orders[ slot ] : playerStateTableOrder;
+
+	if ( order.numFields != numFields )
+	{
+		Sys::Drop( "playerState delta uses an unknown field order" );
+	}
+
+	unsigned count = MSG_ReadExpGolomb( msg );
+
+	if ( count > unsigned( numFields ) )
+	{
+		Sys::Drop( "invalid playerState field count" );
+	}
+
+	byte changed[ PS_DELTA_MAX_FIELDS ];
+
+	for ( unsigned i = 0, position = -1; i < count; i++ )
+	{
+		position += MSG_ReadExpGolomb( msg ) + 1;
+
+		if ( position >= unsigned( numFields ) )
+		{
+			Sys::Drop( "invalid playerState field index" );
+		}
+
+		changed[ i ] = order.fields[ position ];
+	}
+
+	for ( unsigned i = 0; i < count; i++ )
+	{
+		const netField_t& field = playerStateFields[ changed[ i ] ];
+		auto toF = reinterpret_cast<int *>( reinterpret_cast<byte *>( to ) + field.offset );
+
+		if ( field.bits == STATS_GROUP_FIELD )
+		{
+			ReadStatsGroupAdaptive( msg, toF, field );
+		}
+		else
+		{
+			ReadFieldValue( msg, toF, field, print );
+		}
+	}
+}
+
 /*
 ===================
 MSG_ReadDeltaPlayerstate
 ===================
 */
 void MSG_ReadDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, OpaquePlayerState *to )
+{
+	MSG_ReadDeltaPlayerstate( msg, from, to, nullptr );
+}
+
+void MSG_ReadDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, OpaquePlayerState *to, psDeltaDecoder_t *decoder )
 {
 	int           lc;
 	int           startBit, endBit;
 	int           print;
-	int           trunc;
 
 	if (playerStateFields.empty())
 		Sys::Drop("no netcode table");
@@ -1528,7 +2043,12 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, Opaque
 	int numFields = playerStateFields.size();
 	lc = MSG_ReadByte( msg );
 
-	if ( lc > numFields || lc < 0 )
+	if ( lc == PS_DELTA_ESCAPE )
+	{
+		MSG_ReadAdaptivePlayerstate( msg, to, decoder, print );
+		lc = 0;
+	}
+	else if ( lc > numFields || lc < 0 )
 	{
 		Sys::Drop( "invalid playerState field count" );
 	}
@@ -1547,49 +2067,13 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, Opaque
 			else
 				*toF = *fromF;
 		}
+		else if ( field->bits == STATS_GROUP_FIELD )
+		{
+			ReadStatsGroup(msg, toF, *field);
+		}
 		else
 		{
-			if ( field->bits == 0 )
-			{
-				// float
-				if ( MSG_ReadBits( msg, 1 ) == 0 )
-				{
-					// integral float
-					trunc = MSG_ReadBits( msg, FLOAT_INT_BITS );
-					// bias to allow equal parts positive and negative
-					trunc -= FLOAT_INT_BIAS;
-					* ( float * ) toF = trunc;
-
-					if ( print )
-					{
-						Log::Notice( "%s:%i ", field->name, trunc );
-					}
-				}
-				else
-				{
-					// full floating point value
-					*toF = MSG_ReadBits( msg, 32 );
-
-					if ( print )
-					{
-						Log::Notice( "%s:%f ", field->name, * ( float * ) toF );
-					}
-				}
-			}
-			else if ( field->bits == STATS_GROUP_FIELD )
-			{
-				ReadStatsGroup(msg, toF, *field);
-			}
-			else
-			{
-				// integer
-				*toF = MSG_ReadBits( msg, field->bits );
-
-				if ( print )
-				{
-					Log::Notice( "%s:%i ", field->name, *toF );
-				}
-			}
+			ReadFieldValue( msg, toF, *field, print );
 		}
 	}
 
@@ -0,0 +1,237 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "common/Common.h"
+#include "qcommon/qcommon.h"
+
+namespace {
+
+const int NUM_INT_FIELDS = 40;
+const int PLAYERSTATE_SIZE = 256;
+const int STATS_OFFSET = NUM_INT_FIELDS * PLAYERSTATE_FIELD_SIZE;
+const int NUM_FIELDS = NUM_INT_FIELDS + 1;
+
+// Fields of all kinds: floats, signed and unsigned ints, and a stats group at the end
+int FieldBits( int field )
+{
+	static const int bits[] = { 0, 32, 16, -12, 8, 1 };
+	return bits[ field % ARRAY_LEN( bits ) ];
+}
+
+class PlayerStateDeltaTest : public testing::Test
+{
+protected:
+	std::mt19937 rng{ 42 };
+
+	void SetUp() override
+	{
+		ASSERT_LE( offsetof( OpaquePlayerState, END ), size_t( PLAYERSTATE_SIZE ) );
+
+		NetcodeTable table;
+		for ( int i = 0; i < NUM_INT_FIELDS; i++ )
+		{
+			table.push_back( { Str::Format( "field%d", i ), i * PLAYERSTATE_FIELD_SIZE, FieldBits( i ), 0 } );
+		}
+		table.push_back( { "stats", STATS_OFFSET, STATS_GROUP_FIELD, 0 } );
+
+		MSG_InitNetcodeTables( std::move( table ), PLAYERSTATE_SIZE );
+	}
+
+	int *Field( OpaquePlayerState &ps, int offset )
+	{
+		return reinterpret_cast<int *>( ps.storage + offset );
+	}
+
+	// A value that survives the field's bit count
+	void Change( OpaquePlayerState &ps, int field )
+	{
+		if ( field == NUM_INT_FIELDS )
+		{
+			int *stats = Field( ps, STATS_OFFSET );
+			stats[ rng() % STATS_GROUP_NUM_STATS ] = int16_t( rng() );
+			return;
+		}
+
+		int *value = Field( ps, field * PLAYERSTATE_FIELD_SIZE );
+		int bits = FieldBits( field );
+
+		if ( bits == 0 )
+		{
+			float f = rng() % 2 ? float( int( rng() % 1000 ) - 500 ) : std::ldexp( float( rng() % 100000 ), -7 );
+			memcpy( value, &f, sizeof( f ) );
+		}
+		else if ( bits == 32 )
+		{
+			*value = rng();
+		}
+		else if ( bits > 0 )
+		{
+			*value = rng() & ( ( 1 << bits ) - 1 );
+		}
+		else
+		{
+			*value = int( rng() % ( 1 << -bits ) ) - ( 1 << ( -bits - 1 ) );
+		}
+	}
+
+	/*
+	Sends a sequence of playerstates where a few fields change on most frames, the
+	others rarely, and which fields are the hot ones shifts over time so that the
+	server negotiates several orders. Acknowledgements lag behind by a few messages,
+	and some snapshots are not deltas. Returns the slots the encoder used.
+	*/
+	std::set<int> RoundTrip( int version, int frames )
+	{
+		psDeltaEncoder_t encoder{};
+		psDeltaDecoder_t decoder{};
+		encoder.version = version;
+
+		OpaquePlayerState previous{}, current{}, decoded{};
+		std::set<int> slots;
+		byte buffer[ 4096 ];
+
+		for ( int messageNum = 1; messageNum <= frames; messageNum++ )
+		{
+			int hotBase = ( messageNum / 200 ) * 7 % NUM_FIELDS;
+
+			for ( int field = 0; field < NUM_FIELDS; field++ )
+			{
+				bool hot = ( field - hotBase + NUM_FIELDS ) % NUM_FIELDS < 5;
+
+				if ( rng() % 100 < ( hot ? 80u : 2u ) )
+				{
+					Change( current, field );
+				}
+			}
+
+			bool delta = messageNum % 500 != 0;
+			int acknowledged = messageNum - 1 - int( rng() % 4 );
+
+			msg_t msg;
+			MSG_Init( &msg, buffer, sizeof( buffer ) );
+			MSG_WriteDeltaPlayerstate( &msg, delta ? &previous : nullptr, &current,
+				version == PS_DELTA_LEGACY ? nullptr : &encoder, messageNum, acknowledged, true );
+			EXPECT_FALSE( msg.overflowed );
+
+			slots.insert( encoder.pendingSlot ? encoder.pendingSlot : encoder.slot );
+
+			MSG_BeginReading( &msg );
+			MSG_ReadDeltaPlayerstate( &msg, delta ? &previous : nullptr, &decoded,
+				version == PS_DELTA_LEGACY ? nullptr : &decoder );
+
+			EXPECT_EQ( 0, memcmp( current.storage, decoded.storage, PLAYERSTATE_SIZE ) ) << "at message " << messageNum;
+
+			previous = current;
+		}
+
+		return slots;
+	}
+};
+
+TEST_F(PlayerStateDeltaTest, LegacyRoundTrip)
+{
+	RoundTrip( PS_DELTA_LEGACY, 300 );
+}
+
+TEST_F(PlayerStateDeltaTest, AdaptiveRoundTrip)
+{
+	std::set<int> slots = RoundTrip( PS_DELTA_ADAPTIVE, 2000 );
+
+	// The table order and every other slot were used
+	EXPECT_EQ( size_t( PS_DELTA_ORDER_SLOTS ), slots.size() );
+}
+
+// Entity updates encoded once and copied, leaving some out, as the server does for snapshots
+TEST(BitstreamTest, CopiedEntityUpdatesMatchDirectWrites)
+{
+	std::mt19937 rng{ 42 };
+	std::vector<entityState_t> from( 64 ), to( 64 );
+
+	for ( size_t i = 0; i < from.size(); i++ )
+	{
+		int *fields = reinterpret_cast<int *>( &to[ i ] );
+
+		for ( size_t field = 0; field < sizeof( entityState_t ) / sizeof( int ); field++ )
+		{
+			if ( rng() % 4 == 0 )
+			{
+				fields[ field ] = rng() % 3 ? int( rng() % 512 ) : int( rng() );
+			}
+		}
+
+		from[ i ].number = to[ i ].number = i;
+	}
+
+	static byte scratchData[ MAX_MSGLEN ], directData[ MAX_MSGLEN ], copiedData[ MAX_MSGLEN ];
+	msg_t scratch, direct, copied;
+	MSG_Init( &scratch, scratchData, sizeof( scratchData ) );
+	MSG_Init( &direct, directData, sizeof( directData ) );
+	MSG_Init( &copied, copiedData, sizeof( copiedData ) );
+
+	// start unaligned
+	MSG_WriteBits( &direct, 5, 3 );
+	MSG_WriteBits( &copied, 5, 3 );
+
+	int firstBit = 0;
+	for ( size_t i = 0; i < from.size(); i++ )
+	{
+		int start = scratch.bit;
+		MSG_WriteDeltaEntity( &scratch, &from[ i ], &to[ i ], true );
+
+		if ( i % 5 == 0 )
+		{
+			MSG_WriteBitstream( &copied, &scratch, firstBit, start - firstBit );
+			firstBit = scratch.bit;
+		}
+		else
+		{
+			MSG_WriteDeltaEntity( &direct, &from[ i ], &to[ i ], true );
+		}
+	}
+	MSG_WriteBitstream( &copied, &scratch, firstBit, scratch.bit - firstBit );
+
+	ASSERT_FALSE( scratch.overflowed );
+	ASSERT_EQ( direct.bit, copied.bit );
+	ASSERT_EQ( direct.cursize, copied.cursize );
+	EXPECT_EQ( 0, memcmp( directData, copiedData, direct.cursize ) );
+}
+
+TEST(PlayerStateDeltaStructTest, TriviallyCopyable)
+{
+	// client_t is copied around as raw memory
+	EXPECT_TRUE( std::is_trivially_copyable<psDeltaEncoder_t>::value );
+	EXPECT_TRUE( std::is_trivially_copyable<psDeltaDecoder_t>::value );
+}
+
+} // namespace
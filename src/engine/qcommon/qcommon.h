@@ -41,6 +41,8 @@ Maryland 20850 USA.
 #include "common/Defs.h"
 #include "net_types.h"
 
+#include <bitset>
+
 //============================================================================
 
 //
@@ -65,6 +67,8 @@ struct usercmd_t;
 struct entityState_t;
 
 void  MSG_WriteBits( msg_t *msg, int value, int bits );
+// appends bits written to another message, as if the writes were made again
+void  MSG_WriteBitstream( msg_t *msg, const msg_t *src, int firstBit, int bits );
 
 void  MSG_WriteChar( msg_t *sb, int c );
 void  MSG_WriteByte( msg_t *sb, int c );
@@ -95,10 +99,65 @@ void  MSG_ReadDeltaUsercmd( msg_t *msg, usercmd_t *from, usercmd_t *to );
 void  MSG_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, bool force );
 void  MSG_ReadDeltaEntity( msg_t *msg, const entityState_t *from, entityState_t *to, int number );
 
+/*
+Playerstate delta encodings, the client advertises the newest one it can read in
+the "psdelta" key of its connect userinfo.
+
+PS_DELTA_LEGACY sends the index of the last changed field as a byte, then one
+changed bit per field up to it, in the order of the game's netcode table.
+
+PS_DELTA_ADAPTIVE starts with the PS_DELTA_ESCAPE byte, which legacy readers
+reject, and sends the changed fields as Exp-Golomb coded gaps over a field order
+the server picks for each client from how often the fields change. Orders are
+sent along with the deltas that use them until the client acknowledges one of
+those messages, after which deltas only carry its slot number. Slot 0 is the
+table order, used for non-delta snapshots so demos can start from them.
+*/
+#define PS_DELTA_LEGACY      0
+#define PS_DELTA_ADAPTIVE    1
+#define PS_DELTA_VERSION     PS_DELTA_ADAPTIVE
+
+#define PS_DELTA_ESCAPE      255
+#define PS_DELTA_MAX_FIELDS  ( PS_DELTA_ESCAPE - 1 )
+#define PS_DELTA_ORDER_SLOTS 4
+#define PS_DELTA_SLOT_BITS   2
+#define PS_DELTA_HISTORY     32 // deltas between two evaluations of the field order
+
+// Fixed size, so that client_t and clientConnection_t stay trivially copyable
+struct psDeltaOrder_t
+{
+	int  numFields;
+	byte fields[ PS_DELTA_MAX_FIELDS ];
+};
+
+struct psDeltaEncoder_t
+{
+	int version; // PS_DELTA_*, negotiated when connecting
+	int slot; // order used by the client, 0 is the table order
+	int pendingSlot; // order sent with every delta until acknowledged, or 0
+	int pendingMessage; // first message carrying pendingSlot
+	psDeltaOrder_t orders[ PS_DELTA_ORDER_SLOTS ];
+
+	// which fields changed in the last deltas
+	std::bitset<PS_DELTA_MAX_FIELDS> history[ PS_DELTA_HISTORY ];
+	int numHistory;
+};
+
+struct psDeltaDecoder_t
+{
+	psDeltaOrder_t orders[ PS_DELTA_ORDER_SLOTS ];
+};
+
 void MSG_InitNetcodeTables(NetcodeTable playerStateTable, int playerStateSize);
 void  MSG_WriteDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, const OpaquePlayerState *to );
 void  MSG_ReadDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, OpaquePlayerState *to );
 
+// messageNum is the sequence the delta will be sent with, acknowledged the last one the client received
+void  MSG_WriteDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, const OpaquePlayerState *to,
+                                 psDeltaEncoder_t *encoder, int messageNum, int acknowledged, bool canSendOrder );
+void  MSG_ReadDeltaPlayerstate( msg_t *msg, const OpaquePlayerState *from, OpaquePlayerState *to,
+                                psDeltaDecoder_t *decoder );
+
 //============================================================================
 
 /*
@@ -664,6 +723,7 @@ void     SV_Shutdown( const char *finalmsg );
 void     SV_QuickShutdown( const char *finalmsg );
 void     SV_Frame( int msec );
 void     SV_PacketEvent( const netadr_t& from, msg_t *msg );
+void     SV_FlushClientMessages();
 int      SV_FrameMsec();
 
 /*
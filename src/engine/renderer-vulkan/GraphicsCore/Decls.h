@@ -87,6 +87,7 @@ struct Queue;
 
 class  EngineAllocator;
 struct ResourceSystem;
+struct FramePacer;
 
 struct Buffer;
 struct Image;
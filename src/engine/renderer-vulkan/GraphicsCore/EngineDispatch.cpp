@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 =============================================================================
 */
 
+#include <thread>
 #include <unordered_map>
 
 #include "Thread/TaskList.h"
@@ -39,6 +40,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Decls.h"
 
 #include "ExecutionGraph/ExecutionGraph.h"
+#include "FramePacer.h"
 #include "Memory/DescriptorSet.h"
 #include "GraphicsCoreStore.h"
 #include "Image.h"
@@ -85,7 +87,8 @@ struct Msg {
 	}
 };
 
-void MsgStream() {
+// Engine buffers are cleared through the upload scheduler, their upload IDs are added to bufferClears
+void MsgStream( std::vector<uint64>& bufferClears ) {
 	Msg msg { resourceSystem.engineToCoreBuffer.memory };
 
 	uint32 msgCount = msg.Read();
@@ -163,7 +166,10 @@ void MsgStream() {
 					.usage        = msg.Read()
 				};
 
-				resourceSystem.buffers[bufferCfg.id] = resourceSystem.AllocBuffer( bufferCfg.size, ( Buffer::Usage ) bufferCfg.usage );
+				Buffer& buffer = resourceSystem.buffers[bufferCfg.id];
+				buffer         = resourceSystem.AllocBuffer( bufferCfg.size, ( Buffer::Usage ) bufferCfg.usage );
+
+				bufferClears.push_back( resourceSystem.uploadScheduler.Upload( UPLOAD_STREAMING, buffer, 0, nullptr, bufferCfg.size ) );
 
 				break;
 			}
@@ -207,10 +213,20 @@ void EngineDispatchInit() {
 
 	GetQueueByType( COMPUTE ).executionPhase.Wait( msgStart );
 
-	MsgStream();
+	std::vector<uint64> bufferClears;
+
+	MsgStream( bufferClears );
 
 	resourceSystem.coreToEngineBuffer.memory[0] = 0;
 
+	// The engine must not see its buffers before they're cleared
+	for ( const uint64 id : bufferClears ) {
+		while ( !resourceSystem.uploadScheduler.Retired( id ) ) {
+			resourceSystem.uploadScheduler.Flush();
+			std::this_thread::yield();
+		}
+	}
+
 	UpdateDescriptor( 64, mainSwapChain.images[0], true );
 	UpdateDescriptor( 65, mainSwapChain.images[1], true );
 
@@ -218,19 +234,24 @@ void EngineDispatchInit() {
 }
 
 void EngineDispatch() {
-	static ExecutionGraph engineDispatchEG;
+	// One graph per frame in flight, so each has its own CoreData and swapchain acquire semaphore
+	static ExecutionGraph engineDispatchEGs[maxFramesInFlight];
+
+	const uint32 slot = framePacer.BeginFrame();
 
-	std::string engineDispatchSrc =
+	std::string engineDispatchSrc = Str::Format(
 		"external\n"
-		"push { coreData }\n"
+		"push { coreData%u }\n"
 		"Tonemap tonemap 325 200 { external }\n"
-		"present { tonemap }";
+		"present { tonemap }", slot );
+
+	ExecutionGraph& engineDispatchEG = engineDispatchEGs[slot];
 
 	engineDispatchEG.BuildFromSrc( COMPUTE, engineDispatchSrc );
 
 	static uint32 currentSwapChainImage = 0;
 
-	*( CoreData* ) resourceSystem.coreDataBuffer.memory = {
+	*( CoreData* ) ( ( byte* ) resourceSystem.coreDataBuffer.memory + slot * coreDataSlotSize ) = {
 		.currentSwapChainImage = currentSwapChainImage + 64,
 		.width                 = ( uint32 ) mainSurface.screenWidth,
 		.height                = ( uint32 ) mainSurface.screenHeight
@@ -240,9 +261,9 @@ void EngineDispatch() {
 
 	_mm_sfence();
 
-	uint64 start = engineDispatchEG.Exec();
+	resourceSystem.uploadScheduler.Flush();
 
-	GetQueueByType( COMPUTE ).executionPhase.Wait( start );
+	framePacer.EndFrame( engineDispatchEG.Exec() );
 
 	Task engineDispatch { &EngineDispatch };
 	taskList.AddTask( engineDispatch.Delay( 1000_us ) );
@@ -40,6 +40,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../Vulkan.h"
 
 #include "../GraphicsCoreStore.h"
+#include "../FramePacer.h"
 #include "../Queue.h"
 #include "../ResultCheck.h"
 #include "../Memory/CoreThreadMemory.h"
@@ -573,6 +574,25 @@ void ParseNodeDeps( StringView& v, std::unordered_map<std::string, uint32>& node
 	}
 }
 
+// "coreData" may be followed by the frame slot, which must be one of the coreDataBuffer
+static bool ParseCoreDataSlot( const StringView& o, uint64* slot ) {
+	*slot = 0;
+
+	for ( uint32 i = 8; i < o.size; i++ ) {
+		if ( o.memory[i] < '0' || o.memory[i] > '9' ) {
+			return false;
+		}
+
+		*slot = *slot * 10 + ( o.memory[i] - '0' );
+
+		if ( *slot >= maxFramesInFlight ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 PushConstNode ParsePushConst( StringView& v, std::unordered_map<std::string, uint32>& nodes ) {
 	PushConstNode out {};
 
@@ -612,9 +632,18 @@ PushConstNode ParsePushConst( StringView& v, std::unordered_map<std::string, uin
 			continue;
 		}
 
-		if ( o == "coreData" ) {
+		if ( o.size >= 8 && !memcmp( o.memory, "coreData", 8 ) ) {
+			uint64 slot;
+
+			if ( !ParseCoreDataSlot( o, &slot ) ) {
+				Log::Warn( "Invalid core data slot in execution graph push constants: %s", std::string { o.memory, o.size } );
+
+				out.data.size += 8;
+				continue;
+			}
+
 			specialIDsStream.Write( PUSH_UINT64, 4 );
-			dataStream.Write( resourceSystem.coreDataBuffer.engineMemory, 64 );
+			dataStream.Write( resourceSystem.coreDataBuffer.engineMemory + slot * coreDataSlotSize, 64 );
 
 			out.data.size += 8;
 			continue;
@@ -0,0 +1,163 @@
+/*
+=============================================================================
+Daemon-Vulkan BSD Source Code
+Copyright (c) 2025-2026 Reaper
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Reaper nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL REAPER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=============================================================================
+*/
+
+#include "Timer.h"
+
+#include "GraphicsCoreCVars.h"
+#include "GraphicsCoreStore.h"
+#include "Queue.h"
+
+#include "FramePacer.h"
+
+void FramePacer::Init( Queue* newQueue ) {
+	queue          = newQueue;
+	framesInFlight = r_vkFramesInFlight.Get();
+	frame          = 0;
+
+	for ( uint32 i = 0; i < maxFramesInFlight; i++ ) {
+		executionPhases[i] = 0;
+		submitTimes[i]     = 0;
+		completed[i]       = true;
+	}
+
+	frameStart     = 0;
+	waitTime       = 0;
+	timeouts       = 0;
+
+	for ( FrameStats* stats : { &last, &total } ) {
+		stats->cpuWait    = 0;
+		stats->cpuRecord  = 0;
+		stats->gpuLatency = 0;
+	}
+
+	frames         = 0;
+}
+
+void FramePacer::UpdateCompleted( const uint64 now ) {
+	const uint64 currentPhase = queue->executionPhase.Current();
+
+	for ( uint32 i = 0; i < maxFramesInFlight; i++ ) {
+		if ( !completed[i] && executionPhases[i] <= currentPhase ) {
+			completed[i]     = true;
+
+			const uint64 gpuLatency = now - submitTimes[i];
+
+			last.gpuLatency   = gpuLatency;
+			total.gpuLatency += gpuLatency;
+		}
+	}
+}
+
+uint32 FramePacer::BeginFrame() {
+	// Only change the number of frames in flight once all of them are done, so no slot is skipped while in use
+	if ( framesInFlight != ( uint32 ) r_vkFramesInFlight.Get() ) {
+		for ( uint32 i = 0; i < maxFramesInFlight; i++ ) {
+			if ( !completed[i] ) {
+				queue->executionPhase.Wait( executionPhases[i] );
+			}
+		}
+
+		UpdateCompleted( TimeNs() );
+
+		framesInFlight = r_vkFramesInFlight.Get();
+	}
+
+	const uint32 slot      = frame % framesInFlight;
+
+	const uint64 waitStart = TimeNs();
+
+	UpdateCompleted( waitStart );
+
+	// Wait in steps so a lost GPU shows up in the log instead of as a silent hang
+	while ( !completed[slot] ) {
+		if ( !queue->executionPhase.Wait( executionPhases[slot], 1_s ) ) {
+			timeouts++;
+			Log::Warn( "Frame %u hasn't completed on the GPU after %u s", frame - framesInFlight, timeouts );
+			continue;
+		}
+
+		UpdateCompleted( TimeNs() );
+	}
+
+	frameStart     = TimeNs();
+	waitTime       = frameStart - waitStart;
+	timeouts       = 0;
+
+	return slot;
+}
+
+void FramePacer::EndFrame( const uint64 executionPhase ) {
+	const uint32 slot      = frame % framesInFlight;
+	const uint64 now       = TimeNs();
+
+	executionPhases[slot]  = executionPhase;
+	submitTimes[slot]      = now;
+	completed[slot]        = false;
+
+	last.cpuWait           = waitTime;
+	last.cpuRecord         = now - frameStart;
+
+	total.cpuWait         += waitTime;
+	total.cpuRecord       += now - frameStart;
+
+	frame++;
+	frames++;
+}
+
+class VkFrameStatsCmd : public Cmd::StaticCmd {
+	public:
+	VkFrameStatsCmd() : StaticCmd( "vkFrameStats", Cmd::RENDERER, "print CPU wait, CPU record and GPU latency of frames, and reset the averages" ) {
+	}
+
+	void Run( const Cmd::Args& ) const override {
+		FramePacer& pacer = framePacer;
+
+		Print( "frames in flight: %u", pacer.framesInFlight.load() );
+
+		// The EngineDispatch task keeps adding to the totals, each of them is taken and reset in one step
+		const uint64 frames = pacer.frames.exchange( 0 );
+
+		if ( !frames ) {
+			return;
+		}
+
+		const uint64 cpuWait    = pacer.total.cpuWait.exchange( 0 );
+		const uint64 cpuRecord  = pacer.total.cpuRecord.exchange( 0 );
+		const uint64 gpuLatency = pacer.total.gpuLatency.exchange( 0 );
+
+		Print( "last frame: cpu wait %s, cpu record %s, gpu latency %s",
+			FormatTime( pacer.last.cpuWait.load(), ms ), FormatTime( pacer.last.cpuRecord.load(), ms ),
+			FormatTime( pacer.last.gpuLatency.load(), ms ) );
+		Print( "average over %u frames: cpu wait %s, cpu record %s, gpu latency %s", frames,
+			FormatTime( cpuWait / frames, ms ), FormatTime( cpuRecord / frames, ms ), FormatTime( gpuLatency / frames, ms ) );
+	}
+};
+
+static VkFrameStatsCmd vkFrameStatsCmd;
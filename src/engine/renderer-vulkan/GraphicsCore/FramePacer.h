@@ -0,0 +1,80 @@
+/*
+=============================================================================
+Daemon-Vulkan BSD Source Code
+Copyright (c) 2025-2026 Reaper
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Reaper nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL REAPER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=============================================================================
+*/
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <atomic>
+
+#include "Int.h"
+
+#include "Decls.h"
+
+static constexpr uint32 maxFramesInFlight = 3;
+
+// Atomic because vkFrameStats reads and resets them on the command thread
+struct FrameStats {
+	std::atomic<uint64> cpuWait;
+	std::atomic<uint64> cpuRecord;
+	std::atomic<uint64> gpuLatency;
+};
+
+/* Lets the CPU record up to r_vkFramesInFlight frames ahead of the GPU
+Each frame slot is only reused once the queue's timeline semaphore has passed the value of its last submit
+cpuWait is the time spent blocked on the GPU, cpuRecord the rest of the frame on the CPU,
+gpuLatency the time from submit until the frame was seen completed */
+struct FramePacer {
+	Queue*     queue;
+
+	std::atomic<uint32> framesInFlight;
+	uint64     frame;
+
+	uint64     executionPhases[maxFramesInFlight];
+	uint64     submitTimes[maxFramesInFlight];
+	bool       completed[maxFramesInFlight];
+
+	uint64     frameStart;
+	uint64     waitTime;
+	uint64     timeouts;
+
+	FrameStats last;
+	FrameStats total;
+	std::atomic<uint64> frames;
+
+	void       Init( Queue* newQueue );
+
+	uint32     BeginFrame();
+	void       EndFrame( const uint64 executionPhase );
+
+	private:
+	void       UpdateCompleted( const uint64 now );
+};
+
+#endif // FRAME_PACER_H
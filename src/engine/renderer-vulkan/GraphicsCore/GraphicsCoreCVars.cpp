@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Memory/EngineAllocator.h"
 #include "CapabilityPack.h"
 #include "DebugMsg.h"
+#include "FramePacer.h"
 #include "SwapChain.h"
 
 #include "GraphicsCoreCVars.h"
@@ -90,4 +91,8 @@ Cvar::Range<Cvar::Cvar<int>> r_vkVSync( "r_vkVSync",
 
 Cvar::Range<Cvar::Cvar<int>> r_vkExecutionGraphRate( "r_vkExecutionGraphRate",
 	"The general rate at which ExecutionGraphs are executed",
-	Cvar::NONE, 0, -1, 100000 );
\ No newline at end of file
+	Cvar::NONE, 0, -1, 100000 );
+
+Cvar::Range<Cvar::Cvar<int>> r_vkFramesInFlight( "r_vkFramesInFlight",
+	"How many frames the CPU can record ahead of the GPU; 1 waits for each frame to finish before starting the next one",
+	Cvar::NONE, 2, 1, maxFramesInFlight );
\ No newline at end of file
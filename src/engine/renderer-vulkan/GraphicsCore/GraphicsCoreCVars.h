@@ -62,5 +62,6 @@ extern Cvar::Cvar<bool>               r_vkGraphicsMaxMemoryAuto;
 
 extern Cvar::Range < Cvar::Cvar<int>> r_vkVSync;
 extern Cvar::Range < Cvar::Cvar<int>> r_vkExecutionGraphRate;
+extern Cvar::Range < Cvar::Cvar<int>> r_vkFramesInFlight;
 
 #endif // GRAPHICS_CORE_CVARS_H
\ No newline at end of file
@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Instance.h"
 #include "EngineConfig.h"
 #include "FeaturesConfig.h"
+#include "FramePacer.h"
 #include "Queue.h"
 #include "ResourceSystem.h"
 #include "SwapChain.h"
@@ -64,4 +65,6 @@ Queue* transferDLQueue;
 Queue* sparseQueue;
 
 EngineAllocator engineAllocator;
-ResourceSystem  resourceSystem;
\ No newline at end of file
+ResourceSystem  resourceSystem;
+
+FramePacer      framePacer;
\ No newline at end of file
@@ -60,4 +60,6 @@ extern VkDescriptorSet descriptorSet;
 extern EngineAllocator engineAllocator;
 extern ResourceSystem  resourceSystem;
 
+extern FramePacer      framePacer;
+
 #endif // GRAPHICS_CORE_STORE_H
\ No newline at end of file
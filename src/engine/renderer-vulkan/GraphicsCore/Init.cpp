@@ -41,6 +41,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Memory/DescriptorSet.h"
 #include "EngineConfig.h"
 #include "EngineDispatch.h"
+#include "FramePacer.h"
 #include "GraphicsCoreStore.h"
 #include "Instance.h"
 #include "ResourceSystem.h"
@@ -93,8 +94,14 @@ void InitGraphicsEngine() {
 
 	resourceSystem.Init( 0 );
 
+	framePacer.Init( &GetQueueByType( COMPUTE ) );
+
 	Task engineDispatchInit { &EngineDispatchInit };
 	Task engineDispatch     { &EngineDispatch };
 
 	taskList.AddTasks( { engineDispatch, engineDispatchInit } );
+}
+
+void ShutdownGraphicsEngine() {
+	resourceSystem.uploadScheduler.Free();
 }
\ No newline at end of file
@@ -33,4 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 void InitGraphicsEngine();
 
+// Must be called once the task threads have exited
+void ShutdownGraphicsEngine();
+
 #endif // GRAPHICS_INIT_H
\ No newline at end of file
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "Memory/EngineAllocator.h"
 #include "FeaturesConfig.h"
+#include "FramePacer.h"
 #include "GraphicsCoreStore.h"
 #include "ResourceSystem.h"
 
@@ -45,11 +46,18 @@ void ResourceSystem::Init( uint64 newDedicatedMemorySize ) {
 		coreToEngineBuffer = engineAllocator.AllocBuffer( MemoryHeap::CORE_TO_ENGINE, stagingBufferSize );
 	}
 
+	// The start of coreToEngineBuffer is the message area read by the engine, uploads are staged in a ring after it
+	static constexpr uint64 coreToEngineMsgSize = 1 * 1024 * 1024;
+
+	uploadScheduler.Init( &coreToEngineBuffer, coreToEngineMsgSize, coreToEngineBuffer.size - coreToEngineMsgSize );
+
 	static constexpr uint64 engineToCoreBufferSize = 256 * 1024 * 1024;
 
 	engineToCoreBuffer = engineAllocator.AllocBuffer( MemoryHeap::ENGINE_TO_CORE, engineToCoreBufferSize );
 
-	coreDataBuffer     = engineAllocator.AllocBuffer( MemoryHeap::CORE_TO_ENGINE, 2 * sizeof( CoreData ) );
+	static_assert( sizeof( CoreData ) <= coreDataSlotSize );
+
+	coreDataBuffer     = engineAllocator.AllocBuffer( MemoryHeap::CORE_TO_ENGINE, maxFramesInFlight * coreDataSlotSize );
 }
 
 Buffer ResourceSystem::AllocBuffer( const uint64 size, const Buffer::Usage usage ) {
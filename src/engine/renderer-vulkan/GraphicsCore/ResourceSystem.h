@@ -37,8 +37,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "Memory/EngineAllocator.h"
 
+#include "UploadScheduler.h"
+
 #include "../GraphicsShared/MemoryPool.h"
 
+// Each frame in flight has its own CoreData, "push { coreData<slot> }" points an ExecutionGraph at it
+static constexpr uint64 coreDataSlotSize = 64;
+
 struct ResourceSystem {
 	MemoryPool memoryPoolData;
 	MemoryPool memoryPoolImages;
@@ -49,6 +54,8 @@ struct ResourceSystem {
 	Buffer     coreToEngineBuffer;
 	Buffer     engineToCoreBuffer;
 
+	UploadScheduler uploadScheduler;
+
 	std::unordered_map<std::string, Image> images;
 	std::unordered_map<uint32, Buffer>     buffers;
 
@@ -0,0 +1,385 @@
+/*
+=============================================================================
+Daemon-Vulkan BSD Source Code
+Copyright (c) 2025-2026 Reaper
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Reaper nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL REAPER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=============================================================================
+*/
+
+#include "Vulkan.h"
+
+#include "DebugMsg.h"
+#include "GraphicsCoreStore.h"
+#include "Queue.h"
+
+#include "UploadScheduler.h"
+
+static constexpr uint64 stagingAlignment = 256;
+
+void StagingRing::Init( const uint64 newSize ) {
+	size     = newSize;
+	head     = 0;
+	tail     = 0;
+	peakUsed = 0;
+
+	regions.clear();
+}
+
+bool StagingRing::Alloc( const uint64 allocSize, const uint64 alignment, const uint64 limit, const uint32 lane, uint64* offset ) {
+	uint64 start = ( head + alignment - 1 ) & ~( alignment - 1 );
+
+	// Allocations never wrap around, the padding up to the end of the ring is retired with this region
+	if ( start % size + allocSize > size ) {
+		start += size - start % size;
+	}
+
+	if ( start + allocSize - tail > std::min( limit, size ) ) {
+		return false;
+	}
+
+	head     = start + allocSize;
+	peakUsed = std::max( peakUsed, Used() );
+
+	regions.push_back( { head, 0, lane, false } );
+
+	*offset  = start % size;
+
+	return true;
+}
+
+void StagingRing::Submit( const uint32 lane, const uint64 executionPhase ) {
+	for ( Region& region : regions ) {
+		if ( region.lane == lane && !region.submitted ) {
+			region.executionPhase = executionPhase;
+			region.submitted      = true;
+		}
+	}
+}
+
+void StagingRing::Retire( const uint64* completedPhases ) {
+	while ( !regions.empty() ) {
+		Region& region = regions.front();
+
+		if ( !region.submitted || region.executionPhase > completedPhases[region.lane] ) {
+			break;
+		}
+
+		tail = region.end;
+		regions.pop_front();
+	}
+}
+
+uint64 StagingRing::Used() const {
+	return head - tail;
+}
+
+void UploadScheduler::Init( Buffer* newStagingBuffer, const uint64 newStagingOffset, const uint64 stagingSize ) {
+	stagingBuffer   = newStagingBuffer;
+	stagingOffset   = newStagingOffset;
+
+	ring.Init( stagingSize );
+
+	maxChunkSize    = stagingSize / 8;
+	largeUploadSize = 4 * 1024 * 1024;
+
+	laneQueues[UPLOAD_LANE_GRAPHICS]    = graphicsQueue;
+	laneQueues[UPLOAD_LANE_TRANSFER]    = transferQueue;
+	laneQueues[UPLOAD_LANE_TRANSFER_DL] = transferDLQueue;
+
+	static const char* laneNames[UPLOAD_LANE_COUNT] { "uploadGraphics", "uploadTransfer", "uploadTransferDL" };
+
+	for ( uint32 lane = 0; lane < UPLOAD_LANE_COUNT; lane++ ) {
+		ExecCmdPool& cmdPool = laneCmdPools[lane];
+
+		VkCommandPoolCreateInfo cmdPoolInfo {
+			.flags              = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex   = laneQueues[lane]->id
+		};
+
+		vkCreateCommandPool( device, &cmdPoolInfo, nullptr, &cmdPool.cmdPool );
+
+		DebugLabel( cmdPool.cmdPool, laneNames[lane] );
+
+		VkCommandBufferAllocateInfo cmdInfo {
+			.commandPool        = cmdPool.cmdPool,
+			.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = maxExecCmdBuffers
+		};
+
+		vkAllocateCommandBuffers( device, &cmdInfo, cmdPool.cmds );
+
+		for ( uint64& executionPhase : cmdPool.executionPhase ) {
+			executionPhase = 0;
+		}
+
+		cmdPool.allocState     = 0;
+		completedPhases[lane]  = 0;
+	}
+
+	nextID = 1;
+	stats  = {};
+}
+
+void UploadScheduler::Free() {
+	if ( !stagingBuffer ) {
+		return;
+	}
+
+	for ( uint32 lane = 0; lane < UPLOAD_LANE_COUNT; lane++ ) {
+		laneQueues[lane]->executionPhase.Wait();
+
+		vkDestroyCommandPool( device, laneCmdPools[lane].cmdPool, nullptr );
+
+		laneCopies[lane].clear();
+		laneUploads[lane].clear();
+	}
+
+	for ( std::deque<PendingUpload>& uploads : pending ) {
+		uploads.clear();
+	}
+
+	unsubmitted.clear();
+	inFlight.clear();
+
+	stagingBuffer = nullptr;
+}
+
+uint32 UploadScheduler::SelectLane( const UploadPriority priority, const uint64 size ) const {
+	if ( priority == UPLOAD_FRAME ) {
+		return UPLOAD_LANE_GRAPHICS;
+	}
+
+	if ( size >= largeUploadSize && transferDLQueue != transferQueue ) {
+		return UPLOAD_LANE_TRANSFER_DL;
+	}
+
+	return UPLOAD_LANE_TRANSFER;
+}
+
+bool UploadScheduler::StageChunk( PendingUpload& upload, const UploadPriority priority, const byte* data ) {
+	// Lower priorities leave part of the ring free, so frame uploads can always be staged
+	static constexpr uint64 priorityLimits[UPLOAD_PRIORITY_COUNT] { 4, 3, 2 };
+
+	const uint64 chunkSize = std::min( upload.size - upload.staged, maxChunkSize );
+
+	uint64 offset;
+	if ( !ring.Alloc( chunkSize, stagingAlignment, ring.size / 4 * priorityLimits[priority], upload.lane, &offset ) ) {
+		return false;
+	}
+
+	if ( upload.clear ) {
+		memset( ( byte* ) stagingBuffer->memory + stagingOffset + offset, 0, chunkSize );
+	} else {
+		memcpy( ( byte* ) stagingBuffer->memory + stagingOffset + offset, data, chunkSize );
+	}
+
+	laneCopies[upload.lane].push_back( { upload.dst, stagingOffset + offset, upload.dstOffset + upload.staged, chunkSize } );
+
+	upload.staged += chunkSize;
+
+	if ( upload.staged == upload.size ) {
+		laneUploads[upload.lane].push_back( upload.id );
+	}
+
+	return true;
+}
+
+uint64 UploadScheduler::Upload( const UploadPriority priority, const Buffer& dst, const uint64 dstOffset, const void* data, const uint64 size ) {
+	while ( !accessLock.LockWrite() );
+
+	const uint64 id = nextID++;
+
+	if ( !size ) {
+		accessLock.UnlockWrite();
+		return id;
+	}
+
+	PendingUpload upload {
+		.id        = id,
+		.dst       = dst.buffer,
+		.dstOffset = dstOffset,
+		.size      = size,
+		.staged    = 0,
+		.lane      = SelectLane( priority, size ),
+		.clear     = !data
+	};
+
+	unsubmitted.insert( id );
+
+	stats.uploads++;
+	stats.bytes += size;
+
+	// Only stage right away if nothing of the same or a higher priority is waiting, so uploads in each class stay in order
+	bool waiting = false;
+	for ( uint32 i = 0; i <= priority; i++ ) {
+		waiting |= !pending[i].empty();
+	}
+
+	if ( !waiting ) {
+		while ( upload.staged < size
+			&& StageChunk( upload, priority, upload.clear ? nullptr : ( const byte* ) data + upload.staged ) );
+	}
+
+	if ( upload.staged < size ) {
+		upload.dataOffset = upload.staged;
+
+		if ( !upload.clear ) {
+			upload.data.assign( ( const char* ) data + upload.staged, size - upload.staged );
+		}
+
+		stats.deferredBytes += size - upload.staged;
+
+		pending[priority].push_back( std::move( upload ) );
+	}
+
+	accessLock.UnlockWrite();
+
+	return id;
+}
+
+bool UploadScheduler::SubmitLane( const uint32 lane ) {
+	if ( laneCopies[lane].empty() ) {
+		return true;
+	}
+
+	ExecCmdPool& cmdPool = laneCmdPools[lane];
+
+	uint32 cmdID = maxExecCmdBuffers;
+	for ( uint32 i = 0; i < maxExecCmdBuffers; i++ ) {
+		if ( cmdPool.executionPhase[i] <= completedPhases[lane] ) {
+			cmdID = i;
+			break;
+		}
+	}
+
+	// The copies stay staged in the ring and go out with the next Flush()
+	if ( cmdID == maxExecCmdBuffers ) {
+		stats.cmdStalls++;
+		return false;
+	}
+
+	VkCommandBuffer cmd = cmdPool.cmds[cmdID];
+
+	vkResetCommandBuffer( cmd, 0 );
+
+	VkCommandBufferBeginInfo cmdInfo {
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	vkBeginCommandBuffer( cmd, &cmdInfo );
+
+	std::vector<VkBufferCopy> regions;
+	regions.reserve( laneCopies[lane].size() );
+
+	for ( uint32 i = 0; i < laneCopies[lane].size(); i++ ) {
+		const LaneCopy& copy = laneCopies[lane][i];
+
+		regions.push_back( { copy.srcOffset, copy.dstOffset, copy.size } );
+
+		if ( i + 1 == laneCopies[lane].size() || laneCopies[lane][i + 1].dst != copy.dst ) {
+			vkCmdCopyBuffer( cmd, stagingBuffer->buffer, copy.dst, regions.size(), regions.data() );
+			regions.clear();
+		}
+	}
+
+	vkEndCommandBuffer( cmd );
+
+	const uint64 executionPhase     = laneQueues[lane]->Submit( cmd );
+	cmdPool.executionPhase[cmdID] = executionPhase;
+
+	ring.Submit( lane, executionPhase );
+
+	for ( const uint64 id : laneUploads[lane] ) {
+		unsubmitted.erase( id );
+		inFlight[id] = { lane, executionPhase };
+	}
+
+	laneCopies[lane].clear();
+	laneUploads[lane].clear();
+
+	stats.submits[lane]++;
+
+	return true;
+}
+
+void UploadScheduler::RetireUploads() {
+	for ( uint32 lane = 0; lane < UPLOAD_LANE_COUNT; lane++ ) {
+		completedPhases[lane] = laneQueues[lane]->executionPhase.Current();
+	}
+
+	ring.Retire( completedPhases );
+
+	for ( auto it = inFlight.begin(); it != inFlight.end(); ) {
+		if ( it->second.executionPhase <= completedPhases[it->second.lane] ) {
+			it = inFlight.erase( it );
+		} else {
+			++it;
+		}
+	}
+}
+
+void UploadScheduler::Flush() {
+	while ( !accessLock.LockWrite() );
+
+	RetireUploads();
+
+	for ( uint32 priority = 0; priority < UPLOAD_PRIORITY_COUNT; priority++ ) {
+		std::deque<PendingUpload>& uploads = pending[priority];
+
+		while ( !uploads.empty() ) {
+			PendingUpload& upload = uploads.front();
+
+			while ( upload.staged < upload.size
+				&& StageChunk( upload, ( UploadPriority ) priority,
+					upload.clear ? nullptr : ( const byte* ) upload.data.data() + ( upload.staged - upload.dataOffset ) ) );
+
+			if ( upload.staged < upload.size ) {
+				break;
+			}
+
+			uploads.pop_front();
+		}
+	}
+
+	for ( uint32 lane = 0; lane < UPLOAD_LANE_COUNT; lane++ ) {
+		SubmitLane( lane );
+	}
+
+	accessLock.UnlockWrite();
+}
+
+bool UploadScheduler::Retired( const uint64 id ) {
+	while ( !accessLock.LockWrite() );
+
+	if ( !unsubmitted.contains( id ) && inFlight.contains( id ) ) {
+		RetireUploads();
+	}
+
+	const bool retired = !unsubmitted.contains( id ) && !inFlight.contains( id );
+
+	accessLock.UnlockWrite();
+
+	return retired;
+}
@@ -0,0 +1,167 @@
+/*
+=============================================================================
+Daemon-Vulkan BSD Source Code
+Copyright (c) 2025-2026 Reaper
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Reaper nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL REAPER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=============================================================================
+*/
+
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Int.h"
+#include "AccessLock.h"
+
+#include "Decls.h"
+
+#include "Memory/EngineAllocator.h"
+#include "Memory/CoreThreadMemory.h"
+
+enum UploadPriority : uint32 {
+	UPLOAD_FRAME,      // Needed by the next frame
+	UPLOAD_STREAMING,  // Needed soon, e.g. data for an area the player is moving into
+	UPLOAD_BACKGROUND, // Prefetches, only uses staging space the other classes leave free
+	UPLOAD_PRIORITY_COUNT
+};
+
+enum UploadLane : uint32 {
+	UPLOAD_LANE_GRAPHICS,
+	UPLOAD_LANE_TRANSFER,
+	UPLOAD_LANE_TRANSFER_DL,
+	UPLOAD_LANE_COUNT
+};
+
+/* Offset bookkeeping for the staging ring, without any Vulkan calls,
+so it can be driven by synthetic upload traces
+Offsets are monotonic, the physical offset is offset % size */
+struct StagingRing {
+	struct Region {
+		uint64 end;
+		uint64 executionPhase;
+		uint32 lane;
+		bool   submitted;
+	};
+
+	uint64             size;
+	uint64             head;
+	uint64             tail;
+	uint64             peakUsed;
+
+	std::deque<Region> regions;
+
+	void   Init( const uint64 newSize );
+
+	// Returns false instead of waiting if there isn't enough space below limit
+	bool   Alloc( const uint64 allocSize, const uint64 alignment, const uint64 limit, const uint32 lane, uint64* offset );
+	void   Submit( const uint32 lane, const uint64 executionPhase );
+	void   Retire( const uint64* completedPhases );
+
+	uint64 Used() const;
+};
+
+struct UploadStats {
+	uint64 uploads;
+	uint64 bytes;
+	uint64 deferredBytes;
+	uint64 submits[UPLOAD_LANE_COUNT];
+	uint64 cmdStalls;
+};
+
+/* Copies data into engine buffers through the staging ring
+Uploads needed by the next frame go on the graphics queue, the rest go on the transfer queue,
+or the second transfer queue if it exists and the upload is large, so they overlap with rendering
+Nothing here ever waits on the GPU: uploads that don't fit are kept and staged on a later Flush() */
+struct UploadScheduler {
+	struct PendingUpload {
+		uint64      id;
+		VkBuffer    dst;
+		uint64      dstOffset;
+		uint64      size;
+		uint64      staged;
+		uint32      lane;
+		bool        clear;
+
+		uint64      dataOffset;
+
+		std::string data;
+	};
+
+	struct LaneCopy {
+		VkBuffer dst;
+		uint64   srcOffset;
+		uint64   dstOffset;
+		uint64   size;
+	};
+
+	struct UploadFence {
+		uint32 lane;
+		uint64 executionPhase;
+	};
+
+	Buffer*                                  stagingBuffer;
+	uint64                                   stagingOffset;
+	StagingRing                              ring;
+
+	uint64                                   maxChunkSize;
+	uint64                                   largeUploadSize;
+
+	Queue*                                   laneQueues[UPLOAD_LANE_COUNT];
+	ExecCmdPool                              laneCmdPools[UPLOAD_LANE_COUNT];
+	std::vector<LaneCopy>                    laneCopies[UPLOAD_LANE_COUNT];
+	std::vector<uint64>                      laneUploads[UPLOAD_LANE_COUNT];
+	uint64                                   completedPhases[UPLOAD_LANE_COUNT];
+
+	std::deque<PendingUpload>                pending[UPLOAD_PRIORITY_COUNT];
+	std::unordered_set<uint64>               unsubmitted;
+	std::unordered_map<uint64, UploadFence>  inFlight;
+
+	uint64                                   nextID;
+
+	UploadStats                              stats;
+
+	AccessLock                               accessLock;
+
+	void   Init( Buffer* newStagingBuffer, const uint64 newStagingOffset, const uint64 stagingSize );
+	void   Free();
+
+	// data may be nullptr to clear the range instead
+	uint64 Upload( const UploadPriority priority, const Buffer& dst, const uint64 dstOffset, const void* data, const uint64 size );
+	void   Flush();
+	bool   Retired( const uint64 id );
+
+	private:
+	uint32 SelectLane( const UploadPriority priority, const uint64 size ) const;
+	bool   StageChunk( PendingUpload& upload, const UploadPriority priority, const byte* data );
+	bool   SubmitLane( const uint32 lane );
+	void   RetireUploads();
+};
+
+#endif // UPLOAD_SCHEDULER_H
@@ -0,0 +1,209 @@
+/*
+=============================================================================
+Daemon-Vulkan BSD Source Code
+Copyright (c) 2025-2026 Reaper
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Reaper nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL REAPER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=============================================================================
+*/
+
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "common/Common.h"
+
+#include "UploadScheduler.h"
+
+namespace {
+
+static constexpr uint64 ringSize  = 64 * 1024;
+static constexpr uint64 alignment = 256;
+
+TEST( StagingRingTest, RetiresOnCompletedPhase ) {
+	StagingRing ring;
+	ring.Init( ringSize );
+
+	uint64 offset;
+	ASSERT_TRUE( ring.Alloc( 1000, alignment, ringSize, UPLOAD_LANE_TRANSFER, &offset ) );
+	EXPECT_EQ( 0u, offset );
+	EXPECT_EQ( 1000u, ring.Used() );
+
+	uint64 completed[UPLOAD_LANE_COUNT] {};
+
+	// Not submitted yet
+	completed[UPLOAD_LANE_TRANSFER] = 100;
+	ring.Retire( completed );
+	EXPECT_EQ( 1000u, ring.Used() );
+
+	ring.Submit( UPLOAD_LANE_TRANSFER, 5 );
+
+	completed[UPLOAD_LANE_TRANSFER] = 4;
+	ring.Retire( completed );
+	EXPECT_EQ( 1000u, ring.Used() );
+
+	completed[UPLOAD_LANE_TRANSFER] = 5;
+	ring.Retire( completed );
+	EXPECT_EQ( 0u, ring.Used() );
+}
+
+TEST( StagingRingTest, RespectsLimit ) {
+	StagingRing ring;
+	ring.Init( ringSize );
+
+	uint64 offset;
+	ASSERT_TRUE( ring.Alloc( ringSize / 2, alignment, ringSize / 2, UPLOAD_LANE_TRANSFER, &offset ) );
+	EXPECT_FALSE( ring.Alloc( 1, alignment, ringSize / 2, UPLOAD_LANE_TRANSFER, &offset ) );
+
+	// A failed allocation leaves the ring as it was
+	EXPECT_EQ( ringSize / 2, ring.Used() );
+	EXPECT_EQ( 1u, ring.regions.size() );
+
+	EXPECT_TRUE( ring.Alloc( ringSize / 2, alignment, ringSize, UPLOAD_LANE_GRAPHICS, &offset ) );
+	EXPECT_EQ( ringSize / 2, offset );
+	EXPECT_FALSE( ring.Alloc( 1, alignment, ringSize, UPLOAD_LANE_GRAPHICS, &offset ) );
+}
+
+TEST( StagingRingTest, NeverWraps ) {
+	StagingRing ring;
+	ring.Init( ringSize );
+
+	uint64 completed[UPLOAD_LANE_COUNT] {};
+	uint64 offset;
+
+	ASSERT_TRUE( ring.Alloc( ringSize - 1024, alignment, ringSize, UPLOAD_LANE_TRANSFER, &offset ) );
+	ring.Submit( UPLOAD_LANE_TRANSFER, 1 );
+	completed[UPLOAD_LANE_TRANSFER] = 1;
+	ring.Retire( completed );
+
+	// Doesn't fit before the end, so it goes to the start and the padding is used until it's retired
+	ASSERT_TRUE( ring.Alloc( 2048, alignment, ringSize, UPLOAD_LANE_TRANSFER, &offset ) );
+	EXPECT_EQ( 0u, offset );
+	EXPECT_EQ( 1024u + 2048u, ring.Used() );
+
+	ring.Submit( UPLOAD_LANE_TRANSFER, 2 );
+	completed[UPLOAD_LANE_TRANSFER] = 2;
+	ring.Retire( completed );
+	EXPECT_EQ( 0u, ring.Used() );
+}
+
+TEST( StagingRingTest, RetiresInOrder ) {
+	StagingRing ring;
+	ring.Init( ringSize );
+
+	uint64 completed[UPLOAD_LANE_COUNT] {};
+	uint64 offset;
+
+	ASSERT_TRUE( ring.Alloc( 1024, alignment, ringSize, UPLOAD_LANE_TRANSFER, &offset ) );
+	ASSERT_TRUE( ring.Alloc( 1024, alignment, ringSize, UPLOAD_LANE_GRAPHICS, &offset ) );
+
+	ring.Submit( UPLOAD_LANE_TRANSFER, 10 );
+	ring.Submit( UPLOAD_LANE_GRAPHICS, 3 );
+
+	// The graphics region is done, but it's behind the transfer one
+	completed[UPLOAD_LANE_GRAPHICS] = 3;
+	ring.Retire( completed );
+	EXPECT_EQ( 2048u, ring.Used() );
+
+	completed[UPLOAD_LANE_TRANSFER] = 10;
+	ring.Retire( completed );
+	EXPECT_EQ( 0u, ring.Used() );
+}
+
+// Random uploads on all the lanes, with the GPU completing submits a few flushes late
+TEST( StagingRingTest, SyntheticTrace ) {
+	struct Live {
+		uint64 end; // monotonic
+		uint64 offset;
+		uint64 size;
+	};
+
+	StagingRing ring;
+	ring.Init( ringSize );
+
+	std::mt19937 rng( 42 );
+	std::uniform_int_distribution<uint64> sizes( 1, ringSize / 6 );
+	std::uniform_int_distribution<uint32> lanes( 0, UPLOAD_LANE_COUNT - 1 );
+
+	std::deque<Live> live;
+	uint64 submitted[UPLOAD_LANE_COUNT] {};
+	uint64 completed[UPLOAD_LANE_COUNT] {};
+	uint64 allocated = 0;
+	uint64 failed    = 0;
+
+	static constexpr uint64 latency = 3;
+
+	for ( uint32 flush = 1; flush <= 2000; flush++ ) {
+		for ( uint32 i = 0; i < 4; i++ ) {
+			const uint64 size = sizes( rng );
+			uint64 offset;
+
+			if ( !ring.Alloc( size, alignment, ringSize, lanes( rng ), &offset ) ) {
+				failed++;
+				continue;
+			}
+
+			allocated++;
+
+			ASSERT_EQ( 0u, offset % alignment );
+			ASSERT_LE( offset + size, ringSize );
+			ASSERT_LE( ring.Used(), ringSize );
+
+			// Nothing still in use is overwritten
+			for ( const Live& region : live ) {
+				ASSERT_TRUE( offset + size <= region.offset || region.offset + region.size <= offset );
+			}
+
+			live.push_back( { ring.head, offset, size } );
+		}
+
+		for ( uint32 lane = 0; lane < UPLOAD_LANE_COUNT; lane++ ) {
+			ring.Submit( lane, flush );
+			submitted[lane] = flush;
+			completed[lane] = flush > latency ? flush - latency : 0;
+		}
+
+		ring.Retire( completed );
+
+		while ( !live.empty() && live.front().end <= ring.tail ) {
+			live.pop_front();
+		}
+	}
+
+	// Allocations stall while the GPU is behind, but never for good
+	EXPECT_GT( allocated, 1000u );
+	EXPECT_GT( failed, 0u );
+	EXPECT_LE( ring.peakUsed, ringSize );
+
+	for ( uint32 lane = 0; lane < UPLOAD_LANE_COUNT; lane++ ) {
+		completed[lane] = submitted[lane];
+	}
+
+	ring.Retire( completed );
+	EXPECT_EQ( 0u, ring.Used() );
+	EXPECT_TRUE( ring.regions.empty() );
+}
+
+} // namespace
@@ -39,6 +39,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Surface/Surface.h"
 #include "GraphicsCore/GraphicsCoreCVars.h"
 #include "GraphicsCore/GraphicsCoreStore.h"
+#include "GraphicsCore/Init.h"
 
 #include "Init.h"
 
@@ -59,6 +60,8 @@ namespace TempAPI {
 		taskList.Shutdown();
 		taskList.exitFence.Wait();
 		taskList.FinishShutdown();
+
+		ShutdownGraphicsEngine();
 	}
 
 	bool BeginRegistration( WindowConfig* windowConfig ) {
@@ -195,6 +198,10 @@ namespace TempAPI {
 		return 0;
 	}
 
+	void MarkFragmentsBatch( const markRequest_t*, int numRequests, int, int, int* results ) {
+		std::fill_n( results, numRequests, 0 );
+	}
+
 	int LerpTag( orientation_t*, const refEntity_t*, const char*, int ) {
 		return 0;
 	}
@@ -316,6 +323,13 @@ namespace TempAPI {
 		return 1;
 	}
 
+	void BuildSkeletons( const skeletonRequest_t*, int numRequests, refSkeleton_t* skels, int* results ) {
+		for ( int i = 0; i < numRequests; i++ ) {
+			skels[i].numBones = 0;
+			results[i] = 1;
+		}
+	}
+
 	int BoneIndex( qhandle_t, const char* ) {
 		return 0;
 	}
@@ -401,6 +415,7 @@ refexport_t* GetRefAPI( int apiVersion, refimport_t* rimp ) {
 	re.EndFrame = TempAPI::EndFrame;
 
 	re.MarkFragments = TempAPI::MarkFragments;
+	re.MarkFragmentsBatch = TempAPI::MarkFragmentsBatch;
 
 	re.ModelBounds = TempAPI::ModelBounds;
 
@@ -446,6 +461,7 @@ refexport_t* GetRefAPI( int apiVersion, refimport_t* rimp ) {
 	re.CheckSkeleton = TempAPI::CheckSkeleton;
 	re.BuildSkeleton = TempAPI::BuildSkeleton;
 	re.BlendSkeleton = TempAPI::BlendSkeleton;
+	re.BuildSkeletons = TempAPI::BuildSkeletons;
 	re.BoneIndex = TempAPI::BoneIndex;
 	re.AnimNumFrames = TempAPI::AnimNumFrames;
 	re.AnimFrameRate = TempAPI::AnimFrameRate;
@@ -33,6 +33,8 @@ set( graphicsCoreList
     ${graphicsCore}/FeaturesConfig.h
     ${graphicsCore}/FeaturesConfigMap.cpp
     ${graphicsCore}/FeaturesConfigMap.h
+    ${graphicsCore}/FramePacer.cpp
+    ${graphicsCore}/FramePacer.h
     ${graphicsCore}/GraphicsCoreCVars.cpp
     ${graphicsCore}/GraphicsCoreCVars.h
     ${graphicsCore}/GraphicsCoreStore.cpp
@@ -57,6 +59,8 @@ set( graphicsCoreList
     ${graphicsCore}/Semaphore.h
     ${graphicsCore}/SwapChain.cpp
     ${graphicsCore}/SwapChain.h
+    ${graphicsCore}/UploadScheduler.cpp
+    ${graphicsCore}/UploadScheduler.h
     ${graphicsCore}/Vulkan.h
 )
 
@@ -117,4 +121,8 @@ set( RENDERERLIST
     ${rendererVulkan}/Init.cpp
     ${rendererVulkan}/Init.h
     ${rendererVulkan}/RefAPI.cpp
+)
+
+set( RENDERERTESTLIST
+    ${graphicsCore}/UploadSchedulerTest.cpp
 )
\ No newline at end of file
@@ -0,0 +1,535 @@
+/*
+===========================================================================
+
+Daemon BSD Source Code
+Copyright (c) 2026 Daemon Developers
+All rights reserved.
+
+This file is part of the Daemon BSD Source Code (Daemon Source Code).
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+// FontAtlas.cpp
+
+#include "common/Common.h"
+
+#include "FontAtlas.h"
+
+#include FT_OUTLINE_H
+
+#define _FLOOR( x ) ( ( x ) & - 64 )
+#define _CEIL( x )  ( ( ( x ) + 63 ) & - 64 )
+#define _TRUNC( x ) ( ( x ) >> 6 )
+
+namespace FontAtlas {
+
+static void GetGlyphInfo( FT_GlyphSlot glyph, int *left, int *width, int *top, int *bottom, int *height, int *pitch )
+{
+	// ±1 adjustments for border-related reasons - really want clamp to transparent border (FIXME)
+
+	*left = _FLOOR( glyph->metrics.horiBearingX - 1);
+	int right = _CEIL( glyph->metrics.horiBearingX + glyph->metrics.width + 1);
+	*width = _TRUNC( right - *left );
+
+	*top = _CEIL( glyph->metrics.horiBearingY + 1);
+	*bottom = _FLOOR( glyph->metrics.horiBearingY - glyph->metrics.height - 1);
+	*height = _TRUNC( *top - *bottom );
+	*pitch = ( *width + 3 ) & - 4;
+}
+
+// Renders the glyph loaded in the slot to a grey scale bitmap of glyph->pitch * glyph->height
+static bool RenderGlyph( FT_GlyphSlot slot, glyphInfo_t &glyph, std::vector<byte> &bitmap )
+{
+	int left, width, top, bottom, height, pitch;
+
+	GetGlyphInfo( slot, &left, &width, &top, &bottom, &height, &pitch );
+
+	if ( slot->format != ft_glyph_format_outline )
+	{
+		Log::Warn( "Non-outline fonts are not supported" );
+		return false;
+	}
+
+	bitmap.assign( pitch * height, 0 );
+
+	FT_Bitmap bit2{};
+	bit2.width = width;
+	bit2.rows = height;
+	bit2.pitch = pitch;
+	bit2.pixel_mode = ft_pixel_mode_grays;
+	bit2.buffer = bitmap.data();
+	bit2.num_grays = 256;
+
+	FT_Outline_Translate( &slot->outline, -left, -bottom );
+
+	FT_Outline_Get_Bitmap( slot->library, &slot->outline, &bit2 );
+
+	glyph.height = height;
+	glyph.pitch = pitch;
+	glyph.top = ( slot->metrics.horiBearingY >> 6 ) + 1;
+	glyph.bottom = bottom;
+
+	return true;
+}
+
+/*
+Places a glyph at (*xOut, *yOut) in image, moving to the next row if it doesn't fit.
+Sets *xOut to -1 if the page is full. With calcHeight, only the height is measured.
+*/
+static bool ConstructGlyphInfo( byte *image, int *xOut, int *yOut, int *maxHeight, FT_Face face, int c,
+	bool calcHeight, std::vector<byte> &bitmap, glyphInfo_t &glyph )
+{
+	glyph = {};
+
+	FT_UInt index = FT_Get_Char_Index( face, c );
+
+	if ( index == 0 )
+	{
+		return false; // nothing to render
+	}
+
+	FT_Load_Glyph( face, index, FT_LOAD_DEFAULT );
+
+	if ( !RenderGlyph( face->glyph, glyph, bitmap ) )
+	{
+		return false;
+	}
+
+	glyph.xSkip = ( face->glyph->metrics.horiAdvance >> 6 ) + 1;
+
+	if ( glyph.height > *maxHeight )
+	{
+		*maxHeight = glyph.height;
+	}
+
+	if ( calcHeight )
+	{
+		return true;
+	}
+
+	float scaledWidth = glyph.pitch;
+	float scaledHeight = glyph.height;
+
+	// we need to make sure we fit
+	if ( *xOut + scaledWidth + 1 >= ( PAGE_SIZE - 1 ) )
+	{
+		*xOut = 0;
+		*yOut += *maxHeight + 1;
+	}
+
+	if ( *yOut + *maxHeight + 1 >= ( PAGE_SIZE - 1 ) )
+	{
+		*xOut = -1;
+		return false;
+	}
+
+	const byte *src = bitmap.data();
+	byte *dst = image + ( *yOut * PAGE_SIZE ) + *xOut;
+
+	for ( int i = 0; i < glyph.height; i++ )
+	{
+		memcpy( dst, src, glyph.pitch );
+		src += glyph.pitch;
+		dst += PAGE_SIZE;
+	}
+
+	glyph.imageHeight = scaledHeight;
+	glyph.imageWidth = scaledWidth;
+	glyph.s = ( float ) * xOut / PAGE_SIZE;
+	glyph.t = ( float ) * yOut / PAGE_SIZE;
+	glyph.s2 = glyph.s + ( float ) scaledWidth / PAGE_SIZE;
+	glyph.t2 = glyph.t + ( float ) scaledHeight / PAGE_SIZE;
+	glyph.shaderName[0] = 1; // flag that we have a glyph here
+
+	*xOut += scaledWidth + 1;
+
+	return true;
+}
+
+// Crops the page while retaining a power-of-2 height, and normalises its coverage
+static void StorePage( chunk_t &out, int from, int to, const byte *image, int yEnd )
+{
+	int i = 1;
+	int y = PAGE_SIZE;
+
+	// How much to reduce it?
+	while ( yEnd < y / 2 - 1 ) { i += i; y /= 2; }
+
+	// Fix up the glyphs' Y co-ordinates
+	for ( int j = from; j < to; j++ ) { out.glyphs[j].t *= i; out.glyphs[j].t2 *= i; }
+
+	const int scaledSize = PAGE_SIZE * y;
+
+	float max = *std::max_element( image, image + scaledSize );
+
+	if ( max > 0 )
+	{
+		max = 255 / max;
+	}
+
+	page_t page;
+	page.from = from;
+	page.to = to;
+	page.height = y;
+	page.alpha.resize( scaledSize );
+
+	for ( i = 0; i < scaledSize; i++ )
+	{
+		page.alpha[ i ] = ( float ) image[ i ] * max;
+	}
+
+	out.pages.push_back( std::move( page ) );
+}
+
+void RasterizeChunk( FT_Face face, int chunk, chunk_t &out )
+{
+	int xOut = 0, yOut = 0, maxHeight = 0;
+	bool rendered = false;
+	std::vector<byte> bitmap;
+	glyphInfo_t glyph;
+
+	const int startGlyph = chunk * CHUNK_GLYPHS;
+
+	for ( glyphInfo_t &g : out.glyphs )
+	{
+		g = {};
+	}
+
+	out.pages.clear();
+
+	// calculate max height
+	for ( int i = 0; i < CHUNK_GLYPHS; i++ )
+	{
+		rendered |= ConstructGlyphInfo( nullptr, &xOut, &yOut, &maxHeight, face,
+			( i + startGlyph ) ? ( i + startGlyph ) : 0xFFFD, true, bitmap, glyph );
+	}
+
+	// no glyphs? just return
+	if ( !rendered )
+	{
+		return;
+	}
+
+	std::vector<byte> image( PAGE_SIZE * PAGE_SIZE );
+
+	rendered = false;
+	int i = 0, lastStart = 0;
+
+	while ( i < CHUNK_GLYPHS )
+	{
+		if ( ConstructGlyphInfo( image.data(), &xOut, &yOut, &maxHeight, face,
+			( i + startGlyph ) ? ( i + startGlyph ) : 0xFFFD, false, bitmap, glyph ) )
+		{
+			rendered = true;
+			out.glyphs[ i ] = glyph;
+		}
+
+		if ( xOut == -1 )
+		{
+			StorePage( out, lastStart, i, image.data(), yOut + maxHeight + 1 );
+			std::fill( image.begin(), image.end(), 0 );
+			xOut = yOut = 0;
+			rendered = false;
+			lastStart = i;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if ( rendered )
+	{
+		StorePage( out, lastStart, CHUNK_GLYPHS, image.data(), yOut + maxHeight + 1 );
+	}
+}
+
+/*
+===============
+Glyph chunk cache
+
+A chunk is saved as its glyph infos followed by the pages, each with its coverage bytes.
+The cache is keyed by the checksum of the font file and the point size, so that the same
+font loaded from another path shares it.
+===============
+*/
+static const uint32_t FONT_CACHE_VERSION = 1;
+
+struct fontCacheHeader_t
+{
+	uint32_t version;
+	uint32_t checkSum;
+	uint32_t faceSize;
+	int32_t  pointSize;
+	int32_t  chunk;
+	uint32_t pageSize;
+	uint32_t glyphSize; // sizeof( glyphInfo_t ) of the build that wrote the cache
+	uint32_t numPages;
+};
+
+struct fontCachePage_t
+{
+	int32_t from;
+	int32_t to;
+	int32_t height;
+};
+
+std::string CachePath( const cacheKey_t &key )
+{
+	return Str::Format( "fontcache/%08x_%d_%d.bin", key.checkSum, key.pointSize, key.chunk );
+}
+
+std::string SerializeChunk( const chunk_t &chunk, const cacheKey_t &key )
+{
+	fontCacheHeader_t header;
+	header.version = FONT_CACHE_VERSION;
+	header.checkSum = key.checkSum;
+	header.faceSize = key.faceSize;
+	header.pointSize = key.pointSize;
+	header.chunk = key.chunk;
+	header.pageSize = PAGE_SIZE;
+	header.glyphSize = sizeof( glyphInfo_t );
+	header.numPages = chunk.pages.size();
+
+	size_t size = sizeof( header ) + sizeof( chunk.glyphs );
+	for ( const page_t &page : chunk.pages )
+	{
+		size += sizeof( fontCachePage_t ) + page.alpha.size();
+	}
+
+	std::string data;
+	data.reserve( size );
+
+	data.append( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+	data.append( reinterpret_cast<const char *>( chunk.glyphs ), sizeof( chunk.glyphs ) );
+
+	for ( const page_t &page : chunk.pages )
+	{
+		fontCachePage_t pageHeader = { page.from, page.to, page.height };
+		data.append( reinterpret_cast<const char *>( &pageHeader ), sizeof( pageHeader ) );
+		data.append( reinterpret_cast<const char *>( page.alpha.data() ), page.alpha.size() );
+	}
+
+	return data;
+}
+
+bool DeserializeChunk( Str::StringRef data, const cacheKey_t &key, chunk_t &out )
+{
+	if ( data.size() < sizeof( fontCacheHeader_t ) + sizeof( out.glyphs ) )
+	{
+		return false;
+	}
+
+	fontCacheHeader_t header;
+	memcpy( &header, data.data(), sizeof( header ) );
+
+	if ( header.version != FONT_CACHE_VERSION || header.checkSum != key.checkSum || header.faceSize != key.faceSize
+		|| header.pointSize != key.pointSize || header.chunk != key.chunk || header.pageSize != PAGE_SIZE
+		|| header.glyphSize != sizeof( glyphInfo_t ) || header.numPages > CHUNK_GLYPHS )
+	{
+		return false;
+	}
+
+	const char *p = data.data() + sizeof( header );
+	const char *end = data.data() + data.size();
+
+	memcpy( out.glyphs, p, sizeof( out.glyphs ) );
+	p += sizeof( out.glyphs );
+
+	out.pages.clear();
+	out.pages.resize( header.numPages );
+
+	for ( page_t &page : out.pages )
+	{
+		fontCachePage_t pageHeader;
+
+		if ( size_t( end - p ) < sizeof( pageHeader ) )
+		{
+			return false;
+		}
+
+		memcpy( &pageHeader, p, sizeof( pageHeader ) );
+		p += sizeof( pageHeader );
+
+		if ( pageHeader.from < 0 || pageHeader.from > pageHeader.to || pageHeader.to > CHUNK_GLYPHS
+			|| pageHeader.height <= 0 || pageHeader.height > PAGE_SIZE || ( pageHeader.height & ( pageHeader.height - 1 ) ) )
+		{
+			return false;
+		}
+
+		const size_t alphaSize = PAGE_SIZE * pageHeader.height;
+
+		if ( size_t( end - p ) < alphaSize )
+		{
+			return false;
+		}
+
+		page.from = pageHeader.from;
+		page.to = pageHeader.to;
+		page.height = pageHeader.height;
+		page.alpha.assign( p, p + alphaSize );
+		p += alphaSize;
+	}
+
+	if ( p != end )
+	{
+		Log::Warn( "Font cache %s has wrong size", CachePath( key ) );
+		return false;
+	}
+
+	return true;
+}
+
+Worker::~Worker()
+{
+	Shutdown();
+}
+
+void Worker::Submit( const void *owner, const void *faceData, size_t faceSize, int pointSize, int chunk )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+
+	job_t job;
+	job.owner = owner;
+	job.faceData = faceData;
+	job.faceSize = faceSize;
+	job.pointSize = pointSize;
+	job.chunk = chunk;
+	job.failed = false;
+	queued_.push_back( std::move( job ) );
+
+	if ( thread_.joinable() )
+	{
+		alarm_.notify_one();
+	}
+	else
+	{
+		// Start thread on first use
+		Log::Debug( "Starting glyph rasterisation thread" );
+		halt_ = false;
+		thread_ = std::thread( &Worker::WorkerMain, this );
+	}
+}
+
+void Worker::Collect( const void *owner, std::vector<job_t> &out )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+
+	auto it = std::stable_partition( finished_.begin(), finished_.end(),
+		[ owner ]( const job_t &job ) { return job.owner != owner; } );
+
+	std::move( it, finished_.end(), std::back_inserter( out ) );
+	finished_.erase( it, finished_.end() );
+}
+
+void Worker::Cancel( const void *owner )
+{
+	std::unique_lock<std::mutex> lock( mutex_ );
+
+	queued_.erase( std::remove_if( queued_.begin(), queued_.end(),
+		[ owner ]( const job_t &job ) { return job.owner == owner; } ), queued_.end() );
+
+	done_.wait( lock, [ this, owner ] { return current_ != owner; } );
+
+	finished_.erase( std::remove_if( finished_.begin(), finished_.end(),
+		[ owner ]( const job_t &job ) { return job.owner == owner; } ), finished_.end() );
+}
+
+void Worker::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		halt_ = true;
+		queued_.clear();
+		alarm_.notify_one();
+	}
+
+	if ( thread_.joinable() )
+	{
+		thread_.join();
+	}
+
+	finished_.clear();
+}
+
+void Worker::WorkerMain()
+{
+	FT_Library library;
+
+	if ( FT_Init_FreeType( &library ) )
+	{
+		Log::Warn( "Glyph rasterisation thread: Unable to initialize FreeType." );
+		library = nullptr;
+	}
+
+	std::unique_lock<std::mutex> lock( mutex_ );
+	while ( !halt_ )
+	{
+		if ( queued_.empty() )
+		{
+			alarm_.wait( lock );
+			continue;
+		}
+
+		job_t job = std::move( queued_.front() );
+		queued_.pop_front();
+		current_ = job.owner;
+		lock.unlock();
+
+		FT_Face face;
+
+		if ( !library || FT_New_Memory_Face( library, (const FT_Byte*) job.faceData, job.faceSize, 0, &face ) )
+		{
+			job.failed = true;
+		}
+		else
+		{
+			if ( FT_Set_Char_Size( face, job.pointSize << 6, job.pointSize << 6, 72, 72 ) )
+			{
+				job.failed = true;
+			}
+			else
+			{
+				RasterizeChunk( face, job.chunk, job.result );
+			}
+
+			FT_Done_Face( face );
+		}
+
+		lock.lock();
+		finished_.push_back( std::move( job ) );
+		current_ = nullptr;
+		done_.notify_all();
+	}
+
+	lock.unlock();
+
+	if ( library )
+	{
+		FT_Done_FreeType( library );
+	}
+}
+
+} // namespace FontAtlas
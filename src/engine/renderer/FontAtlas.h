@@ -0,0 +1,132 @@
+/*
+===========================================================================
+
+Daemon BSD Source Code
+Copyright (c) 2026 Daemon Developers
+All rights reserved.
+
+This file is part of the Daemon BSD Source Code (Daemon Source Code).
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+// FontAtlas.h: rasterisation of glyph chunks into atlas pages, without touching GL
+
+#ifndef FONT_ATLAS_H
+#define FONT_ATLAS_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "engine/RefAPI.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+namespace FontAtlas {
+
+// Width of a page, and its height before cropping
+static const int PAGE_SIZE = 512;
+
+// A chunk is a range of 256 code points, rendered into as many pages as it needs
+static const int CHUNK_GLYPHS = 256;
+
+struct page_t
+{
+	int from, to; // glyphs [from, to) of the chunk are on this page
+	int height; // power of 2, PAGE_SIZE at most
+	std::vector<byte> alpha; // PAGE_SIZE * height coverage, normalised to a maximum of 255
+};
+
+struct chunk_t
+{
+	glyphInfo_t glyphs[ CHUNK_GLYPHS ]; // glyph handles and shader names are not set
+	std::vector<page_t> pages; // empty if the face has none of the chunk's glyphs
+};
+
+// What a cached chunk must match to be used
+struct cacheKey_t
+{
+	uint32_t checkSum; // of the font file
+	uint32_t faceSize;
+	int      pointSize;
+	int      chunk;
+};
+
+// Only uses the face and the FT_Library it belongs to, so a thread with its own library can call it
+void RasterizeChunk( FT_Face face, int chunk, chunk_t &out );
+
+std::string CachePath( const cacheKey_t &key );
+std::string SerializeChunk( const chunk_t &chunk, const cacheKey_t &key );
+bool DeserializeChunk( Str::StringRef data, const cacheKey_t &key, chunk_t &out );
+
+/*
+Rasterises chunks on a thread with its own FT_Library, opening a face per job from
+the font file in memory. All the functions are meant to be called by the main thread.
+*/
+class Worker
+{
+public:
+	struct job_t
+	{
+		const void *owner; // the font the chunk is for
+		const void *faceData; // must stay valid until the job is collected or cancelled
+		size_t     faceSize;
+		int        pointSize;
+		int        chunk;
+		bool       failed;
+		chunk_t    result;
+	};
+
+	~Worker();
+
+	void Submit( const void *owner, const void *faceData, size_t faceSize, int pointSize, int chunk );
+
+	// Moves the finished jobs of owner to out
+	void Collect( const void *owner, std::vector<job_t> &out );
+
+	// Drops the jobs of owner, waiting for the one being rasterised if any
+	void Cancel( const void *owner );
+
+	// Drops all the jobs and stops the thread, it restarts on the next Submit
+	void Shutdown();
+
+private:
+	std::deque<job_t> queued_;
+	std::vector<job_t> finished_;
+	const void *current_ = nullptr; // owner of the job being rasterised
+	std::thread thread_;
+	std::condition_variable alarm_;
+	std::condition_variable done_;
+	std::mutex mutex_; // Guards everything above, and halt_
+	bool halt_ = false;
+
+	void WorkerMain();
+};
+
+} // namespace FontAtlas
+
+#endif // FONT_ATLAS_H
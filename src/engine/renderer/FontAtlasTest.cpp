@@ -0,0 +1,192 @@
+/*
+===========================================================================
+
+Daemon BSD Source Code
+Copyright (c) 2026 Daemon Developers
+All rights reserved.
+
+This file is part of the Daemon BSD Source Code (Daemon Source Code).
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+
+#include <gtest/gtest.h>
+
+#include "common/Common.h"
+
+#include "DaemonEmbeddedFiles/ConsoleFont.h"
+
+#include "FontAtlas.h"
+
+namespace {
+
+const int POINT_SIZE = 16;
+
+class FontAtlasTest : public testing::Test
+{
+protected:
+	FT_Library library = nullptr;
+	FT_Face face = nullptr;
+
+	void SetUp() override
+	{
+		ASSERT_FALSE( FT_Init_FreeType( &library ) );
+		ASSERT_FALSE( FT_New_Memory_Face( library, (const FT_Byte*) ConsoleFont::unifont_otf.data,
+			ConsoleFont::unifont_otf.size, 0, &face ) );
+		ASSERT_FALSE( FT_Set_Char_Size( face, POINT_SIZE << 6, POINT_SIZE << 6, 72, 72 ) );
+	}
+
+	void TearDown() override
+	{
+		if ( face )
+		{
+			FT_Done_Face( face );
+		}
+
+		if ( library )
+		{
+			FT_Done_FreeType( library );
+		}
+	}
+
+	FontAtlas::cacheKey_t Key( int chunk )
+	{
+		return { 0x12345678, uint32_t( ConsoleFont::unifont_otf.size ), POINT_SIZE, chunk };
+	}
+};
+
+void ExpectSameAtlas( const FontAtlas::chunk_t &a, const FontAtlas::chunk_t &b )
+{
+	EXPECT_EQ( 0, memcmp( a.glyphs, b.glyphs, sizeof( a.glyphs ) ) );
+	ASSERT_EQ( a.pages.size(), b.pages.size() );
+
+	for ( size_t i = 0; i < a.pages.size(); i++ )
+	{
+		EXPECT_EQ( a.pages[ i ].from, b.pages[ i ].from );
+		EXPECT_EQ( a.pages[ i ].to, b.pages[ i ].to );
+		EXPECT_EQ( a.pages[ i ].height, b.pages[ i ].height );
+		EXPECT_EQ( a.pages[ i ].alpha, b.pages[ i ].alpha );
+	}
+}
+
+TEST_F(FontAtlasTest, RasterizesPages)
+{
+	FontAtlas::chunk_t chunk;
+	FontAtlas::RasterizeChunk( face, 0, chunk );
+
+	ASSERT_FALSE( chunk.pages.empty() );
+	EXPECT_EQ( 0, chunk.pages.front().from );
+	EXPECT_EQ( FontAtlas::CHUNK_GLYPHS, chunk.pages.back().to );
+
+	for ( const FontAtlas::page_t &page : chunk.pages )
+	{
+		EXPECT_EQ( size_t( FontAtlas::PAGE_SIZE * page.height ), page.alpha.size() );
+		EXPECT_EQ( 255, *std::max_element( page.alpha.begin(), page.alpha.end() ) );
+	}
+
+	// 'A' is somewhere on the atlas
+	EXPECT_TRUE( chunk.glyphs[ 'A' ].shaderName[ 0 ] );
+	EXPECT_GT( chunk.glyphs[ 'A' ].imageWidth, 0 );
+	EXPECT_LE( chunk.glyphs[ 'A' ].t2, 1.0f );
+}
+
+TEST_F(FontAtlasTest, CacheRoundTrip)
+{
+	FontAtlas::chunk_t chunk;
+	FontAtlas::RasterizeChunk( face, 0, chunk );
+
+	std::string data = FontAtlas::SerializeChunk( chunk, Key( 0 ) );
+
+	FontAtlas::chunk_t loaded;
+	ASSERT_TRUE( FontAtlas::DeserializeChunk( data, Key( 0 ), loaded ) );
+	ExpectSameAtlas( chunk, loaded );
+
+	// Another point size, chunk or a truncated file must not be used
+	FontAtlas::cacheKey_t otherSize = Key( 0 );
+	otherSize.pointSize++;
+	EXPECT_FALSE( FontAtlas::DeserializeChunk( data, otherSize, loaded ) );
+	EXPECT_FALSE( FontAtlas::DeserializeChunk( data, Key( 1 ), loaded ) );
+	EXPECT_FALSE( FontAtlas::DeserializeChunk( data.substr( 0, data.size() - 1 ), Key( 0 ), loaded ) );
+}
+
+TEST_F(FontAtlasTest, EmptyChunk)
+{
+	// Private use area planes have no glyphs
+	FontAtlas::chunk_t chunk;
+	FontAtlas::RasterizeChunk( face, 0xF00, chunk );
+	EXPECT_TRUE( chunk.pages.empty() );
+
+	FontAtlas::chunk_t loaded;
+	ASSERT_TRUE( FontAtlas::DeserializeChunk( FontAtlas::SerializeChunk( chunk, Key( 0xF00 ) ), Key( 0xF00 ), loaded ) );
+	EXPECT_TRUE( loaded.pages.empty() );
+}
+
+TEST_F(FontAtlasTest, WorkerMatchesMainThread)
+{
+	FontAtlas::Worker worker;
+	const int owner = 0;
+
+	for ( int chunk = 0; chunk < 2; chunk++ )
+	{
+		worker.Submit( &owner, ConsoleFont::unifont_otf.data, ConsoleFont::unifont_otf.size, POINT_SIZE, chunk );
+	}
+
+	std::vector<FontAtlas::Worker::job_t> jobs;
+	for ( int i = 0; i < 1000 && jobs.size() < 2; i++ )
+	{
+		worker.Collect( &owner, jobs );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+
+	ASSERT_EQ( 2u, jobs.size() );
+
+	for ( const FontAtlas::Worker::job_t &job : jobs )
+	{
+		ASSERT_FALSE( job.failed );
+
+		FontAtlas::chunk_t chunk;
+		FontAtlas::RasterizeChunk( face, job.chunk, chunk );
+		ExpectSameAtlas( chunk, job.result );
+	}
+}
+
+TEST_F(FontAtlasTest, CancelDropsJobs)
+{
+	FontAtlas::Worker worker;
+	const int owner = 0;
+
+	for ( int chunk = 0; chunk < 4; chunk++ )
+	{
+		worker.Submit( &owner, ConsoleFont::unifont_otf.data, ConsoleFont::unifont_otf.size, POINT_SIZE, chunk );
+	}
+
+	worker.Cancel( &owner );
+
+	std::vector<FontAtlas::Worker::job_t> jobs;
+	worker.Collect( &owner, jobs );
+	EXPECT_TRUE( jobs.empty() );
+}
+
+} // namespace
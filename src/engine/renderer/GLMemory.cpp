@@ -50,6 +50,71 @@ void GLBufferCopy( GLBuffer* src, GLBuffer* dst, GLintptr srcOffset, GLintptr ds
 		srcOffset * sizeof( uint32_t ), dstOffset * sizeof( uint32_t ), size * sizeof( uint32_t ) );
 }
 
+// Buffers with more than one area, for r_speeds
+static std::vector<GLBuffer*> ringBuffers;
+
+void GLBuffer::TrackStalls() {
+	if ( std::find( ringBuffers.begin(), ringBuffers.end(), this ) == ringBuffers.end() ) {
+		ringBuffers.push_back( this );
+	}
+
+	ClearStalls();
+}
+
+void GLBuffer::UntrackStalls() {
+	ringBuffers.erase( std::remove( ringBuffers.begin(), ringBuffers.end(), this ), ringBuffers.end() );
+}
+
+/* Polls the fence of the current area first, and only if the GPU is still using it
+waits for it in short steps, so that the time the CPU spends blocked is accounted for */
+void GLBuffer::WaitAreaSync() {
+	GLenum status = glClientWaitSync( syncs[area], GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+
+	if ( status == GL_TIMEOUT_EXPIRED ) {
+		const Sys::SteadyClock::time_point start = Sys::SteadyClock::now();
+		const std::chrono::nanoseconds timeout( SYNC_TIMEOUT );
+
+		do {
+			if ( Sys::SteadyClock::now() - start > timeout ) {
+				Sys::Drop( "Failed buffer %s area %u sync", name, area );
+			}
+
+			status = glClientWaitSync( syncs[area], 0, SYNC_POLL_TIMEOUT );
+		} while ( status == GL_TIMEOUT_EXPIRED );
+
+		stalledThisCycle = true;
+		stallCount++;
+		stallTime += Sys::SteadyClock::now() - start;
+	}
+
+	if ( status == GL_WAIT_FAILED ) {
+		Sys::Drop( "Failed buffer %s area %u sync", name, area );
+	}
+
+	glDeleteSync( syncs[area] );
+	syncs[area] = nullptr;
+}
+
+/*
+====================
+GLBufferStallCounters
+
+Called by R_PerformanceCounters before the frame ends
+====================
+*/
+void GLBufferStallCounters() {
+	for ( const GLBuffer* buffer : ringBuffers ) {
+		Log::Notice( "%s: %i areas %i stalls %.3f ms", buffer->name, buffer->ActiveAreas(), buffer->StallCount(),
+			std::chrono::duration<double, std::milli>( buffer->StallTime() ).count() );
+	}
+}
+
+void GLBufferClearStallCounters() {
+	for ( GLBuffer* buffer : ringBuffers ) {
+		buffer->ClearStalls();
+	}
+}
+
 uint32_t* GLStagingBuffer::MapBuffer( const GLsizeiptr size ) {
 	if ( size > SIZE ) {
 		Sys::Drop( "Couldn't map GL staging buffer: size too large (%u/%u)", size, SIZE );
@@ -50,6 +50,7 @@ class GLBuffer {
 
 	std::string name;
 	const GLuint64 SYNC_TIMEOUT = 10000000000; // 10 seconds
+	const GLuint64 SYNC_POLL_TIMEOUT = 1000000; // 1 ms
 
 	GLuint id = 0;
 
@@ -96,11 +97,22 @@ class GLBuffer {
 		glNamedBufferData( id, size * sizeof( uint32_t ), data, usageFlags );
 	}
 
-	void BufferStorage( const GLsizeiptr newAreaSize, const GLsizeiptr areaCount, const void* data ) {
+	/* Storage for maxAreaCount areas is allocated, but the ring starts with areaCount of them,
+	and gets another one each time it wraps around after the CPU had to wait for the GPU.
+	data must cover all the areas. The shaders of a buffer that can grow must be given
+	its CurrentArea() instead of picking an area by frame */
+	void BufferStorage( const GLsizeiptr newAreaSize, const GLsizeiptr areaCount, const void* data,
+		const GLsizeiptr maxAreaCount = 0 ) {
 		areaSize = newAreaSize;
-		maxAreas = areaCount;
-		glNamedBufferStorage( id, areaSize * areaCount * sizeof( uint32_t ), data, flags );
-		syncs.resize( areaCount );
+		activeAreas = areaCount;
+		maxAreas = std::max( areaCount, maxAreaCount );
+		area = 0;
+		glNamedBufferStorage( id, areaSize * maxAreas * sizeof( uint32_t ), data, flags );
+		syncs.assign( maxAreas, nullptr );
+
+		if ( maxAreas > 1 ) {
+			TrackStalls();
+		}
 
 		GL_CheckErrors();
 	}
@@ -108,8 +120,15 @@ class GLBuffer {
 	void AreaIncr() {
 		syncs[area] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
 		area++;
-		if ( area >= maxAreas ) {
-			area = 0;
+		if ( area >= activeAreas ) {
+			if ( stalledThisCycle && activeAreas < maxAreas ) {
+				activeAreas++;
+				Log::Debug( "Buffer %s stalled, growing it to %i areas", name, activeAreas );
+			} else {
+				area = 0;
+			}
+
+			stalledThisCycle = false;
 		}
 	}
 
@@ -122,10 +141,7 @@ class GLBuffer {
 
 	uint32_t* GetCurrentAreaData() {
 		if ( syncs[area] != nullptr ) {
-			if ( glClientWaitSync( syncs[area], GL_SYNC_FLUSH_COMMANDS_BIT, SYNC_TIMEOUT ) == GL_TIMEOUT_EXPIRED ) {
-				Sys::Drop( "Failed buffer %s area %u sync", name, area );
-			}
-			glDeleteSync( syncs[area] );
+			WaitAreaSync();
 		}
 
 		return data + area * areaSize;
@@ -174,11 +190,42 @@ class GLBuffer {
 	}
 
 	void DelBuffer() {
+		for ( GLsync& sync : syncs ) {
+			if ( sync != nullptr ) {
+				glDeleteSync( sync );
+				sync = nullptr;
+			}
+		}
+
+		UntrackStalls();
+
 		glDeleteBuffers( 1, &id );
 		id = 0;
 		mapped = false;
 	}
 
+	// Waits for the GPU to release an area, since the last ClearStalls()
+	uint32_t StallCount() const {
+		return stallCount;
+	}
+
+	Sys::SteadyClock::duration StallTime() const {
+		return stallTime;
+	}
+
+	GLsizeiptr ActiveAreas() const {
+		return activeAreas;
+	}
+
+	GLsizeiptr CurrentArea() const {
+		return area;
+	}
+
+	void ClearStalls() {
+		stallCount = 0;
+		stallTime = Sys::SteadyClock::duration::zero();
+	}
+
 	private:
 	const GLenum internalTarget;
 	const GLuint internalBindingPoint;
@@ -190,8 +237,17 @@ class GLBuffer {
 	std::vector<GLsync> syncs;
 	GLsizeiptr area = 0;
 	GLsizeiptr areaSize = 0;
+	GLsizeiptr activeAreas = 0;
 	GLsizeiptr maxAreas = 0;
 	uint32_t* data;
+
+	bool stalledThisCycle = false;
+	uint32_t stallCount = 0;
+	Sys::SteadyClock::duration stallTime = Sys::SteadyClock::duration::zero();
+
+	void WaitAreaSync();
+	void TrackStalls();
+	void UntrackStalls();
 };
 
 // Shorthands for buffers that are only bound to one specific target
@@ -289,6 +345,9 @@ class GLVAO {
 
 void GLBufferCopy( GLBuffer* src, GLBuffer* dst, GLintptr srcOffset, GLintptr dstOffset, GLsizeiptr size );
 
+void GLBufferStallCounters();
+void GLBufferClearStallCounters();
+
 struct GLStagingCopy {
 	GLBuffer* dst;
 	GLsizeiptr stagingOffset;
@@ -359,16 +359,196 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 ===========================================================================
 */
+static Cvar::Cvar<bool> r_optimiseVertexCache( "r_optimiseVertexCache",
+	"reorder world triangles for the post-transform vertex cache on map load", Cvar::NONE, true );
+
+static const int VERTEX_CACHE_SIZE = 32;
+
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" scoring
+static float VertexCacheScore( const int cachePosition, const uint32_t remainingTris ) {
+	if ( !remainingTris ) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if ( cachePosition >= 0 ) {
+		// The last triangle's vertices get a fixed score so that strips don't get favoured over fans
+		if ( cachePosition < 3 ) {
+			score = 0.75f;
+		} else {
+			score = powf( 1.0f - ( cachePosition - 3 ) / float( VERTEX_CACHE_SIZE - 3 ), 1.5f );
+		}
+	}
+
+	// Prefer vertices with few triangles left, so we don't leave lone triangles behind
+	return score + 2.0f / sqrtf( remainingTris );
+}
+
+static void OptimiseVertexCache( glIndex_t* indices, const uint32_t numIndices ) {
+	const uint32_t numTris = numIndices / 3;
+
+	if ( numTris < 2 ) {
+		return;
+	}
+
+	// Remap the indices to a dense local range
+	std::vector<glIndex_t> uniqueVerts( indices, indices + numIndices );
+	std::sort( uniqueVerts.begin(), uniqueVerts.end() );
+	uniqueVerts.erase( std::unique( uniqueVerts.begin(), uniqueVerts.end() ), uniqueVerts.end() );
+	const uint32_t numVerts = uniqueVerts.size();
+
+	std::vector<uint32_t> triVerts( numIndices );
+	std::vector<uint32_t> remainingTris( numVerts, 0 );
+	for ( uint32_t i = 0; i < numIndices; i++ ) {
+		triVerts[i] = std::lower_bound( uniqueVerts.begin(), uniqueVerts.end(), indices[i] ) - uniqueVerts.begin();
+		remainingTris[triVerts[i]]++;
+	}
+
+	std::vector<uint32_t> vertTrisOffset( numVerts + 1, 0 );
+	for ( uint32_t i = 0; i < numVerts; i++ ) {
+		vertTrisOffset[i + 1] = vertTrisOffset[i] + remainingTris[i];
+	}
+
+	std::vector<uint32_t> vertTris( numIndices );
+	std::vector<uint32_t> vertTrisCount( numVerts, 0 );
+	for ( uint32_t i = 0; i < numIndices; i++ ) {
+		const uint32_t vert = triVerts[i];
+		vertTris[vertTrisOffset[vert] + vertTrisCount[vert]] = i / 3;
+		vertTrisCount[vert]++;
+	}
+
+	std::vector<int> cachePositions( numVerts, -1 );
+	std::vector<float> vertScores( numVerts );
+	for ( uint32_t i = 0; i < numVerts; i++ ) {
+		vertScores[i] = VertexCacheScore( -1, remainingTris[i] );
+	}
+
+	std::vector<bool> triEmitted( numTris, false );
+
+	uint32_t cache[VERTEX_CACHE_SIZE + 3];
+	uint32_t cacheSize = 0;
+	uint32_t nextTri = 0;
+	int bestTri = -1;
+
+	std::vector<glIndex_t> out;
+	out.reserve( numIndices );
+
+	for ( uint32_t emitted = 0; emitted < numTris; emitted++ ) {
+		if ( bestTri < 0 ) {
+			// Nothing in the cache has any triangles left, continue from the next unemitted one
+			while ( triEmitted[nextTri] ) {
+				nextTri++;
+			}
+
+			bestTri = nextTri;
+		}
+
+		triEmitted[bestTri] = true;
+		const uint32_t* tri = &triVerts[3 * bestTri];
+
+		uint32_t newCache[VERTEX_CACHE_SIZE + 6];
+		uint32_t newCacheSize = 0;
+
+		for ( int j = 0; j < 3; j++ ) {
+			const uint32_t vert = tri[j];
+			out.push_back( uniqueVerts[vert] );
+
+			uint32_t* vertTrisStart = &vertTris[vertTrisOffset[vert]];
+			uint32_t* vertTrisEnd = vertTrisStart + remainingTris[vert];
+			std::swap( *std::find( vertTrisStart, vertTrisEnd, ( uint32_t ) bestTri ), *( vertTrisEnd - 1 ) );
+			remainingTris[vert]--;
+
+			if ( std::find( newCache, newCache + newCacheSize, vert ) == newCache + newCacheSize ) {
+				newCache[newCacheSize++] = vert;
+			}
+		}
+
+		for ( uint32_t i = 0; i < cacheSize; i++ ) {
+			if ( cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2] ) {
+				newCache[newCacheSize++] = cache[i];
+			}
+		}
+
+		for ( uint32_t i = VERTEX_CACHE_SIZE; i < newCacheSize; i++ ) {
+			cachePositions[newCache[i]] = -1;
+			vertScores[newCache[i]] = VertexCacheScore( -1, remainingTris[newCache[i]] );
+		}
+
+		cacheSize = std::min( newCacheSize, ( uint32_t ) VERTEX_CACHE_SIZE );
+		for ( uint32_t i = 0; i < cacheSize; i++ ) {
+			cache[i] = newCache[i];
+			cachePositions[cache[i]] = i;
+			vertScores[cache[i]] = VertexCacheScore( i, remainingTris[cache[i]] );
+		}
+
+		// Only the triangles using cached vertices could have changed their score
+		bestTri = -1;
+		float bestScore = -1.0f;
+		for ( uint32_t i = 0; i < cacheSize; i++ ) {
+			const uint32_t vert = cache[i];
+
+			for ( uint32_t j = 0; j < remainingTris[vert]; j++ ) {
+				const uint32_t triNum = vertTris[vertTrisOffset[vert] + j];
+				const uint32_t* candidate = &triVerts[3 * triNum];
+				const float score = vertScores[candidate[0]] + vertScores[candidate[1]] + vertScores[candidate[2]];
+
+				if ( score > bestScore ) {
+					bestScore = score;
+					bestTri = triNum;
+				}
+			}
+		}
+	}
+
+	memcpy( indices, out.data(), numIndices * sizeof( glIndex_t ) );
+}
+
 void MergeDuplicateVertices( bspSurface_t** rendererSurfaces, int numSurfaces, srfVert_t* vertices, int numVerticesIn,
 	glIndex_t* indices, int numIndicesIn, int& numVerticesOut, int& numIndicesOut ) {
 	int start = Sys::Milliseconds();
 
-	std::unordered_map<srfVert_t, uint32_t, MapVertHasher, MapVertEqual> verts;
-	uint32_t idx = 0;
-	uint32_t vertIdx = 0;
-
 	// To shut CI up since this *is* used for an assert
 	Q_UNUSED( numIndicesIn );
+
+	std::vector<uint32_t> surfaceFirstVertex( numSurfaces + 1, 0 );
+	for ( int i = 0; i < numSurfaces; i++ ) {
+		bspSurface_t* surface = rendererSurfaces[i];
+		srfGeneric_t* srf = ( srfGeneric_t* ) surface->data;
+
+		/* There were some crashes due to bad lightmap values in .bsp vertices,
+		do the check again here just in case some calculation earlier, like patch mesh triangulation,
+		fucks things up again */
+		for ( int j = 0; j < srf->numVerts; j++ ) {
+			ValidateVertex( &srf->verts[j], -1, surface->shader );
+		}
+
+		surfaceFirstVertex[i + 1] = surfaceFirstVertex[i] + srf->numVerts;
+	}
+
+	std::vector<uint32_t> vertexHashes( surfaceFirstVertex[numSurfaces] );
+
+	#pragma omp parallel for schedule( dynamic, 64 )
+	for ( int i = 0; i < numSurfaces; i++ ) {
+		srfGeneric_t* srf = ( srfGeneric_t* ) rendererSurfaces[i]->data;
+
+		for ( int j = 0; j < srf->numVerts; j++ ) {
+			vertexHashes[surfaceFirstVertex[i] + j] = MapVertHasher()( srf->verts[j] );
+		}
+	}
+
+	/* Open addressing with linear probing, each slot holds an output vertex index + 1, 0 is empty.
+	The table is kept at most half full, and the hash is spread with Fibonacci hashing since
+	MapVertHasher() only mixes the bits of the position */
+	uint32_t tableBits = 4;
+	while ( ( 1u << tableBits ) < 2 * ( uint32_t ) numVerticesIn ) {
+		tableBits++;
+	}
+
+	const uint32_t tableMask = ( 1u << tableBits ) - 1;
+	std::vector<uint32_t> table( tableMask + 1, 0 );
+
+	uint32_t idx = 0;
+	uint32_t vertIdx = 0;
 	for ( int i = 0; i < numSurfaces; i++ ) {
 		bspSurface_t* surface = rendererSurfaces[i];
 		
@@ -376,25 +556,25 @@ void MergeDuplicateVertices( bspSurface_t** rendererSurfaces, int numSurfaces, s
 		srf->firstIndex = idx;
 		for ( srfTriangle_t* triangle = srf->triangles; triangle < srf->triangles + srf->numTriangles; triangle++ ) {
 			for ( int j = 0; j < 3; j++ ) {
-				srfVert_t& vert = srf->verts[triangle->indexes[j]];
-				uint32_t index = verts[vert];
+				const srfVert_t& vert = srf->verts[triangle->indexes[j]];
+				const uint32_t hash = vertexHashes[surfaceFirstVertex[i] + triangle->indexes[j]];
 
-				/* There were some crashes due to bad lightmap values in .bsp vertices,
-				do the check again here just in case some calculation earlier, like patch mesh triangulation,
-				fucks things up again */
-				ValidateVertex( &vert, -1, surface->shader );
+				uint32_t slot = ( hash * 2654435769u ) >> ( 32 - tableBits );
+				while ( table[slot] && !MapVertEqual()( vertices[table[slot] - 1], vert ) ) {
+					slot = ( slot + 1 ) & tableMask;
+				}
 
 				ASSERT_LT( idx, ( uint32_t ) numIndicesIn );
-				if ( !index ) {
-					verts[vert] = vertIdx + 1;
+				if ( !table[slot] ) {
+					ASSERT_LT( vertIdx, ( uint32_t ) numVerticesIn );
+
+					table[slot] = vertIdx + 1;
 					vertices[vertIdx] = vert;
 					indices[idx] = vertIdx;
 
-					ASSERT_LT( vertIdx, ( uint32_t ) numVerticesIn );
-
 					vertIdx++;
 				} else {
-					indices[idx] = index - 1;
+					indices[idx] = table[slot] - 1;
 				}
 				idx++;
 			}
@@ -405,6 +585,19 @@ void MergeDuplicateVertices( bspSurface_t** rendererSurfaces, int numSurfaces, s
 	numIndicesOut = idx;
 
 	Log::Notice( "Merged %i vertices into %i in %i ms", numVerticesIn, numVerticesOut, Sys::Milliseconds() - start );
+
+	if ( r_optimiseVertexCache.Get() ) {
+		start = Sys::Milliseconds();
+
+		// Triangle order within a surface doesn't matter, so each surface's index range can be reordered on its own
+		#pragma omp parallel for schedule( dynamic, 16 )
+		for ( int i = 0; i < numSurfaces; i++ ) {
+			srfGeneric_t* srf = ( srfGeneric_t* ) rendererSurfaces[i]->data;
+			OptimiseVertexCache( indices + srf->firstIndex, srf->numTriangles * 3 );
+		}
+
+		Log::Debug( "Optimised vertex cache order of %i surfaces in %i ms", numSurfaces, Sys::Milliseconds() - start );
+	}
 }
 
 static void ProcessMaterialSurface( MaterialSurface* surface, SurfaceIndexes* surfaceIdxs,
@@ -418,6 +611,10 @@ static void ProcessMaterialSurface( MaterialSurface* surface, SurfaceIndexes* su
 		AddPointToBounds( vertexes[surfaceIdxs->idxs[i]].xyz, mins, maxs );
 	}
 
+	if ( r_optimiseVertexCache.Get() ) {
+		OptimiseVertexCache( surfaceIdxs->idxs, surface->count );
+	}
+
 	const uint32_t oldFirstIndex = surface->firstIndex;
 	surface->firstIndex = *numIndices;
 
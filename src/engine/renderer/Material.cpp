@@ -1668,6 +1668,8 @@ void MaterialSystem::CullSurfaces() {
 		gl_cullShader->SetUniform_ViewWidth( depthImage->width );
 		gl_cullShader->SetUniform_ViewHeight( depthImage->height );
 		gl_cullShader->SetUniform_SurfaceCommandsOffset( surfaceCommandsCount * ( MAX_VIEWS * nextFrame + view ) );
+		// The ring can grow, so the area the CPU reads back next is given rather than derived from the frame
+		gl_cullShader->SetUniform_PortalSurfacesOffset( totalPortals * MAX_VIEWS * portalSurfacesSSBO.CurrentArea() );
 		gl_cullShader->SetUniform_P00( glState.projectionMatrix[glState.stackIndex][0] );
 		gl_cullShader->SetUniform_P11( glState.projectionMatrix[glState.stackIndex][5] );
 
@@ -1730,7 +1732,7 @@ void MaterialSystem::GeneratePortalBoundingSpheres() {
 	// FIXME: This only requires distance, origin and radius can be moved to surfaceDescriptors SSBO,
 	// drawSurfID is not needed as it's the same as the index in portalSurfacesSSBO
 	PortalSurface* portalSurfs =
-		( PortalSurface* ) ri.Hunk_AllocateTempMemory( totalPortals * MAX_VIEWFRAMES * sizeof( PortalSurface ) );
+		( PortalSurface* ) ri.Hunk_AllocateTempMemory( totalPortals * MAX_VIEWS * MAX_PORTAL_SURFACE_AREAS * sizeof( PortalSurface ) );
 
 	uint32_t index = 0;
 	for ( MaterialSurface& surface : portalSurfaces ) {
@@ -1741,7 +1743,7 @@ void MaterialSystem::GeneratePortalBoundingSpheres() {
 		sphere.distance = -1;
 
 		portalBounds.emplace_back( sphere );
-		for ( uint32_t i = 0; i < MAX_FRAMES; i++ ) {
+		for ( uint32_t i = 0; i < MAX_PORTAL_SURFACE_AREAS; i++ ) {
 			for ( uint32_t j = 0; j < MAX_VIEWS; j++ ) {
 				portalSurfs[index + ( i * MAX_VIEWS + j ) * totalPortals] = sphere;
 			}
@@ -1749,7 +1751,8 @@ void MaterialSystem::GeneratePortalBoundingSpheres() {
 		index++;
 	}
 
-	portalSurfacesSSBO.BufferStorage( totalPortals * PORTAL_SURFACE_SIZE * MAX_VIEWS, 2, portalSurfs );
+	portalSurfacesSSBO.BufferStorage( totalPortals * PORTAL_SURFACE_SIZE * MAX_VIEWS, MAX_FRAMES, portalSurfs,
+		MAX_PORTAL_SURFACE_AREAS );
 	portalSurfacesSSBO.MapAll();
 
 	ri.Hunk_FreeTempMemory( portalSurfs );
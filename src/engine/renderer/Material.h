@@ -270,6 +270,7 @@ Current mapss use up to ~38kb at max, without models */
 
 #define MAX_FRAMES 2
 #define MAX_VIEWFRAMES MAX_VIEWS * MAX_FRAMES // Buffer 2 frames for each view
+#define MAX_PORTAL_SURFACE_AREAS 4 // portalSurfacesSSBO starts with MAX_FRAMES areas, and grows up to this if the CPU stalls on it
 
 struct ViewFrame {
 	uint32_t viewID = 0;
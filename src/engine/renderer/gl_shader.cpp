@@ -3005,6 +3005,7 @@ GLShader_cull::GLShader_cull() :
 	u_ModelViewMatrix( this ),
 	u_FirstPortalGroup( this ),
 	u_TotalPortals( this ),
+	u_PortalSurfacesOffset( this ),
 	u_ViewWidth( this ),
 	u_ViewHeight( this ),
 	u_P00( this ),
@@ -2211,6 +2211,18 @@ class u_SurfaceCommandsOffset :
 	}
 };
 
+class u_PortalSurfacesOffset :
+	GLUniform1ui {
+	public:
+	u_PortalSurfacesOffset( GLShader* shader ) :
+		GLUniform1ui( shader, "u_PortalSurfacesOffset", PUSH ) {
+	}
+
+	void SetUniform_PortalSurfacesOffset( const uint portalSurfacesOffset ) {
+		this->SetValue( portalSurfacesOffset );
+	}
+};
+
 class u_MaterialColour :
 	GLUniform3f {
 	public:
@@ -3428,6 +3440,7 @@ class GLShader_cull :
 	public u_ModelViewMatrix,
 	public u_FirstPortalGroup,
 	public u_TotalPortals,
+	public u_PortalSurfacesOffset,
 	public u_ViewWidth,
 	public u_ViewHeight,
 	public u_P00,
@@ -78,6 +78,7 @@ uniform bool u_UseOcclusionCulling;
 uniform vec3 u_CameraPosition;
 uniform uint u_FirstPortalGroup;
 uniform uint u_TotalPortals;
+uniform uint u_PortalSurfacesOffset;
 uniform mat4 u_ModelViewMatrix;
 uniform uint u_ViewWidth;
 uniform uint u_ViewHeight;
@@ -189,7 +190,7 @@ void main() {
 	// Portals
 	const uint portalID = globalInvocationID - u_FirstPortalGroup * 64;
 	if( globalGroupID >= u_FirstPortalGroup && ( portalID < u_TotalPortals ) ) {
-		const uint portalSurfaceID = portalID + ( u_Frame * MAX_VIEWS + u_ViewID ) * u_TotalPortals;
+		const uint portalSurfaceID = u_PortalSurfacesOffset + portalID + u_ViewID * u_TotalPortals;
 		PortalSurface surface = portalSurfaces[portalSurfaceID];
 		bool culled = CullSurface( surface.boundingSphere );
 
@@ -16,6 +16,8 @@ set(RENDERERLIST
     ${ENGINE_DIR}/renderer/tr_font.cpp
     ${ENGINE_DIR}/renderer/EntityCache.cpp
     ${ENGINE_DIR}/renderer/EntityCache.h
+    ${ENGINE_DIR}/renderer/FontAtlas.cpp
+    ${ENGINE_DIR}/renderer/FontAtlas.h
     ${ENGINE_DIR}/renderer/GeometryCache.cpp
     ${ENGINE_DIR}/renderer/GeometryCache.h
     ${ENGINE_DIR}/renderer/GeometryOptimiser.cpp
@@ -69,5 +71,6 @@ set(RENDERERLIST
 )
 
 set(RENDERERTESTLIST
+    ${ENGINE_DIR}/renderer/FontAtlasTest.cpp
     ${ENGINE_DIR}/renderer/gl_shader_test.cpp
 )
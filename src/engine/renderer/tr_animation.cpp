@@ -24,6 +24,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "tr_local.h"
 #include "GeometryOptimiser.h"
 
+static Cvar::Cvar<bool> r_md5AnimCache(
+	"r_md5AnimCache", "cache parsed md5anim files as binaries in the homepath", Cvar::NONE, true );
+
 /*
 ===========================================================================
 All bones should be an identity orientation to display the mesh exactly
@@ -414,6 +417,183 @@ static bool R_LoadMD5Anim( skelAnimation_t *skelAnim, const char *buffer, const
 	return true;
 }
 
+/*
+===============
+MD5 animation cache
+
+The parsed md5Animation_t is saved as-is to the homepath, with the frame components
+packed after the channels and frame bounds, so that loading it back is a single read
+followed by a pointer fixup. The cache is keyed by the checksum of the .md5anim text.
+===============
+*/
+static const uint32_t MD5_ANIM_CACHE_VERSION = 1;
+
+struct md5AnimCacheHeader_t
+{
+	uint32_t version;
+	uint32_t checkSum;
+	uint32_t sourceSize;
+	uint32_t channelSize; // sizeof( md5Channel_t ) of the build that wrote the cache
+	uint32_t numFrames;
+	uint32_t numChannels;
+	int32_t  frameRate;
+	uint32_t numAnimatedComponents;
+};
+
+static std::string R_MD5AnimCachePath( const char *name )
+{
+	return Str::Format( "md5cache/%s.bin", name );
+}
+
+// The components a channel reads must be within the frames, as a bad cache file must not be trusted
+static bool R_ValidateMD5AnimCacheChannels( const md5Channel_t *channels, const md5AnimCacheHeader_t &header )
+{
+	for ( uint32_t i = 0; i < header.numChannels; i++ )
+	{
+		md5Channel_t channel;
+		memcpy( &channel, &channels[ i ], sizeof( channel ) );
+
+		if ( !memchr( channel.name, '\0', sizeof( channel.name ) ) )
+		{
+			return false;
+		}
+
+		if ( channel.parentIndex < -1 || channel.parentIndex >= int( header.numChannels ) )
+		{
+			return false;
+		}
+
+		if ( channel.componentsBits & ~( COMPONENT_BIT_TX | COMPONENT_BIT_TY | COMPONENT_BIT_TZ
+			| COMPONENT_BIT_QX | COMPONENT_BIT_QY | COMPONENT_BIT_QZ ) )
+		{
+			return false;
+		}
+
+		uint32_t numComponents = 0;
+		for ( int bits = channel.componentsBits; bits; bits &= bits - 1 )
+		{
+			numComponents++;
+		}
+
+		if ( channel.componentsOffset + numComponents > header.numAnimatedComponents )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool R_LoadMD5AnimCache( skelAnimation_t *skelAnim, const char *name, uint32_t checkSum, uint32_t sourceSize )
+{
+	std::error_code err;
+	const std::string cachePath = R_MD5AnimCachePath( name );
+
+	FS::File cacheFile = FS::HomePath::OpenRead( cachePath, err );
+	if ( err )
+	{
+		return false;
+	}
+
+	const std::string cacheData = cacheFile.ReadAll( err );
+	if ( err || cacheData.size() < sizeof( md5AnimCacheHeader_t ) )
+	{
+		return false;
+	}
+
+	md5AnimCacheHeader_t header;
+	memcpy( &header, cacheData.data(), sizeof( header ) );
+
+	if ( header.version != MD5_ANIM_CACHE_VERSION || header.checkSum != checkSum || header.sourceSize != sourceSize
+		|| header.channelSize != sizeof( md5Channel_t ) )
+	{
+		return false;
+	}
+
+	if ( header.numFrames == 0 || header.numFrames > UINT16_MAX || header.numChannels > UINT8_MAX )
+	{
+		return false;
+	}
+
+	const size_t channelsSize = sizeof( md5Channel_t ) * header.numChannels;
+	const size_t boundsSize = sizeof( vec3_t ) * 2 * header.numFrames;
+	const size_t componentsSize = sizeof( float ) * header.numAnimatedComponents * header.numFrames;
+
+	if ( cacheData.size() != sizeof( header ) + channelsSize + boundsSize + componentsSize )
+	{
+		Log::Warn( "MD5 animation cache %s has wrong size", cachePath );
+		return false;
+	}
+
+	const byte *data = reinterpret_cast<const byte *>( cacheData.data() ) + sizeof( header );
+
+	if ( !R_ValidateMD5AnimCacheChannels( reinterpret_cast<const md5Channel_t *>( data ), header ) )
+	{
+		Log::Warn( "MD5 animation cache %s has bad channels", cachePath );
+		return false;
+	}
+
+	md5Animation_t *anim = (md5Animation_t*) ri.Hunk_Alloc( sizeof( *anim ), ha_pref::h_low );
+	anim->numFrames = header.numFrames;
+	anim->numChannels = header.numChannels;
+	anim->frameRate = header.frameRate;
+	anim->numAnimatedComponents = header.numAnimatedComponents;
+
+	anim->channels = (md5Channel_t*) ri.Hunk_Alloc( channelsSize, ha_pref::h_low );
+	memcpy( anim->channels, data, channelsSize );
+	data += channelsSize;
+
+	anim->frames = (md5Frame_t*) ri.Hunk_Alloc( sizeof( md5Frame_t ) * anim->numFrames, ha_pref::h_low );
+	float *components = (float*) ri.Hunk_Alloc( componentsSize, ha_pref::h_low );
+	memcpy( components, data + boundsSize, componentsSize );
+
+	for ( int i = 0; i < anim->numFrames; i++ )
+	{
+		memcpy( anim->frames[ i ].bounds, data, sizeof( vec3_t ) * 2 );
+		data += sizeof( vec3_t ) * 2;
+
+		anim->frames[ i ].components = components + i * anim->numAnimatedComponents;
+	}
+
+	skelAnim->type = animType_t::AT_MD5;
+	skelAnim->md5 = anim;
+
+	return true;
+}
+
+static void R_SaveMD5AnimCache( const md5Animation_t *anim, const char *name, uint32_t checkSum, uint32_t sourceSize )
+{
+	md5AnimCacheHeader_t header;
+	header.version = MD5_ANIM_CACHE_VERSION;
+	header.checkSum = checkSum;
+	header.sourceSize = sourceSize;
+	header.channelSize = sizeof( md5Channel_t );
+	header.numFrames = anim->numFrames;
+	header.numChannels = anim->numChannels;
+	header.frameRate = anim->frameRate;
+	header.numAnimatedComponents = anim->numAnimatedComponents;
+
+	std::string cacheData;
+	cacheData.reserve( sizeof( header ) + sizeof( md5Channel_t ) * anim->numChannels
+		+ ( sizeof( vec3_t ) * 2 + sizeof( float ) * anim->numAnimatedComponents ) * anim->numFrames );
+
+	cacheData.append( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+	cacheData.append( reinterpret_cast<const char *>( anim->channels ), sizeof( md5Channel_t ) * anim->numChannels );
+
+	for ( int i = 0; i < anim->numFrames; i++ )
+	{
+		cacheData.append( reinterpret_cast<const char *>( anim->frames[ i ].bounds ), sizeof( vec3_t ) * 2 );
+	}
+
+	for ( int i = 0; i < anim->numFrames; i++ )
+	{
+		cacheData.append( reinterpret_cast<const char *>( anim->frames[ i ].components ),
+			sizeof( float ) * anim->numAnimatedComponents );
+	}
+
+	ri.FS_WriteFile( R_MD5AnimCachePath( name ).c_str(), cacheData.data(), cacheData.size() );
+}
+
 /*
 ===============
 RE_RegisterAnimationIQM
@@ -542,7 +722,19 @@ qhandle_t RE_RegisterAnimation( const char *name )
 
 	if ( Str::IsPrefix( MD5_IDENTSTRING, buffer ) )
 	{
-		loaded = R_LoadMD5Anim( anim, buffer.c_str(), name );
+		const uint32_t checkSum = Com_BlockChecksum( buffer.data(), buffer.size() );
+
+		loaded = r_md5AnimCache.Get() && R_LoadMD5AnimCache( anim, name, checkSum, buffer.size() );
+
+		if ( !loaded )
+		{
+			loaded = R_LoadMD5Anim( anim, buffer.c_str(), name );
+
+			if ( loaded && r_md5AnimCache.Get() )
+			{
+				R_SaveMD5AnimCache( anim->md5, name, checkSum, buffer.size() );
+			}
+		}
 	}
 	else
 	{
@@ -1178,6 +1370,30 @@ int RE_BuildSkeleton( refSkeleton_t *skel, qhandle_t hAnim, int startFrame, int
 	return false;
 }
 
+/*
+==============
+RE_BuildSkeletons
+
+Builds a batch of skeletons, spread over the OpenMP threads since each one only
+reads the shared animation data
+==============
+*/
+void RE_BuildSkeletons( const skeletonRequest_t *requests, int numRequests, refSkeleton_t *skels, int *results )
+{
+	// a single skeleton is only a few microseconds, don't wake up threads for a couple
+	constexpr int MIN_PARALLEL_SKELETONS = 8;
+
+	#pragma omp parallel for if ( numRequests >= MIN_PARALLEL_SKELETONS )
+	for ( int i = 0; i < numRequests; i++ )
+	{
+		const skeletonRequest_t *request = &requests[ i ];
+
+		skels[ i ].numBones = 0;
+		results[ i ] = RE_BuildSkeleton( &skels[ i ], request->animationHandle, request->startFrame, request->endFrame,
+			request->frac, request->clearOrigin );
+	}
+}
+
 /*
 ==============
 RE_BlendSkeleton
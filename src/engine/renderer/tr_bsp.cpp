@@ -698,7 +698,8 @@ R_LoadVisibility
 */
 static void R_LoadVisibility( lump_t *l )
 {
-	int  len, i, j, k;
+	int  len, i;
+	int  fileClusterBytes;
 	byte *buf;
 
 	Log::Debug("...loading visibility" );
@@ -717,7 +718,11 @@ static void R_LoadVisibility( lump_t *l )
 	buf = fileBase + l->fileofs;
 
 	s_worldData.numClusters = LittleLong( ( ( int * ) buf ) [ 0 ] );
-	s_worldData.clusterBytes = LittleLong( ( ( int * ) buf ) [ 1 ] );
+	fileClusterBytes = LittleLong( ( ( int * ) buf ) [ 1 ] );
+
+	// the rows are padded the same way as in CMod_LoadVisibility,
+	// so that the vis data of the collision map can be shared
+	s_worldData.clusterBytes = std::max( VisBits::RowBytes( s_worldData.numClusters ), ( fileClusterBytes + 15 ) & ~15 );
 
 	// CM_Load should have given us the vis data to share, so
 	// we don't need to allocate another copy
@@ -729,8 +734,13 @@ static void R_LoadVisibility( lump_t *l )
 	{
 		byte *dest;
 
-		dest = (byte*) ri.Hunk_Alloc( len - 8, ha_pref::h_low );
-		memcpy( dest, buf + 8, len - 8 );
+		dest = (byte*) ri.Hunk_Alloc( s_worldData.numClusters * s_worldData.clusterBytes, ha_pref::h_low );
+
+		for ( i = 0; i < s_worldData.numClusters; i++ )
+		{
+			memcpy( dest + i * s_worldData.clusterBytes, buf + 8 + i * fileClusterBytes, fileClusterBytes );
+		}
+
 		s_worldData.vis = dest;
 	}
 
@@ -741,42 +751,15 @@ static void R_LoadVisibility( lump_t *l )
 
 	for ( i = 0; i < s_worldData.numClusters; i++ )
 	{
-		const byte *src;
-		const int *src2;
-		byte *dest;
+		const byte *src = s_worldData.vis + i * s_worldData.clusterBytes;
+		byte *dest = s_worldData.visvis + i * s_worldData.clusterBytes;
 
-		src  = s_worldData.vis + i * s_worldData.clusterBytes;
-		dest = s_worldData.visvis + i * s_worldData.clusterBytes;
-
-		// for each byte in the current cluster's vis data
-		for ( j = 0; j < s_worldData.clusterBytes; j++ )
+		// OR the vis data of every cluster visible from the current cluster
+		for ( int cluster = 0; cluster < s_worldData.numClusters; cluster++ )
 		{
-			byte bitbyte = src[ j ];
-
-			if ( !bitbyte )
-			{
-				continue;
-			}
-
-			for ( k = 0; k < 8; k++ )
+			if ( VisBits::Test( src, cluster ) )
 			{
-				int index;
-
-				// check if this cluster ( k = ( cluster & 7 ) ) is visible from the current cluster
-				if ( ! ( bitbyte & ( 1 << k ) ) )
-				{
-					continue;
-				}
-
-				// retrieve vis data for the cluster
-				index = ( ( j << 3 ) | k );
-				src2 = ( int * ) ( s_worldData.vis + index * s_worldData.clusterBytes );
-
-				// OR this vis data with the current cluster's
-				for (unsigned m = 0; m < ( s_worldData.clusterBytes / sizeof( int ) ); m++ )
-				{
-					( ( int * ) dest )[ m ] |= src2[ m ];
-				}
+				VisBits::Or( dest, s_worldData.vis + cluster * s_worldData.clusterBytes, s_worldData.clusterBytes );
 			}
 		}
 	}
@@ -1284,6 +1267,78 @@ static void ParseMesh( dsurface_t *ds, drawVert_t *verts, bspSurface_t *surf )
 	SphereFromBounds( grid->bounds[0], grid->bounds[1], grid->origin, &grid->radius );
 }
 
+/*
+=================
+LoD groups
+
+Patches that must subdivide the same to avoid cracking share the exact same lod origin
+and radius. Only patches of the same group are ever stitched or have their LoD errors
+synced, so the grids are bucketed by group once instead of testing every surface pair.
+The groups hold surface indices in increasing order, so iterating a group visits
+the same patches in the same order as a scan over all surfaces would.
+=================
+*/
+struct lodGroupKey_t
+{
+	uint32_t bits[ 4 ];
+
+	bool operator==( const lodGroupKey_t &other ) const
+	{
+		return !memcmp( bits, other.bits, sizeof( bits ) );
+	}
+};
+
+struct lodGroupKeyHash_t
+{
+	size_t operator()( const lodGroupKey_t &key ) const
+	{
+		size_t hash = 0;
+
+		for ( uint32_t bits : key.bits )
+		{
+			hash = hash * 31 + bits;
+		}
+
+		return hash;
+	}
+};
+
+static std::unordered_map<lodGroupKey_t, std::vector<int>, lodGroupKeyHash_t> lodGroups;
+
+static lodGroupKey_t R_LodGroupKey( const srfGridMesh_t *grid )
+{
+	lodGroupKey_t key;
+
+	// adding 0 turns -0 into +0, so that keys match exactly when the floats compare equal
+	const float values[ 4 ] = { grid->lodOrigin[ 0 ] + 0.0f, grid->lodOrigin[ 1 ] + 0.0f,
+		grid->lodOrigin[ 2 ] + 0.0f, grid->lodRadius + 0.0f };
+	memcpy( key.bits, values, sizeof( key.bits ) );
+
+	return key;
+}
+
+static void R_BuildLodGroups()
+{
+	lodGroups.clear();
+
+	for ( int i = 0; i < s_worldData.numSurfaces; i++ )
+	{
+		srfGridMesh_t *grid = ( srfGridMesh_t * ) s_worldData.surfaces[ i ].data;
+
+		if ( grid->surfaceType != surfaceType_t::SF_GRID )
+		{
+			continue;
+		}
+
+		lodGroups[ R_LodGroupKey( grid ) ].push_back( i );
+	}
+}
+
+static const std::vector<int> &R_GetLodGroup( const srfGridMesh_t *grid )
+{
+	return lodGroups.at( R_LodGroupKey( grid ) );
+}
+
 /*
 =================
 R_MergedWidthPoints
@@ -1369,48 +1424,26 @@ FIXME: write generalized version that also avoids cracks between a patch and one
 */
 void R_FixSharedVertexLodError_r( int start, srfGridMesh_t *grid1 )
 {
-	int           j, k, l, m, n, offset1, offset2, touch;
+	int           k, l, m, n, offset1, offset2, touch;
 	srfGridMesh_t *grid2;
 
-	for ( j = start; j < s_worldData.numSurfaces; j++ )
+	// only grids in the same LOD group can share vertices with matching LoD
+	for ( int j : R_GetLodGroup( grid1 ) )
 	{
-		//
-		grid2 = ( srfGridMesh_t * ) s_worldData.surfaces[ j ].data;
-
-		// if this surface is not a grid
-		if ( grid2->surfaceType != surfaceType_t::SF_GRID )
+		if ( j < start )
 		{
 			continue;
 		}
 
+		//
+		grid2 = ( srfGridMesh_t * ) s_worldData.surfaces[ j ].data;
+
 		// if the LOD errors are already fixed for this patch
 		if ( grid2->lodFixed == 2 )
 		{
 			continue;
 		}
 
-		// grids in the same LOD group should have the exact same lod radius
-		if ( grid1->lodRadius != grid2->lodRadius )
-		{
-			continue;
-		}
-
-		// grids in the same LOD group should have the exact same lod origin
-		if ( grid1->lodOrigin[ 0 ] != grid2->lodOrigin[ 0 ] )
-		{
-			continue;
-		}
-
-		if ( grid1->lodOrigin[ 1 ] != grid2->lodOrigin[ 1 ] )
-		{
-			continue;
-		}
-
-		if ( grid1->lodOrigin[ 2 ] != grid2->lodOrigin[ 2 ] )
-		{
-			continue;
-		}
-
 		//
 		touch = false;
 
@@ -1644,6 +1677,8 @@ void R_FixSharedVertexLodError()
 	int           i;
 	srfGridMesh_t *grid1;
 
+	R_BuildLodGroups();
+
 	for ( i = 0; i < s_worldData.numSurfaces; i++ )
 	{
 		//
@@ -1666,6 +1701,8 @@ void R_FixSharedVertexLodError()
 		// recursively fix other patches in the same LOD group
 		R_FixSharedVertexLodError_r( i + 1, grid1 );
 	}
+
+	lodGroups.clear();
 }
 
 /*
@@ -2450,44 +2487,15 @@ might still appear at that side.
 */
 int R_TryStitchingPatch( int grid1num )
 {
-	int           j, numstitches;
+	int           numstitches;
 
 	numstitches = 0;
 
-	for ( j = 0; j < s_worldData.numSurfaces; j++ )
-	{
-		srfGridMesh_t *grid2 = ( srfGridMesh_t * ) s_worldData.surfaces[ j ].data;
-
-		// if this surface is not a grid
-		if ( grid2->surfaceType != surfaceType_t::SF_GRID )
-		{
-			continue;
-		}
-
-		srfGridMesh_t *grid1 = ( srfGridMesh_t * ) s_worldData.surfaces[ grid1num ].data;
-
-		// grids in the same LOD group should have the exact same lod radius
-		if ( grid1->lodRadius != grid2->lodRadius )
-		{
-			continue;
-		}
-
-		// grids in the same LOD group should have the exact same lod origin
-		if ( grid1->lodOrigin[ 0 ] != grid2->lodOrigin[ 0 ] )
-		{
-			continue;
-		}
-
-		if ( grid1->lodOrigin[ 1 ] != grid2->lodOrigin[ 1 ] )
-		{
-			continue;
-		}
-
-		if ( grid1->lodOrigin[ 2 ] != grid2->lodOrigin[ 2 ] )
-		{
-			continue;
-		}
+	// stitching replaces the grids but keeps their lod origin and radius, so the group stays valid
+	const srfGridMesh_t *grid1 = ( srfGridMesh_t * ) s_worldData.surfaces[ grid1num ].data;
 
+	for ( int j : R_GetLodGroup( grid1 ) )
+	{
 		//
 		while ( R_StitchPatches( grid1num, j ) )
 		{
@@ -2510,6 +2518,8 @@ void R_StitchAllPatches()
 
 	Log::Debug("...stitching LoD cracks" );
 
+	R_BuildLodGroups();
+
 	numstitches = 0;
 
 	do
@@ -2542,6 +2552,8 @@ void R_StitchAllPatches()
 	}
 	while ( stitched );
 
+	lodGroups.clear();
+
 	Log::Debug("stitched %d LoD cracks", numstitches );
 }
 
@@ -3072,11 +3084,15 @@ static void R_LoadNodesAndLeafs( lump_t *nodeLump, lump_t *leafLump )
 
 	backEndData[ 0 ]->traversalList = ( bspNode_t ** ) ri.Hunk_Alloc( sizeof( bspNode_t * ) * s_worldData.numnodes, ha_pref::h_low );
 	backEndData[ 0 ]->traversalLength = 0;
+	backEndData[ 0 ]->worldSurfaceCandidates = ( worldSurfaceCandidate_t * ) ri.Hunk_Alloc( sizeof( worldSurfaceCandidate_t ) * s_worldData.numMarkSurfaces, ha_pref::h_low );
+	backEndData[ 0 ]->numWorldSurfaceCandidates = 0;
 
 	if ( r_smp->integer )
 	{
 		backEndData[ 1 ]->traversalList = ( bspNode_t ** ) ri.Hunk_Alloc( sizeof( bspNode_t * ) * s_worldData.numnodes, ha_pref::h_low );
 		backEndData[ 1 ]->traversalLength = 0;
+		backEndData[ 1 ]->worldSurfaceCandidates = ( worldSurfaceCandidate_t * ) ri.Hunk_Alloc( sizeof( worldSurfaceCandidate_t ) * s_worldData.numMarkSurfaces, ha_pref::h_low );
+		backEndData[ 1 ]->numWorldSurfaceCandidates = 0;
 	}
 }
 
@@ -4013,131 +4029,329 @@ void R_LoadEntities( lump_t *l, std::string &externalEntities )
 	}
 }
 
-static std::string headerString;
-static const std::string gridPath = "reflectionCubemaps";
-static const std::string gridExtension = ".cubemapGrid";
-static bool R_LoadCubeMaps() {
-	std::error_code err;
+static const std::string cubeProbeCachePath = "reflectionCubemaps";
 
-	const std::string dirPath = Str::Format( "%s/%s/", gridPath, tr.world->baseName );
-	std::string cubemapGridPath = Str::Format( "%s%s%s", dirPath, tr.world->baseName, gridExtension );
-	FS::File cubemapGridFile = FS::HomePath::OpenRead( cubemapGridPath, err );
-	if ( err ) {
-		if ( err != std::error_code( Util::ordinal( FS::filesystem_error::no_such_file ), FS::filesystem_category() ) ) {
-			Log::Notice( "No saved cubemap grid found for %s", cubemapGridPath );
-			return false;
-		}
+/*
+The probes are cached one by one in reflectionCubemaps/<map>/, named after a
+hash of everything that ends up in them: their origin, the cubemap size and
+the world surfaces in their PVS. Editing one part of a map only changes the
+hash of the probes that can see it.
+*/
+static uint64_t R_HashBytes( uint64_t hash, const void *data, size_t size ) {
+	// FNV-1a
+	const byte *bytes = ( const byte * ) data;
 
-		Log::Warn( "Failed to open cubemap probe grid file %s: %s", cubemapGridPath, err.message() );
-		return false;
+	for ( size_t i = 0; i < size; i++ ) {
+		hash = ( hash ^ bytes[i] ) * 0x100000001b3ull;
 	}
 
-	std::istringstream gridStream( cubemapGridFile.ReadAll() );
-	std::string line;
+	return hash;
+}
 
-	std::getline( gridStream, line, ' ' );
-	const uint32_t cubemapVersion = std::stoi( line );
-	std::getline( gridStream, line, '\n' );
+static const uint64_t CUBE_PROBE_HASH_SEED = 0xcbf29ce484222325ull;
 
-	if ( cubemapVersion != REFLECTION_CUBEMAP_VERSION || line != headerString ) {
-		Log::Notice( "Saved cube probe version or BSP header doesn't match the current one "
-			"(current: version: %u, header: %s; saved: version: %u, header: %s)", REFLECTION_CUBEMAP_VERSION, headerString, cubemapVersion, line );
-		return false;
-	}
+static uint64_t R_HashWorldSurface( const bspSurface_t *surface ) {
+	uint64_t hash = CUBE_PROBE_HASH_SEED;
 
-	std::getline( gridStream, line, ' ' );
-	const int cubemapSize = std::stoi( line );
-	std::getline( gridStream, line, '\n' );
-	const uint32_t cubemapSpacing = std::stoi( line );
+	hash = R_HashBytes( hash, surface->shader->name, strlen( surface->shader->name ) );
+	hash = R_HashBytes( hash, &surface->lightmapNum, sizeof( surface->lightmapNum ) );
+	hash = R_HashBytes( hash, surface->data, sizeof( surfaceType_t ) );
 
-	if ( cubemapSize != r_cubeProbeSize.Get() || cubemapSpacing != tr.cubeProbeSpacing ) {
-		Log::Notice( "Saved cube probe parameters don't match current ones (current: size: %u, spacing: %u; saved: size: %u, spacing: %u)",
-			r_cubeProbeSize.Get(), tr.cubeProbeSpacing, cubemapSize, cubemapSpacing );
-		return false;
+	switch ( *surface->data ) {
+		case surfaceType_t::SF_FACE:
+		case surfaceType_t::SF_GRID:
+		case surfaceType_t::SF_TRIANGLES:
+		{
+			const srfGeneric_t *srf = ( const srfGeneric_t * ) surface->data;
+
+			hash = R_HashBytes( hash, srf->verts, srf->numVerts * sizeof( srfVert_t ) );
+			hash = R_HashBytes( hash, srf->triangles, srf->numTriangles * sizeof( srfTriangle_t ) );
+			break;
+		}
+
+		case surfaceType_t::SF_VBO_MESH:
+		{
+			const srfGeneric_t *srf = ( const srfGeneric_t * ) surface->data;
+
+			hash = R_HashBytes( hash, srf->bounds, sizeof( srf->bounds ) );
+			hash = R_HashBytes( hash, &srf->numVerts, sizeof( srf->numVerts ) );
+			hash = R_HashBytes( hash, &srf->numTriangles, sizeof( srf->numTriangles ) );
+			break;
+		}
+
+		default:
+			break;
 	}
 
-	uint32_t gridSize[3];
-	for ( int i = 0; i < 3; i++ ) {
-		std::getline( gridStream, line, ' ' );
-		gridSize[i] = std::stoi( line );
+	return hash;
+}
+
+static void R_HashCubeProbes( std::vector<uint64_t> &probeHashes ) {
+	world_t *world = tr.world;
+
+	std::vector<uint64_t> surfaceHashes( world->numSurfaces );
+
+	#pragma omp parallel for
+	for ( int i = 0; i < world->numSurfaces; i++ ) {
+		surfaceHashes[i] = R_HashWorldSurface( &world->surfaces[i] );
 	}
-	tr.cubeProbeGrid.SetSize( gridSize[0], gridSize[1], gridSize[2] );
 
-	std::getline( gridStream, line, '\n' );
-	const uint32_t count = std::stoi( line );
+	// Summed so that the order of the leafs and of their surfaces doesn't matter
+	std::vector<uint64_t> clusterHashes( std::max( world->numClusters, 1 ) );
 
-	for ( uint32_t i = 0; i < count; i++ ) {
-		cubemapProbe_t cubeProbe;
-		for ( int j = 0; j < 3; j++ ) {
-			std::getline( gridStream, line, ( j < 2 ? ' ' : '\n' ) );
-			cubeProbe.origin[j] = std::stof( line );
+	for ( int i = 0; i < world->numnodes; i++ ) {
+		const bspNode_t *node = &world->nodes[i];
+
+		if ( node->contents == CONTENTS_NODE || node->cluster < 0 || node->cluster >= world->numClusters ) {
+			continue;
 		}
 
-		imageParams_t imageParams = {};
-		imageParams.bits = IF_HOMEPATH;
-		imageParams.filterType = filterType_t::FT_DEFAULT;
-		imageParams.wrapType = wrapTypeEnum_t::WT_EDGE_CLAMP;
+		bspSurface_t **view = world->viewSurfaces + node->firstMarkSurface;
+
+		for ( int j = 0; j < node->numMarkSurfaces; j++ ) {
+			clusterHashes[node->cluster] += surfaceHashes[view[j] - world->surfaces];
+		}
+	}
+
+	const int cubeMapSize = r_cubeProbeSize.Get();
+	const uint32_t version = REFLECTION_CUBEMAP_VERSION;
+
+	probeHashes.resize( tr.cubeProbes.size() );
+
+	#pragma omp parallel for
+	for ( size_t i = 0; i < tr.cubeProbes.size(); i++ ) {
+		const cubemapProbe_t &cubeProbe = tr.cubeProbes[i];
+		const byte *vis = R_ClusterPVS( cubeProbe.cluster );
 
-		std::string imageName = Str::Format( "%s%u", dirPath, i );
+		uint64_t visibleHash = 0;
 
-		image_t* cubemap = R_FindCubeImage( imageName.c_str(), imageParams );
-		if ( !cubemap ) {
-			Log::Warn( "Failed to load cubemap %s", imageName );
-			return false;
+		for ( int cluster = 0; cluster < world->numClusters; cluster++ ) {
+			if ( vis[cluster >> 3] & ( 1 << ( cluster & 7 ) ) ) {
+				visibleHash += clusterHashes[cluster];
+			}
 		}
-		cubeProbe.cubemap = cubemap;
 
-		tr.cubeProbes.push_back( cubeProbe );
+		uint64_t hash = CUBE_PROBE_HASH_SEED;
+		hash = R_HashBytes( hash, &version, sizeof( version ) );
+		hash = R_HashBytes( hash, &cubeMapSize, sizeof( cubeMapSize ) );
+		hash = R_HashBytes( hash, cubeProbe.origin, sizeof( cubeProbe.origin ) );
+		hash = R_HashBytes( hash, &visibleHash, sizeof( visibleHash ) );
+
+		probeHashes[i] = hash;
 	}
+}
 
-	for ( uint32_t i = 0; i < tr.cubeProbeGrid.size; i++ ) {
-		std::getline( gridStream, line, '\n' );
-		line.erase( std::remove( line.begin(), line.end(), '\r' ), line.end() );
-		tr.cubeProbeGrid( i ) = std::stoi( line );
+static std::string R_CubeProbeCacheName( const uint64_t hash ) {
+	return Str::Format( "%s/%s/%016x", cubeProbeCachePath, tr.world->baseName, hash );
+}
+
+static bool R_LoadCachedCubeProbe( cubemapProbe_t *cubeProbe, const uint64_t hash ) {
+	imageParams_t imageParams = {};
+	imageParams.bits = IF_HOMEPATH;
+	imageParams.filterType = filterType_t::FT_DEFAULT;
+	imageParams.wrapType = wrapTypeEnum_t::WT_EDGE_CLAMP;
+
+	image_t *cubemap = R_FindCubeImage( R_CubeProbeCacheName( hash ).c_str(), imageParams );
+
+	if ( !cubemap ) {
+		return false;
 	}
 
-	Log::Notice( "Loaded cubemap probe grid from %s", cubemapGridPath );
+	cubeProbe->cubemap = cubemap;
 
 	return true;
 }
 
-static bool R_SaveCubeMaps() {
-	const std::string dirPath = Str::Format( "%s/%s/", gridPath, tr.world->baseName );
+static void R_SaveCachedCubeProbe( const cubemapProbe_t *cubeProbe, const uint64_t hash ) {
+	const std::string imagePath = R_CubeProbeCacheName( hash ) + ".ktx";
+
+	SaveImageKTX( imagePath.c_str(), cubeProbe->cubemap );
+}
+
+// Deletes the cached cube probes of the map that aren't in probeHashes, e. g. baked before the map changed
+static void R_PruneCachedCubeProbes( const std::vector<uint64_t> &probeHashes ) {
+	const std::string cacheDir = FS::Path::Build( cubeProbeCachePath, tr.world->baseName );
+
+	std::unordered_set<std::string> current;
+	for ( const uint64_t hash : probeHashes ) {
+		current.insert( Str::Format( "%016x.ktx", hash ) );
+	}
 
 	std::error_code err;
-	std::string cubemapGridPath = Str::Format( "%s%s%s", dirPath, tr.world->baseName, gridExtension );
-	FS::File cubemapGridFile = FS::HomePath::OpenWrite( cubemapGridPath, err );
+	FS::HomePath::DirectoryRange files = FS::HomePath::ListFiles( cacheDir, err );
 	if ( err ) {
-		Log::Warn( "Failed to open cubemap grid file %s: %s", cubemapGridPath, err.message() );
-		return false;
+		return;
 	}
 
-	cubemapGridFile.Printf( "%u %s\n", REFLECTION_CUBEMAP_VERSION, headerString );
+	int pruned = 0;
+	for ( const std::string &file : files ) {
+		if ( !Str::IsSuffix( ".ktx", file ) || current.count( file ) ) {
+			continue;
+		}
 
-	cubemapGridFile.Printf( "%u %u\n", r_cubeProbeSize.Get(), tr.cubeProbeSpacing );
+		FS::HomePath::DeleteFile( FS::Path::Build( cacheDir, file ), err );
+		if ( err ) {
+			Log::Warn( "Failed to delete stale cube probe %s/%s: %s", cacheDir, file, err.message() );
+			continue;
+		}
 
-	cubemapGridFile.Printf( "%u %u %u %u\n", tr.cubeProbeGrid.width, tr.cubeProbeGrid.height, tr.cubeProbeGrid.depth, tr.cubeProbes.size() - 1 );
+		pruned++;
+	}
 
-	for ( uint32_t i = 1; i < tr.cubeProbes.size(); i++ ) {
-		cubemapGridFile.Printf( "%f %f %f\n", tr.cubeProbes[i].origin[0], tr.cubeProbes[i].origin[1], tr.cubeProbes[i].origin[2] );
+	if ( pruned ) {
+		Log::Debug( "Deleted %d stale cube probes from %s", pruned, cacheDir );
+	}
+}
+
+/*
+The k-d tree over the probes (without the default one) is stored implicitly in
+tr.cubeProbeTree: each range is split at its middle element along the axis of
+its depth, the lower half comes before it and the upper half after it.
+*/
+static void R_BuildCubeProbeTree( uint32_t *first, uint32_t *last, const int axis ) {
+	if ( last - first < 2 ) {
+		return;
+	}
+
+	uint32_t *middle = first + ( last - first ) / 2;
+
+	std::nth_element( first, middle, last,
+		[axis]( const uint32_t lhs, const uint32_t rhs ) {
+			return tr.cubeProbes[lhs].origin[axis] < tr.cubeProbes[rhs].origin[axis];
+		} );
+
+	R_BuildCubeProbeTree( first, middle, ( axis + 1 ) % 3 );
+	R_BuildCubeProbeTree( middle + 1, last, ( axis + 1 ) % 3 );
+}
 
-		std::string imagePath = Str::Format( "%s%u.ktx", dirPath, i - 1 );
+static const int MAX_CUBE_PROBE_CANDIDATES = 8;
+
+struct cubeProbeCandidates_t {
+	int count;
+	uint32_t probes[MAX_CUBE_PROBE_CANDIDATES]; // nearest first
+	float distances[MAX_CUBE_PROBE_CANDIDATES]; // squared
+};
+
+static void R_FindNearestCubeProbes( const vec3_t position, const uint32_t *first, const uint32_t *last, int axis,
+	cubeProbeCandidates_t &candidates ) {
+	while ( first < last ) {
+		const uint32_t *middle = first + ( last - first ) / 2;
+		const float *origin = tr.cubeProbes[*middle].origin;
+		const float distance = DistanceSquared( position, origin );
+
+		if ( candidates.count < MAX_CUBE_PROBE_CANDIDATES || distance < candidates.distances[MAX_CUBE_PROBE_CANDIDATES - 1] ) {
+			int i = std::min( candidates.count, MAX_CUBE_PROBE_CANDIDATES - 1 );
+
+			for ( ; i > 0 && candidates.distances[i - 1] > distance; i-- ) {
+				candidates.probes[i] = candidates.probes[i - 1];
+				candidates.distances[i] = candidates.distances[i - 1];
+			}
+
+			candidates.probes[i] = *middle;
+			candidates.distances[i] = distance;
+			candidates.count = std::min( candidates.count + 1, MAX_CUBE_PROBE_CANDIDATES );
+		}
+
+		const float split = position[axis] - origin[axis];
+		const int nextAxis = ( axis + 1 ) % 3;
+
+		if ( split < 0 ) {
+			R_FindNearestCubeProbes( position, first, middle, nextAxis, candidates );
+			first = middle + 1;
+		} else {
+			R_FindNearestCubeProbes( position, middle + 1, last, nextAxis, candidates );
+			last = middle;
+		}
 
-		SaveImageKTX( imagePath.c_str(), tr.cubeProbes[i].cubemap );
+		if ( candidates.count == MAX_CUBE_PROBE_CANDIDATES && split * split >= candidates.distances[MAX_CUBE_PROBE_CANDIDATES - 1] ) {
+			return;
+		}
+
+		axis = nextAxis;
 	}
+}
 
-	for ( uint32_t i = 0; i < tr.cubeProbeGrid.size; i++ ) {
-		cubemapGridFile.Printf( "%u\n", tr.cubeProbeGrid( i ) );
+/*
+================
+R_FindNearestCubeProbesInPVS
+
+Fills probes with up to count of the probes nearest to position, the ones in
+its PVS first. The others are only used if fillHidden is set. Returns the number
+of probes found.
+================
+*/
+static int R_FindNearestCubeProbesInPVS( const vec3_t position, uint32_t *probes, const int count, const bool fillHidden ) {
+	if ( tr.cubeProbeTree.empty() ) {
+		return 0;
 	}
 
-	cubemapGridFile.Flush( err );
-	if ( err ) {
-		Sys::Drop( "Failed to write cubemap probe grid: %s %s", cubemapGridPath, err.message() );
+	cubeProbeCandidates_t candidates;
+	candidates.count = 0;
+
+	R_FindNearestCubeProbes( position, tr.cubeProbeTree.data(), tr.cubeProbeTree.data() + tr.cubeProbeTree.size(), 0,
+		candidates );
+
+	const byte *vis = R_ClusterPVS( R_PointInLeaf( position )->cluster );
+	bool used[MAX_CUBE_PROBE_CANDIDATES]{};
+	int found = 0;
+
+	for ( int i = 0; i < candidates.count && found < count; i++ ) {
+		const int cluster = tr.cubeProbes[candidates.probes[i]].cluster;
+
+		if ( cluster < 0 || ( vis[cluster >> 3] & ( 1 << ( cluster & 7 ) ) ) ) {
+			probes[found++] = candidates.probes[i];
+			used[i] = true;
+		}
 	}
 
-	Log::Notice( "Saved cubemap probe grid %s", cubemapGridPath );
+	for ( int i = 0; fillHidden && i < candidates.count && found < count; i++ ) {
+		if ( !used[i] ) {
+			probes[found++] = candidates.probes[i];
+		}
+	}
 
-	return true;
+	return found;
+}
+
+/*
+The same entity is usually drawn with several reflective surfaces or stages in a
+frame, so the probes found for a position are kept until the frame ends.
+*/
+struct cubeProbeQuery_t {
+	vec3_t position;
+	int frameCount;
+	int samples;
+	int found;
+	uint32_t probes[4];
+};
+
+static const int CUBE_PROBE_QUERY_CACHE_SIZE = 64;
+static cubeProbeQuery_t cubeProbeQueryCache[CUBE_PROBE_QUERY_CACHE_SIZE];
+
+static void R_ClearCubeProbeQueryCache() {
+	for ( cubeProbeQuery_t &query : cubeProbeQueryCache ) {
+		query.frameCount = -1;
+	}
+}
+
+static int R_FindNearestCubeProbesCached( const vec3_t position, uint32_t *probes, const int samples ) {
+	uint32_t bits[3];
+	memcpy( bits, position, sizeof( bits ) );
+
+	const uint32_t slot = ( ( bits[0] * 73856093u ) ^ ( bits[1] * 19349663u ) ^ ( bits[2] * 83492791u ) )
+		% CUBE_PROBE_QUERY_CACHE_SIZE;
+	cubeProbeQuery_t &query = cubeProbeQueryCache[slot];
+
+	if ( query.frameCount != tr.frameCount || query.samples != samples || !VectorCompare( query.position, position ) ) {
+		query.found = R_FindNearestCubeProbesInPVS( position, query.probes, samples, true );
+		query.frameCount = tr.frameCount;
+		query.samples = samples;
+		VectorCopy( position, query.position );
+	}
+
+	std::copy_n( query.probes, query.found, probes );
+
+	return query.found;
 }
 
 void R_GetNearestCubeMaps( const vec3_t position, cubemapProbe_t** cubeProbes, vec4_t trilerp, const uint8_t samples,
@@ -4145,43 +4359,28 @@ void R_GetNearestCubeMaps( const vec3_t position, cubemapProbe_t** cubeProbes, v
 	ASSERT_GE( samples, 1 );
 	ASSERT_LE( samples, 4 );
 
-	vec3_t pos;
-	VectorCopy( position, pos );
-	VectorSubtract( pos, tr.world->nodes[0].mins, pos );
-	VectorScale( pos, 1.0 / tr.cubeProbeSpacing, pos );
-
-	struct ProbeTrilerp {
-		vec3_t gridPoint;
-		uint32_t probe;
-		float distance;
-	};
-
-	ProbeTrilerp probes[8];
+	uint32_t probes[4]{};
+	const int found = R_FindNearestCubeProbesCached( position, probes, samples );
 
-	uint32_t gridPosition[3]{ ( uint32_t ) pos[0], ( uint32_t ) pos[1], ( uint32_t ) pos[2] };
-	static uint32_t offsets[8][3] = { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 1 }, { 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, 0 }, { 1, 1, 1 } };
-	for ( int i = 0; i < 8; i++ ) {
-		probes[i].probe = tr.cubeProbeGrid( gridPosition[0] + offsets[i][0], gridPosition[1] + offsets[i][1], gridPosition[2] + offsets[i][2] );
-		VectorSet( probes[i].gridPoint, gridPosition[0] + offsets[i][0], gridPosition[1] + offsets[i][1], gridPosition[2] + offsets[i][2] );
-		probes[i].distance = Distance( pos, probes[i].gridPoint );
+	// There may be fewer probes than samples
+	for ( int i = std::max( found, 1 ); i < samples; i++ ) {
+		probes[i] = probes[found ? found - 1 : 0];
 	}
 
-	std::sort( std::begin( probes ), std::end( probes ),
-		[]( const ProbeTrilerp& lhs, const ProbeTrilerp& rhs ) {
-			return lhs.distance < rhs.distance;
-		} );
-
 	float distanceSum = 0;
 	for ( uint8_t i = 0; i < samples; i++ ) {
-		distanceSum += Distance( position, tr.cubeProbes[probes[i].probe].origin );
+		distanceSum += Distance( position, tr.cubeProbes[probes[i]].origin );
 	}
 
 	for ( uint8_t i = 0; i < samples; i++ ) {
-		cubeProbes[i] = &tr.cubeProbes[probes[i].probe];
-		trilerp[i] = Distance( position, cubeProbes[i]->origin ) / distanceSum;
+		cubeProbes[i] = &tr.cubeProbes[probes[i]];
+		trilerp[i] = distanceSum > 0 ? Distance( position, cubeProbes[i]->origin ) / distanceSum : 1.0f / samples;
 
 		if ( gridPoints != nullptr ) {
-			VectorCopy( probes[i].gridPoint, gridPoints[i] );
+			// The grid cell the probe is in
+			VectorSubtract( cubeProbes[i]->origin, tr.world->nodes[0].mins, gridPoints[i] );
+			VectorScale( gridPoints[i], 1.0 / tr.cubeProbeSpacing, gridPoints[i] );
+			SnapVector( gridPoints[i] );
 		}
 	}
 }
@@ -4220,44 +4419,110 @@ static bool R_NodeSuitableForCubeMap( const bspNode_t* node ) {
 	return true;
 }
 
-static std::unordered_map<const bspNode_t*, uint32_t> cubeProbeMap;
-int R_FindNearestCubeMapForGrid( const vec3_t position, bspNode_t* node ) {
-	// check to see if this is a shit location
-	if ( node->contents == CONTENTS_NODE ) {
-		const float distance = DotProduct( position, node->plane->normal ) - node->plane->dist;
+/*
+================
+R_PlaceCubeProbes
 
-		uint32_t side = distance <= 0;
+Puts a probe in the middle of every leaf with visible surfaces, unless one is
+already within tr.cubeProbeSpacing. Leafs are checked in parallel, then picked
+in order with a hash of probe cells so that the result doesn't depend on it.
+================
+*/
+static void R_PlaceCubeProbes() {
+	const int numNodes = tr.world->numnodes;
+	std::vector<char> suitable( numNodes );
 
-		int out = R_FindNearestCubeMapForGrid( position, node->children[side] );
-		if ( out == -1 ) {
-			return R_FindNearestCubeMapForGrid( position, node->children[side ^ 1] );
-		}
+	#pragma omp parallel for schedule( dynamic, 256 )
+	for ( int i = 0; i < numNodes; i++ ) {
+		const bspNode_t* node = &tr.world->nodes[i];
 
-		return out;
+		// check to see if this is a shit location
+		suitable[i] = node->contents != CONTENTS_NODE && R_NodeSuitableForCubeMap( node );
 	}
 
-	if ( !R_NodeSuitableForCubeMap( node ) ) {
-		return -1;
-	}
+	const float spacing = tr.cubeProbeSpacing;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
 
-	std::unordered_map<const bspNode_t*, uint32_t>::iterator it = cubeProbeMap.find( node );
-	if ( it == cubeProbeMap.end() ) {
-		return -1;
-	}
+	auto cellKey = []( const int x, const int y, const int z ) {
+		return ( uint64_t( uint32_t( x ) & 0x1fffff ) << 42 ) | ( uint64_t( uint32_t( y ) & 0x1fffff ) << 21 )
+			| uint64_t( uint32_t( z ) & 0x1fffff );
+	};
 
-	vec3_t origin;
-	VectorCopy( node->mins, origin );
-	VectorAdd( origin, node->maxs, origin );
-	VectorScale( origin, 0.5, origin );
+	for ( int i = 0; i < numNodes; i++ ) {
+		if ( !suitable[i] ) {
+			continue;
+		}
+
+		const bspNode_t* node = &tr.world->nodes[i];
+
+		vec3_t origin;
+		VectorAdd( node->maxs, node->mins, origin );
+		VectorScale( origin, 0.5, origin );
+
+		const int cell[3] = { int( floorf( origin[0] / spacing ) ), int( floorf( origin[1] / spacing ) ),
+			int( floorf( origin[2] / spacing ) ) };
+
+		// Don't spam probes where there's a lot of leafs
+		// TODO: Find a better way to determine where to place probes
+		bool tooClose = false;
+
+		for ( int x = cell[0] - 1; x <= cell[0] + 1 && !tooClose; x++ ) {
+			for ( int y = cell[1] - 1; y <= cell[1] + 1 && !tooClose; y++ ) {
+				for ( int z = cell[2] - 1; z <= cell[2] + 1 && !tooClose; z++ ) {
+					auto it = cells.find( cellKey( x, y, z ) );
+
+					if ( it == cells.end() ) {
+						continue;
+					}
+
+					for ( const uint32_t probe : it->second ) {
+						if ( Distance( origin, tr.cubeProbes[probe].origin ) <= spacing ) {
+							tooClose = true;
+							break;
+						}
+					}
+				}
+			}
+		}
 
-	const byte* vis = R_ClusterPVS( node->cluster );
-	const bspNode_t* node2 = R_PointInLeaf( origin );
+		if ( tooClose ) {
+			continue;
+		}
+
+		cubemapProbe_t cubeProbe {};
+		VectorCopy( origin, cubeProbe.origin );
+		cubeProbe.cluster = node->cluster;
+		tr.cubeProbes.push_back( cubeProbe );
 
-	if ( !( vis[node->cluster >> 3] & ( 1 << ( node2->cluster & 7 ) ) ) ) {
-		return -1;
+		cells[cellKey( cell[0], cell[1], cell[2] )].push_back( tr.cubeProbes.size() - 1 );
 	}
 
-	return it->second;
+	tr.cubeProbeTree.resize( tr.cubeProbes.size() - 1 );
+	std::iota( tr.cubeProbeTree.begin(), tr.cubeProbeTree.end(), 1 );
+	R_BuildCubeProbeTree( tr.cubeProbeTree.data(), tr.cubeProbeTree.data() + tr.cubeProbeTree.size(), 0 );
+
+	Log::Notice( "Using cube probe grid size: %u %u %u", tr.cubeProbeGrid.width, tr.cubeProbeGrid.height, tr.cubeProbeGrid.depth );
+
+	const uint32_t width = tr.cubeProbeGrid.width;
+	const uint32_t height = tr.cubeProbeGrid.height;
+
+	#pragma omp parallel for schedule( dynamic, 256 )
+	for ( uint32_t i = 0; i < tr.cubeProbeGrid.size; i++ ) {
+		const uint32_t x = i % width;
+		const uint32_t y = ( i / width ) % height;
+		const uint32_t z = i / ( width * height );
+
+		vec3_t position{ ( float ) x * tr.cubeProbeSpacing, ( float ) y * tr.cubeProbeSpacing, ( float ) z * tr.cubeProbeSpacing };
+
+		// Match the map's start coords
+		VectorAdd( position, tr.world->nodes[0].mins, position );
+
+		// The default probe if none of the nearest ones is in the PVS
+		uint32_t cubeProbe = 0;
+		R_FindNearestCubeProbesInPVS( position, &cubeProbe, 1, false );
+
+		tr.cubeProbeGrid( i ) = cubeProbe;
+	}
 }
 
 void R_BuildCubeMaps()
@@ -4281,24 +4546,47 @@ void R_BuildCubeMaps()
 		return;
 	}
 
+	const int startTime = ri.Milliseconds();
+
 	// calculate origins for our probes
 	tr.cubeProbes.clear();
-	cubeProbeMap.clear();
+	tr.cubeProbeTree.clear();
+	R_ClearCubeProbeQueryCache();
 
 	cubemapProbe_t defaultCubeProbe{};
 	VectorClear( defaultCubeProbe.origin );
+	defaultCubeProbe.cluster = R_PointInLeaf( defaultCubeProbe.origin )->cluster;
 
 	defaultCubeProbe.cubemap = tr.whiteCubeImage;
 
 	tr.cubeProbes.push_back( defaultCubeProbe );
 
-	if ( r_autoBuildCubeMaps.Get() == Util::ordinal( cubeProbesAutoBuildMode::CACHED ) && R_LoadCubeMaps() ) {
+	R_PlaceCubeProbes();
+
+	const bool cached = r_autoBuildCubeMaps.Get() == Util::ordinal( cubeProbesAutoBuildMode::CACHED );
+	std::vector<uint64_t> probeHashes;
+	std::vector<bool> baked( tr.cubeProbes.size(), true );
+	size_t numBaked = tr.cubeProbes.size();
+
+	if ( cached ) {
+		R_HashCubeProbes( probeHashes );
+
+		for ( size_t i = 0; i < tr.cubeProbes.size(); i++ ) {
+			if ( R_LoadCachedCubeProbe( &tr.cubeProbes[i], probeHashes[i] ) ) {
+				baked[i] = false;
+				numBaked--;
+			}
+		}
+
+		Log::Notice( "Loaded %d cached cube probes from %s/%s", tr.cubeProbes.size() - numBaked,
+			cubeProbeCachePath, tr.world->baseName );
+	}
+
+	if ( !numBaked ) {
 		glConfig.reflectionMapping = true;
 		return;
 	}
 
-	const int startTime = ri.Milliseconds();
-
 	// TODO: Use highest available settings here
 
 	refdef_t rf{};
@@ -4307,66 +4595,7 @@ void R_BuildCubeMaps()
 	{
 		tr.cubeTemp[ i ] = (byte*) Z_Malloc( ( size_t ) cubeMapSize * cubeMapSize * 4 );
 	}
-
-	for ( int i = 0; i < tr.world->numnodes; i++ )
-	{
-		const bspNode_t* node = &tr.world->nodes[ i ];
-
-		// check to see if this is a shit location
-		if ( node->contents == CONTENTS_NODE )
-		{
-			continue;
-		}
-
-		if ( !R_NodeSuitableForCubeMap( node ) ) {
-			continue;
-		}
-
-		vec3_t origin;
-		VectorAdd( node->maxs, node->mins, origin );
-		VectorScale( origin, 0.5, origin );
-
-		// Don't spam probes where there's a lot of leafs
-		// TODO: Find a better way to determine where to place probes
-		if ( std::find_if( cubeProbeMap.begin(), cubeProbeMap.end(),
-			[&origin]( const std::unordered_map<const bspNode_t*, uint32_t>::value_type& nodeCheck ) {
-				vec3_t nodeOrigin;
-				VectorAdd( nodeCheck.first->mins, nodeCheck.first->maxs, nodeOrigin );
-				VectorScale( nodeOrigin, 0.5, nodeOrigin );
-
-				return Distance( origin, nodeOrigin ) <= tr.cubeProbeSpacing;
-			} ) != cubeProbeMap.end() ) {
-			continue;
-		}
-
-		cubemapProbe_t cubeProbe {};
-		VectorCopy( origin, cubeProbe.origin );
-		tr.cubeProbes.push_back( cubeProbe );
-
-		cubeProbeMap[node] = tr.cubeProbes.size() - 1;
-	}
-
-	Log::Notice( "Using cube probe grid size: %u %u %u", tr.cubeProbeGrid.width, tr.cubeProbeGrid.height, tr.cubeProbeGrid.depth );
-
-	for( Grid<uint32_t>::Iterator it = tr.cubeProbeGrid.begin(); it != tr.cubeProbeGrid.end(); it++ ) {
-		uint32_t x;
-		uint32_t y;
-		uint32_t z;
-		tr.cubeProbeGrid.IteratorToCoords( it, &x, &y, &z );
-		vec3_t position{ ( float ) x * tr.cubeProbeSpacing, ( float ) y * tr.cubeProbeSpacing, ( float ) z * tr.cubeProbeSpacing };
-
-		// Match the map's start coords
-		VectorAdd( position, tr.world->nodes[0].mins, position );
-
-		int cubeProbe = R_FindNearestCubeMapForGrid( position, &tr.world->nodes[0] );
-
-		if ( cubeProbe == -1 ) {
-			cubeProbe = 0;
-		}
-		tr.cubeProbeGrid( x, y, z ) = cubeProbe;
-	}
-
-	Log::Notice( "...pre-rendering %d cubemaps", tr.cubeProbes.size() );
+	Log::Notice( "...pre-rendering %d cubemaps", numBaked );
 
 	const bool gpuOcclusionCulling = r_gpuOcclusionCulling.Get();
 	r_gpuOcclusionCulling.Set( false );
@@ -4377,6 +4606,10 @@ void R_BuildCubeMaps()
 
 	for ( size_t i = 0; i < tr.cubeProbes.size(); i++ )
 	{
+		if ( !baked[i] ) {
+			continue;
+		}
+
 		cubemapProbe_t* cubeProbe = &tr.cubeProbes[i];
 
 		VectorCopy( cubeProbe->origin, rf.vieworg );
@@ -4570,6 +4803,14 @@ void R_BuildCubeMaps()
 		imageParams_t imageParams = {};
 
 		R_UploadImage( name.c_str(), ( const byte ** ) tr.cubeTemp, 6, 1, cubeProbe->cubemap, imageParams );
+
+		if ( cached ) {
+			R_SaveCachedCubeProbe( cubeProbe, probeHashes[i] );
+		}
+	}
+
+	if ( cached ) {
+		R_PruneCachedCubeProbes( probeHashes );
 	}
 
 	r_gpuOcclusionCulling.Set( gpuOcclusionCulling );
@@ -4582,12 +4823,8 @@ void R_BuildCubeMaps()
 	glConfig.reflectionMapping = true;
 
 	const int endTime = ri.Milliseconds();
-	Log::Notice( "Cubemap probes pre-rendering time of %d cubes = %5.2f seconds", tr.cubeProbes.size(),
+	Log::Notice( "Cubemap probes pre-rendering time of %d cubes = %5.2f seconds", numBaked,
 	           ( endTime - startTime ) / 1000.0 );
-
-	if ( r_autoBuildCubeMaps.Get() == Util::ordinal( cubeProbesAutoBuildMode::CACHED ) ) {
-		R_SaveCubeMaps();
-	}
 }
 
 static Cmd::LambdaCmd buildCubeMapsCmd(
@@ -4808,12 +5045,6 @@ void RE_LoadWorldMap( const char *name )
 		( ( int * ) header ) [ j ] = LittleLong( ( ( int * ) header ) [ j ] );
 	}
 
-	if ( glConfig.reflectionMappingAvailable ) {
-		// TODO: Take into account potential shader changes
-		headerString = Str::Format( "%i %i %i %i %i", header->lumps[LUMP_PLANES].filelen, header->lumps[LUMP_NODES].filelen,
-			header->lumps[LUMP_LEAFS].filelen, header->lumps[LUMP_BRUSHES].filelen, header->lumps[LUMP_SURFACES].filelen );
-	}
-
 	// load into heap
 
 	std::string externalEntitiesFileName = FS::Path::StripExtension( name ) + ".ent";
@@ -4878,6 +5109,8 @@ void RE_LoadWorldMap( const char *name )
 	// only set tr.world now that we know the entire level has loaded properly
 	tr.world = &s_worldData;
 
+	R_BuildMarkTriangles();
+
 	tr.worldLoaded = true;
 	tr.loadingMap = "";
 	GLSL_InitWorldShaders();
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // tr_cmds.c
 #include "tr_local.h"
 #include "GLUtils.h"
+#include "GLMemory.h"
 
 volatile bool            renderThreadActive;
 
@@ -38,6 +39,7 @@ void R_PerformanceCounters()
 		// clear the counters even if we aren't printing
 		tr.pc = {};
 		backEnd.pc = {};
+		GLBufferClearStallCounters();
 		return;
 	}
 
@@ -78,9 +80,18 @@ void R_PerformanceCounters()
 	{
 		Log::Notice("zNear: %.0f zFar: %.0f", tr.viewParms.zNear, tr.viewParms.zFar );
 	}
+	else if ( r_speeds->integer == Util::ordinal(renderSpeeds_t::RSPEEDS_FRAME_ARENA ))
+	{
+		R_FrameArenaCounters();
+	}
+	else if ( r_speeds->integer == Util::ordinal(renderSpeeds_t::RSPEEDS_BUFFER_STALLS ))
+	{
+		GLBufferStallCounters();
+	}
 
 	tr.pc = {};
 	backEnd.pc = {};
+	GLBufferClearStallCounters();
 }
 
 /*
@@ -567,8 +578,9 @@ void RE_2DPolyies( polyVert_t *verts, int numverts, qhandle_t hShader )
 {
 	Poly2dCommand *cmd;
 
-	if ( r_numPolyVerts + numverts > r_maxPolyVerts->integer )
+	if ( r_numPolyVerts + numverts > backEndData[ tr.smpFrame ]->scratchSize.polyVerts )
 	{
+		tr.frameScratchDropped.polyVerts += numverts;
 		return;
 	}
 
@@ -590,14 +602,13 @@ void RE_2DPolyies( polyVert_t *verts, int numverts, qhandle_t hShader )
 void RE_2DPolyiesIndexed( polyVert_t *verts, int numverts, int *indexes, int numindexes, int trans_x, int trans_y, qhandle_t hShader )
 {
 	Poly2dIndexedCommand *cmd;
+	const frameScratch_t &scratchSize = backEndData[ tr.smpFrame ]->scratchSize;
 
-	if ( r_numPolyVerts + numverts > r_maxPolyVerts->integer )
-	{
-		return;
-	}
-
-	if ( r_numPolyIndexes + numindexes > r_maxPolyVerts->integer )
+	if ( r_numPolyVerts + numverts > scratchSize.polyVerts
+		|| r_numPolyIndexes + numindexes > scratchSize.polyIndexes )
 	{
+		tr.frameScratchDropped.polyVerts += numverts;
+		tr.frameScratchDropped.polyIndexes += numindexes;
 		return;
 	}
 
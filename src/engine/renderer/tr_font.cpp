@@ -41,212 +41,26 @@ Maryland 20850 USA.
 
 #include "DaemonEmbeddedFiles/ConsoleFont.h"
 
-#include <ft2build.h>
-#include FT_FREETYPE_H
-#include FT_ERRORS_H
-#include FT_SYSTEM_H
-#include FT_IMAGE_H
-#include FT_OUTLINE_H
-
-#define _FLOOR( x ) ( ( x ) & - 64 )
-#define _CEIL( x )  ( ( ( x ) + 63 ) & - 64 )
-#define _TRUNC( x ) ( ( x ) >> 6 )
+#include "FontAtlas.h"
 
 using glyphBlock_t = glyphInfo_t[256];
 
 FT_Library ftLibrary = nullptr;
 
-static const int FONT_SIZE = 512;
-
-void RE_RenderChunk( fontInfo_t *font, const int chunk );
-
-
-void R_GetGlyphInfo( FT_GlyphSlot glyph, int *left, int *right, int *width, int *top, int *bottom, int *height, int *pitch )
-{
-	// ±1 adjustments for border-related reasons - really want clamp to transparent border (FIXME)
-
-	*left = _FLOOR( glyph->metrics.horiBearingX - 1);
-	*right = _CEIL( glyph->metrics.horiBearingX + glyph->metrics.width + 1);
-	*width = _TRUNC( *right - *left );
-
-	*top = _CEIL( glyph->metrics.horiBearingY + 1);
-	*bottom = _FLOOR( glyph->metrics.horiBearingY - glyph->metrics.height - 1);
-	*height = _TRUNC( *top - *bottom );
-	*pitch = ( *width + 3 ) & - 4;
-}
-
-FT_Bitmap      *R_RenderGlyph( FT_GlyphSlot glyph, glyphInfo_t *glyphOut )
-{
-	FT_Bitmap *bit2;
-	int       left, right, width, top, bottom, height, pitch, size;
-
-	R_GetGlyphInfo( glyph, &left, &right, &width, &top, &bottom, &height, &pitch );
-
-	if ( glyph->format == ft_glyph_format_outline )
-	{
-		size = pitch * height;
-
-		bit2 = (FT_Bitmap*) Z_Malloc( sizeof( FT_Bitmap ) );
-
-		bit2->width = width;
-		bit2->rows = height;
-		bit2->pitch = pitch;
-		bit2->pixel_mode = ft_pixel_mode_grays;
-		bit2->buffer = (unsigned char*) Z_Calloc( size );
-		bit2->num_grays = 256;
-
-		FT_Outline_Translate( &glyph->outline, -left, -bottom );
-
-		FT_Outline_Get_Bitmap( ftLibrary, &glyph->outline, bit2 );
+static Cvar::Cvar<bool> r_fontCache(
+	"r_fontCache", "cache rasterised glyph pages in the homepath", Cvar::NONE, true );
+static Cvar::Cvar<bool> r_fontWorker(
+	"r_fontWorker", "rasterise missing glyph chunks on a background thread", Cvar::NONE, true );
 
-		glyphOut->height = height;
-		glyphOut->pitch = pitch;
-		glyphOut->top = ( glyph->metrics.horiBearingY >> 6 ) + 1;
-		glyphOut->bottom = bottom;
+static FontAtlas::Worker fontWorker;
 
-		return bit2;
-	}
-	else
-	{
-		Log::Warn("Non-outline fonts are not supported" );
-	}
-
-	return nullptr;
-}
-
-static glyphInfo_t *RE_ConstructGlyphInfo( unsigned char *imageOut, int *xOut, int *yOut,
-    int *maxHeight, FT_Face face, const int c, bool calcHeight )
-{
-	int                i;
-	static glyphInfo_t glyph;
-	unsigned char      *src, *dst;
-	float              scaledWidth, scaledHeight;
-	FT_Bitmap          *bitmap = nullptr;
-
-	glyph = {};
-
-	// make sure everything is here
-	if ( face != nullptr )
-	{
-		FT_UInt index = FT_Get_Char_Index( face, c );
-
-		if ( index == 0 )
-		{
-			return nullptr; // nothing to render
-		}
-
-		FT_Load_Glyph( face, index, FT_LOAD_DEFAULT );
-		bitmap = R_RenderGlyph( face->glyph, &glyph );
-
-		if ( bitmap )
-		{
-			glyph.xSkip = ( face->glyph->metrics.horiAdvance >> 6 ) + 1;
-		}
-		else
-		{
-			return nullptr;
-		}
-
-		if ( glyph.height > *maxHeight )
-		{
-			*maxHeight = glyph.height;
-		}
-
-		if ( calcHeight )
-		{
-			Z_Free( bitmap->buffer );
-			Z_Free( bitmap );
-			return &glyph;
-		}
-
-		scaledWidth = glyph.pitch;
-		scaledHeight = glyph.height;
-
-		// we need to make sure we fit
-		if ( *xOut + scaledWidth + 1 >= ( FONT_SIZE - 1 ) )
-		{
-			*xOut = 0;
-			*yOut += *maxHeight + 1;
-		}
-
-		if ( *yOut + *maxHeight + 1 >= ( FONT_SIZE - 1 ) )
-		{
-			*xOut = -1;
-			Z_Free( bitmap->buffer );
-			Z_Free( bitmap );
-			return nullptr;
-		}
-
-		src = bitmap->buffer;
-		dst = imageOut + ( *yOut * FONT_SIZE ) + *xOut;
-
-		if ( bitmap->pixel_mode == ft_pixel_mode_mono )
-		{
-			for ( i = 0; i < glyph.height; i++ )
-			{
-				int           j;
-				unsigned char *_src = src;
-				unsigned char *_dst = dst;
-				unsigned char mask = 0x80;
-				unsigned char val = *_src;
-
-				for ( j = 0; j < glyph.pitch; j++ )
-				{
-					if ( mask == 0x80 )
-					{
-						val = *_src++;
-					}
-
-					if ( val & mask )
-					{
-						*_dst = 0xff;
-					}
-
-					mask >>= 1;
-
-					if ( mask == 0 )
-					{
-						mask = 0x80;
-					}
-
-					_dst++;
-				}
-
-				src += glyph.pitch;
-				dst += FONT_SIZE;
-			}
-		}
-		else
-		{
-			for ( i = 0; i < glyph.height; i++ )
-			{
-				memcpy( dst, src, glyph.pitch );
-				src += glyph.pitch;
-				dst += FONT_SIZE;
-			}
-		}
-
-		// we now have an 8 bit per pixel grey scale bitmap
-		// that is width wide and pf->ftSize->metrics.y_ppem tall
-
-		glyph.imageHeight = scaledHeight;
-		glyph.imageWidth = scaledWidth;
-		glyph.s = ( float ) * xOut / FONT_SIZE;
-		glyph.t = ( float ) * yOut / FONT_SIZE;
-		glyph.s2 = glyph.s + ( float ) scaledWidth / FONT_SIZE;
-		glyph.t2 = glyph.t + ( float ) scaledHeight / FONT_SIZE;
-		glyph.shaderName[0] = 1; // flag that we have a glyph here
-
-		*xOut += scaledWidth + 1;
-
-		Z_Free( bitmap->buffer );
-		Z_Free( bitmap );
-
-		return &glyph;
-	}
+// chunks without any glyph, and chunks being rasterised by the worker
+static glyphBlock_t nullGlyphs;
+static glyphBlock_t pendingGlyphs;
 
-	return nullptr;
-}
+static void RE_UploadChunk( fontInfo_t *font, int chunk, const FontAtlas::chunk_t &glyphs );
+static void RE_CollectChunks( fontInfo_t *font );
+static void RE_RenderChunk( fontInfo_t *font, const int chunk, bool background );
 
 void RE_GlyphChar( fontInfo_t *font, int ch, glyphInfo_t *glyph )
 {
@@ -259,10 +73,16 @@ void RE_GlyphChar( fontInfo_t *font, int ch, glyphInfo_t *glyph )
 	// render if needed
 	if ( !font->glyphBlock[ ch / 256 ] )
 	{
-		RE_RenderChunk( font, ch / 256 );
+		RE_RenderChunk( font, ch / 256, r_fontWorker.Get() );
+	}
+
+	// pick up the chunks the worker is done with
+	if ( font->glyphBlock[ ch / 256 ] == pendingGlyphs )
+	{
+		RE_CollectChunks( font );
 	}
 
-	// default if no glyph
+	// default if no glyph, or not rendered yet
 	if ( !font->glyphBlock[ ch / 256 ][ ch % 256 ].glyph )
 	{
 		ch = 0;
@@ -272,13 +92,10 @@ void RE_GlyphChar( fontInfo_t *font, int ch, glyphInfo_t *glyph )
 	*glyph = font->glyphBlock[ ch / 256][ ch % 256 ];
 }
 
-static void RE_StoreImage( fontInfo_t *font, int chunk, int page, int from, int to, const unsigned char *bitmap, int yEnd )
+static void RE_StoreImage( fontInfo_t *font, int chunk, int page, const FontAtlas::page_t &atlasPage )
 {
-	int           scaledSize = FONT_SIZE * FONT_SIZE;
-	int           i, j, y;
-	float         max;
-
-	glyphInfo_t   *glyphs = font->glyphBlock[chunk];
+	int           scaledSize = FontAtlas::PAGE_SIZE * atlasPage.height;
+	int           i, j;
 
 	unsigned char *buffer;
 	image_t       *image;
@@ -289,51 +106,24 @@ static void RE_StoreImage( fontInfo_t *font, int chunk, int page, int from, int
 	// about to render an image
 	R_SyncRenderThread();
 
-	// maybe crop image while retaining power-of-2 height
-	i = 1;
-	y = FONT_SIZE;
-
-	// How much to reduce it?
-	while ( yEnd < y / 2 - 1 ) { i += i; y /= 2; }
-
-	// Fix up the glyphs' Y co-ordinates
-	for ( j = from; j < to; j++ ) { glyphs[j].t *= i; glyphs[j].t2 *= i; }
-
-	scaledSize /= i;
-
-	max = 0;
-
-	for ( i = 0; i < scaledSize; i++ )
-	{
-		if ( max < bitmap[ i ] )
-		{
-			max = bitmap[ i ];
-		}
-	}
-
-	if ( max > 0 )
-	{
-		max = 255 / max;
-	}
-
 	buffer = ( unsigned char * ) Z_AllocUninit( scaledSize * 4 );
 	for ( i = j = 0; i < scaledSize; i++ )
 	{
 		buffer[ j++ ] = 255;
 		buffer[ j++ ] = 255;
 		buffer[ j++ ] = 255;
-		buffer[ j++ ] = ( ( float ) bitmap[ i ] * max );
+		buffer[ j++ ] = atlasPage.alpha[ i ];
 	}
 
 	Com_sprintf( fileName, sizeof( fileName ), "*%s_%i_%i_%i", font->name, chunk, page, font->pointSize );
 
-	image = R_CreateGlyph( fileName, buffer, FONT_SIZE, y );
+	image = R_CreateGlyph( fileName, buffer, FontAtlas::PAGE_SIZE, atlasPage.height );
 
 	Z_Free( buffer );
 
 	h = RE_RegisterShaderFromImage( fileName, image );
 
-	for ( j = from; j < to; j++ )
+	for ( j = atlasPage.from; j < atlasPage.to; j++ )
 	{
 		if ( font->glyphBlock[ chunk ][ j ].shaderName[0] ) // non-0 if we have a glyph here
 		{
@@ -343,78 +133,121 @@ static void RE_StoreImage( fontInfo_t *font, int chunk, int page, int from, int
 	}
 }
 
-static glyphBlock_t nullGlyphs;
-
-void RE_RenderChunk( fontInfo_t *font, const int chunk )
+static void RE_UploadChunk( fontInfo_t *font, int chunk, const FontAtlas::chunk_t &glyphs )
 {
-	int           xOut, yOut, maxHeight;
-	int           i, lastStart, page;
-	unsigned char *out;
-	glyphInfo_t   *glyphs;
-	bool      rendered;
+	// no glyphs? just mark the chunk
+	if ( glyphs.pages.empty() )
+	{
+		font->glyphBlock[ chunk ] = nullGlyphs;
+		return;
+	}
 
-	const int     startGlyph = chunk * 256;
+	font->glyphBlock[ chunk ] = (glyphInfo_t*) Z_Calloc( sizeof( glyphBlock_t ) );
+	memcpy( font->glyphBlock[ chunk ], glyphs.glyphs, sizeof( glyphBlock_t ) );
 
-	// sanity check
-	if ( chunk < 0 || chunk >= 0x1100 || font->glyphBlock[ chunk ] )
+	for ( size_t page = 0; page < glyphs.pages.size(); page++ )
 	{
-		return;
+		RE_StoreImage( font, chunk, page, glyphs.pages[ page ] );
 	}
+}
 
-	out = (unsigned char*) Z_Calloc( FONT_SIZE * FONT_SIZE );
+static FontAtlas::cacheKey_t RE_FontCacheKey( const fontInfo_t *font, int chunk )
+{
+	return { font->checkSum, uint32_t( font->faceSize ), font->pointSize, chunk };
+}
 
-	// calculate max height
-	maxHeight = 0;
-	rendered = false;
+static bool RE_LoadChunkCache( fontInfo_t *font, int chunk )
+{
+	std::error_code err;
+	const FontAtlas::cacheKey_t key = RE_FontCacheKey( font, chunk );
 
-	for ( i = 0; i < 256; i++ )
+	FS::File cacheFile = FS::HomePath::OpenRead( FontAtlas::CachePath( key ), err );
+	if ( err )
 	{
-		rendered |= !!RE_ConstructGlyphInfo( out, &xOut, &yOut, &maxHeight, (FT_Face) font->face, ( i + startGlyph ) ? ( i + startGlyph ) : 0xFFFD, true );
+		return false;
 	}
 
-	// no glyphs? just return
-	if ( !rendered )
+	const std::string cacheData = cacheFile.ReadAll( err );
+	if ( err )
 	{
-		Z_Free( out );
-		font->glyphBlock[ chunk ] = nullGlyphs;
-		return;
+		return false;
 	}
 
-	glyphs = font->glyphBlock[ chunk ] = (glyphInfo_t*) Z_Calloc( sizeof( glyphBlock_t ) );
+	FontAtlas::chunk_t glyphs;
+	if ( !FontAtlas::DeserializeChunk( cacheData, key, glyphs ) )
+	{
+		return false;
+	}
 
-	xOut = yOut = 0;
-	rendered = false;
-	i = lastStart = page = 0;
+	RE_UploadChunk( font, chunk, glyphs );
+	return true;
+}
 
-	while ( i < 256 )
-	{
-		glyphInfo_t *glyph = RE_ConstructGlyphInfo( out, &xOut, &yOut, &maxHeight, (FT_Face) font->face, ( i + startGlyph ) ? ( i + startGlyph ) : 0xFFFD, false );
+static void RE_SaveChunkCache( const fontInfo_t *font, int chunk, const FontAtlas::chunk_t &glyphs )
+{
+	const FontAtlas::cacheKey_t key = RE_FontCacheKey( font, chunk );
+	const std::string cacheData = FontAtlas::SerializeChunk( glyphs, key );
 
-		if ( glyph )
-		{
-			rendered = true;
-			glyphs[ i ] = *glyph;
-		}
+	ri.FS_WriteFile( FontAtlas::CachePath( key ).c_str(), cacheData.data(), cacheData.size() );
+}
+
+static void RE_CollectChunks( fontInfo_t *font )
+{
+	std::vector<FontAtlas::Worker::job_t> jobs;
+	fontWorker.Collect( font, jobs );
 
-		if ( xOut == -1 )
+	for ( const FontAtlas::Worker::job_t &job : jobs )
+	{
+		if ( job.failed )
 		{
-			RE_StoreImage( font, chunk, page++, lastStart, i, out, yOut + maxHeight + 1 );
-			memset( out, 0, FONT_SIZE * FONT_SIZE );
-			xOut = yOut = 0;
-			rendered = false;
-			lastStart = i;
+			Log::Warn( "RE_CollectChunks: unable to rasterise chunk %d of font %s", job.chunk, font->name );
+			font->glyphBlock[ job.chunk ] = nullGlyphs;
+			continue;
 		}
-		else
+
+		RE_UploadChunk( font, job.chunk, job.result );
+
+		if ( r_fontCache.Get() )
 		{
-			i++;
+			RE_SaveChunkCache( font, job.chunk, job.result );
 		}
 	}
+}
+
+/*
+Chunks are loaded from the cache if they were rasterised before. Otherwise they are
+rasterised synchronously, or by the worker if background is set, in which case the
+chunk uses the default glyph until RE_GlyphChar picks up the result.
+*/
+static void RE_RenderChunk( fontInfo_t *font, const int chunk, bool background )
+{
+	// sanity check
+	if ( chunk < 0 || chunk >= 0x1100 || font->glyphBlock[ chunk ] )
+	{
+		return;
+	}
+
+	if ( r_fontCache.Get() && RE_LoadChunkCache( font, chunk ) )
+	{
+		return;
+	}
 
-	if ( rendered )
+	if ( background )
 	{
-		RE_StoreImage( font, chunk, page, lastStart, 256, out, yOut + maxHeight + 1 );
+		font->glyphBlock[ chunk ] = pendingGlyphs;
+		fontWorker.Submit( font, font->faceData, font->faceSize, font->pointSize, chunk );
+		return;
+	}
+
+	FontAtlas::chunk_t glyphs;
+	FontAtlas::RasterizeChunk( (FT_Face) font->face, chunk, glyphs );
+
+	RE_UploadChunk( font, chunk, glyphs );
+
+	if ( r_fontCache.Get() )
+	{
+		RE_SaveChunkCache( font, chunk, glyphs );
 	}
-	Z_Free( out );
 }
 
 static int RE_LoadFontFile( const char *name, void **buffer )
@@ -511,9 +344,12 @@ fontInfo_t* RE_RegisterFont( const char *fontName, int pointSize )
 	Q_strncpyz( font->name, strippedName, sizeof( font->name ) );
 	font->face = face;
 	font->faceData = faceData;
+	font->faceSize = len;
+	font->checkSum = Com_BlockChecksum( faceData, len );
 	font->pointSize = pointSize;
 
-	RE_RenderChunk( font, 0 );
+	// the default glyph is in chunk 0, it can't wait for the worker
+	RE_RenderChunk( font, 0, false );
 
 	return font;
 }
@@ -533,6 +369,9 @@ void RE_UnregisterFont( fontInfo_t *font )
 		return;
 	}
 
+	// the worker may still be reading the font file
+	fontWorker.Cancel( font );
+
 	if ( font->face )
 	{
 		FT_Done_Face( (FT_Face) font->face );
@@ -541,7 +380,7 @@ void RE_UnregisterFont( fontInfo_t *font )
 
 	for ( int i = 0; i < 0x1100; ++i )
 	{
-		if ( font->glyphBlock[ i ] && font->glyphBlock[ i ] != nullGlyphs )
+		if ( font->glyphBlock[ i ] && font->glyphBlock[ i ] != nullGlyphs && font->glyphBlock[ i ] != pendingGlyphs )
 		{
 			Z_Free( font->glyphBlock[ i ] );
 			font->glyphBlock[ i ] = nullptr;
@@ -553,6 +392,8 @@ void RE_UnregisterFont( fontInfo_t *font )
 
 void R_DoneFreeType()
 {
+	fontWorker.Shutdown();
+
 	if ( ftLibrary )
 	{
 		FT_Done_FreeType( ftLibrary );
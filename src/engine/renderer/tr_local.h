@@ -27,6 +27,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <GL/glew.h>
 
 #include "common/FileSystem.h"
+#include "common/VisBits.h"
 #include "qcommon/q_shared.h"
 #include "qcommon/qfiles.h"
 #include "qcommon/qcommon.h"
@@ -201,8 +202,7 @@ static inline void halfToFloat( const f16vec4_t in, vec4_t out )
 
 #define MAX_IN_GAME_VIDEOS 32
 
-#define MAX_DRAWSURFS      0x10000
-#define DRAWSURF_MASK      ( MAX_DRAWSURFS - 1 )
+#define MAX_DRAWSURFS      0x10000 // initial size, the per-frame drawSurf array grows with the scenes
 
 // 16x16 pixels per tile
 #define TILE_SHIFT 4
@@ -352,6 +352,8 @@ enum class ssaoMode {
 	  RSPEEDS_VIEWCLUSTER,
 	  RSPEEDS_CHC,
 	  RSPEEDS_NEAR_FAR,
+	  RSPEEDS_FRAME_ARENA,
+	  RSPEEDS_BUFFER_STALLS,
 	};
 
 	enum class glDebugModes_t
@@ -1657,6 +1659,15 @@ enum
 		surfaceType_t   *data; // any of srf*_t
 	};
 
+	// world surface that passed the BSP traversal, waiting for the per-surface cull
+	struct worldSurfaceCandidate_t
+	{
+		bspSurface_t *surface;
+		int          portalNum;
+		int          planeBits;
+		uint8_t      cullFlags;
+	};
+
 #define CONTENTS_NODE -1
 	struct bspNode_t
 	{
@@ -1770,7 +1781,7 @@ enum
 		bool hasSkyboxPortal;
 	};
 
-#define REFLECTION_CUBEMAP_VERSION 0
+#define REFLECTION_CUBEMAP_VERSION 1
 
 	/*
 	==============================================================================
@@ -2116,6 +2127,15 @@ enum
 		int c_leafs;
 	};
 
+	// element counts of the per-frame scratch arrays, see R_ToggleSmpFrame
+	struct frameScratch_t
+	{
+		int drawSurfs;
+		int polys;
+		int polyVerts;
+		int polyIndexes;
+	};
+
 #define FUNCTABLE_SIZE  1024
 #define FUNCTABLE_SIZE2 10
 #define FUNCTABLE_MASK  ( FUNCTABLE_SIZE - 1 )
@@ -2238,6 +2258,7 @@ enum
 	struct cubemapProbe_t
 	{
 		vec3_t  origin;
+		int     cluster;
 		image_t *cubemap;
 	};
 
@@ -2421,7 +2442,6 @@ enum
 		int      sceneCount; // incremented every scene
 		int      viewCount; // incremented every view (twice a scene if portaled)
 		int      viewCountNoReset; // incremented when doing something that visits surfaces and sets their viewCount
-		// and every R_MarkFragments call
 
 		int        smpFrame; // toggles from 0 to 1 every endFrame
 
@@ -2543,6 +2563,9 @@ enum
 		frontEndCounters_t pc;
 		int                frontEndMsec; // not in pc due to clearing issue
 
+		frameScratch_t     frameScratchDropped; // didn't fit in this frame's arrays
+		frameScratch_t     frameScratchPeak; // most ever asked for in a frame
+
 		bool skipSubgroupProfiler = false;
 		bool skipVBO = false;
 
@@ -2572,6 +2595,7 @@ enum
 
 		byte *cubeTemp[ 6 ]; // 6 textures for cubemap storage
 		std::vector<cubemapProbe_t> cubeProbes; // all cubemaps in a linear growing list
+		std::vector<uint32_t> cubeProbeTree; // k-d tree of the cubeProbes, see R_BuildCubeProbeTree
 		Grid<uint32_t> cubeProbeGrid{ true };
 		uint32_t cubeProbeSpacing;
 
@@ -3303,6 +3327,9 @@ void GLimp_LogComment_( std::string comment );
 
 	int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projection,
 	                     int maxPoints, vec3_t pointBuffer, int maxFragments, markFragment_t *fragmentBuffer );
+	void RE_MarkFragmentsBatch( const markRequest_t *requests, int numRequests, int maxPoints, int maxFragments, int *results );
+	void R_BuildMarkTriangles();
+	void R_ShutdownMarkTriangles();
 
 	/*
 	============================================================
@@ -3335,6 +3362,8 @@ void GLimp_LogComment_( std::string comment );
 	*/
 
 	void R_ToggleSmpFrame();
+	void R_FrameArenaCounters();
+	void R_ShutdownFrameArenas();
 
 	void RE_ClearScene();
 	void RE_AddRefEntityToScene( const refEntity_t *ent );
@@ -3381,6 +3410,7 @@ void GLimp_LogComment_( std::string comment );
 	                                  bool clearOrigin );
 	void R_TransformSkeleton( refSkeleton_t* skel, const float scale );
 	int             RE_BlendSkeleton( refSkeleton_t *skel, const refSkeleton_t *blend, float frac );
+	void            RE_BuildSkeletons( const skeletonRequest_t *requests, int numRequests, refSkeleton_t *skels, int *results );
 	int             RE_AnimNumFrames( qhandle_t hAnim );
 	int             RE_AnimFrameRate( qhandle_t hAnim );
 
@@ -3601,14 +3631,15 @@ void GLimp_LogComment_( std::string comment );
 // on an SMP machine
 	struct backEndData_t
 	{
-		drawSurf_t          drawSurfs[ MAX_DRAWSURFS ];
-
-		refLight_t          lights[ MAX_REF_LIGHTS ];
-
+		// carved out of a per-frame arena by R_ToggleSmpFrame
+		frameScratch_t      scratchSize;
+		drawSurf_t          *drawSurfs;
 		srfPoly_t           *polys;
 		polyVert_t          *polyVerts;
 		int                 *polyIndexes;
 
+		refLight_t          lights[ MAX_REF_LIGHTS ];
+
 		// the backend communicates to the frontend through visTestResult_t
 		int                 numVisTests;
 		visTestResult_t     visTests[ MAX_VISTESTS ];
@@ -3616,6 +3647,9 @@ void GLimp_LogComment_( std::string comment );
 		bspNode_t			**traversalList;
 		int                 traversalLength;
 
+		worldSurfaceCandidate_t *worldSurfaceCandidates;
+		int                 numWorldSurfaceCandidates;
+
 		renderCommandList_t commands;
 	};
 
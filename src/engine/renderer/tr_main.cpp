@@ -1613,10 +1613,14 @@ R_AddDrawSurf
 */
 void R_AddDrawSurf( surfaceType_t *surface, shader_t *shader, int lightmapNum, bool bspSurface, int portalNum )
 {
-	// instead of checking for overflow, we just mask the index
-	// so it wraps around
-	const int baseIndex = tr.refdef.numDrawSurfs & DRAWSURF_MASK;
-	int index = baseIndex;
+	// the next frames are given room for it, see R_ToggleSmpFrame
+	if ( tr.refdef.numDrawSurfs >= backEndData[ tr.smpFrame ]->scratchSize.drawSurfs )
+	{
+		tr.frameScratchDropped.drawSurfs += shader->depthShader ? 2 : 1;
+		return;
+	}
+
+	int index = tr.refdef.numDrawSurfs;
 
 	drawSurf_t* drawSurf = &tr.refdef.drawSurfs[ index ];
 
@@ -1639,7 +1643,7 @@ void R_AddDrawSurf( surfaceType_t *surface, shader_t *shader, int lightmapNum, b
 
 	if (shader->sort > Util::ordinal(shaderSort_t::SS_OPAQUE))
 	{
-		index = MAX_DRAWSURFS - index; // reverse the sorting (front:back -> back:front)
+		index = SORT_INDEX_MASK - index; // reverse the sorting (front:back -> back:front)
 	}
 
 	drawSurf->setSort( shader->sortedIndex, lightmapNum, entityNum, index );
@@ -1672,14 +1676,6 @@ static void R_SortDrawSurfs()
 		return;
 	}
 
-	// if we overflowed MAX_DRAWSURFS, the drawsurfs
-	// wrapped around in the buffer and we will be missing
-	// the first surfaces, not the last ones
-	if ( tr.viewParms.numDrawSurfs > MAX_DRAWSURFS )
-	{
-		tr.viewParms.numDrawSurfs = MAX_DRAWSURFS;
-	}
-
 	std::sort( tr.viewParms.drawSurfs, tr.viewParms.drawSurfs + tr.viewParms.numDrawSurfs,
 	           []( const drawSurf_t &a, const drawSurf_t &b ) {
 	               return a.sort < b.sort;
@@ -26,8 +26,6 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static const int MAX_VERTS_ON_POLY = 64;
 
-static const int MARKER_OFFSET     = 0;
-
 /*
 =============
 R_ChopPolyBehindPlane
@@ -146,88 +144,224 @@ static void R_ChopPolyBehindPlane( int numInPoints, vec3_t inPoints[ MAX_VERTS_O
 }
 
 /*
-=================
-R_BoxSurfaces_r
-=================
+=============================================================
+
+MARK TRIANGLES
+
+The triangles of the world surfaces that can receive marks are gathered
+when the map is loaded, and bucketed in a spatial hash of cubic cells.
+A triangle is put in the bucket of every cell its bounds touch, so
+a mark only has to look at the buckets of the cells its own bounds touch.
+Projecting a mark doesn't write anything shared, so a batch of marks
+can be projected in parallel.
+
+=============================================================
 */
-void R_BoxSurfaces_r( bspNode_t *node, vec3_t mins, vec3_t maxs, surfaceType_t **list, int listsize, int *listlength, vec3_t dir )
+
+static const float MARK_CELL_SIZE = 128.0f;
+
+enum class markTriangleType_t : uint8_t
 {
-	int          s, c;
-	bspSurface_t *surf, **mark;
+	FACE,
+	GRID_FIRST,  // the two triangles of a grid quad are tested
+	GRID_SECOND, // with slightly different angles
+	TRISURF,
+};
 
-	// do the tail recursion in a loop
-	while ( node->contents == -1 )
-	{
-		s = BoxOnPlaneSide( mins, maxs, node->plane );
+struct markTriangle_t
+{
+	vec3_t             xyz[ 3 ];
+	vec3_t             mins;
+	vec3_t             maxs;
+	vec3_t             normal; // the triangle normal for grids
+	const cplane_t     *plane; // the surface plane for faces
+	markTriangleType_t type;
+};
+
+struct markTriangleHash_t
+{
+	std::vector<markTriangle_t> triangles;
 
-		if ( s == 1 )
-		{
-			node = node->children[ 0 ];
-		}
-		else if ( s == 2 )
-		{
-			node = node->children[ 1 ];
-		}
-		else
+	// the triangles of bucket i are the entries from bucketStart[ i ] to bucketStart[ i + 1 ]
+	std::vector<uint32_t>       bucketStart;
+	std::vector<uint32_t>       entries;
+	uint32_t                    bucketMask;
+
+	// bounds of all the triangles, the cells a mark looks at are kept within them
+	vec3_t                      mins;
+	vec3_t                      maxs;
+};
+
+static markTriangleHash_t markTriangles;
+
+static int R_MarkCell( float coord )
+{
+	return static_cast<int>( floorf( coord * ( 1.0f / MARK_CELL_SIZE ) ) );
+}
+
+static uint32_t R_MarkBucket( int x, int y, int z )
+{
+	return ( uint32_t( x ) * 73856093u ^ uint32_t( y ) * 19349663u ^ uint32_t( z ) * 83492791u ) & markTriangles.bucketMask;
+}
+
+// Different cells may share a bucket, the triangle must only be listed once in it
+static void R_MarkTriangleBuckets( const markTriangle_t &tri, std::vector<uint32_t> &buckets )
+{
+	buckets.clear();
+
+	for ( int x = R_MarkCell( tri.mins[ 0 ] ); x <= R_MarkCell( tri.maxs[ 0 ] ); x++ )
+	{
+		for ( int y = R_MarkCell( tri.mins[ 1 ] ); y <= R_MarkCell( tri.maxs[ 1 ] ); y++ )
 		{
-			R_BoxSurfaces_r( node->children[ 0 ], mins, maxs, list, listsize, listlength, dir );
-			node = node->children[ 1 ];
+			for ( int z = R_MarkCell( tri.mins[ 2 ] ); z <= R_MarkCell( tri.maxs[ 2 ] ); z++ )
+			{
+				buckets.push_back( R_MarkBucket( x, y, z ) );
+			}
 		}
 	}
 
-	// add the individual surfaces
-	mark = tr.world->markSurfaces + node->firstMarkSurface;
-	c = node->numMarkSurfaces;
+	std::sort( buckets.begin(), buckets.end() );
+	buckets.erase( std::unique( buckets.begin(), buckets.end() ), buckets.end() );
+}
+
+static void R_AddMarkTriangle( const vec3_t v0, const vec3_t v1, const vec3_t v2,
+                               markTriangleType_t type, const cplane_t *plane )
+{
+	markTriangle_t tri;
+
+	VectorCopy( v0, tri.xyz[ 0 ] );
+	VectorCopy( v1, tri.xyz[ 1 ] );
+	VectorCopy( v2, tri.xyz[ 2 ] );
 
-	while ( c-- )
+	ClearBounds( tri.mins, tri.maxs );
+
+	for ( int i = 0; i < 3; i++ )
 	{
-		//
-		if ( *listlength >= listsize )
-		{
-			break;
-		}
+		AddPointToBounds( tri.xyz[ i ], tri.mins, tri.maxs );
+	}
 
-		//
-		surf = *mark;
+	vec3_t e1, e2;
+	VectorSubtract( tri.xyz[ 0 ], tri.xyz[ 1 ], e1 );
+	VectorSubtract( tri.xyz[ 2 ], tri.xyz[ 1 ], e2 );
+	CrossProduct( e1, e2, tri.normal );
+	VectorNormalizeFast( tri.normal );
+
+	tri.plane = plane;
+	tri.type = type;
+
+	markTriangles.triangles.push_back( tri );
+}
+
+/*
+=================
+R_BuildMarkTriangles
+
+Called once the world is loaded
+=================
+*/
+void R_BuildMarkTriangles()
+{
+	R_ShutdownMarkTriangles();
+
+	const bspModel_t &worldModel = tr.world->models[ 0 ];
+
+	for ( uint32_t i = 0; i < worldModel.numSurfaces; i++ )
+	{
+		const bspSurface_t *surf = worldModel.firstSurface + i;
 
 		// check if the surface has NOIMPACT or NOMARKS set
 		if ( ( surf->shader->surfaceFlags & ( SURF_NOIMPACT | SURF_NOMARKS ) ) || ( surf->shader->contentFlags & CONTENTS_FOG ) )
 		{
-			surf->viewCount = tr.viewCountNoReset;
+			continue;
 		}
-		// extra check for surfaces to avoid list overflows
-		else if ( * ( surf->data ) == surfaceType_t::SF_FACE )
+
+		if ( *surf->data == surfaceType_t::SF_GRID )
 		{
-			// the face plane should go through the box
-			s = BoxOnPlaneSide( mins, maxs, & ( ( srfGeneric_t* ) surf->data )->plane );
+			const srfGridMesh_t *cv = ( const srfGridMesh_t * ) surf->data;
 
-			if ( s == 1 || s == 2 )
+			// LOD is not taken into account, not such a big deal though.
+			for ( int m = 0; m < cv->height - 1; m++ )
 			{
-				surf->viewCount = tr.viewCountNoReset;
+				for ( int n = 0; n < cv->width - 1; n++ )
+				{
+					const srfVert_t *dv = cv->verts + m * cv->width + n;
+
+					R_AddMarkTriangle( dv[ 0 ].xyz, dv[ cv->width ].xyz, dv[ 1 ].xyz, markTriangleType_t::GRID_FIRST, nullptr );
+					R_AddMarkTriangle( dv[ 1 ].xyz, dv[ cv->width ].xyz, dv[ cv->width + 1 ].xyz, markTriangleType_t::GRID_SECOND, nullptr );
+				}
 			}
-			else if ( DotProduct( ( ( srfGeneric_t* ) surf->data )->plane.normal, dir ) > -0.5 )
+		}
+		else if ( *surf->data == surfaceType_t::SF_FACE || *surf->data == surfaceType_t::SF_TRIANGLES )
+		{
+			const srfGeneric_t *gen = ( const srfGeneric_t * ) surf->data;
+			const bool face = *surf->data == surfaceType_t::SF_FACE;
+
+			for ( int k = 0; k < gen->numTriangles; k++ )
 			{
-				// don't add faces that make sharp angles with the projection direction
-				surf->viewCount = tr.viewCountNoReset;
+				const srfTriangle_t *tri = gen->triangles + k;
+
+				R_AddMarkTriangle( gen->verts[ tri->indexes[ 0 ] ].xyz, gen->verts[ tri->indexes[ 1 ] ].xyz,
+					gen->verts[ tri->indexes[ 2 ] ].xyz,
+					face ? markTriangleType_t::FACE : markTriangleType_t::TRISURF, face ? &gen->plane : nullptr );
 			}
 		}
-		else if ( * ( surfaceType_t * )( surf->data ) != surfaceType_t::SF_GRID
-		          && * ( surfaceType_t * )( surf->data ) != surfaceType_t::SF_TRIANGLES )
+	}
+
+	const std::vector<markTriangle_t> &triangles = markTriangles.triangles;
+
+	ClearBounds( markTriangles.mins, markTriangles.maxs );
+
+	for ( const markTriangle_t &tri : triangles )
+	{
+		AddPointToBounds( tri.mins, markTriangles.mins, markTriangles.maxs );
+		AddPointToBounds( tri.maxs, markTriangles.mins, markTriangles.maxs );
+	}
+
+	uint32_t numBuckets = 1024;
+	while ( numBuckets < triangles.size() )
+	{
+		numBuckets <<= 1;
+	}
+
+	markTriangles.bucketMask = numBuckets - 1;
+	markTriangles.bucketStart.assign( numBuckets + 1, 0 );
+
+	std::vector<uint32_t> buckets;
+
+	for ( const markTriangle_t &tri : triangles )
+	{
+		R_MarkTriangleBuckets( tri, buckets );
+
+		for ( uint32_t bucket : buckets )
 		{
-			surf->viewCount = tr.viewCountNoReset;
+			markTriangles.bucketStart[ bucket + 1 ]++;
 		}
+	}
+
+	for ( uint32_t i = 0; i < numBuckets; i++ )
+	{
+		markTriangles.bucketStart[ i + 1 ] += markTriangles.bucketStart[ i ];
+	}
+
+	std::vector<uint32_t> fill( markTriangles.bucketStart.begin(), markTriangles.bucketStart.end() - 1 );
+	markTriangles.entries.resize( markTriangles.bucketStart[ numBuckets ] );
 
-		// check the viewCount because the surface may have
-		// already been added if it spans multiple leafs
-		if ( surf->viewCount != tr.viewCountNoReset )
+	for ( size_t i = 0; i < triangles.size(); i++ )
+	{
+		R_MarkTriangleBuckets( triangles[ i ], buckets );
+
+		for ( uint32_t bucket : buckets )
 		{
-			surf->viewCount = tr.viewCountNoReset;
-			list[ *listlength ] = ( surfaceType_t * ) surf->data;
-			( *listlength ) ++;
+			markTriangles.entries[ fill[ bucket ]++ ] = i;
 		}
-
-		mark++;
 	}
+
+	Log::Debug( "%i mark triangles in %i buckets, %i entries", triangles.size(), numBuckets, markTriangles.entries.size() );
+}
+
+void R_ShutdownMarkTriangles()
+{
+	markTriangles = {};
 }
 
 /*
@@ -236,10 +370,10 @@ R_AddMarkFragments
 
 =================
 */
-void R_AddMarkFragments( int numClipPoints, vec3_t clipPoints[ 2 ][ MAX_VERTS_ON_POLY ],
-                         int numPlanes, vec3_t *normals, float *dists,
-                         int maxPoints, vec3_t pointBuffer, markFragment_t *fragmentBuffer,
-                         int *returnedPoints, int *returnedFragments )
+static void R_AddMarkFragments( int numClipPoints, vec3_t clipPoints[ 2 ][ MAX_VERTS_ON_POLY ],
+                                int numPlanes, vec3_t *normals, float *dists,
+                                int maxPoints, vec3_t pointBuffer, markFragment_t *fragmentBuffer,
+                                int *returnedPoints, int *returnedFragments )
 {
 	int            pingPong, i;
 	markFragment_t *mf;
@@ -285,31 +419,44 @@ void R_AddMarkFragments( int numClipPoints, vec3_t clipPoints[ 2 ][ MAX_VERTS_ON
 =================
 R_MarkFragments
 
+Only reads the mark triangles, so it may be called from worker threads
 =================
 */
 int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projection,
                      int maxPoints, vec3_t pointBuffer, int maxFragments, markFragment_t *fragmentBuffer )
 {
-	int              numsurfaces, numPlanes;
-	int              i, j, k, m, n;
-	surfaceType_t    *surfaces[ 64 ];
+	int              numPlanes;
+	int              i;
 	vec3_t           mins, maxs;
 	int              returnedFragments;
 	int              returnedPoints;
 	vec3_t           normals[ MAX_VERTS_ON_POLY + 2 ];
 	float            dists[ MAX_VERTS_ON_POLY + 2 ];
 	vec3_t           clipPoints[ 2 ][ MAX_VERTS_ON_POLY ];
-	int              numClipPoints;
-	float            *v;
-	srfGridMesh_t    *cv;
-	srfVert_t        *dv;
-	srfTriangle_t    *tri;
-	vec3_t           normal;
 	vec3_t           projectionDir;
 	vec3_t           v1, v2;
 
-	//increment view count for double check prevention
-	tr.viewCountNoReset++;
+	if ( markTriangles.triangles.empty() || numPoints <= 0 || maxFragments <= 0 )
+	{
+		return 0;
+	}
+
+	// the polygon comes from the cgame, NaNs would be left out of the bounds below
+	for ( i = 0; i < 3; i++ )
+	{
+		if ( !std::isfinite( projection[ i ] ) )
+		{
+			return 0;
+		}
+
+		for ( int j = 0; j < numPoints; j++ )
+		{
+			if ( !std::isfinite( points[ j ][ i ] ) )
+			{
+				return 0;
+			}
+		}
+	}
 
 	//
 	VectorNormalize2( projection, projectionDir );
@@ -352,151 +499,120 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 	dists[ numPoints + 1 ] = DotProduct( normals[ numPoints + 1 ], points[ 0 ] ) - 20;
 	numPlanes = numPoints + 2;
 
-	numsurfaces = 0;
-	R_BoxSurfaces_r( tr.world->nodes, mins, maxs, surfaces, 64, &numsurfaces, projectionDir );
-
 	returnedPoints = 0;
 	returnedFragments = 0;
 
-	for ( i = 0; i < numsurfaces; i++ )
+	const bool marksOnTrisurfs = !r_noMarksOnTrisurfs->integer;
+
+	// returns true once there is no space left for more fragments
+	auto addTriangle = [ & ]( const markTriangle_t &tri )
 	{
-		if ( *surfaces[ i ] == surfaceType_t::SF_GRID )
+		switch ( tri.type )
 		{
-			cv = ( srfGridMesh_t * ) surfaces[ i ];
-
-			for ( m = 0; m < cv->height - 1; m++ )
-			{
-				for ( n = 0; n < cv->width - 1; n++ )
+			case markTriangleType_t::FACE:
+				// the face plane should go through the box, and
+				// don't add faces that make sharp angles with the projection direction
+				if ( BoxOnPlaneSide( mins, maxs, tri.plane ) != 3 || DotProduct( tri.plane->normal, projectionDir ) > -0.5 )
 				{
-					// We triangulate the grid and chop all triangles within
-					// the bounding planes of the to be projected polygon.
-					// LOD is not taken into account, not such a big deal though.
-					//
-					// It's probably much nicer to chop the grid itself and deal
-					// with this chopped grid as an SF_GRID surface, so LOD will
-					// be applied. However the LOD of that chopped grid must
-					// be synced with the LOD of the original curve.
-					// One way to do this; the chopped grid shares vertices with
-					// the original curve. When LOD is applied to the original
-					// curve the unused vertices are flagged. Now the chopped curve
-					// should skip the flagged vertices. This still leaves the
-					// problems with the vertices at the chopped grid edges.
-					//
-					// To avoid issues when LOD applied to "hollow curves" (like
-					// the ones around many jump pads) we now just add a 2 unit
-					// offset to the triangle vertices.
-					// The offset is added in the vertex normal vector direction
-					// so all triangles will still fit together.
-					// The 2 unit offset should avoid pretty much all LOD problems.
-
-					numClipPoints = 3;
-
-					dv = cv->verts + m * cv->width + n;
-
-					VectorCopy( dv[ 0 ].xyz, clipPoints[ 0 ][ 0 ] );
-					VectorMA( clipPoints[ 0 ][ 0 ], MARKER_OFFSET, dv[ 0 ].normal, clipPoints[ 0 ][ 0 ] );
-					VectorCopy( dv[ cv->width ].xyz, clipPoints[ 0 ][ 1 ] );
-					VectorMA( clipPoints[ 0 ][ 1 ], MARKER_OFFSET, dv[ cv->width ].normal, clipPoints[ 0 ][ 1 ] );
-					VectorCopy( dv[ 1 ].xyz, clipPoints[ 0 ][ 2 ] );
-					VectorMA( clipPoints[ 0 ][ 2 ], MARKER_OFFSET, dv[ 1 ].normal, clipPoints[ 0 ][ 2 ] );
-					// check the normal of this triangle
-					VectorSubtract( clipPoints[ 0 ][ 0 ], clipPoints[ 0 ][ 1 ], v1 );
-					VectorSubtract( clipPoints[ 0 ][ 2 ], clipPoints[ 0 ][ 1 ], v2 );
-					CrossProduct( v1, v2, normal );
-					VectorNormalizeFast( normal );
-
-					if ( DotProduct( normal, projectionDir ) < -0.1 )
-					{
-						// add the fragments of this triangle
-						R_AddMarkFragments( numClipPoints, clipPoints,
-						                    numPlanes, normals, dists,
-						                    maxPoints, pointBuffer,
-						                    fragmentBuffer, &returnedPoints, &returnedFragments );
-
-						if ( returnedFragments == maxFragments )
-						{
-							return returnedFragments; // not enough space for more fragments
-						}
-					}
-
-					VectorCopy( dv[ 1 ].xyz, clipPoints[ 0 ][ 0 ] );
-					VectorMA( clipPoints[ 0 ][ 0 ], MARKER_OFFSET, dv[ 1 ].normal, clipPoints[ 0 ][ 0 ] );
-					VectorCopy( dv[ cv->width ].xyz, clipPoints[ 0 ][ 1 ] );
-					VectorMA( clipPoints[ 0 ][ 1 ], MARKER_OFFSET, dv[ cv->width ].normal, clipPoints[ 0 ][ 1 ] );
-					VectorCopy( dv[ cv->width + 1 ].xyz, clipPoints[ 0 ][ 2 ] );
-					VectorMA( clipPoints[ 0 ][ 2 ], MARKER_OFFSET, dv[ cv->width + 1 ].normal, clipPoints[ 0 ][ 2 ] );
-					// check the normal of this triangle
-					VectorSubtract( clipPoints[ 0 ][ 0 ], clipPoints[ 0 ][ 1 ], v1 );
-					VectorSubtract( clipPoints[ 0 ][ 2 ], clipPoints[ 0 ][ 1 ], v2 );
-					CrossProduct( v1, v2, normal );
-					VectorNormalizeFast( normal );
-
-					if ( DotProduct( normal, projectionDir ) < -0.05 )
-					{
-						// add the fragments of this triangle
-						R_AddMarkFragments( numClipPoints, clipPoints,
-						                    numPlanes, normals, dists,
-						                    maxPoints, pointBuffer,
-						                    fragmentBuffer, &returnedPoints, &returnedFragments );
-
-						if ( returnedFragments == maxFragments )
-						{
-							return returnedFragments; // not enough space for more fragments
-						}
-					}
+					return false;
 				}
-			}
-		}
-		else if ( *surfaces[ i ] == surfaceType_t::SF_FACE )
-		{
-			srfGeneric_t* face = ( srfGeneric_t* ) surfaces[i];
-
-			// check the normal of this face
-			if ( DotProduct( face->plane.normal, projectionDir ) > -0.5 )
-			{
-				continue;
-			}
+				break;
 
-			for ( k = 0, tri = face->triangles; k < face->numTriangles; k++, tri++ )
-			{
-				for ( j = 0; j < 3; j++ )
+			case markTriangleType_t::GRID_FIRST:
+				if ( DotProduct( tri.normal, projectionDir ) >= -0.1 )
 				{
-					v = face->verts[ tri->indexes[ j ] ].xyz;
-					VectorMA( v, MARKER_OFFSET, face->plane.normal, clipPoints[ 0 ][ j ] );
+					return false;
 				}
+				break;
 
-				// add the fragments of this face
-				R_AddMarkFragments( 3, clipPoints,
-				                    numPlanes, normals, dists,
-				                    maxPoints, pointBuffer,
-				                    fragmentBuffer, &returnedPoints, &returnedFragments );
+			case markTriangleType_t::GRID_SECOND:
+				if ( DotProduct( tri.normal, projectionDir ) >= -0.05 )
+				{
+					return false;
+				}
+				break;
 
-				if ( returnedFragments == maxFragments )
+			case markTriangleType_t::TRISURF:
+				if ( !marksOnTrisurfs )
 				{
-					return returnedFragments; // not enough space for more fragments
+					return false;
 				}
-			}
+				break;
+		}
+
+		memcpy( clipPoints[ 0 ], tri.xyz, sizeof( tri.xyz ) );
+
+		// add the fragments of this triangle
+		R_AddMarkFragments( 3, clipPoints,
+		                    numPlanes, normals, dists,
+		                    maxPoints, pointBuffer,
+		                    fragmentBuffer, &returnedPoints, &returnedFragments );
+
+		return returnedFragments == maxFragments;
+	};
+
+	int cellMins[ 3 ], cellMaxs[ 3 ];
+	uint64_t numCells = 1;
+
+	for ( i = 0; i < 3; i++ )
+	{
+		// the bounds are clamped to the triangles' before they're turned into cells,
+		// so a huge mark from the cgame can't overflow the cell coordinates
+		if ( !std::isfinite( mins[ i ] ) || !std::isfinite( maxs[ i ] )
+		     || mins[ i ] > markTriangles.maxs[ i ] || maxs[ i ] < markTriangles.mins[ i ] )
+		{
+			return 0;
 		}
-		else if ( *surfaces[ i ] == surfaceType_t::SF_TRIANGLES && !r_noMarksOnTrisurfs->integer )
+
+		cellMins[ i ] = R_MarkCell( std::max( mins[ i ], markTriangles.mins[ i ] ) );
+		cellMaxs[ i ] = R_MarkCell( std::min( maxs[ i ], markTriangles.maxs[ i ] ) );
+		numCells *= cellMaxs[ i ] - cellMins[ i ] + 1;
+	}
+
+	// a mark covering more cells than there are triangles is cheaper to test against every triangle
+	if ( numCells > markTriangles.triangles.size() )
+	{
+		for ( const markTriangle_t &tri : markTriangles.triangles )
 		{
-			srfGeneric_t* trisurf = ( srfGeneric_t* ) surfaces[ i ];
+			if ( BoundsIntersect( mins, maxs, tri.mins, tri.maxs ) && addTriangle( tri ) )
+			{
+				return returnedFragments; // not enough space for more fragments
+			}
+		}
+
+		return returnedFragments;
+	}
 
-			for ( k = 0, tri = trisurf->triangles; k < trisurf->numTriangles; k++, tri++ )
+	for ( int x = cellMins[ 0 ]; x <= cellMaxs[ 0 ]; x++ )
+	{
+		for ( int y = cellMins[ 1 ]; y <= cellMaxs[ 1 ]; y++ )
+		{
+			for ( int z = cellMins[ 2 ]; z <= cellMaxs[ 2 ]; z++ )
 			{
-				for ( j = 0; j < 3; j++ )
+				const uint32_t bucket = R_MarkBucket( x, y, z );
+
+				for ( uint32_t e = markTriangles.bucketStart[ bucket ]; e < markTriangles.bucketStart[ bucket + 1 ]; e++ )
 				{
-					VectorCopy( trisurf->verts[ tri->indexes[ j ] ].xyz, clipPoints[ 0 ][ j ] );
-				}
+					const markTriangle_t &tri = markTriangles.triangles[ markTriangles.entries[ e ] ];
 
-				// add the fragments of this face
-				R_AddMarkFragments( 3, clipPoints,
-				                    numPlanes, normals, dists,
-				                    maxPoints, pointBuffer,
-				                    fragmentBuffer, &returnedPoints, &returnedFragments );
+					if ( !BoundsIntersect( mins, maxs, tri.mins, tri.maxs ) )
+					{
+						continue;
+					}
 
-				if ( returnedFragments == maxFragments )
-				{
-					return returnedFragments; // not enough space for more fragments
+					// a triangle that spans several of the cells is only projected in the one
+					// holding the lowest corner of its overlap with the mark bounds
+					if ( R_MarkCell( std::max( mins[ 0 ], tri.mins[ 0 ] ) ) != x
+					     || R_MarkCell( std::max( mins[ 1 ], tri.mins[ 1 ] ) ) != y
+					     || R_MarkCell( std::max( mins[ 2 ], tri.mins[ 2 ] ) ) != z )
+					{
+						continue;
+					}
+
+					if ( addTriangle( tri ) )
+					{
+						return returnedFragments; // not enough space for more fragments
+					}
 				}
 			}
 		}
@@ -504,3 +620,25 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 
 	return returnedFragments;
 }
+
+/*
+=================
+RE_MarkFragmentsBatch
+
+Projects a batch of marks, spread over the OpenMP threads
+=================
+*/
+void RE_MarkFragmentsBatch( const markRequest_t *requests, int numRequests, int maxPoints, int maxFragments, int *results )
+{
+	// a mark is usually a handful of triangles, don't wake up threads for a couple
+	constexpr int MIN_PARALLEL_MARKS = 8;
+
+	#pragma omp parallel for schedule( dynamic ) if ( numRequests >= MIN_PARALLEL_MARKS )
+	for ( int i = 0; i < numRequests; i++ )
+	{
+		const markRequest_t *request = &requests[ i ];
+
+		results[ i ] = R_MarkFragments( request->numPoints, request->points, request->projection,
+			maxPoints, request->pointBuffer, maxFragments, request->fragmentBuffer );
+	}
+}
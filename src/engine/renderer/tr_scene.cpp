@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "tr_local.h"
 #include "Material.h"
 #include "EntityCache.h"
+#include "Memory/StackAllocator.h"
 
 static Cvar::Cvar<bool> r_drawDynamicLights(
 	"r_drawDynamicLights", "render dynamic lights (if realtime lighting is enabled)", Cvar::NONE, true );
@@ -45,6 +46,144 @@ int        r_numPolyIndexes;
 int r_numVisTests;
 int r_firstSceneVisTest;
 
+/*
+===========================================================================
+
+PER-FRAME ARENAS
+
+The drawSurf and poly arrays of each SMP frame are carved out of a linear
+arena when the frame starts. A frame asking for more than fits loses the
+surplus, but the arrays of the next frames are sized after the high-water
+mark, so only a scene getting busier drops anything.
+
+===========================================================================
+*/
+
+// Heap memory for the per-frame arenas
+class FrameArenaAllocator : public Allocator
+{
+public:
+	byte *Alloc( const uint64 size, const uint64 alignment ) override
+	{
+		return ( byte * ) Com_Allocate_Aligned( alignment, size );
+	}
+
+	void Free( byte *memory ) override
+	{
+		Com_Free_Aligned( memory );
+	}
+};
+
+static const int MAX_FRAME_SCRATCH = 1 << 22;
+
+static FrameArenaAllocator frameArenaAllocator;
+static StackAllocator frameArenas[ SMP_FRAMES ] = {
+	StackAllocator( &frameArenaAllocator ),
+	StackAllocator( &frameArenaAllocator )
+};
+
+// keeps the arrays from reallocating every frame while a scene is getting busier
+static int R_FrameScratchSize( int size, int initialSize, int peak, int limit )
+{
+	size = std::max( size, initialSize );
+
+	while ( size < peak && size < limit )
+	{
+		size += size / 2;
+	}
+
+	return std::min( size, limit );
+}
+
+/*
+====================
+R_AllocFrameScratch
+
+The back end is done with these buffers, R_IssueRenderCommands waited for it
+====================
+*/
+static void R_AllocFrameScratch( backEndData_t *data, StackAllocator &arena )
+{
+	const frameScratch_t &peak = tr.frameScratchPeak;
+	frameScratch_t size = data->scratchSize;
+
+	// the drawSurf index is part of the sort key
+	size.drawSurfs = R_FrameScratchSize( size.drawSurfs, MAX_DRAWSURFS, peak.drawSurfs, SORT_INDEX_MASK + 1 );
+	size.polys = R_FrameScratchSize( size.polys, r_maxPolys->integer, peak.polys, MAX_FRAME_SCRATCH );
+	size.polyVerts = R_FrameScratchSize( size.polyVerts, r_maxPolyVerts->integer, peak.polyVerts, MAX_FRAME_SCRATCH );
+	size.polyIndexes = R_FrameScratchSize( size.polyIndexes, r_maxPolyVerts->integer, peak.polyIndexes, MAX_FRAME_SCRATCH );
+
+	// each array may need padding for its alignment
+	const uint64 bytes = size.drawSurfs * sizeof( drawSurf_t ) + size.polys * sizeof( srfPoly_t )
+		+ size.polyVerts * sizeof( polyVert_t ) + size.polyIndexes * sizeof( int ) + 4 * 64;
+
+	if ( arena.Size() < bytes )
+	{
+		if ( arena.Size() )
+		{
+			Log::Debug( "Growing frame arena %d to %d drawsurfs %d polys %d polyverts %d polyindexes (%d kB)",
+				&arena - frameArenas, size.drawSurfs, size.polys, size.polyVerts, size.polyIndexes, bytes / 1024 );
+		}
+
+		arena.Free();
+		arena.Init( bytes );
+	}
+
+	arena.Reset();
+
+	data->drawSurfs = ( drawSurf_t * ) arena.Alloc( size.drawSurfs * sizeof( drawSurf_t ), alignof( drawSurf_t ) );
+	data->polys = ( srfPoly_t * ) arena.Alloc( size.polys * sizeof( srfPoly_t ), alignof( srfPoly_t ) );
+	data->polyVerts = ( polyVert_t * ) arena.Alloc( size.polyVerts * sizeof( polyVert_t ), alignof( polyVert_t ) );
+	data->polyIndexes = ( int * ) arena.Alloc( size.polyIndexes * sizeof( int ), alignof( int ) );
+	data->scratchSize = size;
+}
+
+/*
+====================
+R_FrameArenaCounters
+
+Called by R_PerformanceCounters before the frame ends
+====================
+*/
+void R_FrameArenaCounters()
+{
+	const frameScratch_t &size = backEndData[ tr.smpFrame ]->scratchSize;
+	const frameScratch_t &dropped = tr.frameScratchDropped;
+	const frameScratch_t &peak = tr.frameScratchPeak;
+
+	Log::Notice( "%i/%i drawsurfs %i/%i polys %i/%i polyverts %i/%i polyindexes",
+		r_firstSceneDrawSurf, size.drawSurfs, r_numPolys, size.polys,
+		r_numPolyVerts, size.polyVerts, r_numPolyIndexes, size.polyIndexes );
+
+	Log::Notice( "peak %i drawsurfs %i polys %i polyverts %i polyindexes",
+		peak.drawSurfs, peak.polys, peak.polyVerts, peak.polyIndexes );
+
+	if ( dropped.drawSurfs || dropped.polys || dropped.polyVerts || dropped.polyIndexes )
+	{
+		Log::Notice( "dropped %i drawsurfs %i polys %i polyverts %i polyindexes",
+			dropped.drawSurfs, dropped.polys, dropped.polyVerts, dropped.polyIndexes );
+	}
+
+	Log::Notice( "arena %i: %i/%i kB", tr.smpFrame,
+		frameArenas[ tr.smpFrame ].Used() / 1024, frameArenas[ tr.smpFrame ].Size() / 1024 );
+}
+
+void R_ShutdownFrameArenas()
+{
+	for ( StackAllocator &arena : frameArenas )
+	{
+		arena.Free();
+	}
+
+	for ( backEndData_t *data : backEndData )
+	{
+		if ( data )
+		{
+			data->scratchSize = {};
+		}
+	}
+}
+
 /*
 ====================
 R_ToggleSmpFrame
@@ -52,6 +191,17 @@ R_ToggleSmpFrame
 */
 void R_ToggleSmpFrame()
 {
+	// record what the frame that just ended asked for
+	frameScratch_t &peak = tr.frameScratchPeak;
+	const frameScratch_t &dropped = tr.frameScratchDropped;
+
+	peak.drawSurfs = std::max( peak.drawSurfs, r_firstSceneDrawSurf + dropped.drawSurfs );
+	peak.polys = std::max( peak.polys, r_numPolys + dropped.polys );
+	peak.polyVerts = std::max( peak.polyVerts, r_numPolyVerts + dropped.polyVerts );
+	peak.polyIndexes = std::max( peak.polyIndexes, r_numPolyIndexes + dropped.polyIndexes );
+
+	tr.frameScratchDropped = {};
+
 	if ( r_smp->integer )
 	{
 		// use the other buffers next frame, because another CPU
@@ -63,6 +213,8 @@ void R_ToggleSmpFrame()
 		tr.smpFrame = 0;
 	}
 
+	R_AllocFrameScratch( backEndData[ tr.smpFrame ], frameArenas[ tr.smpFrame ] );
+
 	backEndData[ tr.smpFrame ]->commands.used = 0;
 
 	r_firstSceneDrawSurf = 0;
@@ -159,15 +311,13 @@ static void R_AddPolysToScene( qhandle_t hShader, int numVerts, const polyVert_t
 
 	for ( j = 0; j < numPolys; j++ )
 	{
-		if ( r_numPolyVerts + numVerts >= r_maxPolyVerts->integer || r_numPolys >= r_maxPolys->integer )
+		const frameScratch_t &scratchSize = backEndData[ tr.smpFrame ]->scratchSize;
+
+		if ( r_numPolyVerts + numVerts > scratchSize.polyVerts || r_numPolys >= scratchSize.polys )
 		{
-			/*
-			   NOTE TTimo this was initially Log::Warn
-			   but it happens a lot with high fighting scenes and particles
-			   since we don't plan on changing the const and making for room for those effects
-			   simply cut this message to developer only
-			 */
-			Log::Debug("RE_AddPolyToScene: r_max_polys or r_max_polyverts reached" );
+			// the next frames are given room for them, see R_ToggleSmpFrame
+			tr.frameScratchDropped.polys += numPolys - j;
+			tr.frameScratchDropped.polyVerts += numVerts * ( numPolys - j );
 			return;
 		}
 
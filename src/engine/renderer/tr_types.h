@@ -189,6 +189,27 @@ struct alignas(16) refSkeleton_t
 	refBone_t         bones[ MAX_BONES ];
 };
 
+// One skeleton to build in a RE_BuildSkeletons batch
+struct skeletonRequest_t
+{
+	int     animationHandle;
+	int     startFrame;
+	int     endFrame;
+	float   frac;
+	bool8_t clearOrigin;
+};
+
+// One mark to project in a RE_MarkFragmentsBatch, into its own buffers
+// of maxPoints points and maxFragments fragments
+struct markRequest_t
+{
+	int            numPoints;
+	const vec3_t   *points;
+	const float    *projection;
+	float          *pointBuffer;
+	markFragment_t *fragmentBuffer;
+};
+
 // XreaL END
 
 enum EntityTag : uint8_t {
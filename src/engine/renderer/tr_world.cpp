@@ -37,28 +37,42 @@ Tries to back face cull surfaces before they are lighted or
 added to the sorting list.
 
 This will also allow mirrors on both sides of a model without recursion.
+
+Only reads the view state, so it may be called from worker threads;
+the performance counters to update are returned as SCF_* flags.
 ================
 */
-static bool R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBits )
+enum surfaceCullFlags_t : uint8_t
+{
+	SCF_CULLED = BIT( 0 ),
+	SCF_PLANE_IN = BIT( 1 ),
+	SCF_PLANE_OUT = BIT( 2 ),
+	SCF_BOX_IN = BIT( 3 ),
+	SCF_BOX_CLIP = BIT( 4 ),
+	SCF_BOX_OUT = BIT( 5 ),
+};
+
+static uint8_t R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBits )
 {
 	srfGeneric_t *gen;
 	float        d;
+	uint8_t      flags = 0;
 
 	// allow culling to be disabled
 	if ( r_nocull->integer )
 	{
-		return false;
+		return 0;
 	}
 
 	// ydnar: made surface culling generic, inline with q3map2 surface classification
 	if ( *surface == surfaceType_t::SF_GRID && r_nocurves->integer )
 	{
-		return true;
+		return SCF_CULLED;
 	}
 
 	if ( *surface != surfaceType_t::SF_FACE && *surface != surfaceType_t::SF_TRIANGLES && *surface != surfaceType_t::SF_VBO_MESH && *surface != surfaceType_t::SF_GRID )
 	{
-		return true;
+		return SCF_CULLED;
 	}
 
 	// get generic surface
@@ -77,20 +91,18 @@ static bool R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBi
 		{
 			if ( d < -8.0f )
 			{
-				tr.pc.c_plane_cull_out++;
-				return true;
+				return SCF_CULLED | SCF_PLANE_OUT;
 			}
 		}
 		else if ( shader->cullType == CT_BACK_SIDED )
 		{
 			if ( d > 8.0f )
 			{
-				tr.pc.c_plane_cull_out++;
-				return true;
+				return SCF_CULLED | SCF_PLANE_OUT;
 			}
 		}
 
-		tr.pc.c_plane_cull_in++;
+		flags |= SCF_PLANE_IN;
 	}
 
 	if ( planeBits )
@@ -108,26 +120,27 @@ static bool R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBi
 
 		if ( cull == CULL_OUT )
 		{
-			tr.pc.c_box_cull_out++;
-			return true;
+			return flags | SCF_CULLED | SCF_BOX_OUT;
 		}
 		else if ( cull == CULL_CLIP )
 		{
-			tr.pc.c_box_cull_clip++;
+			flags |= SCF_BOX_CLIP;
 		}
 		else
 		{
-			tr.pc.c_box_cull_in++;
+			flags |= SCF_BOX_IN;
 		}
 	}
 
 	// must be visible
-	return false;
+	return flags;
 }
 
 /*
 ======================
 R_AddWorldSurface
+
+Queues the surface for culling, the draw surface is added by R_AddWorldSurfaceCandidates
 ======================
 */
 static bool R_AddWorldSurface( bspSurface_t *surf, int portalNum, int planeBits )
@@ -139,14 +152,59 @@ static bool R_AddWorldSurface( bspSurface_t *surf, int portalNum, int planeBits
 
 	surf->viewCount = tr.viewCountNoReset;
 
-	// try to cull before lighting or adding
-	if ( R_CullSurface( surf->data, surf->shader, planeBits ) )
+	worldSurfaceCandidate_t *candidate = &backEndData[ tr.smpFrame ]->worldSurfaceCandidates[
+		backEndData[ tr.smpFrame ]->numWorldSurfaceCandidates++ ];
+
+	candidate->surface = surf;
+	candidate->portalNum = portalNum;
+	candidate->planeBits = planeBits;
+	return true;
+}
+
+/*
+======================
+R_AddWorldSurfaceCandidates
+
+Culls the surfaces gathered by the BSP traversal in parallel, then adds the visible ones
+in traversal order, so the resulting draw surfaces don't depend on the thread count
+======================
+*/
+static void R_AddWorldSurfaceCandidates()
+{
+	// below this the threading overhead outweighs the culling work
+	constexpr int MIN_PARALLEL_CANDIDATES = 256;
+
+	worldSurfaceCandidate_t *candidates = backEndData[ tr.smpFrame ]->worldSurfaceCandidates;
+	const int numCandidates = backEndData[ tr.smpFrame ]->numWorldSurfaceCandidates;
+
+	#pragma omp parallel for if ( numCandidates >= MIN_PARALLEL_CANDIDATES )
+	for ( int i = 0; i < numCandidates; i++ )
 	{
-		return true;
+		worldSurfaceCandidate_t *candidate = &candidates[ i ];
+		candidate->cullFlags = R_CullSurface( candidate->surface->data, candidate->surface->shader, candidate->planeBits );
 	}
 
-	R_AddDrawSurf( surf->data, surf->shader, surf->lightmapNum, true, portalNum );
-	return true;
+	for ( int i = 0; i < numCandidates; i++ )
+	{
+		worldSurfaceCandidate_t *candidate = &candidates[ i ];
+		const uint8_t flags = candidate->cullFlags;
+
+		tr.pc.c_plane_cull_in += !!( flags & SCF_PLANE_IN );
+		tr.pc.c_plane_cull_out += !!( flags & SCF_PLANE_OUT );
+		tr.pc.c_box_cull_in += !!( flags & SCF_BOX_IN );
+		tr.pc.c_box_cull_clip += !!( flags & SCF_BOX_CLIP );
+		tr.pc.c_box_cull_out += !!( flags & SCF_BOX_OUT );
+
+		if ( flags & SCF_CULLED )
+		{
+			continue;
+		}
+
+		bspSurface_t *surf = candidate->surface;
+		R_AddDrawSurf( surf->data, surf->shader, surf->lightmapNum, true, candidate->portalNum );
+	}
+
+	backEndData[ tr.smpFrame ]->numWorldSurfaceCandidates = 0;
 }
 
 /*
@@ -419,7 +477,7 @@ bool R_inPVS( const vec3_t p1, const vec3_t p2 )
 	vis = R_ClusterPVS( leaf->cluster );
 	leaf = R_PointInLeaf( p2 );
 
-	if ( !( vis[ leaf->cluster >> 3 ] & ( 1 << ( leaf->cluster & 7 ) ) ) )
+	if ( !VisBits::Test( vis, leaf->cluster ) )
 	{
 		return false;
 	}
@@ -441,7 +499,7 @@ bool R_inPVVS( const vec3_t p1, const vec3_t p2 )
 	vis = R_ClusterPVVS( leaf->cluster );
 	leaf = R_PointInLeaf( p2 );
 
-	if ( !( vis[ leaf->cluster >> 3 ] & ( 1 << ( leaf->cluster & 7 ) ) ) )
+	if ( !VisBits::Test( vis, leaf->cluster ) )
 	{
 		return false;
 	}
@@ -527,6 +585,11 @@ static void R_MarkLeaves()
 
 	vis = R_ClusterPVS( tr.visClusters[ tr.visIndex ] );
 
+	if ( r_showCluster.Get() && tr.world->vis )
+	{
+		Log::Notice("cluster:%i sees %i of %i clusters", cluster, VisBits::PopCount( vis, tr.world->clusterBytes ), tr.world->numClusters );
+	}
+
 	for ( i = 0, leaf = tr.world->nodes; i < tr.world->numnodes; i++, leaf++ )
 	{
 		if ( tr.world->vis )
@@ -536,7 +599,7 @@ static void R_MarkLeaves()
 			if ( cluster >= 0 && cluster < tr.world->numClusters )
 			{
 				// check general pvs
-				if ( !( vis[ cluster >> 3 ] & ( 1 << ( cluster & 7 ) ) ) )
+				if ( !VisBits::Test( vis, cluster ) )
 				{
 					continue;
 				}
@@ -597,9 +660,12 @@ void R_AddWorldSurfaces()
 	// determine which leaves are in the PVS / areamask
 	R_MarkLeaves();
 
-	// clear traversal list
+	// clear traversal and candidate lists
 	backEndData[ tr.smpFrame ]->traversalLength = 0;
+	backEndData[ tr.smpFrame ]->numWorldSurfaceCandidates = 0;
 
-	// update visbounds and add surfaces that weren't cached with VBOs
+	// update visbounds and gather surfaces that weren't cached with VBOs
 	R_RecursiveWorldNode( tr.world->nodes, FRUSTUM_CLIPALL );
+
+	R_AddWorldSurfaceCandidates();
 }
@@ -40,6 +40,7 @@ Maryland 20850 USA.
 #include "sg_api.h"
 #include "framework/VirtualMachine.h"
 #include "framework/CommonVMServices.h"
+#include "Timer.h"
 
 //=============================================================================
 
@@ -132,6 +133,10 @@ struct netchan_buffer_t
 	netchan_buffer_t *next;
 };
 
+// sv_download.cpp
+struct downloadPak_t;
+struct downloadBlock_t;
+
 struct client_t
 {
 	clientState_t  state;
@@ -154,13 +159,13 @@ struct client_t
 
 	// downloading
 	char          downloadName[ MAX_OSPATH ]; // if not empty string, we are downloading
-	FS::File*     download; // file being downloaded
+	downloadPak_t *download; // pak being downloaded
 	int           downloadSize; // total bytes (can't use EOF because of paks)
 	int           downloadCount; // bytes sent
 	int           downloadClientBlock; // last block we sent to the client, awaiting ack
 	int           downloadCurrentBlock; // current block number
 	int           downloadXmitBlock; // last block we xmited
-	unsigned char *downloadBlocks[ MAX_DOWNLOAD_WINDOW ]; // the buffers for the download blocks
+	const downloadBlock_t *downloadBlocks[ MAX_DOWNLOAD_WINDOW ]; // the shared blocks in the window
 	int           downloadBlockSize[ MAX_DOWNLOAD_WINDOW ];
 	bool      downloadEOF; // We have sent the EOF block
 	int           downloadSendTime; // time we last got an ack from the client
@@ -179,6 +184,8 @@ struct client_t
 	bool         rateDelayed; // true if nextSnapshotTime was set based on rate instead of snapshotMsec
 	int              timeoutCount; // must timeout a few frames in a row so debugging doesn't break
 	clientSnapshot_t frames[ PACKET_BACKUP ]; // updates can be delta'd from here
+	psDeltaEncoder_t psDelta; // playerstate encoding negotiated when connecting
+	byte             entityDeferrals[ MAX_GENTITIES ]; // snapshots in a row an entity update was held back for
 	int              ping;
 	int              rate; // bytes / second
 	int              snapshotMsec; // requests a snapshot every snapshotMsec unless rate choked
@@ -271,6 +278,7 @@ public:
 
 private:
 	virtual void Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel) override final;
+	virtual void FlushPendingMsgs() override final;
 	void QVMSyscall(int syscallNum, Util::Reader& reader, IPC::Channel& channel);
 
 	IPC::SharedMemory shmRegion;
@@ -356,6 +364,8 @@ void SV_GetChallenge( const netadr_t& from );
 void SV_DirectConnect( const netadr_t& from, const Cmd::Args& args );
 
 void SV_ExecuteClientMessage( client_t *cl, msg_t *msg );
+bool SV_QueueClientMessage( client_t *cl, msg_t *msg );
+void SV_ShutdownClientMessages();
 void SV_UserinfoChanged( client_t *cl );
 
 void SV_ClientEnterWorld( client_t *client, usercmd_t *cmd );
@@ -367,6 +377,42 @@ void SV_ClientThink( client_t *cl, usercmd_t *cmd );
 
 void SV_WriteDownloadToClient( client_t *cl, msg_t *msg );
 
+//
+// sv_download.cpp
+//
+downloadPak_t         *SV_OpenDownloadPak( const std::string& path, FS::offset_t& length );
+void                  SV_CloseDownloadPak( downloadPak_t *pak );
+const downloadBlock_t *SV_AcquireDownloadBlock( downloadPak_t *pak, int blockNum, int *size );
+void                  SV_ReleaseDownloadBlock( const downloadBlock_t *block );
+const byte            *SV_DownloadBlockData( const downloadBlock_t *block );
+void                  SV_ShutdownDownloadCache();
+
+//
+// sv_profile.cpp
+//
+extern std::atomic<bool> sv_profileActive;
+
+void SV_ProfileRecord( const char *name, uint64_t start, uint64_t end );
+
+// Records the time spent in the enclosing scope while sv_profile is enabled,
+// name must be a string literal
+class SV_ProfileZone
+{
+public:
+	explicit SV_ProfileZone( const char *zoneName ) :
+		name( sv_profileActive.load( std::memory_order_relaxed ) ? zoneName : nullptr ), start( name ? TimeNs() : 0 ) {}
+	~SV_ProfileZone() { if ( name ) SV_ProfileRecord( name, start, TimeNs() ); }
+
+	SV_ProfileZone( const SV_ProfileZone& ) = delete;
+	SV_ProfileZone& operator=( const SV_ProfileZone& ) = delete;
+
+private:
+	const char *name;
+	uint64_t   start;
+};
+
+#define SV_PROFILE_ZONE( name ) SV_ProfileZone profileZone_##name( #name )
+
 //
 // sv_snapshot.c
 //
@@ -40,10 +40,18 @@ Maryland 20850 USA.
 #include "qcommon/sys.h"
 #include <common/FileSystem.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 // HTTP download params
 static Cvar::Cvar<bool> sv_wwwDownload("sv_wwwDownload", "have clients download missing paks via HTTP", Cvar::NONE, true);
 static Cvar::Cvar<std::string> sv_wwwBaseURL("sv_wwwBaseURL", "where clients download paks (must NOT be HTTPS, must contain PAKSERVER)", Cvar::NONE, WWW_BASEURL);
 static Cvar::Cvar<std::string> sv_wwwFallbackURL("sv_wwwFallbackURL", "alternative download site to sv_wwwBaseURL", Cvar::NONE, "");
+static Cvar::Range<Cvar::Cvar<int>> sv_playerStateDelta("sv_playerStateDelta",
+	"newest playerstate delta encoding offered to connecting clients (0 = legacy, 1 = adaptive field order)",
+	Cvar::NONE, PS_DELTA_VERSION, PS_DELTA_LEGACY, PS_DELTA_VERSION);
 
 static void SV_CloseDownload( client_t *cl );
 
@@ -200,6 +208,10 @@ void SV_DirectConnect( const netadr_t& from, const Cmd::Args& args )
 	// Save the pubkey
 	Q_strncpyz( new_client->pubkey, userinfo["pubkey"].c_str(), sizeof( new_client->pubkey ) );
 	userinfo.erase("pubkey");
+
+	// clients that don't send it only know the legacy encoding
+	new_client->psDelta.version = Math::Clamp( atoi( userinfo["psdelta"].c_str() ), int( PS_DELTA_LEGACY ), sv_playerStateDelta.Get() );
+	userinfo.erase("psdelta");
 	// save the userinfo
 	Q_strncpyz( new_client->userinfo, InfoMapToString(userinfo).c_str(), sizeof( new_client->userinfo ) );
 
@@ -454,24 +466,24 @@ static void SV_CloseDownload( client_t *cl )
 {
 	int i;
 
-	// EOF
-	if ( cl->download )
-	{
-		delete cl->download;
-		cl->download = nullptr;
-	}
-
-	*cl->downloadName = 0;
-
-	// Free the temporary buffer space
+	// Release the blocks before the pak, so that they can be reused by other downloads
 	for ( i = 0; i < MAX_DOWNLOAD_WINDOW; i++ )
 	{
 		if ( cl->downloadBlocks[ i ] )
 		{
-			Z_Free( cl->downloadBlocks[ i ] );
+			SV_ReleaseDownloadBlock( cl->downloadBlocks[ i ] );
 			cl->downloadBlocks[ i ] = nullptr;
 		}
 	}
+
+	// EOF
+	if ( cl->download )
+	{
+		SV_CloseDownloadPak( cl->download );
+		cl->download = nullptr;
+	}
+
+	*cl->downloadName = 0;
 }
 
 /*
@@ -837,9 +849,8 @@ void SV_WriteDownloadToClient( client_t *cl, msg_t *msg )
 
 			if (pak) {
 				try {
-					cl->download = new FS::File(FS::RawPath::OpenRead(pak->path));
-
-					const FS::offset_t length{cl->download->Length()};
+					FS::offset_t length;
+					cl->download = SV_OpenDownloadPak(pak->path, length);
 
 					if (length > std::numeric_limits<decltype(cl->downloadSize)>::max()) {
 						throw std::system_error{Util::ordinal(std::errc::value_too_large), std::system_category(),
@@ -879,19 +890,32 @@ void SV_WriteDownloadToClient( client_t *cl, msg_t *msg )
 	{
 		curindex = ( cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW );
 
-		if ( !cl->downloadBlocks[ curindex ] )
+		// The blocks are shared with other clients downloading the same pak and read by another thread
+		int blockSize;
+		const downloadBlock_t *block = SV_AcquireDownloadBlock( cl->download, cl->downloadCurrentBlock, &blockSize );
+
+		if ( !block )
 		{
-			cl->downloadBlocks[ curindex ] = ( byte* ) Z_Malloc( MAX_DOWNLOAD_BLKSIZE );
+			// Not read yet, try again next frame
+			break;
 		}
 
-		try {
-			cl->downloadBlockSize[ curindex ] = cl->download->Read(cl->downloadBlocks[ curindex ], MAX_DOWNLOAD_BLKSIZE);
-		} catch (std::system_error&) {
+		if ( blockSize < 0 )
+		{
 			// EOF right now
+			SV_ReleaseDownloadBlock( block );
 			cl->downloadCount = cl->downloadSize;
 			break;
 		}
 
+		if ( cl->downloadBlocks[ curindex ] )
+		{
+			SV_ReleaseDownloadBlock( cl->downloadBlocks[ curindex ] );
+		}
+
+		cl->downloadBlocks[ curindex ] = block;
+		cl->downloadBlockSize[ curindex ] = blockSize;
+
 		cl->downloadCount += cl->downloadBlockSize[ curindex ];
 
 		// Load in next block
@@ -988,7 +1012,7 @@ void SV_WriteDownloadToClient( client_t *cl, msg_t *msg )
 		// Write the block
 		if ( cl->downloadBlockSize[ curindex ] )
 		{
-			MSG_WriteData( msg, cl->downloadBlocks[ curindex ], cl->downloadBlockSize[ curindex ] );
+			MSG_WriteData( msg, SV_DownloadBlockData( cl->downloadBlocks[ curindex ] ), cl->downloadBlockSize[ curindex ] );
 		}
 
 		Log::Debug( "clientDownload: %d: writing block %d", ( int )( cl - svs.clients ), cl->downloadXmitBlock );
@@ -1168,11 +1192,8 @@ void SV_ExecuteClientCommand( client_t *cl, const char *s, bool premaprestart )
 SV_ClientCommand
 ===============
 */
-static bool SV_ClientCommand( client_t *cl, msg_t *msg, bool premaprestart )
+static bool SV_ClientCommand( client_t *cl, int seq, const char *s, bool premaprestart )
 {
-	auto seq = MSG_ReadLong( msg );
-	auto s = MSG_ReadString( msg );
-
 	// see if we have already executed it
 	if ( cl->lastClientCommand >= seq )
 	{
@@ -1199,6 +1220,26 @@ static bool SV_ClientCommand( client_t *cl, msg_t *msg, bool premaprestart )
 
 //==================================================================================
 
+/*
+A client packet read into plain values, which doesn't touch the client or the
+game so that it can be done away from the main thread, see SV_ReadClientMessage
+*/
+struct clientMessage_t
+{
+	client_t          *client;
+	msg_t             msg;
+	std::vector<byte> data;
+
+	int               serverId;
+	int               messageAcknowledge;
+	int               reliableAcknowledge;
+	std::vector<std::pair<int, std::string>> commands;
+	int               c; // byte after the commands, clc_move or clc_moveNoDelta if there are usercmds
+	int               cmdCount; // read from the message, usercmds are only read if in range
+	usercmd_t         cmds[ MAX_PACKET_USERCMDS ];
+	bool              missingEOF;
+};
+
 /*
 ==================
 SV_ClientThink
@@ -1230,12 +1271,11 @@ On very fast clients, there may be multiple usercmd packed into
 each of the backup packets.
 ==================
 */
-static void SV_UserMove( client_t *cl, msg_t *msg, bool delta )
+static void SV_UserMove( client_t *cl, clientMessage_t& message, bool delta )
 {
 	int       i;
 	int       cmdCount;
-	usercmd_t cmds[ MAX_PACKET_USERCMDS ];
-	usercmd_t *cmd, *oldcmd;
+	usercmd_t *cmds = message.cmds;
 
 	if ( delta )
 	{
@@ -1246,7 +1286,7 @@ static void SV_UserMove( client_t *cl, msg_t *msg, bool delta )
 		cl->deltaMessage = -1;
 	}
 
-	cmdCount = MSG_ReadByte( msg );
+	cmdCount = message.cmdCount;
 
 	if ( cmdCount < 1 )
 	{
@@ -1260,17 +1300,6 @@ static void SV_UserMove( client_t *cl, msg_t *msg, bool delta )
 		return;
 	}
 
-	usercmd_t nullcmd{};
-	oldcmd = &nullcmd;
-
-	for ( i = 0; i < cmdCount; i++ )
-	{
-		cmd = &cmds[ i ];
-		MSG_ReadDeltaUsercmd( msg, oldcmd, cmd );
-//      MSG_ReadDeltaUsercmd( msg, oldcmd, cmd );
-		oldcmd = cmd;
-	}
-
 	// save time for ping calculation
 	cl->frames[ cl->messageAcknowledge & PACKET_MASK ].messageAcked = svs.time;
 
@@ -1317,22 +1346,103 @@ USER CMD EXECUTION
 ===========================================================================
 */
 
+// MSG_ReadString uses a static buffer
+static void SV_ReadClientString( msg_t *msg, std::string& s )
+{
+	s.clear();
+
+	while ( s.size() < MAX_STRING_CHARS - 1 )
+	{
+		int c = MSG_ReadByte( msg );  // use ReadByte so -1 is out of bounds
+
+		if ( c == -1 || c == 0 )
+		{
+			break;
+		}
+
+		s += c;
+	}
+}
+
 /*
 ===================
-SV_ExecuteClientMessage
+SV_ReadClientMessage
 
-Parse a client packet
+Reads everything in a client packet, can run on any thread
 ===================
 */
-void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
+static void SV_ReadClientMessage( clientMessage_t& message )
 {
-	int c;
-	int serverId;
+	msg_t *msg = &message.msg;
+
+	SV_PROFILE_ZONE( SV_ReadClientMessage );
 
 	MSG_Bitstream( msg );
 
-	serverId = MSG_ReadLong( msg );
-	cl->messageAcknowledge = MSG_ReadLong( msg );
+	message.serverId = MSG_ReadLong( msg );
+	message.messageAcknowledge = MSG_ReadLong( msg );
+	message.reliableAcknowledge = MSG_ReadLong( msg );
+
+	// optional clientCommand strings
+	size_t numCommands = 0;
+
+	for (;;)
+	{
+		message.c = MSG_ReadByte( msg );
+
+		if ( message.c != clc_clientCommand )
+		{
+			break;
+		}
+
+		if ( numCommands == message.commands.size() )
+		{
+			message.commands.emplace_back();
+		}
+
+		message.commands[ numCommands ].first = MSG_ReadLong( msg );
+		SV_ReadClientString( msg, message.commands[ numCommands ].second );
+		numCommands++;
+	}
+
+	// the vector is kept around with the message to reuse the strings
+	message.commands.resize( numCommands );
+
+	// the usercmd_t
+	message.cmdCount = 0;
+
+	if ( message.c == clc_move || message.c == clc_moveNoDelta )
+	{
+		message.cmdCount = MSG_ReadByte( msg );
+
+		if ( message.cmdCount >= 1 && message.cmdCount <= MAX_PACKET_USERCMDS )
+		{
+			usercmd_t nullcmd{};
+			usercmd_t *oldcmd = &nullcmd;
+
+			for ( int i = 0; i < message.cmdCount; i++ )
+			{
+				MSG_ReadDeltaUsercmd( msg, oldcmd, &message.cmds[ i ] );
+				oldcmd = &message.cmds[ i ];
+			}
+		}
+	}
+
+	message.missingEOF = message.c != clc_EOF && MSG_ReadByte( msg ) != clc_EOF;
+}
+
+/*
+===================
+SV_ExecuteReadClientMessage
+
+Acts on a packet read by SV_ReadClientMessage
+===================
+*/
+static void SV_ExecuteReadClientMessage( client_t *cl, clientMessage_t& message )
+{
+	int c = message.c;
+
+	cl->messageAcknowledge = message.messageAcknowledge;
 
 	if ( cl->messageAcknowledge < 0 )
 	{
@@ -1344,7 +1454,7 @@ void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
 		return;
 	}
 
-	cl->reliableAcknowledge = MSG_ReadLong( msg );
+	cl->reliableAcknowledge = message.reliableAcknowledge;
 
 	// NOTE: when the client message is fux0red the acknowledgement numbers
 	// can be out of range, this could cause the server to send thousands of server
@@ -1372,9 +1482,9 @@ void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
 	// don't drop as long as previous command was a nextdl, after a dl is done, downloadName is set back to ""
 	// but we still need to read the next message to move to next download or send gamestate
 	// I don't like this hack though, it must have been working fine at some point, suspecting the fix is somewhere else
-	if ( serverId != sv.serverId && !*cl->downloadName && !strstr( cl->lastClientCommandString, "nextdl" ) )
+	if ( message.serverId != sv.serverId && !*cl->downloadName && !strstr( cl->lastClientCommandString, "nextdl" ) )
 	{
-		if ( serverId >= sv.restartedServerId && serverId < sv.serverId )
+		if ( message.serverId >= sv.restartedServerId && message.serverId < sv.serverId )
 		{
 			// TTimo - use a comparison here to catch multiple map_restart
 			// they just haven't caught the map_restart yet
@@ -1390,22 +1500,10 @@ void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
 			SV_SendClientGameState( cl );
 		}
 
-		// read optional clientCommand strings
-		do
+		// optional clientCommand strings
+		for ( const auto& command : message.commands )
 		{
-			c = MSG_ReadByte( msg );
-
-			if ( c == clc_EOF )
-			{
-				break;
-			}
-
-			if ( c != clc_clientCommand )
-			{
-				break;
-			}
-
-			if ( !SV_ClientCommand( cl, msg, true ) )
+			if ( !SV_ClientCommand( cl, command.first, command.second.c_str(), true ) )
 			{
 				return; // we couldn't execute it because of the flood protection
 			}
@@ -1415,22 +1513,14 @@ void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
 				return; // disconnect command
 			}
 		}
-		while ( true );
 
 		return;
 	}
 
-	// read optional clientCommand strings
-	for (;;)
+	// optional clientCommand strings
+	for ( const auto& command : message.commands )
 	{
-		c = MSG_ReadByte( msg );
-
-		if ( c != clc_clientCommand )
-		{
-			break;
-		}
-
-		if ( !SV_ClientCommand( cl, msg, false ) )
+		if ( !SV_ClientCommand( cl, command.first, command.second.c_str(), false ) )
 		{
 			return; // we couldn't execute it because of the flood protection
 		}
@@ -1441,15 +1531,15 @@ void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
 		}
 	}
 
-	// read the usercmd_t
+	// the usercmd_t
 	if (c == clc_move) {
-		SV_UserMove(cl, msg, true);
+		SV_UserMove(cl, message, true);
 	} else if (c == clc_moveNoDelta) {
-		SV_UserMove(cl, msg, false);
+		SV_UserMove(cl, message, false);
 	} else if (c != clc_EOF) {
 		Log::Warn("bad command byte for client %i", (int) (cl - svs.clients));
 	}
-	if (c != clc_EOF && MSG_ReadByte(msg) != clc_EOF) {
+	if (message.missingEOF) {
 		Log::Warn("missing clc_EOF byte for client %i", (int) (cl - svs.clients));
 	}
 
@@ -1458,3 +1548,262 @@ void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
 //		Log::Warn("Junk at end of packet for client %i (%i bytes), read %i of %i bytes", cl - svs.clients, msg->cursize - msg->readcount, msg->readcount, msg->cursize);
 //	}
 }
+
+/*
+===================
+SV_ExecuteClientMessage
+
+Parse a client packet
+===================
+*/
+void SV_ExecuteClientMessage( client_t *cl, msg_t *msg )
+{
+	clientMessage_t message;
+
+	SV_PROFILE_ZONE( SV_ExecuteClientMessage );
+
+	message.msg = *msg;
+	SV_ReadClientMessage( message );
+	SV_ExecuteReadClientMessage( cl, message );
+}
+
+/*
+===========================================================================
+
+BATCHED CLIENT MESSAGES
+
+With sv_clientMessageThreads set, SV_PacketEvent queues the packets of clients
+after their netchan has accepted them. Once the pending network events are
+handled, SV_FlushClientMessages reads the queued packets on several threads,
+the Huffman decoding of the usercmds being most of the work, then executes
+them on the main thread in client number order.
+
+===========================================================================
+*/
+
+static Cvar::Range<Cvar::Cvar<int>> sv_clientMessageThreads( "sv_clientMessageThreads",
+	"threads helping the main one read client packets, 0 executes each packet as it arrives", Cvar::NONE, 2, 0, 16 );
+
+// below this many queued packets, reading them on the main thread is faster than waking the workers
+static const size_t MIN_PARALLEL_CLIENT_MESSAGES = 8;
+
+// what Huffman decoding a malformed message may read past its end
+static const int CLIENT_MESSAGE_SLACK = 2048;
+
+namespace {
+class ClientMessageReader
+{
+public:
+	~ClientMessageReader()
+	{
+		Stop();
+	}
+
+	// reads all messages, workers included while there are enough of them
+	void Read( clientMessage_t **messages, size_t count )
+	{
+		size_t numThreads = sv_clientMessageThreads.Get();
+
+		if ( count < MIN_PARALLEL_CLIENT_MESSAGES || !numThreads )
+		{
+			for ( size_t i = 0; i < count; i++ )
+			{
+				SV_ReadClientMessage( *messages[ i ] );
+			}
+
+			return;
+		}
+
+		if ( workers_.size() != numThreads )
+		{
+			Stop();
+			Start( numThreads );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( mutex_ );
+			messages_ = messages;
+			count_ = count;
+			next_ = 0;
+			busy_ = workers_.size();
+			generation_++;
+		}
+
+		wake_.notify_all();
+		Work();
+
+		std::unique_lock<std::mutex> lock( mutex_ );
+		done_.wait( lock, [ this ] { return busy_ == 0; } );
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex_ );
+			halt_ = true;
+		}
+
+		wake_.notify_all();
+
+		for ( std::thread& worker : workers_ )
+		{
+			worker.join();
+		}
+
+		workers_.clear();
+		halt_ = false;
+	}
+
+private:
+	std::vector<std::thread> workers_;
+	std::condition_variable  wake_;
+	std::condition_variable  done_;
+	std::mutex               mutex_; // guards everything below but next_
+	bool                     halt_ = false;
+	unsigned                 generation_ = 0;
+	size_t                   busy_ = 0; // workers still reading the current batch
+	clientMessage_t          **messages_ = nullptr;
+	size_t                   count_ = 0;
+	std::atomic<size_t>      next_{ 0 };
+
+	void Start( size_t numThreads )
+	{
+		for ( size_t i = 0; i < numThreads; i++ )
+		{
+			workers_.emplace_back( &ClientMessageReader::WorkerMain, this, generation_ );
+		}
+	}
+
+	void Work()
+	{
+		for ( size_t i; ( i = next_.fetch_add( 1 ) ) < count_; )
+		{
+			SV_ReadClientMessage( *messages_[ i ] );
+		}
+	}
+
+	void WorkerMain( unsigned seen )
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+
+		for (;;)
+		{
+			wake_.wait( lock, [ this, seen ] { return halt_ || generation_ != seen; } );
+
+			if ( halt_ )
+			{
+				return;
+			}
+
+			seen = generation_;
+			lock.unlock();
+			Work();
+			lock.lock();
+
+			if ( --busy_ == 0 )
+			{
+				done_.notify_one();
+			}
+		}
+	}
+};
+} // namespace
+
+static ClientMessageReader clientMessageReader;
+
+// messages_[ 0 .. numQueuedMessages - 1 ] are queued, the others are kept for reuse
+static std::vector<std::unique_ptr<clientMessage_t>> queuedMessages;
+static size_t numQueuedMessages;
+
+/*
+===================
+SV_QueueClientMessage
+
+Queues a packet accepted by the client's netchan for SV_FlushClientMessages,
+returns false if it has to be executed right away
+===================
+*/
+bool SV_QueueClientMessage( client_t *cl, msg_t *msg )
+{
+	if ( !sv_clientMessageThreads.Get() )
+	{
+		return false;
+	}
+
+	if ( numQueuedMessages == queuedMessages.size() )
+	{
+		queuedMessages.emplace_back( new clientMessage_t );
+	}
+
+	clientMessage_t& message = *queuedMessages[ numQueuedMessages++ ];
+
+	message.client = cl;
+	message.data.assign( msg->data, msg->data + msg->cursize );
+	message.data.resize( msg->cursize + CLIENT_MESSAGE_SLACK );
+
+	MSG_Init( &message.msg, message.data.data(), message.data.size() );
+	message.msg.cursize = msg->cursize;
+	message.msg.readcount = msg->readcount;
+	message.msg.bit = msg->bit;
+	message.msg.oob = msg->oob;
+
+	return true;
+}
+
+/*
+===================
+SV_FlushClientMessages
+
+Reads the queued packets and executes them, clients in order and the packets
+of each client in the order they came
+===================
+*/
+void SV_FlushClientMessages()
+{
+	if ( !numQueuedMessages )
+	{
+		return;
+	}
+
+	SV_PROFILE_ZONE( SV_FlushClientMessages );
+
+	std::vector<clientMessage_t *> messages;
+	messages.reserve( numQueuedMessages );
+
+	for ( size_t i = 0; i < numQueuedMessages; i++ )
+	{
+		messages.push_back( queuedMessages[ i ].get() );
+	}
+
+	numQueuedMessages = 0;
+
+	clientMessageReader.Read( messages.data(), messages.size() );
+
+	std::stable_sort( messages.begin(), messages.end(), []( const clientMessage_t *a, const clientMessage_t *b ) {
+		return a->client < b->client;
+	} );
+
+	for ( clientMessage_t *message : messages )
+	{
+		client_t *cl = message->client;
+
+		// may have been dropped by an earlier message or command
+		if ( cl->state == clientState_t::CS_FREE || cl->state == clientState_t::CS_ZOMBIE )
+		{
+			continue;
+		}
+
+		SV_ExecuteReadClientMessage( cl, *message );
+	}
+}
+
+/*
+===================
+SV_ShutdownClientMessages
+===================
+*/
+void SV_ShutdownClientMessages()
+{
+	numQueuedMessages = 0;
+	clientMessageReader.Stop();
+}
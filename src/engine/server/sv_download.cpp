@@ -0,0 +1,441 @@
+/*
+===========================================================================
+
+Daemon BSD Source Code
+Copyright (c) 2026 Daemon Developers
+All rights reserved.
+
+This file is part of the Daemon BSD Source Code (Daemon Source Code).
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+// sv_download.cpp: pak blocks shared by all clients doing UDP downloads
+
+#include "server.h"
+#include <common/FileSystem.h>
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+
+static Cvar::Range<Cvar::Cvar<int>> sv_dl_cacheSize( "sv_dl_cacheSize",
+	"max KiB of pak data kept in memory for UDP downloads", Cvar::NONE, 16384, 256, 1048576 );
+
+// How many blocks past the one a client asks for are read in advance
+static const int DOWNLOAD_READAHEAD_BLOCKS = MAX_DOWNLOAD_WINDOW;
+
+struct downloadBlock_t
+{
+	downloadPak_t *pak;
+	int           blockNum;
+	int           refCount = 0;
+	int           size = 0; // -1 if the read failed
+	bool          ready = false; // set by the reader thread once data and size are valid
+	std::list<downloadBlock_t *>::iterator lru; // only valid while ready and unreferenced
+	byte          data[ MAX_DOWNLOAD_BLKSIZE ];
+};
+
+struct downloadPak_t
+{
+	std::string path;
+	FS::File    file; // used by the reader thread while pendingReads is non-zero
+	FS::offset_t length = 0;
+	int         clients = 0;
+	int         pendingReads = 0;
+	std::unordered_map<int, downloadBlock_t *> blocks;
+};
+
+namespace {
+// All functions in this class besides ReaderMain are intended to be called
+// by the server main thread only.
+class DownloadCache
+{
+private:
+	std::unordered_map<std::string, std::unique_ptr<downloadPak_t>> paks_;
+	std::list<downloadBlock_t *> lru_; // ready blocks no client is using, oldest first
+	std::deque<downloadBlock_t *> requests_;
+	std::thread readerThread_;
+	std::condition_variable alarm_;
+	std::mutex mutex_; // Guards everything above except block data and pak files, and halt_
+	bool halt_ = false;
+
+	size_t memory_ = 0;
+
+	// Statistics
+	uint64_t served_ = 0;
+	uint64_t waits_ = 0;
+	uint64_t reads_ = 0;
+	uint64_t readBytes_ = 0;
+	uint64_t evictions_ = 0;
+
+	void ReaderMain()
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+		while ( !halt_ )
+		{
+			if ( requests_.empty() )
+			{
+				alarm_.wait( lock );
+				continue;
+			}
+
+			downloadBlock_t *block = requests_.front();
+			requests_.pop_front();
+			downloadPak_t *pak = block->pak;
+			lock.unlock();
+
+			int size;
+			{
+				SV_PROFILE_ZONE( SV_ReadDownloadBlock );
+				try {
+					pak->file.SeekSet( FS::offset_t( block->blockNum ) * MAX_DOWNLOAD_BLKSIZE );
+					size = pak->file.Read( block->data, MAX_DOWNLOAD_BLKSIZE );
+				} catch ( std::system_error& ex ) {
+					Log::Warn( "Failed to read block %d of %s: %s", block->blockNum, pak->path, ex.what() );
+					size = -1;
+				}
+			}
+
+			lock.lock();
+			block->size = size;
+			block->ready = true;
+			pak->pendingReads--;
+			reads_++;
+			readBytes_ += std::max( size, 0 );
+
+			if ( !block->refCount )
+			{
+				ReleaseUnused( block );
+			}
+		}
+	}
+
+	// Called with mutex_ held when a ready block isn't used by any client
+	void ReleaseUnused( downloadBlock_t *block )
+	{
+		if ( block->size < 0 )
+		{
+			// Failures are evicted first so that a later download tries again
+			lru_.push_front( block );
+			block->lru = lru_.begin();
+			return;
+		}
+
+		lru_.push_back( block );
+		block->lru = std::prev( lru_.end() );
+	}
+
+	void FreeBlock( downloadBlock_t *block )
+	{
+		block->pak->blocks.erase( block->blockNum );
+		memory_ -= sizeof( downloadBlock_t );
+		delete block;
+	}
+
+	void Evict( size_t needed )
+	{
+		const size_t cap = size_t( sv_dl_cacheSize.Get() ) * 1024;
+
+		while ( memory_ + needed > cap && !lru_.empty() )
+		{
+			downloadBlock_t *block = lru_.front();
+			lru_.pop_front();
+			FreeBlock( block );
+			evictions_++;
+		}
+	}
+
+	// Blocks that are only read ahead are not allocated past the memory cap,
+	// blocks a client is waiting for always are
+	downloadBlock_t *FindOrRequest( downloadPak_t *pak, int blockNum, bool readAhead )
+	{
+		auto it = pak->blocks.find( blockNum );
+
+		if ( it != pak->blocks.end() )
+		{
+			return it->second;
+		}
+
+		Evict( sizeof( downloadBlock_t ) );
+
+		if ( readAhead && memory_ + sizeof( downloadBlock_t ) > size_t( sv_dl_cacheSize.Get() ) * 1024 )
+		{
+			return nullptr;
+		}
+
+		downloadBlock_t *block = new downloadBlock_t;
+		block->pak = pak;
+		block->blockNum = blockNum;
+		pak->blocks[ blockNum ] = block;
+		pak->pendingReads++;
+		memory_ += sizeof( downloadBlock_t );
+
+		requests_.push_back( block );
+
+		if ( readerThread_.joinable() )
+		{
+			alarm_.notify_one();
+		}
+		else
+		{
+			// Start thread on first use
+			Log::Debug( "Starting download reader thread" );
+			readerThread_ = std::thread( &DownloadCache::ReaderMain, this );
+		}
+
+		return block;
+	}
+
+	// Close the files of paks no client is downloading anymore, and forget the paks that have nothing cached
+	void CollectGarbage()
+	{
+		for ( auto it = paks_.begin(); it != paks_.end(); )
+		{
+			downloadPak_t *pak = it->second.get();
+
+			if ( pak->clients || pak->pendingReads )
+			{
+				++it;
+				continue;
+			}
+
+			pak->file = FS::File();
+
+			if ( pak->blocks.empty() )
+			{
+				it = paks_.erase( it );
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+public:
+	downloadPak_t *Open( const std::string& path, FS::offset_t& length )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		std::unique_ptr<downloadPak_t>& pak = paks_[ path ];
+
+		if ( !pak )
+		{
+			pak.reset( new downloadPak_t );
+			pak->path = path;
+		}
+
+		if ( !pak->file )
+		{
+			try {
+				pak->file = FS::RawPath::OpenRead( path );
+				pak->length = pak->file.Length();
+			} catch ( std::system_error& ) {
+				CollectGarbage();
+				throw;
+			}
+		}
+
+		pak->clients++;
+		length = pak->length;
+
+		return pak.get();
+	}
+
+	void Close( downloadPak_t *pak )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		pak->clients--;
+		CollectGarbage();
+	}
+
+	const downloadBlock_t *Acquire( downloadPak_t *pak, int blockNum )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		downloadBlock_t *block = FindOrRequest( pak, blockNum, false );
+
+		for ( int i = 1; i <= DOWNLOAD_READAHEAD_BLOCKS; i++ )
+		{
+			if ( FS::offset_t( blockNum + i ) * MAX_DOWNLOAD_BLKSIZE >= pak->length )
+			{
+				break;
+			}
+
+			FindOrRequest( pak, blockNum + i, true );
+		}
+
+		if ( !block->ready )
+		{
+			waits_++;
+			return nullptr;
+		}
+
+		if ( !block->refCount++ )
+		{
+			lru_.erase( block->lru );
+		}
+
+		served_++;
+		return block;
+	}
+
+	void Release( const downloadBlock_t *constBlock )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		downloadBlock_t *block = const_cast<downloadBlock_t *>( constBlock );
+
+		if ( !--block->refCount )
+		{
+			ReleaseUnused( block );
+		}
+	}
+
+	void PrintInfo()
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		size_t numBlocks = 0;
+		int numClients = 0;
+		for ( const auto& pak : paks_ )
+		{
+			numBlocks += pak.second->blocks.size();
+			numClients += pak.second->clients;
+		}
+
+		Log::Notice( "%d paks, %d clients, %d blocks, %d unused, %d pending",
+			paks_.size(), numClients, numBlocks, lru_.size(), requests_.size() );
+		Log::Notice( "%d KiB used out of %d KiB", memory_ / 1024, sv_dl_cacheSize.Get() );
+		Log::Notice( "%d blocks served, %d waits, %d reads (%d KiB), %d evictions",
+			served_, waits_, reads_, readBytes_ / 1024, evictions_ );
+
+		if ( served_ )
+		{
+			Log::Notice( "hit rate: %.1f%%", 100.0 * ( 1.0 - std::min( 1.0, double( reads_ ) / served_ ) ) );
+		}
+	}
+
+	void Shutdown()
+	{
+		if ( readerThread_.joinable() )
+		{
+			{
+				std::lock_guard<std::mutex> lock( mutex_ );
+				halt_ = true;
+			}
+
+			Log::Debug( "Stopping download reader thread" );
+			alarm_.notify_one();
+			readerThread_.join();
+			halt_ = false;
+		}
+
+		for ( const auto& pak : paks_ )
+		{
+			for ( const auto& block : pak.second->blocks )
+			{
+				delete block.second;
+			}
+		}
+
+		paks_.clear();
+		lru_.clear();
+		requests_.clear();
+		memory_ = 0;
+	}
+};
+} // namespace
+
+static DownloadCache downloadCache;
+
+/*
+==================
+SV_OpenDownloadPak
+
+Throws std::system_error if the pak can't be opened
+==================
+*/
+downloadPak_t *SV_OpenDownloadPak( const std::string& path, FS::offset_t& length )
+{
+	return downloadCache.Open( path, length );
+}
+
+void SV_CloseDownloadPak( downloadPak_t *pak )
+{
+	downloadCache.Close( pak );
+}
+
+/*
+==================
+SV_AcquireDownloadBlock
+
+Returns nullptr while the block is still being read, the next blocks are read ahead in any case.
+A block with a negative size means the read failed, it still has to be released
+==================
+*/
+const downloadBlock_t *SV_AcquireDownloadBlock( downloadPak_t *pak, int blockNum, int *size )
+{
+	const downloadBlock_t *block = downloadCache.Acquire( pak, blockNum );
+
+	if ( block )
+	{
+		*size = block->size;
+	}
+
+	return block;
+}
+
+void SV_ReleaseDownloadBlock( const downloadBlock_t *block )
+{
+	downloadCache.Release( block );
+}
+
+const byte *SV_DownloadBlockData( const downloadBlock_t *block )
+{
+	return block->data;
+}
+
+void SV_ShutdownDownloadCache()
+{
+	downloadCache.Shutdown();
+}
+
+class DownloadCacheInfoCmd: public Cmd::StaticCmd
+{
+public:
+	DownloadCacheInfoCmd():
+		StaticCmd("downloadCacheInfo", Cmd::SERVER, "Shows the state of the pak block cache used by UDP downloads")
+	{}
+
+	void Run(const Cmd::Args&) const override
+	{
+		downloadCache.PrintInfo();
+	}
+};
+static DownloadCacheInfoCmd downloadCacheInfoCmdRegistration;
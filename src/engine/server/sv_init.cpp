@@ -720,6 +720,9 @@ void SV_Shutdown( const char *finalmsg )
 		Z_Free( svs.clients );
 	}
 
+	SV_ShutdownDownloadCache();
+	SV_ShutdownClientMessages();
+
 	ResetStruct( svs );
 
 	svs.serverLoad = -1;
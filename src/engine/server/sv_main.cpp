@@ -1080,6 +1080,8 @@ void SV_PacketEvent( const netadr_t& from, msg_t *msg )
 	client_t *cl;
 	int      qport;
 
+	SV_PROFILE_ZONE( SV_PacketEvent );
+
 	if ( !SV_IsAllowedNetwork( from ) )
 	{
 		return;
@@ -1088,6 +1090,8 @@ void SV_PacketEvent( const netadr_t& from, msg_t *msg )
 	// check for connectionless packet (0xffffffff) first
 	if ( msg->cursize >= 4 && * ( int * ) msg->data == -1 )
 	{
+		// keep the order of queued client packets and connects, rcon...
+		SV_FlushClientMessages();
 		SV_ConnectionlessPacket( from, msg );
 		return;
 	}
@@ -1136,7 +1140,11 @@ void SV_PacketEvent( const netadr_t& from, msg_t *msg )
 			if ( cl->state != clientState_t::CS_ZOMBIE )
 			{
 				cl->lastPacketTime = svs.time; // don't timeout
-				SV_ExecuteClientMessage( cl, msg );
+
+				if ( !SV_QueueClientMessage( cl, msg ) )
+				{
+					SV_ExecuteClientMessage( cl, msg );
+				}
 			}
 		}
 
@@ -1345,6 +1353,8 @@ void SV_Frame( int msec )
 		return;
 	}
 
+	SV_PROFILE_ZONE( SV_Frame );
+
 	// if time is about to hit the 32nd bit, kick all clients
 	// and clear sv.time, rather
 	// than checking for negative time wraparound everywhere.
@@ -100,6 +100,8 @@ then buffer them and make sure they get sent in correct order
 */
 void SV_Netchan_Transmit( client_t *client, msg_t *msg )
 {
+	SV_PROFILE_ZONE( SV_Netchan_Transmit );
+
 	//int length, const byte *data ) {
 	MSG_WriteByte( msg, svc_EOF );
 
@@ -0,0 +1,327 @@
+/*
+===========================================================================
+
+Daemon BSD Source Code
+Copyright (c) 2026 Daemon Developers
+All rights reserved.
+
+This file is part of the Daemon BSD Source Code (Daemon Source Code).
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+// sv_profile.cpp: scoped timing zones of the server frame, exported as Chrome traces
+
+#include "server.h"
+#include <common/FileSystem.h>
+
+#include <mutex>
+
+static void SV_ProfileSetActive( bool active );
+
+// Read by the recording threads, the cvar itself is only used on the main thread
+std::atomic<bool> sv_profileActive( false );
+
+static Cvar::Callback<Cvar::Cvar<bool>> sv_profile( "sv_profile",
+	"record the time spent in parts of the server frame, see sv_profileExport; turning it off discards the events",
+	Cvar::NONE, false, SV_ProfileSetActive );
+
+// Events kept per thread, older ones are overwritten
+static const size_t PROFILE_EVENTS_PER_THREAD = 65536;
+
+// Relaxed atomics, so that an export can read a ring its thread is writing to
+struct profileEvent_t
+{
+	std::atomic<const char *> name;
+	std::atomic<uint64_t>     start;
+	std::atomic<uint64_t>     end;
+};
+
+struct profileExportEvent_t
+{
+	const char *name;
+	uint64_t   start;
+	uint64_t   end;
+};
+
+/*
+Each thread that records a zone gets its own ring, so recording a zone never takes
+a lock. The ring is only written by its thread, which counts the events it wrote
+after writing each of them; an export reads the ring concurrently and discards the
+events that may have been overwritten while it was copying them.
+
+The rings are freed on the main thread when profiling stops. A thread sets recording
+before checking sv_profileActive again, so a ring is never freed under its writer.
+*/
+struct profileThread_t
+{
+	int                                  tid;
+	bool                                 mainThread;
+	std::atomic<bool>                    recording{ false };
+	std::atomic<size_t>                  written{ 0 };
+	std::atomic<profileEvent_t *>        events{ nullptr };
+};
+
+static std::mutex profileThreadsLock; // Guards the list, not the rings
+static std::vector<std::unique_ptr<profileThread_t>> profileThreads;
+static thread_local profileThread_t *profileThread = nullptr;
+
+static profileThread_t *SV_ProfileRegisterThread()
+{
+	std::lock_guard<std::mutex> guard( profileThreadsLock );
+
+	profileThreads.emplace_back( new profileThread_t );
+	profileThread_t *thread = profileThreads.back().get();
+	thread->tid = profileThreads.size() - 1;
+	thread->mainThread = Sys::OnMainThread();
+
+	return thread;
+}
+
+/*
+==================
+SV_ProfileRecord
+==================
+*/
+void SV_ProfileRecord( const char *name, uint64_t start, uint64_t end )
+{
+	if ( !profileThread )
+	{
+		profileThread = SV_ProfileRegisterThread();
+	}
+
+	profileThread_t *thread = profileThread;
+	thread->recording.store( true );
+
+	if ( !sv_profileActive.load() )
+	{
+		thread->recording.store( false, std::memory_order_release );
+		return;
+	}
+
+	profileEvent_t *events = thread->events.load( std::memory_order_relaxed );
+
+	if ( !events )
+	{
+		events = new profileEvent_t[ PROFILE_EVENTS_PER_THREAD ]();
+		thread->events.store( events, std::memory_order_release );
+	}
+
+	size_t written = thread->written.load( std::memory_order_relaxed );
+
+	// An export that reads this event must then see the count from before it
+	std::atomic_thread_fence( std::memory_order_release );
+
+	profileEvent_t &event = events[ written % PROFILE_EVENTS_PER_THREAD ];
+
+	event.name.store( name, std::memory_order_relaxed );
+	event.start.store( start, std::memory_order_relaxed );
+	event.end.store( end, std::memory_order_relaxed );
+
+	thread->written.store( written + 1, std::memory_order_release );
+	thread->recording.store( false, std::memory_order_release );
+}
+
+// Called on the main thread when the cvar changes
+static void SV_ProfileSetActive( bool active )
+{
+	sv_profileActive.store( active );
+
+	if ( active )
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard( profileThreadsLock );
+
+	for ( const auto& thread : profileThreads )
+	{
+		// A zone may have seen the cvar on just before it was turned off
+		while ( thread->recording.load() )
+		{
+			std::this_thread::yield();
+		}
+
+		delete[] thread->events.exchange( nullptr );
+		thread->written.store( 0, std::memory_order_relaxed );
+	}
+}
+
+// Copies the events a thread recorded, oldest first
+static std::vector<profileExportEvent_t> SV_ProfileCopyEvents( const profileThread_t &thread )
+{
+	std::vector<profileExportEvent_t> events;
+	const profileEvent_t *ring = thread.events.load( std::memory_order_acquire );
+
+	if ( !ring )
+	{
+		return events;
+	}
+
+	const size_t end = thread.written.load( std::memory_order_acquire );
+	const size_t begin = end > PROFILE_EVENTS_PER_THREAD ? end - PROFILE_EVENTS_PER_THREAD : 0;
+
+	events.reserve( end - begin );
+
+	for ( size_t i = begin; i < end; i++ )
+	{
+		const profileEvent_t &event = ring[ i % PROFILE_EVENTS_PER_THREAD ];
+		events.push_back( { event.name.load( std::memory_order_relaxed ),
+			event.start.load( std::memory_order_relaxed ), event.end.load( std::memory_order_relaxed ) } );
+	}
+
+	// Events written during the copy, and the one being written, may have overwritten the oldest ones
+	std::atomic_thread_fence( std::memory_order_acquire );
+	const size_t after = thread.written.load( std::memory_order_relaxed ) + 1;
+	const size_t safeBegin = after > PROFILE_EVENTS_PER_THREAD ? after - PROFILE_EVENTS_PER_THREAD : 0;
+
+	if ( safeBegin > begin )
+	{
+		events.erase( events.begin(), events.begin() + std::min( safeBegin - begin, events.size() ) );
+	}
+
+	return events;
+}
+
+/*
+==================
+SV_ProfileExport
+
+Writes the recorded zones as complete ("X") events of the Chrome trace event
+format, which chrome://tracing and Perfetto load directly. Timestamps are in
+microseconds from the oldest event.
+==================
+*/
+static void SV_ProfileExport( const std::string& name )
+{
+	std::vector<std::pair<int, std::vector<profileExportEvent_t>>> threads;
+	std::vector<bool> mainThreads;
+
+	{
+		std::lock_guard<std::mutex> guard( profileThreadsLock );
+
+		for ( const auto& thread : profileThreads )
+		{
+			threads.emplace_back( thread->tid, SV_ProfileCopyEvents( *thread ) );
+			mainThreads.push_back( thread->mainThread );
+		}
+	}
+
+	uint64_t origin = UINT64_MAX;
+	size_t numEvents = 0;
+
+	for ( const auto& thread : threads )
+	{
+		for ( const profileExportEvent_t& event : thread.second )
+		{
+			origin = std::min( origin, event.start );
+		}
+
+		numEvents += thread.second.size();
+	}
+
+	if ( !numEvents )
+	{
+		Log::Notice( "No server profile events recorded, set sv_profile to 1 first" );
+		return;
+	}
+
+	try
+	{
+		FS::File file = FS::HomePath::OpenWrite( name );
+		std::string buffer = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		const char *separator = "";
+
+		for ( size_t i = 0; i < threads.size(); i++ )
+		{
+			int tid = threads[ i ].first;
+
+			buffer += Str::Format( "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				separator, tid, mainThreads[ i ] ? "main" : Str::Format( "thread %d", tid ) );
+			separator = ",\n";
+
+			for ( const profileExportEvent_t& event : threads[ i ].second )
+			{
+				buffer += Str::Format( ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, tid, ( event.start - origin ) / 1000.0, ( event.end - event.start ) / 1000.0 );
+
+				if ( buffer.size() >= 1 << 16 )
+				{
+					file.Write( buffer.data(), buffer.size() );
+					buffer.clear();
+				}
+			}
+		}
+
+		buffer += "\n]}\n";
+		file.Write( buffer.data(), buffer.size() );
+
+		Log::Notice( "Wrote %d server profile events from %d threads to %s", numEvents, threads.size(), name );
+	}
+	catch ( std::system_error& err )
+	{
+		Log::Warn( "Couldn't write the server profile to %s: %s", name, err.what() );
+	}
+}
+
+/*
+==================
+SV_ProfileClear
+==================
+*/
+static void SV_ProfileClear()
+{
+	// Same as turning profiling off and on again
+	if ( sv_profileActive.load() )
+	{
+		SV_ProfileSetActive( false );
+		SV_ProfileSetActive( true );
+	}
+}
+
+class ProfileExportCmd: public Cmd::StaticCmd
+{
+public:
+	ProfileExportCmd():
+		StaticCmd("sv_profileExport", Cmd::SERVER, "Writes the zones recorded with sv_profile as a Chrome trace (JSON) to the homepath")
+	{}
+
+	void Run(const Cmd::Args& args) const override
+	{
+		if (args.Argc() > 2)
+		{
+			PrintUsage(args, "[<file> | clear]");
+			return;
+		}
+
+		if (args.Argc() == 2 && args.Argv(1) == "clear")
+		{
+			SV_ProfileClear();
+			return;
+		}
+
+		SV_ProfileExport(args.Argc() == 2 ? args.Argv(1) : "serverprofile.json");
+	}
+};
+static ProfileExportCmd profileExportCmdRegistration;
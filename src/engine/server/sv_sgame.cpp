@@ -435,6 +435,7 @@ void GameVM::GameClientThink(int clientNum)
 
 void GameVM::GameRunFrame(int levelTime)
 {
+	SV_PROFILE_ZONE( GameRunFrameMsg );
 	this->SendMsg<GameRunFrameMsg>(levelTime);
 }
 
@@ -443,6 +444,13 @@ void GameVM::BotAIStartFrame(int)
 	Sys::Drop("GameVM::BotAIStartFrame not implemented");
 }
 
+void GameVM::FlushPendingMsgs()
+{
+	if (services) {
+		services->FlushCvarChanges();
+	}
+}
+
 void GameVM::Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel)
 {
 	int major = id >> 16;
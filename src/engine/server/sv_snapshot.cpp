@@ -34,6 +34,7 @@ Maryland 20850 USA.
 
 #include "server.h"
 #include "qcommon/sys.h"
+#include "common/VisBits.h"
 
 /*
 =============================================================================
@@ -59,8 +60,217 @@ A server packet will look something like:
 
 static Cvar::Cvar<bool> sv_novis("sv_novis", "skip PVS check when transmitting entities", 0, false);
 
+static Cvar::Cvar<bool> sv_snapshotPriority("sv_snapshotPriority",
+	"hold back the least important entity updates when a snapshot would exceed what the client's rate allows", Cvar::NONE, true);
+
 static Log::Logger bandwidthLog("server.bandwidth");
 
+// an update held back this many snapshots in a row is sent whatever the budget
+static const int SNAPSHOT_MAX_DEFERRALS = 3;
+
+struct snapshotEntityUpdate_t
+{
+	int  newindex; // -1 for a removal
+	int  oldindex; // -1 for a new entity
+	int  priority;
+	int  firstBit; // where the update is in snapshotUpdateMsg
+	int  bits;
+	int  uncompressedBits;
+	bool required;
+	bool deferred;
+};
+
+// the entity updates of the snapshot being written, in the order they are sent; each is
+// encoded once, which sizes it, and its bits are copied to the snapshot unless held back
+static std::vector<snapshotEntityUpdate_t> snapshotUpdates;
+static byte                                snapshotUpdateData[ MAX_MSGLEN ];
+static msg_t                               snapshotUpdateMsg;
+
+/*
+=============
+SV_SnapshotEntityPriority
+
+Updates held back in the previous snapshots come first, then the ones of other
+players and of entities the game wants sent explicitly, closer ones first.
+=============
+*/
+static int SV_SnapshotEntityPriority( const client_t *client, const clientSnapshot_t *frame, const entityState_t *state )
+{
+	sharedEntity_t *ent = SV_GentityNum( state->number );
+	vec3_t         center;
+
+	VectorAdd( ent->r.absmin, ent->r.absmax, center );
+	VectorScale( center, 0.5f, center );
+
+	int priority = client->entityDeferrals[ state->number ] * 2000;
+
+	priority -= std::min( static_cast<int>( Distance( center, frame->ps.origin ) ) / 8, 1000 );
+
+	if ( state->number < MAX_CLIENTS )
+	{
+		priority += 500;
+	}
+
+	if ( ent->r.svFlags & ( SVF_BROADCAST | SVF_SINGLECLIENT | SVF_CLIENTS_IN_RANGE ) )
+	{
+		priority += 250;
+	}
+
+	return priority;
+}
+
+static void SV_EncodeEntityUpdate( snapshotEntityUpdate_t update, entityState_t *from, entityState_t *to, bool force )
+{
+	int uncompsize = snapshotUpdateMsg.uncompsize;
+
+	update.firstBit = snapshotUpdateMsg.bit;
+	MSG_WriteDeltaEntity( &snapshotUpdateMsg, from, to, force );
+	update.bits = snapshotUpdateMsg.bit - update.firstBit;
+	update.uncompressedBits = snapshotUpdateMsg.uncompsize - uncompsize;
+
+	snapshotUpdates.push_back( update );
+}
+
+/*
+=============
+SV_PrioritisePacketEntities
+
+Encodes the entity updates of a snapshot to snapshotUpdates and, if they don't fit
+in budget bytes, marks the least important ones as held back. A held back entity
+keeps the state the client has in the frame, so the next snapshot deltas from it
+again. Entities new to the client and entities with an event are never held back,
+since temporary entities and events would expire before the client sees them.
+
+Returns false if the updates couldn't be encoded, then they must be written as usual.
+=============
+*/
+static bool SV_PrioritisePacketEntities( client_t *client, const clientSnapshot_t *from, clientSnapshot_t *to, int budget )
+{
+	static std::vector<snapshotEntityUpdate_t *> optional;
+	int fixedBits = 16 + GENTITYNUM_BITS; // entity count and terminator
+	int optionalBits = 0;
+
+	snapshotUpdates.clear();
+	optional.clear();
+	MSG_Init( &snapshotUpdateMsg, snapshotUpdateData, sizeof( snapshotUpdateData ) );
+
+	for ( int newindex = 0, oldindex = 0; newindex < to->num_entities || oldindex < from->num_entities; )
+	{
+		entityState_t *newent = newindex < to->num_entities
+		                        ? &svs.snapshotEntities[( to->first_entity + newindex ) % svs.numSnapshotEntities ] : nullptr;
+		entityState_t *oldent = oldindex < from->num_entities
+		                        ? &svs.snapshotEntities[( from->first_entity + oldindex ) % svs.numSnapshotEntities ] : nullptr;
+		int newnum = newent ? newent->number : MAX_GENTITIES;
+		int oldnum = oldent ? oldent->number : MAX_GENTITIES;
+
+		if ( newnum == oldnum )
+		{
+			if ( memcmp( oldent, newent, sizeof( entityState_t ) ) )
+			{
+				bool events = newent->event || newent->event != oldent->event || newent->eventSequence != oldent->eventSequence;
+				snapshotEntityUpdate_t update{};
+
+				update.newindex = newindex;
+				update.oldindex = oldindex;
+				update.required = events || client->entityDeferrals[ newnum ] >= SNAPSHOT_MAX_DEFERRALS;
+
+				if ( !update.required )
+				{
+					update.priority = SV_SnapshotEntityPriority( client, to, newent );
+				}
+
+				SV_EncodeEntityUpdate( update, oldent, newent, false );
+
+				if ( update.required )
+				{
+					fixedBits += snapshotUpdates.back().bits;
+					client->entityDeferrals[ newnum ] = 0;
+				}
+				else
+				{
+					optionalBits += snapshotUpdates.back().bits;
+				}
+			}
+			else
+			{
+				client->entityDeferrals[ newnum ] = 0;
+			}
+
+			oldindex++;
+			newindex++;
+		}
+		else if ( newnum < oldnum )
+		{
+			SV_EncodeEntityUpdate( { newindex, -1, 0, 0, 0, 0, true, false }, &sv.svEntities[ newnum ].baseline, newent, true );
+			fixedBits += snapshotUpdates.back().bits;
+			client->entityDeferrals[ newnum ] = 0;
+			newindex++;
+		}
+		else
+		{
+			SV_EncodeEntityUpdate( { -1, oldindex, 0, 0, 0, 0, true, false }, oldent, nullptr, true );
+			fixedBits += snapshotUpdates.back().bits;
+			oldindex++;
+		}
+	}
+
+	if ( snapshotUpdateMsg.overflowed )
+	{
+		return false;
+	}
+
+	int budgetBits = budget * 8 - fixedBits;
+
+	for ( snapshotEntityUpdate_t& update : snapshotUpdates )
+	{
+		if ( !update.required )
+		{
+			optional.push_back( &update );
+		}
+	}
+
+	// when nothing but the required updates fits, holding the others back would only
+	// delay them without bringing the snapshot within the budget
+	if ( optionalBits <= budgetBits || budgetBits <= 0 )
+	{
+		for ( const snapshotEntityUpdate_t *update : optional )
+		{
+			client->entityDeferrals[ svs.snapshotEntities[( to->first_entity + update->newindex ) % svs.numSnapshotEntities ].number ] = 0;
+		}
+
+		return true;
+	}
+
+	std::sort( optional.begin(), optional.end(), []( const snapshotEntityUpdate_t *a, const snapshotEntityUpdate_t *b ) {
+		return a->priority > b->priority;
+	} );
+
+	int deferred = 0;
+
+	for ( snapshotEntityUpdate_t *update : optional )
+	{
+		entityState_t *newent = &svs.snapshotEntities[( to->first_entity + update->newindex ) % svs.numSnapshotEntities ];
+		byte& deferrals = client->entityDeferrals[ newent->number ];
+
+		if ( update->bits <= budgetBits )
+		{
+			budgetBits -= update->bits;
+			deferrals = 0;
+			continue;
+		}
+
+		deferrals = std::min( deferrals + 1, 255 );
+		deferred++;
+		update->deferred = true;
+
+		*newent = svs.snapshotEntities[( from->first_entity + update->oldindex ) % svs.numSnapshotEntities ];
+	}
+
+	bandwidthLog.Debug( "%s^*: held back %d of %d entity updates to fit in %d bytes", client->name, deferred, optional.size(), budget );
+
+	return true;
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -68,15 +278,13 @@ SV_EmitPacketEntities
 Writes a delta update of an entityState_t list to the message.
 =============
 */
-static void SV_EmitPacketEntities( const clientSnapshot_t *from, clientSnapshot_t *to, msg_t *msg )
+static void SV_EmitPacketEntities( client_t *client, const clientSnapshot_t *from, clientSnapshot_t *to, msg_t *msg, int budget )
 {
 	entityState_t *oldent, *newent;
 	int           oldindex, newindex;
 	int           oldnum, newnum;
 	int           from_num_entities;
 
-    MSG_WriteShort(msg, to->num_entities);
-
 	// generate the delta update
 	if ( !from )
 	{
@@ -90,6 +298,35 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, clientSnapshot_
 		from_num_entities = from->num_entities;
 	}
 
+	// the message may already be over the budget, with a big playerstate or reliable commands
+	bool encoded = budget > msg->cursize && sv_snapshotPriority.Get() &&
+	               SV_PrioritisePacketEntities( client, from, to, budget - msg->cursize );
+
+    MSG_WriteShort(msg, to->num_entities);
+
+	if ( encoded )
+	{
+		// the updates sent are contiguous between the held back ones
+		int firstBit = 0;
+		int uncompressedBits = snapshotUpdateMsg.uncompsize;
+
+		for ( const snapshotEntityUpdate_t& update : snapshotUpdates )
+		{
+			if ( update.deferred )
+			{
+				MSG_WriteBitstream( msg, &snapshotUpdateMsg, firstBit, update.firstBit - firstBit );
+				firstBit = update.firstBit + update.bits;
+				uncompressedBits -= update.uncompressedBits;
+			}
+		}
+
+		MSG_WriteBitstream( msg, &snapshotUpdateMsg, firstBit, snapshotUpdateMsg.bit - firstBit );
+		msg->uncompsize += uncompressedBits;
+
+		MSG_WriteBits( msg, ( MAX_GENTITIES - 1 ), GENTITYNUM_BITS );  // end of packetentities
+		return;
+	}
+
 	newent = nullptr;
 	oldent = nullptr;
 	newindex = 0;
@@ -153,7 +390,7 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, clientSnapshot_
 SV_WriteSnapshotToClient
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg )
+static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg, int budget )
 {
 	clientSnapshot_t *frame, *oldframe;
 	int              lastframe;
@@ -225,18 +462,16 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg )
 
 	{
 		// delta encode the playerstate
-		if ( oldframe )
-		{
-			MSG_WriteDeltaPlayerstate( msg, &oldframe->ps, &frame->ps );
-		}
-		else
-		{
-			MSG_WriteDeltaPlayerstate( msg, nullptr, &frame->ps );
-		}
+		// a new field order is only started when this message is sent right away, so that
+		// acknowledging its sequence means the client got the order
+		bool canSendOrder = !client->netchan.unsentFragments && !client->netchan_start_queue;
+
+		MSG_WriteDeltaPlayerstate( msg, oldframe ? &oldframe->ps : nullptr, &frame->ps, &client->psDelta,
+		                           client->netchan.outgoingSequence, client->messageAcknowledge, canSendOrder );
 	}
 
 	// delta encode the entities
-	SV_EmitPacketEntities( oldframe, frame, msg );
+	SV_EmitPacketEntities( client, oldframe, frame, msg, budget );
 
 	// padding for rate debugging
 	if ( sv_padPackets.Get() )
@@ -482,7 +717,7 @@ static void SV_AddEntitiesVisibleFromPoint( client_t* client, vec3_t origin, cli
 		// Gordon: just check origin for being in pvs, ignore bmodel extents
 		if ( ent->r.svFlags & SVF_IGNOREBMODELEXTENTS )
 		{
-			if ( bitvector[ ent->r.originCluster >> 3 ] & ( 1 << ( ent->r.originCluster & 7 ) ) )
+			if ( VisBits::Test( bitvector, ent->r.originCluster ) )
 			{
 				SV_AddEntToSnapshot( svEnt, ent, eNums );
 			}
@@ -514,7 +749,7 @@ static void SV_AddEntitiesVisibleFromPoint( client_t* client, vec3_t origin, cli
 		{
 			l = ent->r.clusternums[ i ];
 
-			if ( bitvector[ l >> 3 ] & ( 1 << ( l & 7 ) ) )
+			if ( VisBits::Test( bitvector, l ) )
 			{
 				break;
 			}
@@ -526,15 +761,9 @@ static void SV_AddEntitiesVisibleFromPoint( client_t* client, vec3_t origin, cli
 		{
 			if ( ent->r.lastCluster )
 			{
-				for ( ; l <= ent->r.lastCluster; l++ )
-				{
-					if ( bitvector[ l >> 3 ] & ( 1 << ( l & 7 ) ) )
-					{
-						break;
-					}
-				}
-
-				if ( l == ent->r.lastCluster )
+				// culled only when the first visible overflow cluster is the last one
+				if ( l < ent->r.lastCluster && !VisBits::AnyInRange( bitvector, l, ent->r.lastCluster - 1 )
+				     && VisBits::Test( bitvector, ent->r.lastCluster ) )
 				{
 					continue;
 				}
@@ -676,6 +905,8 @@ static void SV_BuildClientSnapshot( client_t *client )
 	sharedEntity_t          *clent;
 	int                     clientNum;
 
+	SV_PROFILE_ZONE( SV_BuildClientSnapshot );
+
 	// bump the counter used to prevent double adding
 	sv.snapshotCounter++;
 
@@ -774,18 +1005,25 @@ TTimo - use sv_maxRate or sv_dl_maxRate depending on regular or downloading clie
 ====================
 */
 static const int HEADER_RATE_BYTES = 48; // include our header, IP header, and some overhead
+static int SV_ClientRate( client_t *client );
+
 static int SV_RateMsec( client_t *client, int messageSize )
 {
-	int rate;
-	int rateMsec;
-	int maxRate;
-
 	// individual messages will never be larger than fragment size
 	if ( messageSize > 1500 )
 	{
 		messageSize = 1500;
 	}
 
+	return ( messageSize + HEADER_RATE_BYTES ) * 1000 / SV_ClientRate( client );
+}
+
+// bytes / second the messages to a client are limited to
+static int SV_ClientRate( client_t *client )
+{
+	int rate;
+	int maxRate;
+
 	// low watermark for sv_maxRate, never 0 < sv_maxRate < 1000 (0 is no limitation)
 	if ( sv_maxRate.Get() > 0 && sv_maxRate.Get() < NETWORK_MIN_RATE )
 	{
@@ -810,9 +1048,31 @@ static int SV_RateMsec( client_t *client, int messageSize )
 		rate = std::min( rate, maxRate );
 	}
 
-	rateMsec = ( messageSize + HEADER_RATE_BYTES ) * 1000 / rate;
+	return rate;
+}
+
+/*
+====================
+SV_SnapshotBudget
 
-	return rateMsec;
+Returns how many bytes a snapshot can take without SV_RateMsec delaying the next
+one past snapshotMsec, nor being fragmented, or 0 when it isn't limited
+====================
+*/
+static const int SNAPSHOT_MIN_BUDGET = 400;
+static const int SNAPSHOT_MAX_BUDGET = 1200; // a bit less than the netchan's fragment size
+static int SV_SnapshotBudget( client_t *client )
+{
+	// local clients get snapshots every frame
+	if ( client->netchan.remoteAddress.type == netadrtype_t::NA_LOOPBACK ||
+	     ( sv_lanForceRate.Get() && Sys_IsLANAddress( client->netchan.remoteAddress ) ) )
+	{
+		return 0;
+	}
+
+	int budget = SV_ClientRate( client ) * client->snapshotMsec / 1000 - HEADER_RATE_BYTES;
+
+	return Math::Clamp( budget, SNAPSHOT_MIN_BUDGET, SNAPSHOT_MAX_BUDGET );
 }
 
 /*
@@ -971,7 +1231,7 @@ void SV_SendClientSnapshot( client_t *client )
 
 	// send over all the relevant entityState_t
 	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+	SV_WriteSnapshotToClient( client, &msg, SV_SnapshotBudget( client ) );
 
 	// Add any download data if the client is downloading
 	SV_WriteDownloadToClient( client, &msg );
@@ -1003,6 +1263,8 @@ void SV_SendClientMessages()
 	client_t *c;
 	int      numclients = 0; // NERVE - SMF - net debugging
 
+	SV_PROFILE_ZONE( SV_SendClientMessages );
+
 	sv.bpsTotalBytes = 0; // NERVE - SMF - net debugging
 	sv.ubpsTotalBytes = 0; // NERVE - SMF - net debugging
 
@@ -285,6 +285,9 @@ namespace Cvar{
         std::string description;
         int flags;
         std::string defaultValue;
+
+        // Position in cvarHandles once registered with the engine
+        int handle = -1;
     };
 
     using CvarMap = std::unordered_map<std::string, CvarRecord>;
@@ -294,9 +297,15 @@ namespace Cvar{
         return map;
     }
 
+    // The engine refers to our cvars by the order in which they were registered
+    static std::vector<CvarRecord*> cvarHandles;
+
     static bool cvarsInitialized = false;
 
     void RegisterCvarRPC(const std::string& name, std::string description, int flags, std::string defaultValue) {
+        CvarRecord& record = GetCvarMap()[name];
+        record.handle = cvarHandles.size();
+        cvarHandles.push_back(&record);
         VM::SendMsg<VM::RegisterCvarMsg>(name, description, flags, defaultValue);
     }
 
@@ -331,6 +340,13 @@ namespace Cvar{
     }
 
     void SetValue(const std::string& name, const std::string& value) {
+        const CvarMap& map = GetCvarMap();
+        auto it = map.find(name);
+        if (it != map.end() && it->second.handle >= 0) { // Saves the engine a lookup by name
+            VM::SendMsg<VM::SetCvarHandleMsg>(it->second.handle, value);
+            return;
+        }
+
         VM::SendMsg<VM::SetCvarMsg>(name, value);
     }
 
@@ -364,12 +380,39 @@ namespace Cvar{
         });
     }
 
+    void CallOnValueChangedBatchSyscall(Util::Reader& reader, IPC::Channel& channel) {
+        IPC::HandleMsg<VM::OnValueChangedBatchMsg>(channel, std::move(reader), [](std::vector<std::pair<int, std::string>> changes, std::vector<std::pair<bool, std::string>>& results) {
+            results.reserve(changes.size());
+
+            for (auto& change: changes) {
+                if (change.first < 0 || change.first >= (int) cvarHandles.size()) {
+                    Log::Warn("Cvar handle %i not registered here", change.first);
+                    results.emplace_back(true, "");
+                    continue;
+                }
+
+                CvarRecord& record = *cvarHandles[change.first];
+                auto res = record.cvar->OnValueChanged(change.second);
+
+                if (res.success) {
+                    record.currentValue = std::move(change.second); // Update cache
+                }
+
+                results.emplace_back(res.success, std::move(res.description));
+            }
+        });
+    }
+
     void HandleSyscall(int minor, Util::Reader& reader, IPC::Channel& channel) {
         switch (minor) {
             case VM::ON_VALUE_CHANGED:
                 CallOnValueChangedSyscall(reader, channel);
                 break;
 
+            case VM::ON_VALUE_CHANGED_BATCH:
+                CallOnValueChangedBatchSyscall(reader, channel);
+                break;
+
             default:
                 Sys::Drop("Unhandled engine cvar syscall %i", minor);
         }
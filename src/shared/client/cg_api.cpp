@@ -453,6 +453,11 @@ int trap_R_BuildSkeleton( refSkeleton_t *skel, qhandle_t anim, int startFrame, i
 	return result;
 }
 
+void trap_R_BuildSkeletons( const std::vector<skeletonRequest_t>& requests, std::vector<refSkeleton_t>& skels, std::vector<int>& results )
+{
+	VM::SendMsg<Render::BuildSkeletonsMsg>(requests, skels, results);
+}
+
 // Shamelessly stolen from tr_animation.cpp
 int trap_R_BlendSkeleton( refSkeleton_t *skel, const refSkeleton_t *blend, float frac )
 {